@@ -546,9 +546,9 @@ void DPTreephaser::AdvanceState(TreephaserPath *child, const TreephaserPath *par
     child->calibA = parent->calibA;
     // Log zero mer flow coefficients
     for (int flow = parent->flow+1; flow < child->flow; flow++)
-      child->calibA.at(flow) = (*As_).at(flow).at(flow_order_.int_at(flow)).at(0);
+      child->calibA.at(flow) = recal_table_->AB(flow, flow_order_.int_at(flow), 0)[0];
     if (child->flow < max_flow)
-      child->calibA.at(child->flow) = (*As_).at(child->flow).at(flow_order_.int_at(child->flow)).at(calib_hp);
+      child->calibA.at(child->flow) = recal_table_->AB(child->flow, flow_order_.int_at(child->flow), calib_hp)[0];
   }
   // ---
 
@@ -596,13 +596,14 @@ void DPTreephaser::AdvanceState(TreephaserPath *child, const TreephaserPath *par
       else {
         // Inverse recalibration operation for active flow
         float original_prediction = parent->prediction.at(flow);
-        if (child->last_hp > 1 and (*As_).at(flow).at(flow_order_.int_at(flow)).at(child->last_hp-1) > 0) {
-        original_prediction = (parent->prediction.at(flow) - (*Bs_).at(flow).at(flow_order_.int_at(flow)).at(child->last_hp-1))
-                              / (*As_).at(flow).at(flow_order_.int_at(flow)).at(child->last_hp-1);
+        if (child->last_hp > 1) {
+          const float *prev_ab = recal_table_->AB(flow, flow_order_.int_at(flow), child->last_hp-1);
+          if (prev_ab[0] > 0)
+            original_prediction = (parent->prediction.at(flow) - prev_ab[1]) / prev_ab[0];
         }
         // Apply recalibration for the flow where we changed a base
         child->prediction[flow] = ( (original_prediction + child->state[flow]) * child->calibA.at(flow) )
-   		                          + (*Bs_).at(flow).at(flow_order_.int_at(flow)).at(calib_hp);
+   		                          + recal_table_->AB(flow, flow_order_.int_at(flow), calib_hp)[1];
       }
     }
     else {
@@ -614,7 +615,7 @@ void DPTreephaser::AdvanceState(TreephaserPath *child, const TreephaserPath *par
     if (recalibrate_predictions_ and flow <= child->flow) {
       child->prediction[flow] = child->state[flow] * child->calibA.at(flow);
       if (flow == child->flow)
-        child->prediction[flow] += (*Bs_).at(flow).at(flow_order_.int_at(flow)).at(calib_hp);
+        child->prediction[flow] += recal_table_->AB(flow, flow_order_.int_at(flow), calib_hp)[1];
     }
     else {
       // The simple no HP recalibration case
@@ -657,8 +658,8 @@ void DPTreephaser::AdvanceStateInPlace(TreephaserPath *state, char nuc, int max_
   // --- Maintaining recalibration data structures & logging coefficients for this path
   if (recalibrate_predictions_) {
     for (int flow = old_flow+1; flow < state->flow; flow++)
-      state->calibA.at(flow) = (*As_).at(flow).at(flow_order_.int_at(flow)).at(0);
-    state->calibA.at(state->flow) = (*As_).at(state->flow).at(flow_order_.int_at(state->flow)).at(calib_hp);
+      state->calibA.at(flow) = recal_table_->AB(flow, flow_order_.int_at(flow), 0)[0];
+    state->calibA.at(state->flow) = recal_table_->AB(state->flow, flow_order_.int_at(state->flow), calib_hp)[0];
   }
   // ---
 
@@ -692,14 +693,15 @@ void DPTreephaser::AdvanceStateInPlace(TreephaserPath *state, char nuc, int max_
       }
       else {
         float original_prediction = state->prediction[flow];
-	    if (state->last_hp > 1 and (*As_).at(flow).at(flow_order_.int_at(flow)).at(state->last_hp-1) > 0) {
-          // Invert re-calibration operation for active flow
-	      original_prediction = ( state->prediction[flow] - (*Bs_).at(flow).at(flow_order_.int_at(flow)).at(state->last_hp-1) )
-	                            / (*As_).at(flow).at(flow_order_.int_at(flow)).at(state->last_hp-1);
+	    if (state->last_hp > 1) {
+	      const float *prev_ab = recal_table_->AB(flow, flow_order_.int_at(flow), state->last_hp-1);
+	      // Invert re-calibration operation for active flow
+	      if (prev_ab[0] > 0)
+	        original_prediction = ( state->prediction[flow] - prev_ab[1] ) / prev_ab[0];
 	    }
 	    // Apply recalibration for the flow where we changed a base
 	    state->prediction[flow] = ( (original_prediction + state->state[flow]) * state->calibA.at(flow) )
-	    		                  + (*Bs_).at(flow).at(flow_order_.int_at(flow)).at(calib_hp);
+	    		                  + recal_table_->AB(flow, flow_order_.int_at(flow), calib_hp)[1];
       }
 	}
 	else
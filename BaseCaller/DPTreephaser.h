@@ -13,6 +13,7 @@
 #include "BaseCallerUtils.h"
 #include "SystemMagicDefines.h"
 #include "PIDloop.h"
+#include "RecalibrationModel.h"
 
 using namespace std;
 
@@ -172,11 +173,10 @@ public:
   void  PIDNormalize(BasecallerRead& read, const int num_samples);
   float PIDNormalize(BasecallerRead& read, const int start_flow, const int end_flow);
 
-  //! @brief     Set pointers to recalibration model
-  bool SetAsBs(const vector<vector< vector<float> > > *As, const vector<vector< vector<float> > > *Bs){
-    As_ = As;
-    Bs_ = Bs;
-    pm_model_available_ = (As_ != NULL) and (Bs_ != NULL);
+  //! @brief     Set pointer to the compiled recalibration model of the read's region
+  bool SetAsBs(const RecalibrationTable *recal_table){
+    recal_table_ = recal_table;
+    pm_model_available_ = (recal_table_ != NULL);
     recalibrate_predictions_ = pm_model_available_; // We bothered loading the model, of course we want to use it!
     return(pm_model_available_);
   };
@@ -191,7 +191,7 @@ public:
   void DisableRecalibration() {
     pm_model_available_ = false;
     recalibrate_predictions_ = false;
-    As_ = 0; Bs_ = 0;
+    recal_table_ = 0;
   };
 
   //! @brief    Treephaser's slot for partial base sequence, complete with tree search metrics and state for extending
@@ -288,8 +288,7 @@ protected:
   const static float  kDgainG       = 0.0f;
   const static float  kInitGain     = 1.0f;
 
-  const vector< vector< vector<float> > > *As_; //!< Pointer to recalibration structure: multiplicative constant
-  const vector< vector< vector<float> > > *Bs_; //!< Pointer to recalibration structure: additive constant
+  const RecalibrationTable *recal_table_;       //!< Pointer to recalibration structure: {multiplicative, additive} constants
   bool pm_model_available_;                     //!< Signals availability of a recalibration model
   bool recalibrate_predictions_;                //!< Switch to use recalibration model during metric generation
   bool skip_recal_during_normalization_;        //!< Switch to skip recalibration during the normalization phase
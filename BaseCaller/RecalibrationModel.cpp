@@ -20,6 +20,32 @@ int NuctoInt(char nuc) {
     }
 }
 
+const float RecalibrationTable::kIdentityAB[2] = {1.0f, 0.0f};
+
+void RecalibrationTable::Compile(const vector<vector<vector<float> > > &As, const vector<vector<vector<float> > > &Bs)
+{
+    num_flows = min(As.size(), Bs.size());
+    num_hps = 0;
+    for (int flow = 0; flow < num_flows; ++flow)
+      for (unsigned int nuc = 0; nuc < As[flow].size() and nuc < 4; ++nuc)
+        num_hps = max(num_hps, (int)As[flow][nuc].size());
+
+    ab.assign(num_flows * 4 * num_hps * 2, 0.0f);
+    for (int flow = 0; flow < num_flows; ++flow) {
+      for (int nuc = 0; nuc < 4; ++nuc) {
+        for (int hp = 0; hp < num_hps; ++hp) {
+          float *entry = &ab[(((flow << 2) + nuc) * num_hps + hp) << 1];
+          bool modeled = nuc < (int)As[flow].size() and hp < (int)As[flow][nuc].size()
+                     and nuc < (int)Bs[flow].size() and hp < (int)Bs[flow][nuc].size();
+          entry[0] = modeled ? As[flow][nuc][hp] : 1.0f;
+          entry[1] = modeled ? Bs[flow][nuc][hp] : 0.0f;
+        }
+      }
+    }
+}
+
+// --------------------------------------------------------------------
+
 RecalibrationModel::RecalibrationModel()
 {
     is_enabled_ = false;
@@ -107,6 +133,7 @@ void RecalibrationModel::InitializeFromJSON(Json::Value &recal_params, string &m
         // note we only fill >in< flows fit by the recalibration model
         FillIndexes(offsetRegion,nucInd, refHP, flowStart, flowEnd, paramA, paramB);        
     }
+   CompileTables();
    // now we're done!
    if (spam_enabled)
     printf("Recalibration: enabled (using recalibration comment %s)\n\n", my_block_key.c_str());
@@ -201,6 +228,7 @@ bool RecalibrationModel::InitializeModel(string model_file_name, int model_thres
     }
 
     model_file.close();
+    CompileTables();
 
     printf("Recalibration Model: enabled (using calibration file %s)\n", model_file_name.c_str());
     printf(" - using calibration model for HPs %d and up.\n\n",recalModelHPThres);
@@ -216,6 +244,13 @@ void RecalibrationModel::FillIndexes(int offsetRegion, int nucInd, int refHP, in
     }
 }
 
+void RecalibrationModel::CompileTables() {
+    int num_regions = min(stratifiedAs.size(), stratifiedBs.size());
+    compiledAB.assign(num_regions, RecalibrationTable());
+    for (int ind = 0; ind < num_regions; ++ind)
+      compiledAB[ind].Compile(stratifiedAs[ind], stratifiedBs[ind]);
+}
+
 void RecalibrationModel::getAB(MultiAB &multi_ab, int x, int y) const {
      if (!is_enabled_) {
        multi_ab.Null();
@@ -229,6 +264,7 @@ void RecalibrationModel::getAB(MultiAB &multi_ab, int x, int y) const {
     else{
       multi_ab.aPtr = &(stratifiedAs[offsetRegion]);
       multi_ab.bPtr = &(stratifiedBs[offsetRegion]);
+      multi_ab.table = (offsetRegion < (int)compiledAB.size()) ? &(compiledAB[offsetRegion]) : 0;
     }
 }
 
@@ -56,13 +56,42 @@ class RegionStratification{
   };
 };
 
+//! @brief    Recalibration coefficients of one chip region in a single contiguous block
+//! @ingroup  BaseCaller
+//! Flow-major, hp-minor; A and B of an entry are adjacent so that both come from one indexed load.
+//! Entry (flow, nuc, hp) starts at ab[((flow*4 + nuc)*num_hps + hp)*2]. Read-only once compiled.
+
+class RecalibrationTable {
+  public:
+    int            num_flows;
+    int            num_hps;
+    vector<float>  ab;
+
+    RecalibrationTable() : num_flows(0), num_hps(0) {};
+
+    void Compile(const vector<vector<vector<float> > > &As, const vector<vector<vector<float> > > &Bs);
+
+    //! @brief  Pointer to the {A,B} pair of this flow, nucleotide and hp length; identity past the modeled flows.
+    //!         Homopolymers longer than the table use its last hp bin.
+    const float * AB(int flow, int nuc, int hp) const {
+      if (flow >= num_flows)
+        return kIdentityAB;
+      if (hp >= num_hps)
+        hp = num_hps - 1;
+      return &ab[(((flow << 2) + nuc) * num_hps + hp) << 1];
+    };
+
+    static const float kIdentityAB[2];
+};
+
 class MultiAB{
   public:
     const vector<vector<vector<float> > > * aPtr;
     const vector<vector<vector<float> > > * bPtr;
+    const RecalibrationTable * table;
 
-    MultiAB(){aPtr=0; bPtr = 0;};
-    void Null(){aPtr=0; bPtr = 0;};
+    MultiAB(){aPtr=0; bPtr = 0; table = 0;};
+    void Null(){aPtr=0; bPtr = 0; table = 0;};
     bool Valid(){return (aPtr != 0 && bPtr != 0);};
 };
 
@@ -97,6 +126,9 @@ public:
 
   void SaveModelFileToBamComments(string model_file_name, vector<string> &comments, const string &run_id, int block_col_offset, int block_row_offset);
 
+  //! @brief  Rebuild compiledAB from stratifiedAs and stratifiedBs
+  void CompileTables();
+
 
 //protected:
   bool is_enabled_;
@@ -104,6 +136,7 @@ public:
   int recalModelHPThres;
   vector<vector< vector< vector<float> > > > stratifiedAs;
   vector<vector< vector< vector<float> > > > stratifiedBs;
+  vector<RecalibrationTable> compiledAB;     //!< Flat copy of stratifiedAs/Bs per region, used by the treephasers
   RegionStratification stratification;
 
 };
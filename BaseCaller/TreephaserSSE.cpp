@@ -1126,8 +1126,9 @@ bool TreephaserSSE::Solve(int begin_flow, int end_flow)
       }
       // Recalibration part of the initial simulation: log coefficients for simulation part
       if(recalibrate_predictions_) {
-        parent->calib_A[parent->flow] = (*As_).at(parent->flow).at(flow_order_.int_at(parent->flow)).at(parent->last_hp);
-        parent->calib_B[parent->flow] = (*Bs_).at(parent->flow).at(flow_order_.int_at(parent->flow)).at(parent->last_hp);
+        const float *recal_ab = recal_table_->AB(parent->flow, flow_order_.int_at(parent->flow), parent->last_hp);
+        parent->calib_A[parent->flow] = recal_ab[0];
+        parent->calib_B[parent->flow] = recal_ab[1];
       }
       if (parent->flow >= begin_flow)
         break;
@@ -1360,8 +1361,9 @@ bool TreephaserSSE::Solve(int begin_flow, int end_flow)
             child->calib_B[tempInd] = 0.0f;
           }
           int hp_length = min(child->last_hp, MAX_HPXLEN);
-          child->calib_A[child->flow] = (*As_).at(child->flow).at(flow_order_.int_at(child->flow)).at(hp_length);
-          child->calib_B[child->flow] = (*Bs_).at(child->flow).at(flow_order_.int_at(child->flow)).at(hp_length);
+          const float *recal_ab = recal_table_->AB(child->flow, flow_order_.int_at(child->flow), hp_length);
+          child->calib_A[child->flow] = recal_ab[0];
+          child->calib_B[child->flow] = recal_ab[1];
         }
         ++pathCnt;
       }
@@ -1395,8 +1397,9 @@ bool TreephaserSSE::Solve(int begin_flow, int end_flow)
           parent->calib_A[tempInd] = 1.0f;
           parent->calib_B[tempInd] = 0.0f;
         }
-        parent->calib_A[parent->flow] = (*As_).at(parent->flow).at(flow_order_.int_at(parent->flow)).at(parent->last_hp);
-        parent->calib_B[parent->flow] = (*Bs_).at(parent->flow).at(flow_order_.int_at(parent->flow)).at(parent->last_hp);
+        const float *recal_ab = recal_table_->AB(parent->flow, flow_order_.int_at(parent->flow), parent->last_hp);
+        parent->calib_A[parent->flow] = recal_ab[0];
+        parent->calib_B[parent->flow] = recal_ab[1];
       }
 
       if(state_inphase_enabled_){
@@ -1567,8 +1570,9 @@ void  TreephaserSSE::ComputeQVmetrics(BasecallerRead& read)
       int called_nuc = -1;
 
       if(recalibrate_predictions_) {
-        parent->calib_A[parent->flow] = (*As_).at(parent->flow).at(flow_order_.int_at(parent->flow)).at(parent->last_hp);
-        parent->calib_B[parent->flow] = (*Bs_).at(parent->flow).at(flow_order_.int_at(parent->flow)).at(parent->last_hp);
+        const float *recal_ab = recal_table_->AB(parent->flow, flow_order_.int_at(parent->flow), parent->last_hp);
+        parent->calib_A[parent->flow] = recal_ab[0];
+        parent->calib_B[parent->flow] = recal_ab[1];
       }
 
       // compute child path flow states, predicted signal,negative and positive penalties
@@ -102,11 +102,10 @@ public:
   PathRec* parent;
   int best;
 
-  //! @brief     Set pointers to recalibration model
-  bool SetAsBs(const vector<vector< vector<float> > > *As, const vector<vector< vector<float> > > *Bs){
-    As_ = As;
-    Bs_ = Bs;
-    pm_model_available_ = (As_ != NULL) and (Bs_ != NULL);
+  //! @brief     Set pointer to the compiled recalibration model of the read's region
+  bool SetAsBs(const RecalibrationTable *recal_table){
+    recal_table_ = recal_table;
+    pm_model_available_ = (recal_table_ != NULL);
     recalibrate_predictions_ = pm_model_available_; // We bothered loading the model, of course we want to use it!
     return pm_model_available_;
   };
@@ -121,7 +120,7 @@ public:
   void DisableRecalibration() {
     pm_model_available_ = false;
     recalibrate_predictions_ = false;
-    As_ = 0; Bs_ = 0;
+    recal_table_ = 0;
   };
 
   //! @brief  Switch to disable / enable the use of recalibration during the normalization phase
@@ -178,8 +177,7 @@ protected:
   int windowSize_;                              //!< Adaptive normalization window size
   double              my_cf_;                   //!< Stores the cf phasing parameter used to compute transitions
   double              my_ie_;                   //!< Stores the ie phasing parameter used to compute transitions
-  const vector< vector< vector<float> > > *As_; //!< Pointer to recalibration structure: multiplicative constant
-  const vector< vector< vector<float> > > *Bs_; //!< Pointer to recalibration structure: additive constant
+  const RecalibrationTable *recal_table_;       //!< Pointer to recalibration structure: {multiplicative, additive} constants
   bool pm_model_available_;                     //!< Signals availability of a recalibration model
   bool recalibrate_predictions_;                //!< Switch to use recalibration model during metric generation
   bool skip_recal_during_normalization_;        //!< Switch to skip recalibration during the normalization phase
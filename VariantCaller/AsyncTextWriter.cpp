@@ -0,0 +1,179 @@
+/* Copyright (C) 2013 Ion Torrent Systems, Inc. All Rights Reserved */
+
+//! @file     AsyncTextWriter.cpp
+//! @ingroup  VariantCaller
+//! @brief    Text file output on a dedicated thread, plain or BGZF-compressed with tabix index
+
+#include "AsyncTextWriter.h"
+
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+
+#include "tabixpp/bgzf.h"
+#include "tabixpp/tabix.h"
+
+static const int kMaxQueuedBlocks = 256;    // Callers hand over large blocks, so this is rarely reached
+
+
+AsyncTextWriter::AsyncTextWriter()
+{
+  plain_output_ = NULL;
+  bgzf_output_ = NULL;
+  closing_ = false;
+  vcf_text_ = true;
+  sorted_ = true;
+  last_position_ = 0;
+  pthread_mutex_init(&queue_mutex_, NULL);
+  pthread_cond_init(&queue_not_empty_, NULL);
+  pthread_cond_init(&queue_not_full_, NULL);
+}
+
+AsyncTextWriter::~AsyncTextWriter()
+{
+  Close();
+  pthread_mutex_destroy(&queue_mutex_);
+  pthread_cond_destroy(&queue_not_empty_);
+  pthread_cond_destroy(&queue_not_full_);
+}
+
+
+void AsyncTextWriter::Initialize(const string& filename, bool bgzf, bool vcf_text)
+{
+  filename_ = filename;
+  vcf_text_ = vcf_text;
+  if (bgzf)
+    bgzf_output_ = _bgzf_open(filename.c_str(), "w");
+  else
+    plain_output_ = fopen(filename.c_str(), "w");
+  if (not IsOpen()) {
+    cerr << "ERROR: Cannot open output file " << filename << " : " << strerror(errno) << endl;
+    exit(1);
+  }
+  if (plain_output_)
+    setvbuf(plain_output_, NULL, _IOFBF, 1<<20);
+  closing_ = false;
+
+  if (pthread_create(&writer_thread_, NULL, AsyncTextWriter::WriterThread, this)) {
+    cerr << "ERROR: Cannot start output thread for " << filename << endl;
+    exit(1);
+  }
+}
+
+
+void AsyncTextWriter::Write(string& text)
+{
+  if (text.empty())
+    return;
+  pthread_mutex_lock(&queue_mutex_);
+  while (queue_.size() >= (unsigned int)kMaxQueuedBlocks)
+    pthread_cond_wait(&queue_not_full_, &queue_mutex_);
+  queue_.push_back(string());
+  queue_.back().swap(text);
+  pthread_mutex_unlock(&queue_mutex_);
+  pthread_cond_signal(&queue_not_empty_);
+}
+
+
+void * AsyncTextWriter::WriterThread(void *input)
+{
+  AsyncTextWriter& writer = *static_cast<AsyncTextWriter*>(input);
+  deque<string> batch;
+
+  while (true) {
+    pthread_mutex_lock(&writer.queue_mutex_);
+    while (writer.queue_.empty() and not writer.closing_)
+      pthread_cond_wait(&writer.queue_not_empty_, &writer.queue_mutex_);
+    bool done = writer.queue_.empty() and writer.closing_;
+    batch.swap(writer.queue_);
+    pthread_mutex_unlock(&writer.queue_mutex_);
+    pthread_cond_broadcast(&writer.queue_not_full_);
+
+    if (done)
+      break;
+    for (deque<string>::iterator text = batch.begin(); text != batch.end(); ++text)
+      writer.WriteText(*text);
+    batch.clear();
+  }
+  return NULL;
+}
+
+
+void AsyncTextWriter::WriteText(const string& text)
+{
+  bool failed;
+  if (plain_output_)
+    failed = fwrite(text.data(), 1, text.size(), plain_output_) != text.size();
+  else {
+    if (vcf_text_)
+      CheckSortOrder(text);
+    failed = _bgzf_write((BGZF*)bgzf_output_, text.data(), text.size()) != (int)text.size();
+  }
+  if (failed) {
+    cerr << "ERROR: Cannot write to output file " << filename_ << " : " << strerror(errno) << endl;
+    exit(1);
+  }
+}
+
+
+// tabix exits the process on unsorted input, so find out beforehand
+void AsyncTextWriter::CheckSortOrder(const string& text)
+{
+  for (size_t line_start = 0; sorted_ and line_start < text.size(); ) {
+    size_t line_end = text.find('\n', line_start);
+    if (line_end == string::npos)
+      line_end = text.size();
+    if (text[line_start] != '#') {
+      size_t tab = text.find('\t', line_start);
+      if (tab == string::npos or tab > line_end)
+        tab = line_end;
+      long position = atol(text.c_str() + min(tab+1, line_end));
+      if (text.compare(line_start, tab-line_start, last_contig_) == 0) {
+        if (position < last_position_)
+          sorted_ = false;
+      } else {
+        finished_contigs_.insert(last_contig_);
+        last_contig_.assign(text, line_start, tab-line_start);
+        if (finished_contigs_.count(last_contig_))
+          sorted_ = false;
+      }
+      last_position_ = position;
+    }
+    line_start = line_end + 1;
+  }
+}
+
+
+void AsyncTextWriter::Close()
+{
+  if (not IsOpen())
+    return;
+
+  pthread_mutex_lock(&queue_mutex_);
+  closing_ = true;
+  pthread_mutex_unlock(&queue_mutex_);
+  pthread_cond_signal(&queue_not_empty_);
+  pthread_join(writer_thread_, NULL);
+
+  if (plain_output_) {
+    if (fclose(plain_output_))
+      cerr << "ERROR: Cannot finish writing output file " << filename_ << " : " << strerror(errno) << endl;
+    plain_output_ = NULL;
+    return;
+  }
+
+  if (_bgzf_close((BGZF*)bgzf_output_))
+    cerr << "ERROR: Cannot finish writing output file " << filename_ << endl;
+  bgzf_output_ = NULL;
+  if (not vcf_text_)
+    return;
+  if (not sorted_) {
+    cerr << "WARNING: " << filename_ << " is not sorted, no tabix index is written" << endl;
+    return;
+  }
+  // Same as "tabix -p vcf", the index ends up in filename.tbi
+  if (ti_index_build(filename_.c_str(), &ti_conf_vcf))
+    cerr << "WARNING: Cannot build tabix index for " << filename_ << endl;
+}
@@ -0,0 +1,57 @@
+/* Copyright (C) 2013 Ion Torrent Systems, Inc. All Rights Reserved */
+
+//! @file     AsyncTextWriter.h
+//! @ingroup  VariantCaller
+//! @brief    Text file output on a dedicated thread, plain or BGZF-compressed with tabix index
+
+#ifndef ASYNCTEXTWRITER_H
+#define ASYNCTEXTWRITER_H
+
+#include <stdio.h>
+#include <string>
+#include <deque>
+#include <set>
+#include <pthread.h>
+
+using namespace std;
+
+
+class AsyncTextWriter {
+public:
+  AsyncTextWriter();
+  ~AsyncTextWriter();
+
+  //! @brief  Open the file and start the output thread. With bgzf set, the file is block-gzipped,
+  //!         and if it holds VCF text it gets a tabix index when closed.
+  void Initialize(const string& filename, bool bgzf, bool vcf_text = true);
+  bool IsOpen() const { return plain_output_ != NULL or bgzf_output_ != NULL; }
+
+  //! @brief  Queue a block of whole lines for writing; text is swapped out
+  void Write(string& text);
+
+  //! @brief  Drain the queue and close the file. A BGZF VCF file also gets a tabix index.
+  void Close();
+
+private:
+  static void * WriterThread(void *input);
+  void WriteText(const string& text);
+  void CheckSortOrder(const string& text);
+
+  FILE *                        plain_output_;      //! Uncompressed output file
+  void *                        bgzf_output_;       //! BGZF output file, from vcflib's tabix code
+  string                        filename_;          //! Output file name
+  deque<string>                 queue_;             //! Text blocks waiting for the output thread
+  bool                          closing_;           //! No more text will be queued
+  pthread_t                     writer_thread_;     //! Thread doing compression and file output
+  pthread_mutex_t               queue_mutex_;       //! Mutex protecting queue_ and closing_
+  pthread_cond_t                queue_not_empty_;   //! Signals the output thread
+  pthread_cond_t                queue_not_full_;    //! Signals producers waiting for queue space
+  bool                          vcf_text_;          //! Output is VCF text, not binary
+  bool                          sorted_;            //! Records so far are sorted, so tabix can index them
+  string                        last_contig_;       //! Contig of the last record
+  long                          last_position_;     //! Position of the last record
+  set<string>                   finished_contigs_;  //! Contigs that were left behind
+};
+
+
+#endif // ASYNCTEXTWRITER_H
@@ -11,6 +11,11 @@
 #include "ReferenceReader.h"
 
 
+// Postprocessed reads are held back until the input has moved past their trimmed position.
+// Trimming only moves reads forward, so this is normally a short window; beyond this many
+// reads the earliest are written anyway, which may leave the BAM unsorted.
+static const int kMaxSortBufferSize = 200000;
+
 
 BAMWalkerEngine::BAMWalkerEngine()
 {
@@ -32,6 +37,9 @@ BAMWalkerEngine::BAMWalkerEngine()
   first_excess_read_ = 0;
   first_useful_read_ = 0;
   bam_writing_enabled_ = false;
+  last_written_chr_ = 0;
+  last_written_pos_ = 0;
+  bam_sorted_ = true;
   pthread_mutex_init(&recycle_mutex_, NULL);
 }
 
@@ -43,7 +51,7 @@ BAMWalkerEngine::~BAMWalkerEngine()
 
 
 void BAMWalkerEngine::Initialize(const ReferenceReader& ref_reader, TargetsManager& targets_manager,
-    const vector<string>& bam_filenames, const string& postprocessed_bam)
+    const vector<string>& bam_filenames, const string& postprocessed_bam, int num_threads)
 {
 
   InitializeBAMs(ref_reader, bam_filenames);
@@ -55,11 +63,13 @@ void BAMWalkerEngine::Initialize(const ReferenceReader& ref_reader, TargetsManag
   // BAM writing init
   if (not postprocessed_bam.empty()) {
     bam_writing_enabled_ = true;
+    postprocessed_bam_ = postprocessed_bam;
     SamHeader tmp_header = bam_header_;
     tmp_header.Comments.clear();
     tmp_header.Programs.Clear();
+    tmp_header.SortOrder = "coordinate";
     bam_writer_.SetCompressionMode(BamWriter::Compressed);
-    bam_writer_.SetNumThreads(4);
+    bam_writer_.SetNumThreads(max(2, num_threads / 2));
     if (not bam_writer_.Open(postprocessed_bam, tmp_header, bam_reader_.GetReferenceData())) {
       cerr << "ERROR: Could not open postprocessed BAM file for writing : " << bam_writer_.GetErrorString();
       exit(1);
@@ -69,8 +79,21 @@ void BAMWalkerEngine::Initialize(const ReferenceReader& ref_reader, TargetsManag
 
 void BAMWalkerEngine::Close()
 {
-  if (bam_writing_enabled_)
+  if (bam_writing_enabled_) {
+    WriteSortedAlignments(-1, 0);
     bam_writer_.Close();
+
+    if (bam_sorted_) {
+      BamReader index_reader;
+      if (not index_reader.Open(postprocessed_bam_) or not index_reader.CreateIndex(BamIndex::STANDARD)) {
+        cerr << "ERROR: Could not index postprocessed BAM file : " << index_reader.GetErrorString() << endl;
+        exit(1);
+      }
+      index_reader.Close();
+    } else {
+      cerr << "WARNING: Postprocessed BAM " << postprocessed_bam_ << " is not coordinate-sorted and was not indexed" << endl;
+    }
+  }
   bam_reader_.Close();
 }
 
@@ -188,13 +211,41 @@ void BAMWalkerEngine::SaveAlignments(Alignment* removal_list)
     return;
   
   if (!removal_list) removal_list = alignments_first_;
-    
+
+  Alignment *last_read = NULL;
   for (Alignment *current_read = removal_list; current_read; current_read = current_read->next) {
+    if (current_read->processed)
+      last_read = current_read;
     if (not current_read->worth_saving)
       continue;
     current_read->alignment.RemoveTag("ZM");
     current_read->alignment.RemoveTag("ZP");
-    bam_writer_.SaveAlignment(current_read->alignment);
+    sort_buffer_.insert(make_pair(make_pair(current_read->alignment.RefID, current_read->alignment.Position),
+        current_read->alignment));
+  }
+
+  // Reads still to come start no earlier than the last removed read did before trimming
+  if (last_read)
+    WriteSortedAlignments(last_read->alignment.RefID, last_read->original_position);
+}
+
+
+// Write buffered reads up to and including chr:position, or all of them if chr is -1
+void BAMWalkerEngine::WriteSortedAlignments(int chr, int position)
+{
+  while (not sort_buffer_.empty()) {
+    multimap<pair<int,int>,BamAlignment>::iterator first = sort_buffer_.begin();
+    if (chr >= 0 and first->first > make_pair(chr, position) and (int)sort_buffer_.size() <= kMaxSortBufferSize)
+      break;
+
+    if (first->first.first < last_written_chr_ or
+        (first->first.first == last_written_chr_ and first->first.second < last_written_pos_))
+      bam_sorted_ = false;
+    last_written_chr_ = first->first.first;
+    last_written_pos_ = first->first.second;
+
+    bam_writer_.SaveAlignment(first->second);
+    sort_buffer_.erase(first);
   }
 }
 
@@ -413,16 +464,6 @@ void BAMWalkerEngine::FinishPositionProcessingTask(list<PositionInProgress>::ite
 
 
 
-int BAMWalkerEngine::GetRecentUnmergedTarget()
-{
-  MergedTarget *my_next_target = next_target_;
-  if (my_next_target)
-    return my_next_target->first_unmerged;
-  else
-    return 0;
-}
-
-
 bool BAMWalkerEngine::MemoryContention()
 {
   if (positions_in_progress_.empty())
@@ -437,6 +478,14 @@ bool BAMWalkerEngine::IsEarlierstPositionProcessingTask(list<PositionInProgress>
   return position_ticket == positions_in_progress_.begin();
 }
 
+void BAMWalkerEngine::GetProgress(int& target_idx, long& position, long& reads_loaded, long& reads_in_memory)
+{
+  target_idx = next_target_ - &targets_manager_->merged[0];
+  position = next_position_;
+  reads_loaded = read_counter_;
+  reads_in_memory = alignments_first_ ? read_counter_ - alignments_first_->read_number : 0;
+}
+
 void BAMWalkerEngine::PrintStatus()
 {
   cerr<< "BAMWalkerEngine:"
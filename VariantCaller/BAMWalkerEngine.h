@@ -14,7 +14,9 @@
 #include <string>
 #include "api/BamMultiReader.h"
 #include "api/BamWriter.h"
+#include "api/BamReader.h"
 #include "TargetsManager.h"
+#include "RecalibrationModel.h"
 
 using namespace std;
 using namespace BamTools;
@@ -73,6 +75,7 @@ struct Alignment {
     phase_params.clear();
     runid.clear();
     well_rowcol.clear();
+    recal_ab.Null();
     read_bases.clear();
     pretty_aln.clear();
     left_sc = 0;
@@ -115,6 +118,7 @@ struct Alignment {
   vector<float>         phase_params;       //! cf, ie, droop parameters of this read
   string                runid;              //! Identify the run from which this read came: used to find run-specific parameters
   vector<int>           well_rowcol;        //! 2 element int vector 0-based row, col in that order mapping to row,col in chip
+  MultiAB               recal_ab;           //! HP recalibration model of the chip block this read came from, resolved at load
   string                read_bases;         //! Read sequence as base called (minus hard but including soft clips)
   string                pretty_aln;         //! pretty alignment string displaying matches, insertions, deletions
   int                   left_sc;            //! Number of soft clipped bases at the start of the alignment
@@ -150,7 +154,7 @@ public:
   BAMWalkerEngine();
   ~BAMWalkerEngine();
   void Initialize(const ReferenceReader& ref_reader, TargetsManager& targets_manager,
-      const vector<string>& bam_filenames, const string& postprocessed_bam);
+      const vector<string>& bam_filenames, const string& postprocessed_bam, int num_threads);
   void Close();
   const SamHeader& GetBamHeader() { return bam_header_; }
 
@@ -179,7 +183,9 @@ public:
   void FinishReadRemovalTask(Alignment* removal_list);
 
   void PrintStatus();
-  int GetRecentUnmergedTarget();
+
+  //! @brief  Merged target and position walked next, reads retrieved so far and reads held in memory
+  void GetProgress(int& target_idx, long& position, long& reads_loaded, long& reads_in_memory);
 
   bool HasMoreAlignments() { return has_more_alignments_; }
   bool ReadProcessingTasksInProgress() { return processing_first_; }
@@ -191,6 +197,7 @@ public:
 
 private:
   void InitializeBAMs(const ReferenceReader& ref_reader, const vector<string>& bam_filenames);
+  void WriteSortedAlignments(int chr, int position);
 
   TargetsManager *          targets_manager_;       //! Manages targets loaded from BED file
   BamMultiReader            bam_reader_;            //! BamTools mulit-bam reader
@@ -225,6 +232,11 @@ private:
 
   bool                      bam_writing_enabled_;
   BamWriter                 bam_writer_;
+  string                    postprocessed_bam_;     //! Postprocessed BAM file name
+  multimap<pair<int,int>,BamAlignment> sort_buffer_; //! Saved reads not yet written, by (chr,pos) after trimming
+  int                       last_written_chr_;      //! Chr of the last read written to the postprocessed BAM
+  int                       last_written_pos_;      //! Position of the last read written to the postprocessed BAM
+  bool                      bam_sorted_;            //! Postprocessed BAM is coordinate-sorted so far
 
 };
 
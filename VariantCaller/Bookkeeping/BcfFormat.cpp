@@ -0,0 +1,551 @@
+/* Copyright (C) 2013 Ion Torrent Systems, Inc. All Rights Reserved */
+
+//! @file     BcfFormat.cpp
+//! @ingroup  VariantCaller
+//! @brief    BCF2 encoding of tvc output records
+
+#include "BcfFormat.h"
+
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <set>
+
+// Typed value encoding of BCF2.2
+enum { kTypeNull = 0, kTypeInt8 = 1, kTypeInt16 = 2, kTypeInt32 = 3, kTypeFloat = 5, kTypeChar = 7 };
+
+static const int32_t kInt32Missing   = (int32_t)0x80000000;
+static const int32_t kInt32VectorEnd = (int32_t)0x80000001;
+static const uint32_t kFloatMissing   = 0x7F800001;
+static const uint32_t kFloatVectorEnd = 0x7F800002;
+
+
+static void PutLittleEndian(string& output, uint32_t value, int num_bytes)
+{
+  for (int i = 0; i < num_bytes; ++i)
+    output.push_back((char)((value >> (8*i)) & 0xff));
+}
+
+static void PutFloat(string& output, float value)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, 4);
+  PutLittleEndian(output, bits, 4);
+}
+
+static void EncodeSize(string& output, int size, int type);
+
+// Smallest integer type that holds all values, as htslib picks it; missing and vector end
+// have their own representation in every width
+static int IntegerType(const int32_t *values, int num_values)
+{
+  int32_t min_value = 0x7fffffff, max_value = kInt32Missing;
+  for (int idx = 0; idx < num_values; ++idx) {
+    if (values[idx] == kInt32Missing or values[idx] == kInt32VectorEnd)
+      continue;
+    min_value = min(min_value, values[idx]);
+    max_value = max(max_value, values[idx]);
+  }
+  // The lowest 8 values of each width are reserved
+  if (max_value <= 127 and min_value >= -120)
+    return kTypeInt8;
+  if (max_value <= 32767 and min_value >= -32760)
+    return kTypeInt16;
+  return kTypeInt32;
+}
+
+static void PutIntegers(string& output, const int32_t *values, int num_values, int type)
+{
+  int num_bytes = (type == kTypeInt8) ? 1 : (type == kTypeInt16 ? 2 : 4);
+  for (int idx = 0; idx < num_values; ++idx) {
+    uint32_t value = values[idx];
+    if (values[idx] == kInt32Missing)
+      value = 1u << (8*num_bytes-1);
+    else if (values[idx] == kInt32VectorEnd)
+      value = (1u << (8*num_bytes-1)) + 1;
+    PutLittleEndian(output, value, num_bytes);
+  }
+}
+
+static void EncodeIntegers(string& output, const int32_t *values, int num_values)
+{
+  int type = IntegerType(values, num_values);
+  EncodeSize(output, num_values, num_values ? type : kTypeNull);
+  PutIntegers(output, values, num_values, type);
+}
+
+static void EncodeInteger(string& output, int32_t value)
+{
+  EncodeIntegers(output, &value, 1);
+}
+
+static void EncodeSize(string& output, int size, int type)
+{
+  if (size < 15) {
+    output.push_back((char)(size << 4 | type));
+    return;
+  }
+  output.push_back((char)(15 << 4 | type));
+  EncodeInteger(output, size);
+}
+
+static void EncodeString(string& output, const string& value)
+{
+  EncodeSize(output, value.size(), kTypeChar);
+  output += value;
+}
+
+static void PutFloatValue(string& output, float value, bool missing)
+{
+  if (missing)
+    PutLittleEndian(output, kFloatMissing, 4);
+  else
+    PutFloat(output, value);
+}
+
+// -------------------------------------------------------------------
+
+void BcfHeader::Initialize(const string& vcf_header, const ReferenceReader& ref_reader)
+{
+  dictionary_.clear();
+  contigs_.clear();
+  filters_.clear();
+  info_.clear();
+  format_.clear();
+  sample_names_.clear();
+
+  // PASS is always entry 0 of the dictionary; contigs need declaring for the CHROM index
+  text_.clear();
+  string contig_lines;
+  for (int chr = 0; chr < ref_reader.chr_count(); ++chr) {
+    contig_lines += "##contig=<ID=" + ref_reader.chr_str(chr) + ",length=";
+    AppendVcfInteger(contig_lines, ref_reader.chr_size(chr));
+    contig_lines += ">\n";
+    contigs_[ref_reader.chr_str(chr)] = chr;
+  }
+
+  for (size_t line_start = 0; line_start < vcf_header.size(); ) {
+    size_t line_end = vcf_header.find('\n', line_start);
+    if (line_end == string::npos)
+      line_end = vcf_header.size();
+    string line = vcf_header.substr(line_start, line_end - line_start);
+    line_start = line_end + 1;
+    if (line.empty())
+      continue;
+
+    if (line.compare(0, 6, "#CHROM") == 0) {
+      text_ += contig_lines;
+      size_t column_start = 0;
+      for (int column = 0; column_start != string::npos; ++column) {
+        size_t column_end = line.find('\t', column_start);
+        if (column >= 9)
+          sample_names_.push_back(line.substr(column_start, column_end == string::npos ? string::npos : column_end - column_start));
+        column_start = (column_end == string::npos) ? column_end : column_end + 1;
+      }
+    }
+    text_ += line + "\n";
+
+    if (line.compare(0, 13, "##fileformat=") == 0) {
+      text_ += "##FILTER=<ID=PASS,Description=\"All filters passed\">\n";
+      DictionaryIndex("PASS");
+    } else if (line.compare(0, 10, "##FILTER=<") == 0)
+      ParseFieldLine(line, filters_, true);
+    else if (line.compare(0, 8, "##INFO=<") == 0)
+      ParseFieldLine(line, info_, false);
+    else if (line.compare(0, 10, "##FORMAT=<") == 0)
+      ParseFieldLine(line, format_, false);
+  }
+  filters_["PASS"].index = 0;
+
+  annotation_info_.resize(VariantAnnotation::NUM_INFO_FIELDS);
+  annotation_format_.resize(VariantAnnotation::NUM_FORMAT_FIELDS);
+  for (int field = 0; field < VariantAnnotation::NUM_INFO_FIELDS; ++field)
+    annotation_info_[field] = Info(VariantAnnotation::Key(field));
+  for (int field = 0; field < VariantAnnotation::NUM_FORMAT_FIELDS; ++field)
+    annotation_format_[field] = Format(VariantAnnotation::Key(field));
+}
+
+
+void BcfHeader::ParseFieldLine(const string& line, map<string,FieldDef>& fields, bool is_filter)
+{
+  size_t id_start = line.find("<ID=");
+  if (id_start == string::npos)
+    return;
+  id_start += 4;
+  string id = line.substr(id_start, line.find_first_of(",>", id_start) - id_start);
+
+  FieldDef& field = fields[id];
+  field.index = DictionaryIndex(id);
+  if (is_filter)
+    return;
+  size_t type_start = line.find(",Type=");
+  string type = (type_start == string::npos) ? "" : line.substr(type_start + 6, line.find_first_of(",>", type_start + 6) - type_start - 6);
+  if (type == "Flag")
+    field.type = kFlag;
+  else if (type == "Integer")
+    field.type = kInteger;
+  else if (type == "Float")
+    field.type = kFloat;
+  else
+    field.type = kString;
+}
+
+
+int BcfHeader::DictionaryIndex(const string& id)
+{
+  map<string,int>::iterator entry = dictionary_.find(id);
+  if (entry != dictionary_.end())
+    return entry->second;
+  int index = dictionary_.size();
+  dictionary_[id] = index;
+  return index;
+}
+
+
+void BcfHeader::AppendFileStart(string& output) const
+{
+  output.append("BCF\2\2", 5);
+  PutLittleEndian(output, text_.size() + 1, 4);
+  output += text_;
+  output.push_back('\0');
+}
+
+
+int BcfHeader::Contig(const string& name) const
+{
+  map<string,int>::const_iterator contig = contigs_.find(name);
+  return contig == contigs_.end() ? -1 : contig->second;
+}
+
+int BcfHeader::Filter(const string& name) const
+{
+  map<string,FieldDef>::const_iterator filter = filters_.find(name);
+  return filter == filters_.end() ? -1 : filter->second.index;
+}
+
+const BcfHeader::FieldDef& BcfHeader::Info(const string& key) const
+{
+  static const FieldDef undeclared;
+  map<string,FieldDef>::const_iterator field = info_.find(key);
+  return field == info_.end() ? undeclared : field->second;
+}
+
+const BcfHeader::FieldDef& BcfHeader::Format(const string& key) const
+{
+  static const FieldDef undeclared;
+  map<string,FieldDef>::const_iterator field = format_.find(key);
+  return field == format_.end() ? undeclared : field->second;
+}
+
+// -------------------------------------------------------------------
+
+// A key missing from the header cannot be written to BCF; say so once per key
+static bool CheckDeclared(const BcfHeader::FieldDef& field, const string& kind, const string& key)
+{
+  if (field.index >= 0)
+    return true;
+  static set<string> reported;
+  if (reported.insert(kind + key).second)
+    cerr << "WARNING: " << kind << " key " << key << " is not declared in the VCF header and is left out of BCF output" << endl;
+  return false;
+}
+
+
+static int32_t ParseInteger(const string& value)
+{
+  if (value.empty() or value == ".")
+    return kInt32Missing;
+  return strtol(value.c_str(), NULL, 10);
+}
+
+
+// Encode one INFO or FORMAT value vector given as strings
+static void EncodeValues(string& output, BcfHeader::FieldType type, const vector<string>& values)
+{
+  if (type == BcfHeader::kString) {
+    string joined;
+    for (unsigned int idx = 0; idx < values.size(); ++idx) {
+      if (idx)
+        joined += ',';
+      joined += values[idx];
+    }
+    EncodeString(output, joined);
+  } else if (type == BcfHeader::kInteger) {
+    vector<int32_t> numbers(values.size());
+    for (unsigned int idx = 0; idx < values.size(); ++idx)
+      numbers[idx] = ParseInteger(values[idx]);
+    EncodeIntegers(output, numbers.empty() ? NULL : &numbers[0], numbers.size());
+  } else {
+    EncodeSize(output, values.size(), kTypeFloat);
+    for (unsigned int idx = 0; idx < values.size(); ++idx)
+      PutFloatValue(output, strtod(values[idx].c_str(), NULL), values[idx].empty() or values[idx] == ".");
+  }
+}
+
+// Same for a typed annotation vector
+static void EncodeValues(string& output, BcfHeader::FieldType type, const vector<double>& values)
+{
+  if (type == BcfHeader::kInteger) {
+    vector<int32_t> numbers(values.size());
+    for (unsigned int idx = 0; idx < values.size(); ++idx)
+      numbers[idx] = (int32_t)(long)values[idx];
+    EncodeIntegers(output, numbers.empty() ? NULL : &numbers[0], numbers.size());
+  } else {
+    EncodeSize(output, values.size(), kTypeFloat);
+    for (unsigned int idx = 0; idx < values.size(); ++idx)
+      PutFloat(output, values[idx]);
+  }
+}
+
+
+// GT alleles are (allele+1)<<1 with the low bit set when phased to the previous allele; 0 is missing
+static void ParseGenotype(const string& genotype, vector<int32_t>& alleles)
+{
+  alleles.clear();
+  bool phased = false;
+  for (size_t allele_start = 0; allele_start <= genotype.size(); ) {
+    size_t allele_end = genotype.find_first_of("/|", allele_start);
+    if (allele_end == string::npos)
+      allele_end = genotype.size();
+    if (genotype.compare(allele_start, allele_end - allele_start, ".") == 0 or allele_end == allele_start)
+      alleles.push_back(phased ? 1 : 0);
+    else
+      alleles.push_back((atoi(genotype.c_str() + allele_start) + 1) << 1 | (phased ? 1 : 0));
+    phased = (allele_end < genotype.size() and genotype[allele_end] == '|');
+    allele_start = allele_end + 1;
+  }
+}
+
+
+// One FORMAT key for all samples: values per sample padded to the longest with vector-end
+static void EncodeFormatField(string& output, const string& key, BcfHeader::FieldType type, int annotation_field,
+    const vector<const map<string, vector<string> > *>& sample_values,
+    const vector<const VariantAnnotation::Block *>& sample_annotations)
+{
+  int num_samples = sample_values.size();
+  vector<vector<string> > text_values(num_samples);
+  for (int sample = 0; sample < num_samples; ++sample) {
+    if (annotation_field >= 0 and sample_annotations[sample]
+        and sample_annotations[sample]->field[annotation_field].present)
+      continue;
+    if (sample_values[sample]) {
+      map<string, vector<string> >::const_iterator values = sample_values[sample]->find(key);
+      if (values != sample_values[sample]->end())
+        text_values[sample] = values->second;
+    }
+  }
+  vector<const vector<double> *> typed_values(num_samples, (const vector<double> *)NULL);
+  for (int sample = 0; sample < num_samples; ++sample)
+    if (annotation_field >= 0 and sample_annotations[sample]
+        and sample_annotations[sample]->field[annotation_field].present)
+      typed_values[sample] = &sample_annotations[sample]->field[annotation_field].values;
+
+  if (key == "GT") {
+    vector<vector<int32_t> > alleles(num_samples);
+    int width = 1;
+    for (int sample = 0; sample < num_samples; ++sample) {
+      if (text_values[sample].empty())
+        alleles[sample].push_back(0);
+      else
+        ParseGenotype(text_values[sample][0], alleles[sample]);
+      width = max(width, (int)alleles[sample].size());
+    }
+    vector<int32_t> packed;
+    for (int sample = 0; sample < num_samples; ++sample) {
+      alleles[sample].resize(width, kInt32VectorEnd);
+      packed.insert(packed.end(), alleles[sample].begin(), alleles[sample].end());
+    }
+    int int_type = IntegerType(packed.empty() ? NULL : &packed[0], packed.size());
+    EncodeSize(output, width, int_type);
+    PutIntegers(output, packed.empty() ? NULL : &packed[0], packed.size(), int_type);
+    return;
+  }
+
+  if (type == BcfHeader::kString or type == BcfHeader::kFlag) {
+    vector<string> joined(num_samples);
+    int width = 1;
+    for (int sample = 0; sample < num_samples; ++sample) {
+      for (unsigned int idx = 0; idx < text_values[sample].size(); ++idx) {
+        if (idx)
+          joined[sample] += ',';
+        joined[sample] += text_values[sample][idx];
+      }
+      if (joined[sample].empty())
+        joined[sample] = ".";
+      width = max(width, (int)joined[sample].size());
+    }
+    EncodeSize(output, width, kTypeChar);
+    for (int sample = 0; sample < num_samples; ++sample) {
+      output += joined[sample];
+      output.append(width - joined[sample].size(), '\0');
+    }
+    return;
+  }
+
+  int width = 1;
+  for (int sample = 0; sample < num_samples; ++sample)
+    width = max(width, (int)(typed_values[sample] ? typed_values[sample]->size() : text_values[sample].size()));
+
+  if (type == BcfHeader::kInteger) {
+    vector<int32_t> packed(width * num_samples, kInt32VectorEnd);
+    for (int sample = 0; sample < num_samples; ++sample) {
+      int32_t *sample_packed = &packed[sample * width];
+      if (typed_values[sample]) {
+        for (unsigned int idx = 0; idx < typed_values[sample]->size(); ++idx)
+          sample_packed[idx] = (int32_t)(long)(*typed_values[sample])[idx];
+      } else if (text_values[sample].empty())
+        sample_packed[0] = kInt32Missing;
+      else
+        for (unsigned int idx = 0; idx < text_values[sample].size(); ++idx)
+          sample_packed[idx] = ParseInteger(text_values[sample][idx]);
+    }
+    int int_type = IntegerType(packed.empty() ? NULL : &packed[0], packed.size());
+    EncodeSize(output, width, int_type);
+    PutIntegers(output, packed.empty() ? NULL : &packed[0], packed.size(), int_type);
+    return;
+  }
+
+  EncodeSize(output, width, kTypeFloat);
+  for (int sample = 0; sample < num_samples; ++sample) {
+    int num_written = 0;
+    if (typed_values[sample]) {
+      for (; num_written < (int)typed_values[sample]->size(); ++num_written)
+        PutFloat(output, (*typed_values[sample])[num_written]);
+    } else if (text_values[sample].empty()) {
+      PutLittleEndian(output, kFloatMissing, 4);
+      num_written = 1;
+    } else {
+      for (; num_written < (int)text_values[sample].size(); ++num_written) {
+        const string& value = text_values[sample][num_written];
+        PutFloatValue(output, strtod(value.c_str(), NULL), value.empty() or value == ".");
+      }
+    }
+    for (; num_written < width; ++num_written)
+      PutLittleEndian(output, kFloatVectorEnd, 4);
+  }
+}
+
+
+void WriteBcfRecord(string& output, const BcfHeader& header, vcf::Variant& var, const VariantAnnotation& annotation)
+{
+  string shared;
+  shared.reserve(512);
+
+  int contig = header.Contig(var.sequenceName);
+  if (contig < 0) {
+    cerr << "ERROR: Contig " << var.sequenceName << " is not in the reference, cannot write BCF record" << endl;
+    exit(1);
+  }
+  PutLittleEndian(shared, contig, 4);
+  PutLittleEndian(shared, var.position - 1, 4);
+  PutLittleEndian(shared, var.ref.size(), 4);
+  PutFloat(shared, var.quality);
+  size_t counts_offset = shared.size();
+  PutLittleEndian(shared, 0, 4);    // n_allele << 16 | n_info, filled in below
+  PutLittleEndian(shared, 0, 4);    // n_fmt << 24 | n_sample
+
+  EncodeString(shared, var.id == "." ? string() : var.id);
+  EncodeString(shared, var.ref);
+  for (vector<string>::const_iterator alt = var.alt.begin(); alt != var.alt.end(); ++alt)
+    EncodeString(shared, *alt);
+
+  vector<int32_t> filters;
+  if (var.filter != ".") {
+    for (size_t filter_start = 0; filter_start <= var.filter.size(); ) {
+      size_t filter_end = var.filter.find(';', filter_start);
+      if (filter_end == string::npos)
+        filter_end = var.filter.size();
+      string filter = var.filter.substr(filter_start, filter_end - filter_start);
+      int index = header.Filter(filter);
+      BcfHeader::FieldDef filter_def;
+      filter_def.index = index;
+      if (CheckDeclared(filter_def, "FILTER", filter))
+        filters.push_back(index);
+      filter_start = filter_end + 1;
+    }
+  }
+  EncodeIntegers(shared, filters.empty() ? NULL : &filters[0], filters.size());
+
+  // INFO: same merge of vcf::Variant::info and the annotation as in WriteVcfRecord
+  int num_info = 0;
+  map<string, vector<string> >::const_iterator entry = var.info.begin();
+  int field = 0;
+  while (entry != var.info.end() or field < VariantAnnotation::NUM_INFO_FIELDS) {
+    if (field < VariantAnnotation::NUM_INFO_FIELDS and not annotation.Info((VariantAnnotation::Field)field).present) {
+      ++field;
+      continue;
+    }
+    int order = 1;
+    if (field == VariantAnnotation::NUM_INFO_FIELDS)
+      order = -1;
+    else if (entry != var.info.end())
+      order = entry->first.compare(VariantAnnotation::Key(field));
+
+    if (order < 0) {
+      const BcfHeader::FieldDef& info = header.Info(entry->first);
+      if (not entry->second.empty() and CheckDeclared(info, "INFO", entry->first)) {
+        EncodeInteger(shared, info.index);
+        EncodeValues(shared, info.type, entry->second);
+        num_info++;
+      }
+      ++entry;
+    } else {
+      if (order == 0)
+        ++entry;
+      const BcfHeader::FieldDef& info = header.Info(field);
+      const vector<double>& values = annotation.Info((VariantAnnotation::Field)field).values;
+      if (not values.empty() and CheckDeclared(info, "INFO", VariantAnnotation::Key(field))) {
+        EncodeInteger(shared, info.index);
+        EncodeValues(shared, info.type, values);
+        num_info++;
+      }
+      ++field;
+    }
+  }
+  for (map<string, bool>::const_iterator flag = var.infoFlags.begin(); flag != var.infoFlags.end(); ++flag) {
+    const BcfHeader::FieldDef& info = header.Info(flag->first);
+    if (CheckDeclared(info, "INFO", flag->first)) {
+      EncodeInteger(shared, info.index);
+      EncodeSize(shared, 0, kTypeNull);
+      num_info++;
+    }
+  }
+
+  // FORMAT, one key at a time for all samples
+  string individual;
+  int num_format = 0;
+  const vector<string>& sample_names = header.sample_names();
+  if (not var.format.empty() and not sample_names.empty()) {
+    vector<const map<string, vector<string> > *> sample_values(sample_names.size(), (const map<string, vector<string> > *)NULL);
+    vector<const VariantAnnotation::Block *> sample_annotations(sample_names.size(), (const VariantAnnotation::Block *)NULL);
+    for (unsigned int sample = 0; sample < sample_names.size(); ++sample) {
+      map<string, map<string, vector<string> > >::const_iterator values = var.samples.find(sample_names[sample]);
+      if (values != var.samples.end())
+        sample_values[sample] = &values->second;
+      sample_annotations[sample] = annotation.FindSample(sample_names[sample]);
+    }
+    for (vector<string>::const_iterator key = var.format.begin(); key != var.format.end(); ++key) {
+      int annotation_field = -1;
+      for (int field = 0; field < VariantAnnotation::NUM_FORMAT_FIELDS; ++field)
+        if (*key == VariantAnnotation::Key(field))
+          annotation_field = field;
+      const BcfHeader::FieldDef& format = (annotation_field >= 0) ? header.Format(annotation_field) : header.Format(*key);
+      if (not CheckDeclared(format, "FORMAT", *key))
+        continue;
+      EncodeInteger(individual, format.index);
+      EncodeFormatField(individual, *key, format.type, annotation_field, sample_values, sample_annotations);
+      num_format++;
+    }
+  }
+
+  string counts;
+  PutLittleEndian(counts, (1 + var.alt.size()) << 16 | num_info, 4);
+  PutLittleEndian(counts, num_format << 24 | sample_names.size(), 4);
+  shared.replace(counts_offset, 8, counts);
+
+  PutLittleEndian(output, shared.size(), 4);
+  PutLittleEndian(output, individual.size(), 4);
+  output += shared;
+  output += individual;
+}
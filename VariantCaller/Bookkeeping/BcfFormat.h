@@ -0,0 +1,66 @@
+/* Copyright (C) 2013 Ion Torrent Systems, Inc. All Rights Reserved */
+
+//! @file     BcfFormat.h
+//! @ingroup  VariantCaller
+//! @brief    BCF2 encoding of tvc output records
+
+#ifndef BCFFORMAT_H
+#define BCFFORMAT_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <Variant.h>
+
+#include "VariantAnnotation.h"
+#include "ReferenceReader.h"
+
+using namespace std;
+
+
+//! Dictionaries and field types of a BCF2 file, taken from the text header that getVCFHeader writes
+class BcfHeader {
+public:
+  enum FieldType { kFlag = 0, kInteger, kFloat, kString };
+
+  struct FieldDef {
+    FieldDef() : index(-1), type(kString) {}
+    int         index;      //! Position in the string dictionary, -1 if not declared
+    FieldType   type;
+  };
+
+  //! @brief  Build the dictionaries. PASS and the reference contigs are added to the header text.
+  void Initialize(const string& vcf_header, const ReferenceReader& ref_reader);
+
+  //! @brief  Append the magic, the header length and the NUL-terminated header text
+  void AppendFileStart(string& output) const;
+
+  int Contig(const string& name) const;
+  int Filter(const string& name) const;
+  const FieldDef& Info(const string& key) const;
+  const FieldDef& Format(const string& key) const;
+  const FieldDef& Info(int annotation_field) const { return annotation_info_[annotation_field]; }
+  const FieldDef& Format(int annotation_field) const { return annotation_format_[annotation_field]; }
+  const vector<string>& sample_names() const { return sample_names_; }
+
+private:
+  void ParseFieldLine(const string& line, map<string,FieldDef>& fields, bool is_filter);
+  int DictionaryIndex(const string& id);
+
+  string                        text_;              //! Header text as written to the file
+  map<string,int>               dictionary_;        //! FILTER, INFO and FORMAT IDs, in order of first appearance
+  map<string,int>               contigs_;           //! Contig IDs, in reference order
+  map<string,FieldDef>          filters_;
+  map<string,FieldDef>          info_;
+  map<string,FieldDef>          format_;
+  vector<FieldDef>              annotation_info_;   //! Info() for each VariantAnnotation::Field
+  vector<FieldDef>              annotation_format_; //! Format() for each VariantAnnotation FORMAT field
+  vector<string>                sample_names_;      //! Sample columns of the #CHROM line
+};
+
+
+//! Append one BCF2 record; carries the same content as WriteVcfRecord
+void WriteBcfRecord(string& output, const BcfHeader& header, vcf::Variant& var, const VariantAnnotation& annotation);
+
+
+#endif // BCFFORMAT_H
@@ -26,6 +26,11 @@ void VariantCallerHelp() {
   printf("  -t,--target-file                      FILE        only process targets in this bed file [optional]\n");
   printf("     --trim-ampliseq-primers            on/off      match reads to targets and trim the ends that reach outside them [off]\n");
   printf("  -D,--downsample-to-coverage           INT         ?? [2000]\n");
+  printf("     --adaptive-downsampling            on/off      add reads to the evaluated stack in batches until QUAL and GQ settle [off]\n");
+  printf("     --adaptive-batch-size              INT         number of reads added to the stack per batch [200]\n");
+  printf("     --adaptive-tolerance               FLOAT       max. change of QUAL and GQ between batches for a call to be settled [1.0]\n");
+  printf("     --adaptive-borderline-margin       FLOAT       calls with QUAL within this margin of the min. variant score keep adding reads [5.0]\n");
+  printf("     --adaptive-max-coverage            INT         read stack ceiling for borderline calls [2 x downsample-to-coverage]\n");
   printf("     --model-file                       FILE        HP recalibration model input file.\n");
   printf("     --recal-model-hp-thres             INT         Lower threshold for HP recalibration.\n");
   printf("\n");
@@ -33,6 +38,12 @@ void VariantCallerHelp() {
   printf("Outputs:\n");
   printf("  -O,--output-dir                       DIRECTORY   base directory for all output files [current dir]\n");
   printf("  -o,--output-vcf                       FILE        vcf file with variant calling results [required]\n");
+  printf("     --output-bgzip                     on/off      write block-gzipped vcf files (.vcf.gz) with tabix index [off]\n");
+  printf("     --output-bcf                       on/off      write binary BCF (.bcf) instead of vcf, BGZF-compressed with --output-bgzip [off]\n");
+  printf("     --output-normalized-vcf            FILE        also write a sorted vcf with left-aligned indels, as sort_vcf.py and GATK LeftAlignVariants would [optional]\n");
+  printf("     --normalized-vcf-targets           on/off      leave variants outside the targets (minus trimmed primers) out of the normalized vcf [off]\n");
+  printf("     --progress-file                    FILE        json file with live progress of the run, rewritten periodically [optional]\n");
+  printf("     --progress-interval                INT         seconds between updates of the progress file [10]\n");
   printf("     --suppress-reference-genotypes     on/off      write reference calls into the filtered variants vcf [on]\n");
   printf("     --suppress-no-calls                on/off      write filtered variants into the filtered variants vcf [on]\n");
   printf("     --suppress-nocall-genotypes        on/off      do not report a genotype for filtered variants [on]\n");
@@ -136,12 +147,15 @@ void VariantCallerHelp() {
   printf("     --filter-insertion-predictions     FLOAT       check post-evaluation systematic bias in insertions [100.0]\n");
   printf("\n");
   printf("     --heal-snps                        on/off      suppress in/dels not participating in diploid variant genotypes if the genotype contains a SNP or MNP [on].\n");
+  printf("     --prescreen-candidates             on/off      fail non-hotspot candidates without evaluation if candidate generator counts cannot pass coverage/frequency filters [off]\n");
+  printf("     --prescreen-margin                 FLOAT       fraction of min-coverage, min-cov-each-strand and min-allele-freq a candidate allele must reach to be evaluated [0.5]\n");
   printf("\n");
 
   printf("Debugging:\n");
   printf("  -d,--debug                            INT         (0/1/2) display extra debug messages [0]\n");
-  printf("     --do-json-diagnostic               on/off      (devel) dump internal state to json file (uses much more time/memory/disk) [off]\n");
-  printf("     --postprocessed-bam                FILE        (devel) save tvc-processed reads to an (unsorted) BAM file [optional]");
+  printf("     --do-json-diagnostic               on/off      (devel) dump internal state to json_diagnostic.tvcdiag (see tvcutils extract_diagnostic) [off]\n");
+  printf("     --postprocessed-bam                FILE        (devel) save tvc-processed reads to a sorted, indexed BAM file [optional]\n");
+  printf("     --trace-file                       FILE        (devel) record a per-thread timeline of the run in Chrome trace-event format (chrome://tracing, Perfetto) [optional]\n");
   printf("     --do-minimal-diagnostic            on/off      (devel) provide minimal read information for called variants [off]\n");
   printf("     --override-limits                  on/off      (devel) disable limit-check on input parameters [off].\n");
   printf("\n");
@@ -167,11 +181,18 @@ ControlCallAndFilters::ControlCallAndFilters() {
   sbias_tune = 0.5f;
   downSampleCoverage = 2000;
   RandSeed = 631;
+  adaptive_downsampling = false;
+  adaptive_batch_size = 200;
+  adaptive_tolerance = 1.0f;
+  adaptive_borderline_margin = 5.0f;
+  adaptive_max_coverage = 4000;
   // wanted by downstream
   suppress_reference_genotypes = true;
   suppress_nocall_genotypes = true;
   suppress_no_calls = true;
   heal_snps = true;
+  prescreen_candidates = false;
+  prescreen_margin = 0.5f;
 }
 
 ProgramControlSettings::ProgramControlSettings() {
@@ -182,7 +203,7 @@ ProgramControlSettings::ProgramControlSettings() {
   use_SSE_basecaller = true;
   rich_json_diagnostic = false;
   minimal_diagnostic = false;
-  json_plot_dir = "./json_diagnostic/";
+  json_plot_dir = "./json_diagnostic.tvcdiag";
   inputPositionsOnly = false;
   suppress_recalibration = true;
   resolve_clipped_bases = false;
@@ -371,11 +392,16 @@ void ControlCallAndFilters::CheckParameterLimits() {
   CheckParameterLowerBound<float>     ("data-quality-stringency",  data_quality_stringency,  0.0f);
   CheckParameterLowerUpperBound<float>("read-rejection-threshold", read_rejection_threshold, 0.0f, 1.0f);
   CheckParameterLowerUpperBound<int>  ("downsample-to-coverage",   downSampleCoverage,       20, 100000);
+  CheckParameterLowerUpperBound<int>  ("adaptive-batch-size",      adaptive_batch_size,      20, 100000);
+  CheckParameterLowerUpperBound<float>("adaptive-tolerance",       adaptive_tolerance,       0.0f, 100.0f);
+  CheckParameterLowerUpperBound<float>("adaptive-borderline-margin",adaptive_borderline_margin, 0.0f, 1000.0f);
+  CheckParameterLowerUpperBound<int>  ("adaptive-max-coverage",    adaptive_max_coverage,    downSampleCoverage, 100000);
   CheckParameterLowerUpperBound<float>("position-bias-ref-fraction",position_bias_ref_fraction,  0.0f, 1.0f);
   CheckParameterLowerUpperBound<float>("position-bias",            position_bias,  0.0f, 1.0f);
   CheckParameterLowerUpperBound<float>("position-bias-pval",       position_bias_pval,  0.0f, 1.0f);
  // CheckParameterLowerUpperBound<float>("tune-xbias",      xbias_tune,     0.001f, 1000.0f);
   CheckParameterLowerUpperBound<float>("tune-sbias",      sbias_tune,     0.001f, 1000.0f);
+  CheckParameterLowerUpperBound<float>("prescreen-margin",         prescreen_margin,  0.0f, 1.0f);
 
   CheckParameterLowerBound<int>       ("snp-min-cov-each-strand",  filter_snps.min_cov_each_strand, 0);
   CheckParameterLowerBound<float>     ("snp-min-variant-score",    filter_snps.min_quality_score,   0.0f);
@@ -427,6 +453,11 @@ void ControlCallAndFilters::SetOpts(OptArgs &opts, Json::Value& tvc_params) {
   position_bias_pval                    = RetrieveParameterDouble(opts, tvc_params, '-', "position-bias-pval",0.05f);
 
   downSampleCoverage                    = RetrieveParameterInt   (opts, tvc_params, '-', "downsample-to-coverage", 2000);
+  adaptive_downsampling                 = RetrieveParameterBool  (opts, tvc_params, '-', "adaptive-downsampling", false);
+  adaptive_batch_size                   = RetrieveParameterInt   (opts, tvc_params, '-', "adaptive-batch-size", 200);
+  adaptive_tolerance                    = RetrieveParameterDouble(opts, tvc_params, '-', "adaptive-tolerance", 1.0);
+  adaptive_borderline_margin            = RetrieveParameterDouble(opts, tvc_params, '-', "adaptive-borderline-margin", 5.0);
+  adaptive_max_coverage                 = RetrieveParameterInt   (opts, tvc_params, '-', "adaptive-max-coverage", 2*downSampleCoverage);
   
   //xbias_tune                            = RetrieveParameterDouble(opts, tvc_params, '-', "tune-xbias", 0.005f);
   sbias_tune                            = RetrieveParameterDouble(opts, tvc_params, '-', "tune-sbias", 0.01f);
@@ -437,6 +468,9 @@ void ControlCallAndFilters::SetOpts(OptArgs &opts, Json::Value& tvc_params) {
 
   heal_snps                             = RetrieveParameterBool   (opts, tvc_params, '-', "heal-snps", true);
 
+  prescreen_candidates                  = RetrieveParameterBool   (opts, tvc_params, '-', "prescreen-candidates", false);
+  prescreen_margin                      = RetrieveParameterDouble (opts, tvc_params, '-', "prescreen-margin", 0.5f);
+
   // SNPS are my usual variants
   filter_snps.min_cov_each_strand       = RetrieveParameterInt   (opts, tvc_params, 'C', "snp-min-cov-each-strand", 0);
   filter_snps.min_quality_score         = RetrieveParameterDouble(opts, tvc_params, 'B', "snp-min-variant-score", 10.0);
@@ -535,7 +569,19 @@ void ExtendParameters::SetupFileIO(OptArgs &opts) {
     exit(1);
   }
 
+  output_bgzip                          = opts.GetFirstBoolean('-', "output-bgzip", false);
+  output_bcf                            = opts.GetFirstBoolean('-', "output-bcf", false);
+  normalized_vcf                        = opts.GetFirstString ('-', "output-normalized-vcf", "");
+  normalized_vcf_targets                = opts.GetFirstBoolean('-', "normalized-vcf-targets", false);
+  progress_file                         = opts.GetFirstString ('-', "progress-file", "");
+  progress_interval                     = opts.GetFirstInt    ('-', "progress-interval", 10);
+  if (progress_interval < 1) {
+    cerr << "ERROR: --progress-interval must be at least 1 second" << endl;
+    exit(1);
+  }
+
   postprocessed_bam                     = opts.GetFirstString('-', "postprocessed-bam", "");
+  trace_file                            = opts.GetFirstString('-', "trace-file", "");
 
   sampleName                            = opts.GetFirstString('g', "sample-name", "");
   force_sample_name                     = opts.GetFirstString('-', "force-sample-name", "");
@@ -157,11 +157,22 @@ class ControlCallAndFilters {
     int downSampleCoverage;
     int RandSeed;                  //!< Seed for random number generator to reservoir sample reads.
 
+    // grow the evaluated read stack in batches until the call settles
+    bool adaptive_downsampling;
+    int adaptive_batch_size;           //!< Reads added to the stack per batch
+    float adaptive_tolerance;          //!< Max. change of QUAL and GQ between batches for a settled call
+    float adaptive_borderline_margin;  //!< Calls with QUAL this close to the min. variant score are borderline
+    int adaptive_max_coverage;         //!< Read stack ceiling for borderline calls
+
     bool suppress_reference_genotypes;
     bool suppress_nocall_genotypes;
     bool heal_snps; // if a snp is the best allele, discard all others
     bool suppress_no_calls;
 
+    // skip evaluation of candidates whose generator allele counts cannot pass the basic filters
+    bool prescreen_candidates;
+    float prescreen_margin;        //!< Fraction of each basic threshold a candidate allele must reach to be evaluated
+
     // position bias probably should not be variant specific
     bool use_position_bias;
     float position_bias_ref_fraction;
@@ -193,7 +204,7 @@ class ProgramControlSettings {
 
     bool rich_json_diagnostic;
     bool minimal_diagnostic;
-     string json_plot_dir;
+     string json_plot_dir;           //! Diagnostic container file
 
     bool use_SSE_basecaller;
     bool suppress_recalibration;
@@ -215,6 +226,13 @@ public:
   string            outputFile;
   string            variantPriorsFile;
   string            postprocessed_bam;
+  string            trace_file;           // --trace-file
+  string            progress_file;        // --progress-file
+  int               progress_interval;    // --progress-interval
+  bool              output_bgzip;         // --output-bgzip
+  bool              output_bcf;           // --output-bcf
+  string            normalized_vcf;       // --output-normalized-vcf
+  bool              normalized_vcf_targets; // --normalized-vcf-targets
 
   string            basecaller_version;
   string            tmap_version;
@@ -123,30 +123,12 @@ void InputStructures::DetectFlowOrderzAndKeyFromBam(const SamHeader &samHeader){
 // then we look up the block for this area
 // different size/shape chips mean can't use same lookup table
 // inefficient for now: get the plane off the ground, then make the engines work
-string RecalibrationHandler::FindKey(const string &runid, int x, int y) const {
-    std::pair <std::multimap<string,pair<int,int> >:: const_iterator, std::multimap<string,pair<int,int> >:: const_iterator> blocks;
-    blocks = block_hash.equal_range(runid);
-    int tx,ty;
-    tx = ty=0;
-    for (std::multimap<string,pair<int,int> >:: const_iterator it = blocks.first; it!=blocks.second; ++it) {
-        int ax = it->second.first;
-        int ay = it->second.second;
-        if ((ax<=x) & (ay<=y)) {
-            // potential block including this point because it is less than the point coordinates
-            // take the coordinates largest & closest
-            if (ax >tx)
-                tx = ax;
-            if (ay>ty)
-                ty = ay;
-        }
-    }
-    // why in 2013 am I still using sprintf?
-    char tmpstr[1024];
-    sprintf(tmpstr,"%s.block_X%d_Y%d", runid.c_str(), tx, ty); // runid.block_X0_Y0 for example
-    string retval = tmpstr;
-
-    return(retval);
-};
+int RecalibrationHandler::RunIndex(const string &runid) const {
+    map<string,int>::const_iterator it = run_index.find(runid);
+    if (it == run_index.end())
+      return -1;
+    return it->second;
+}
 
 
 void RecalibrationHandler::ReadRecalibrationFromComments(const SamHeader &samHeader, int max_flows_protect) {
@@ -200,6 +182,26 @@ void RecalibrationHandler::ReadRecalibrationFromComments(const SamHeader &samHea
         }
     }
 
+    // Flatten block_hash so that reads can resolve their block without string work
+    run_index.clear();
+    run_block_start.clear();
+    recal_blocks.clear();
+    for (multimap<string,pair<int,int> >::const_iterator it = block_hash.begin(); it != block_hash.end(); ++it) {
+        if (run_index.find(it->first) == run_index.end()) {
+            run_index[it->first] = run_block_start.size();
+            run_block_start.push_back(recal_blocks.size());
+        }
+        RecalBlock block;
+        block.x = it->second.first;
+        block.y = it->second.second;
+        char tmpstr[1024];
+        sprintf(tmpstr,"%s.block_X%d_Y%d", it->first.c_str(), block.x, block.y); // runid.block_X0_Y0 for example
+        map<string, RecalibrationModel>::const_iterator model = bam_header_recalibration.find(tmpstr);
+        block.model = (model != bam_header_recalibration.end()) ? &(model->second) : NULL;
+        recal_blocks.push_back(block);
+    }
+    run_block_start.push_back(recal_blocks.size());
+
     // okay, now, avoid spamming with possibly large number of lines
     if (is_live){
       cout << "Recalibration was detected from comment lines in bam file(s)" << endl;
@@ -207,19 +209,114 @@ void RecalibrationHandler::ReadRecalibrationFromComments(const SamHeader &samHea
     }
 }
 
-void RecalibrationHandler::getAB(MultiAB &multi_ab, const string &found_key, int x, int y) const {
-    if (use_recal_model_only)
+void RecalibrationHandler::getAB(MultiAB &multi_ab, int run_idx, int x, int y) const {
+    if (use_recal_model_only) {
         recalModel.getAB(multi_ab,x,y);
-    else {
-      // found_key in map to get iterator
-      map<string, RecalibrationModel>::const_iterator it;
-      it = bam_header_recalibration.find(found_key);
-      if (it!=bam_header_recalibration.end()){ 
-        it->second.getAB(multi_ab, x, y);
-      } else
-        multi_ab.Null();
+        return;
+    }
+    multi_ab.Null();
+    if (run_idx < 0)
+        return;
+
+    // take the largest block coordinates not exceeding the point coordinates
+    int tx,ty;
+    tx = ty=0;
+    for (int i_block = run_block_start[run_idx]; i_block < run_block_start[run_idx+1]; ++i_block) {
+        if ((recal_blocks[i_block].x<=x) & (recal_blocks[i_block].y<=y)) {
+            if (recal_blocks[i_block].x > tx)
+                tx = recal_blocks[i_block].x;
+            if (recal_blocks[i_block].y > ty)
+                ty = recal_blocks[i_block].y;
+        }
+    }
+    for (int i_block = run_block_start[run_idx]; i_block < run_block_start[run_idx+1]; ++i_block) {
+        if (recal_blocks[i_block].x == tx and recal_blocks[i_block].y == ty) {
+            if (recal_blocks[i_block].model)
+                recal_blocks[i_block].model->getAB(multi_ab, x, y);
+            return;
+        }
     }
 };
 
 
+// -------------------------------------------------------------------
+
+ReadPrefixCache::Entry * ReadPrefixCache::Find(int read_number) {
+  map<int,Entry>::iterator it = entries_.find(read_number);
+  if (it == entries_.end()) {
+    num_misses_++;
+    return NULL;
+  }
+  num_hits_++;
+  return &(it->second);
+}
+
+ReadPrefixCache::Entry & ReadPrefixCache::Insert(int read_number, int chr, long end) {
+  Entry &entry = entries_[read_number];
+  entry.chr = chr;
+  entry.end = end;
+  entry.prefix_flow = -1;
+  entry.prefix.clear();
+  return entry;
+}
+
+void ReadPrefixCache::Evict(int chr, long position, int first_read_number) {
+  // Reads ahead of the first read of the current window have been passed by the walker for good
+  entries_.erase(entries_.begin(), entries_.lower_bound(first_read_number));
+  if (entries_.size() <= kMaxEntries)
+    return;
+
+  // Window is unusually deep: also drop reads that end before the current position
+  for (map<int,Entry>::iterator it = entries_.begin(); it != entries_.end(); ) {
+    if (it->second.chr < chr or (it->second.chr == chr and it->second.end <= position))
+      entries_.erase(it++);
+    else
+      ++it;
+  }
+  if (entries_.size() > kMaxEntries)
+    entries_.clear();
+}
+
+// -------------------------------------------------------------------
+
+unsigned int RealignmentCache::MakeKey(const string& query, const string& target, const string& aln_path,
+                                       int clipping, bool is_forward) {
+  key_.clear();
+  key_.push_back('0' + clipping);
+  key_.push_back(is_forward ? 'F' : 'R');
+  key_ += query;
+  key_.push_back('\n');
+  key_ += target;
+  key_.push_back('\n');
+  key_ += aln_path;
+
+  // FNV-1a hash of the key
+  unsigned int hash = 2166136261u;
+  for (unsigned int i = 0; i < key_.length(); ++i) {
+    hash ^= (unsigned char)key_[i];
+    hash *= 16777619u;
+  }
+  return hash & (kNumSlots-1);
+}
+
+bool RealignmentCache::Find(const string& query, const string& target, const string& aln_path, int clipping,
+                            bool is_forward, bool& success, string& new_aln_path) {
+  Entry &entry = entries_[MakeKey(query, target, aln_path, clipping, is_forward)];
+  if (not entry.valid or entry.key != key_) {
+    num_misses_++;
+    return false;
+  }
+  num_hits_++;
+  success = entry.success;
+  new_aln_path = entry.new_aln_path;
+  return true;
+}
 
+void RealignmentCache::Insert(const string& query, const string& target, const string& aln_path, int clipping,
+                              bool is_forward, bool success, const string& new_aln_path) {
+  Entry &entry = entries_[MakeKey(query, target, aln_path, clipping, is_forward)];
+  entry.valid = true;
+  entry.success = success;
+  entry.key = key_;
+  entry.new_aln_path = new_aln_path;
+}
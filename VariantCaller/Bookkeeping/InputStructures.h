@@ -16,6 +16,7 @@
 #include <Variant.h>
 
 #include "RecalibrationModel.h"
+#include "VariantAnnotation.h"
 #include "../Splice/ErrorMotifs.h"
 #include "ExtendParameters.h"
 #include "TreephaserSSE.h"
@@ -28,6 +29,7 @@ using namespace ion;
 
 
 class InputStructures;
+class DiagnosticWriter;
 class ReferenceReader;
 class TargetsManager;
 class BAMWalkerEngine;
@@ -35,6 +37,9 @@ class AlleleParser;
 class OrderedVCFWriter;
 class SampleManager;
 class MetricsManager;
+class TraceWriter;
+class TraceBuffer;
+class ProgressReporter;
 
 struct VariantCallerContext {
 
@@ -46,6 +51,9 @@ struct VariantCallerContext {
   AlleleParser *      candidate_generator;          //! Candidate variant generator
   OrderedVCFWriter *  vcf_writer;                   //! Sorting, threading friendly VCF writer
   MetricsManager *    metrics_manager;              //! Keeps track of metrics to output in tvc_metrics.json
+  DiagnosticWriter *  diagnostic_writer;            //! Collects json diagnostic records into one container file
+  TraceWriter *       trace_writer;                 //! Timeline of worker activity, open only with --trace-file
+  ProgressReporter *  progress_reporter;            //! Live progress file, open only with --progress-file
 
   pthread_mutex_t     bam_walker_mutex;             //! Mutex for state-altering bam_walker operations
   pthread_mutex_t     read_loading_mutex;           //! Mutex for raw read retrieval
@@ -117,6 +125,7 @@ struct VariantSpecificParams {
 struct VariantCandidate {
   VariantCandidate(vcf::VariantCallFile& initializer) : variant(initializer), position_upper_bound(0) {}
   vcf::Variant variant;
+  VariantAnnotation annotation;   // Typed INFO/FORMAT values filled in by evaluation and filtering
   vector<VariantSpecificParams> variant_specific_params;
   int position_upper_bound;   // Prevents SNP healing from accidentally reordering vcf records
 };
@@ -133,15 +142,26 @@ class RecalibrationHandler{
     
     map<string, RecalibrationModel> bam_header_recalibration; // look up the proper recalibration handler by run id + block coordinates
     multimap<string,pair<int,int> > block_hash;  // from run id, find appropriate block coordinates available
+
+    // Flat form of block_hash: run ids interned to integers,
+    // blocks of run r are recal_blocks[run_block_start[r]] ... recal_blocks[run_block_start[r+1]-1]
+    struct RecalBlock {
+      int x;
+      int y;
+      const RecalibrationModel * model;   // NULL if the header had no model under this block's key
+    };
+    map<string,int>     run_index;
+    vector<int>         run_block_start;
+    vector<RecalBlock>  recal_blocks;
     
  void ReadRecalibrationFromComments(const SamHeader &samHeader, int max_flows_protect);
  
 //  vector<vector<vector<float> > > * getAs(string &found_key, int x, int y){return(recalModel.getAs(x,y));};
 //  vector<vector<vector<float> > > * getBs(string &found_key, int x, int y){return(recalModel.getBs(x,y));};
-  void getAB(MultiAB &multi_ab, const string &found_key, int x, int y) const;
+  void getAB(MultiAB &multi_ab, int run_idx, int x, int y) const;
   
   bool recal_is_live() const { return(is_live); };
-  string FindKey(const string &runid, int x, int y) const;
+  int  RunIndex(const string &runid) const;
   
   RecalibrationHandler(){use_recal_model_only = false; is_live = false; };
 };
@@ -178,18 +198,97 @@ public:
 
 // -------------------------------------------------------------------
 
+// Per-read evaluation work that does not depend on the candidate variant.
+// Neighboring candidates share most of their reads, so the solved read prefix
+// is computed once per read and reused until the walker moves past it.
+class ReadPrefixCache {
+public:
+
+  struct Entry {
+    int           chr;            //! Chromosome of the read, for eviction
+    long          end;            //! End of the read's last usable allele, for eviction
+    int           prefix_flow;    //! Flow of the last solved prefix base, -1 if not solved yet
+    vector<char>  prefix;         //! Solved read prefix (key, barcode, clipped bases)
+  };
+
+  ReadPrefixCache() : num_hits_(0), num_misses_(0) {}
+
+  //! @brief  Return cached entry for this read number, or NULL if there is none
+  Entry * Find(int read_number);
+  //! @brief  Create an empty entry for this read number
+  Entry & Insert(int read_number, int chr, long end);
+  //! @brief  Drop reads that cannot be used by this or any later position of this thread
+  void    Evict(int chr, long position, int first_read_number);
+
+  long    num_hits() const { return num_hits_; }
+  long    num_misses() const { return num_misses_; }
+
+private:
+  const static unsigned int kMaxEntries = 20000; //! Hard bound for pathological read windows
+
+  map<int,Entry>    entries_;     //! Keyed by read_number, which follows BAM (position) order
+  long              num_hits_;
+  long              num_misses_;
+};
+
+// -------------------------------------------------------------------
+
+// Outcomes of the local realignment done when splicing hypotheses.
+// Reads sharing an amplicon start present identical read windows, reference windows and
+// previous alignments at every nearby candidate, so the realigned path is looked up in a
+// bounded direct mapped table instead of being recomputed.
+class RealignmentCache {
+public:
+
+  RealignmentCache() : entries_(kNumSlots), num_hits_(0), num_misses_(0) {}
+
+  //! @brief  Look up the outcome of a realignment, returns false if it is not cached
+  bool    Find(const string& query, const string& target, const string& aln_path, int clipping,
+               bool is_forward, bool& success, string& new_aln_path);
+  //! @brief  Store the outcome of a realignment, replacing the previous occupant of its slot
+  void    Insert(const string& query, const string& target, const string& aln_path, int clipping,
+               bool is_forward, bool success, const string& new_aln_path);
+
+  long    num_hits() const { return num_hits_; }
+  long    num_misses() const { return num_misses_; }
+
+private:
+  struct Entry {
+    Entry() : valid(false), success(false) {}
+    bool          valid;          //! Slot is occupied
+    bool          success;        //! Realignment succeeded
+    string        key;            //! Exact realignment input, see MakeKey
+    string        new_aln_path;   //! Realigned pretty alignment
+  };
+
+  const static unsigned int kNumSlots = 4096; //! Power of two
+
+  //! @brief  Build key from realignment input in key_ and return its slot
+  unsigned int  MakeKey(const string& query, const string& target, const string& aln_path, int clipping, bool is_forward);
+
+  vector<Entry>     entries_;
+  string            key_;
+  long              num_hits_;
+  long              num_misses_;
+};
+
+// -------------------------------------------------------------------
+
 // A collections of objects that are shared and reused thoughout the execution of one tread
 class PersistingThreadObjects {
 public:
 
 	PersistingThreadObjects(const InputStructures &global_context)
     : realigner(50, 1), dpTreephaser(global_context.treePhaserFlowOrder, 50),
-      treephaser_sse(global_context.treePhaserFlowOrder, 50)  {}
+      treephaser_sse(global_context.treePhaserFlowOrder, 50), trace(NULL)  {}
 	~PersistingThreadObjects() { };
 
 	Realigner         realigner;      // realignment tool
   DPTreephaser      dpTreephaser;   // c++ treephaser
   TreephaserSSE     treephaser_sse; // vectorized treephaser
+  ReadPrefixCache   read_prefix_cache; // per-read work shared between nearby candidates
+  RealignmentCache  realignment_cache; // realignment outcomes shared between reads and candidates
+  TraceBuffer *     trace;          // this thread's timeline events, NULL unless tracing
 };
 
 
@@ -0,0 +1,153 @@
+/* Copyright (C) 2013 Ion Torrent Systems, Inc. All Rights Reserved */
+
+//! @file     VariantAnnotation.h
+//! @ingroup  VariantCaller
+//! @brief    Typed INFO/FORMAT values computed by tvc for one VCF record
+
+#ifndef VARIANTANNOTATION_H
+#define VARIANTANNOTATION_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <utility>
+
+using namespace std;
+
+
+//! Append a number to a VCF line the way ostream << does it (precision 6, %g)
+inline void AppendVcfReal(string& line, double value)
+{
+  char buffer[32];
+  int length = snprintf(buffer, sizeof(buffer), "%g", value);
+  line.append(buffer, length);
+}
+
+inline void AppendVcfInteger(string& line, long value)
+{
+  char buffer[24];
+  char *end = buffer + sizeof(buffer);
+  char *start = end;
+  unsigned long magnitude = value < 0 ? -(unsigned long)value : value;
+  do {
+    *--start = '0' + magnitude % 10;
+    magnitude /= 10;
+  } while (magnitude);
+  if (value < 0)
+    *--start = '-';
+  line.append(start, end - start);
+}
+
+
+//! Values of one INFO or FORMAT key; present mirrors whether the key exists in a vcf::Variant map
+struct AnnotationValues {
+  AnnotationValues() : present(false) {}
+  bool                  present;
+  vector<double>        values;
+};
+
+
+//! The INFO and FORMAT fields that the flow evaluator and the filters fill in.
+//! Values keep their type until WriteVcfRecord prints them, instead of going through convertToString
+//! and the vcf::Variant string maps. Fields from the candidate generator stay in vcf::Variant.
+class VariantAnnotation {
+public:
+  // Sorted by key, so records can be merged with vcf::Variant::info in map order.
+  // The FORMAT fields are the leading NUM_FORMAT_FIELDS entries.
+  enum Field {
+    AF = 0, FAO, FDP, FRO, FSAF, FSAR, FSRF, FSRR,
+    FWDB, FXX, MLLD, PB, PBP, QD, RBI, REFB, REVB, SSEN, SSEP, SSSB, STB, STBP, VARB,
+    NUM_INFO_FIELDS
+  };
+  static const int NUM_FORMAT_FIELDS = FSRR + 1;
+
+  struct Block {
+    AnnotationValues  field[NUM_INFO_FIELDS];
+  };
+
+  static const char * Key(int field) {
+    static const char * keys[NUM_INFO_FIELDS] = {
+      "AF", "FAO", "FDP", "FRO", "FSAF", "FSAR", "FSRF", "FSRR",
+      "FWDB", "FXX", "MLLD", "PB", "PBP", "QD", "RBI", "REFB", "REVB", "SSEN", "SSEP", "SSSB", "STB", "STBP", "VARB" };
+    return keys[field];
+  }
+  static bool IsInteger(int field) {
+    return field == FAO or field == FDP or field == FRO or field == FSAF or field == FSAR or field == FSRF or field == FSRR;
+  }
+  static bool IsPerAllele(int field) {
+    return not (field == FDP or field == FRO or field == FSRF or field == FSRR or field == FXX or field == QD);
+  }
+
+  static void AppendValue(string& line, int field, double value) {
+    if (IsInteger(field))
+      AppendVcfInteger(line, (long)value);
+    else
+      AppendVcfReal(line, value);
+  }
+
+  // INFO fields
+
+  void Push(Field field, double value) {
+    info.field[field].present = true;
+    info.field[field].values.push_back(value);
+  }
+  //! Empties a present field, like ClearVal does for vcf::Variant::info
+  void Clear(Field field) {
+    info.field[field].values.clear();
+  }
+  const AnnotationValues& Info(Field field) const { return info.field[field]; }
+  Block& InfoBlock() { return info; }
+
+  //! The value as it reads back from the VCF text, 0 if missing
+  float PrintedValue(Field field, unsigned int index) const {
+    const AnnotationValues& values = info.field[field];
+    if (index >= values.values.size())
+      return 0.0f;
+    string text;
+    AppendValue(text, field, values.values[index]);
+    return atof(text.c_str());
+  }
+
+  // FORMAT fields, by sample
+
+  static void Push(Block& block, Field field, double value) {
+    block.field[field].present = true;
+    block.field[field].values.push_back(value);
+  }
+  Block& Sample(const string& sample_name) {
+    for (unsigned int i = 0; i < samples.size(); ++i)
+      if (samples[i].first == sample_name)
+        return samples[i].second;
+    samples.push_back(make_pair(sample_name, Block()));
+    return samples.back().second;
+  }
+  const Block * FindSample(const string& sample_name) const {
+    for (unsigned int i = 0; i < samples.size(); ++i)
+      if (samples[i].first == sample_name)
+        return &samples[i].second;
+    return NULL;
+  }
+
+  //! Drop the values of one alternate allele, as vcf::Variant::removeAlt does for Number=A fields
+  void RemoveAllele(int alt_index) {
+    RemoveAllele(info, NUM_INFO_FIELDS, alt_index);
+    for (unsigned int i = 0; i < samples.size(); ++i)
+      RemoveAllele(samples[i].second, NUM_FORMAT_FIELDS, alt_index);
+  }
+
+private:
+  static void RemoveAllele(Block& block, int num_fields, int alt_index) {
+    for (int field = 0; field < num_fields; ++field) {
+      vector<double>& values = block.field[field].values;
+      if (IsPerAllele(field) and alt_index >= 0 and alt_index < (int)values.size())
+        values.erase(values.begin() + alt_index);
+    }
+  }
+
+  Block                         info;       //!< INFO fields
+  vector<pair<string,Block> >   samples;    //!< FORMAT fields by sample name
+};
+
+
+#endif // VARIANTANNOTATION_H
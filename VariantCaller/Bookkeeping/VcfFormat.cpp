@@ -149,7 +149,7 @@ void ClearVal(vcf::Variant &var, const char *clear_me){
 
 
 //clear all the info tags, in case of a HotSpot VCF react Info tags might contain prior values
-void clearInfoTags(vcf::Variant &var) {
+void clearInfoTags(vcf::Variant &var, VariantAnnotation &annotation) {
   map<string, vector<string> >::iterator it;
 
   it = var.info.find("RO");
@@ -180,93 +180,75 @@ void clearInfoTags(vcf::Variant &var) {
   if (it != var.info.end())
       var.info["DP"].clear();
 
-  
-  it = var.info.find("RBI");
-  if (it != var.info.end())
-      var.info["RBI"].clear();
-
   it = var.info.find("HRUN");
   if (it != var.info.end())
       var.info["HRUN"].clear();
 
-  
-  it = var.info.find("MLLD");
-  if (it != var.info.end())
-      var.info["MLLD"].clear();
-
-  //SSE compute
-  ClearVal(var,"SSSB");
-  ClearVal(var,"SSEN");
-  ClearVal(var,"SSEP");
-  
-  it = var.info.find("STB");
-  if (it != var.info.end())
-    var.info["STB"].clear();
+  // Values computed by tvc live in the annotation; drop stale copies that came in with a hotspot record
+  for (int field = 0; field < VariantAnnotation::NUM_INFO_FIELDS; ++field)
+    var.info.erase(VariantAnnotation::Key(field));
 
-  it = var.info.find("STBP");
-  if (it != var.info.end())
-    var.info["STBP"].clear();
-
-  it = var.info.find("PBP");
-  if (it != var.info.end())
-    var.info["PBP"].clear();
+  annotation.Clear(VariantAnnotation::RBI);
+  annotation.Clear(VariantAnnotation::MLLD);
 
-/*  it = var.info.find("SXB");
-  if (it != var.info.end())
-    var.info["SXB"].clear();*/
-
-  ClearVal(var,"FDP");
-  ClearVal(var,"FRO");
-  ClearVal(var,"FAO");
-  //ClearVal(var,"JUNK");
-  ClearVal(var,"AF");
-  ClearVal(var,"FSRF");
-  ClearVal(var,"FSRR");
-  ClearVal(var,"FSAF");
-  ClearVal(var,"FSAR");
-  ClearVal(var,"FXX");
-  ClearVal(var,"QD");
+  //SSE compute
+  annotation.Clear(VariantAnnotation::SSSB);
+  annotation.Clear(VariantAnnotation::SSEN);
+  annotation.Clear(VariantAnnotation::SSEP);
+
+  annotation.Clear(VariantAnnotation::STB);
+  annotation.Clear(VariantAnnotation::STBP);
+  annotation.Clear(VariantAnnotation::PBP);
+
+  annotation.Clear(VariantAnnotation::FDP);
+  annotation.Clear(VariantAnnotation::FRO);
+  annotation.Clear(VariantAnnotation::FAO);
+  annotation.Clear(VariantAnnotation::AF);
+  annotation.Clear(VariantAnnotation::FSRF);
+  annotation.Clear(VariantAnnotation::FSRR);
+  annotation.Clear(VariantAnnotation::FSAF);
+  annotation.Clear(VariantAnnotation::FSAR);
+  annotation.Clear(VariantAnnotation::FXX);
+  annotation.Clear(VariantAnnotation::QD);
 }
 
-void NullInfoFields(vcf::Variant &var, bool use_position_bias){
-   clearInfoTags(var);
+void NullInfoFields(vcf::Variant &var, VariantAnnotation &annotation, bool use_position_bias){
+   clearInfoTags(var, annotation);
    for (vector<string>::iterator I = var.alt.begin(); I != var.alt.end(); ++I) {
      var.info["AO"].push_back(convertToString(0));
      var.info["SAF"].push_back(convertToString(0));
      var.info["SAR"].push_back(convertToString(0));
-     var.info["FAO"].push_back(convertToString(0));
-     var.info["AF"].push_back(convertToString(0));
-     var.info["FSAF"].push_back(convertToString(0));
-     var.info["FSAR"].push_back(convertToString(0));
+     annotation.Push(VariantAnnotation::FAO, 0);
+     annotation.Push(VariantAnnotation::AF, 0);
+     annotation.Push(VariantAnnotation::FSAF, 0);
+     annotation.Push(VariantAnnotation::FSAR, 0);
      var.info["HRUN"].push_back(convertToString(0));
-     var.info["RBI"].push_back(convertToString(0));
-     var.info["FWDB"].push_back(convertToString(0));
-     var.info["REVB"].push_back(convertToString(0));
-     var.info["REFB"].push_back(convertToString(0));
-     var.info["VARB"].push_back(convertToString(0));
-     var.info["SSSB"].push_back(convertToString(0));
-     var.info["SSEN"].push_back(convertToString(0));
-     var.info["SSEP"].push_back(convertToString(0));
-     var.info["STB"].push_back(convertToString(0));
-     var.info["STBP"].push_back(convertToString(0));
+     annotation.Push(VariantAnnotation::RBI, 0);
+     annotation.Push(VariantAnnotation::FWDB, 0);
+     annotation.Push(VariantAnnotation::REVB, 0);
+     annotation.Push(VariantAnnotation::REFB, 0);
+     annotation.Push(VariantAnnotation::VARB, 0);
+     annotation.Push(VariantAnnotation::SSSB, 0);
+     annotation.Push(VariantAnnotation::SSEN, 0);
+     annotation.Push(VariantAnnotation::SSEP, 0);
+     annotation.Push(VariantAnnotation::STB, 0);
+     annotation.Push(VariantAnnotation::STBP, 0);
      if(use_position_bias) {
-    	 var.info["PB"].push_back(convertToString(0.5f));
-    	 var.info["PBP"].push_back(convertToString(1.0f));
+       annotation.Push(VariantAnnotation::PB, 0.5f);
+       annotation.Push(VariantAnnotation::PBP, 1.0f);
      }
-     var.info["MLLD"].push_back(convertToString(0));
+     annotation.Push(VariantAnnotation::MLLD, 0);
    }
    var.info["DP"].push_back(convertToString(0));
    var.info["RO"].push_back(convertToString(0));
    var.info["SRF"].push_back(convertToString(0));
    var.info["SRR"].push_back(convertToString(0));
-   
-   var.info["FDP"].push_back(convertToString(0));
-   var.info["FRO"].push_back(convertToString(0));
-   var.info["FSRF"].push_back(convertToString(0));
-   var.info["FSRR"].push_back(convertToString(0));
-   var.info["FXX"].push_back(convertToString(0.0));
-   var.info["QD"].push_back(convertToString(0.0));
-   
+   annotation.Push(VariantAnnotation::FDP, 0);
+   annotation.Push(VariantAnnotation::FRO, 0);
+   annotation.Push(VariantAnnotation::FSRF, 0);
+   annotation.Push(VariantAnnotation::FSRR, 0);
+   annotation.Push(VariantAnnotation::FXX, 0.0);
+   annotation.Push(VariantAnnotation::QD, 0.0);
 }
 
  // set up format string
@@ -322,6 +304,11 @@ float RetrieveQualityTagValue(vcf::Variant &current_variant, const string &tag_w
   else weight = 0.0f;
   return(weight);
 }
+
+float RetrieveQualityTagValue(const VariantAnnotation &annotation, VariantAnnotation::Field tag_wanted, int _allele_index){
+  // read back the value as printed, so filters decide on the same numbers as downstream tools
+  return annotation.PrintedValue(tag_wanted, _allele_index);
+}
 // XXX
 
 void NullFilterReason(vcf::Variant &candidate_variant){
@@ -335,24 +322,25 @@ void AddFilterReason(vcf::Variant &candidate_variant, string &additional_reason)
 }
 
 // if, for example, missing data
-void NullGenotypeAllSamples(vcf::Variant & candidate_variant)
+void NullGenotypeAllSamples(vcf::Variant & candidate_variant, VariantAnnotation &annotation)
 {
   vector<string>& sampleNames = candidate_variant.sampleNames;
 
   for (vector<string>::iterator its = sampleNames.begin(); its != sampleNames.end(); ++its) {
     string& sampleName = *its;
     map<string, vector<string> >& sampleOutput = candidate_variant.samples[sampleName];
+    VariantAnnotation::Block& sampleAnnotation = annotation.Sample(sampleName);
       sampleOutput["GT"].push_back("./.");
       sampleOutput["GQ"].push_back(convertToString(0));
-      sampleOutput["FDP"].push_back(convertToString(0));
-      sampleOutput["FRO"].push_back(convertToString(0));
-      sampleOutput["FSRF"].push_back(convertToString(0));
-      sampleOutput["FSRR"].push_back(convertToString(0));
+      VariantAnnotation::Push(sampleAnnotation, VariantAnnotation::FDP, 0);
+      VariantAnnotation::Push(sampleAnnotation, VariantAnnotation::FRO, 0);
+      VariantAnnotation::Push(sampleAnnotation, VariantAnnotation::FSRF, 0);
+      VariantAnnotation::Push(sampleAnnotation, VariantAnnotation::FSRR, 0);
       for (vector<string>::iterator I = candidate_variant.alt.begin(); I != candidate_variant.alt.end(); ++I) {
-        sampleOutput["FAO"].push_back(convertToString(0));
-        sampleOutput["AF"].push_back(convertToString(0));
-        sampleOutput["FSAF"].push_back(convertToString(0));
-        sampleOutput["FSAR"].push_back(convertToString(0));
+        VariantAnnotation::Push(sampleAnnotation, VariantAnnotation::FAO, 0);
+        VariantAnnotation::Push(sampleAnnotation, VariantAnnotation::AF, 0);
+        VariantAnnotation::Push(sampleAnnotation, VariantAnnotation::FSAF, 0);
+        VariantAnnotation::Push(sampleAnnotation, VariantAnnotation::FSAR, 0);
       }
   }
 }
@@ -433,37 +421,28 @@ void SetFilteredStatus(vcf::Variant &candidate_variant, bool isFiltered) {
 
 
 
-void AdjustFDPForRemovedAlleles(vcf::Variant &candidate_variant, int filtered_allele_index, string sampleName)
+void AdjustFDPForRemovedAlleles(VariantAnnotation &annotation, int filtered_allele_index, string sampleName)
 {
   // first do the "info" tag as it is easier to find
-  map<string, vector<string> >::iterator it;
-  int total_depth=0;
-
-  it = candidate_variant.info.find("FDP");
-  if (it != candidate_variant.info.end())
-    total_depth = atoi(candidate_variant.info["FDP"][0].c_str()); // or is this current sample ident?
-
-  int allele_depth = 0;
-  it = candidate_variant.info.find("FAO");
-  if (it != candidate_variant.info.end())
-    allele_depth = atoi(candidate_variant.info["FAO"][filtered_allele_index].c_str());
+  int total_depth = RetrieveQualityTagValue(annotation, VariantAnnotation::FDP, 0);
+  int allele_depth = RetrieveQualityTagValue(annotation, VariantAnnotation::FAO, filtered_allele_index);
 
   total_depth -= allele_depth;
   if (total_depth<0)
     total_depth = 0; // how can this happen?
 
-  ClearVal(candidate_variant, "FDP");
-  candidate_variant.info["FDP"].push_back(convertToString(total_depth));
+  annotation.Clear(VariantAnnotation::FDP);
+  annotation.Push(VariantAnnotation::FDP, total_depth);
 
   if (!sampleName.empty()) {
-      map<string, vector<string> >& sampleOutput = candidate_variant.samples[sampleName];
-      sampleOutput["FDP"].clear();
-      sampleOutput["FDP"].push_back(convertToString(total_depth));
+      VariantAnnotation::Block& sampleAnnotation = annotation.Sample(sampleName);
+      sampleAnnotation.field[VariantAnnotation::FDP].values.clear();
+      VariantAnnotation::Push(sampleAnnotation, VariantAnnotation::FDP, total_depth);
   }
 }
 
 
-void RemoveFilteredAlleles(vcf::Variant &candidate_variant, vector<int> &filtered_alleles_index) {
+void RemoveFilteredAlleles(vcf::Variant &candidate_variant, VariantAnnotation &annotation, vector<int> &filtered_alleles_index) {
   //now that all possible alt. alleles are evaluated decide on which allele is most likely and remove any that
   //that does'nt pass score threshold. Determine Genotype based on alleles that have evidence.
   candidate_variant.updateAlleleIndexes();
@@ -485,11 +464,12 @@ void RemoveFilteredAlleles(vcf::Variant &candidate_variant, vector<int> &filtere
 
       //altStr = (*candidate_variant)->alt[index];
       // Note: need to update index for adjustments
-      //AdjustFDPForRemovedAlleles(candidate_variant, index, sample_name);
+      //AdjustFDPForRemovedAlleles(annotation, index, sample_name);
       //cout << "Removed Fitered allele: index = " << index << " allele = " << altStr << endl;
       // @TODO: removeAlt wrecks the genotype as well
       // fix so we don't remove genotype components.
 
+      annotation.RemoveAllele(candidate_variant.getAltAlleleIndex(altStr));
       candidate_variant.removeAlt(altStr);
       candidate_variant.updateAlleleIndexes();
       // if we are deleting alleles, indicate data potentially damaged at this location
@@ -530,3 +510,142 @@ void AdjustAlleles(vcf::Variant &candidate_variant, int position_upper_bound)
 
 }
 
+
+
+static void AppendJoined(string& line, const vector<string>& values)
+{
+  for (unsigned int idx = 0; idx < values.size(); ++idx) {
+    if (idx)
+      line += ',';
+    line += values[idx];
+  }
+}
+
+static void AppendJoined(string& line, int field, const vector<double>& values)
+{
+  for (unsigned int idx = 0; idx < values.size(); ++idx) {
+    if (idx)
+      line += ',';
+    VariantAnnotation::AppendValue(line, field, values[idx]);
+  }
+}
+
+// Index of a present FORMAT field in the sample annotation, -1 if the key is not there
+static int FindFormatField(const VariantAnnotation::Block *block, const string& key)
+{
+  if (block)
+    for (int field = 0; field < VariantAnnotation::NUM_FORMAT_FIELDS; ++field)
+      if (block->field[field].present and key == VariantAnnotation::Key(field))
+        return field;
+  return -1;
+}
+
+// Produces the same text as vcflib's operator<<, with the annotation merged into INFO and FORMAT
+void WriteVcfRecord(string& line, vcf::Variant& var, const VariantAnnotation& annotation)
+{
+  line += var.sequenceName;
+  line += '\t';
+  AppendVcfInteger(line, var.position);
+  line += '\t';
+  line += var.id;
+  line += '\t';
+  line += var.ref;
+  line += '\t';
+  AppendJoined(line, var.alt);
+  line += '\t';
+  AppendVcfReal(line, var.quality);
+  line += '\t';
+  line += var.filter;
+  line += '\t';
+
+  // INFO: both sources are sorted by key; vcflib omits the separator only before the very first key, empty or not
+  bool info_empty = var.info.empty();
+  for (int field = 0; field < VariantAnnotation::NUM_INFO_FIELDS; ++field)
+    if (annotation.Info((VariantAnnotation::Field)field).present)
+      info_empty = false;
+
+  bool first_key = true;
+  map<string, vector<string> >::const_iterator entry = var.info.begin();
+  int field = 0;
+  while (entry != var.info.end() or field < VariantAnnotation::NUM_INFO_FIELDS) {
+    if (field < VariantAnnotation::NUM_INFO_FIELDS and not annotation.Info((VariantAnnotation::Field)field).present) {
+      ++field;
+      continue;
+    }
+    int order = 1;
+    if (field == VariantAnnotation::NUM_INFO_FIELDS)
+      order = -1;
+    else if (entry != var.info.end())
+      order = entry->first.compare(VariantAnnotation::Key(field));
+
+    if (order < 0) {
+      if (not entry->second.empty()) {
+        if (not first_key)
+          line += ';';
+        line += entry->first;
+        line += '=';
+        AppendJoined(line, entry->second);
+      }
+      ++entry;
+    } else {
+      if (order == 0)
+        ++entry;  // annotation takes precedence over a string value of the same key
+      const vector<double>& values = annotation.Info((VariantAnnotation::Field)field).values;
+      if (not values.empty()) {
+        if (not first_key)
+          line += ';';
+        line += VariantAnnotation::Key(field);
+        line += '=';
+        AppendJoined(line, field, values);
+      }
+      ++field;
+    }
+    first_key = false;
+  }
+
+  for (map<string, bool>::const_iterator flag = var.infoFlags.begin(); flag != var.infoFlags.end(); ++flag) {
+    if (flag != var.infoFlags.begin() or not info_empty)
+      line += ';';
+    line += flag->first;
+  }
+
+  if (not var.format.empty()) {
+    line += '\t';
+    for (vector<string>::const_iterator key = var.format.begin(); key != var.format.end(); ++key) {
+      if (key != var.format.begin())
+        line += ':';
+      line += *key;
+    }
+    for (vector<string>::const_iterator sample_name = var.outputSampleNames.begin(); sample_name != var.outputSampleNames.end(); ++sample_name) {
+      line += '\t';
+      map<string, map<string, vector<string> > >::const_iterator sample = var.samples.find(*sample_name);
+      const VariantAnnotation::Block *sample_annotation = annotation.FindSample(*sample_name);
+      int num_values = 0;
+      if (sample != var.samples.end())
+        num_values += sample->second.size();
+      if (sample_annotation)
+        for (int field = 0; field < VariantAnnotation::NUM_FORMAT_FIELDS; ++field)
+          if (sample_annotation->field[field].present)
+            ++num_values;
+      if (num_values == 0) {
+        line += '.';
+        continue;
+      }
+      for (vector<string>::const_iterator key = var.format.begin(); key != var.format.end(); ++key) {
+        if (key != var.format.begin())
+          line += ':';
+        int field = FindFormatField(sample_annotation, *key);
+        if (field >= 0) {
+          AppendJoined(line, field, sample_annotation->field[field].values);
+          continue;
+        }
+        map<string, vector<string> >::const_iterator values;
+        if (sample != var.samples.end() and (values = sample->second.find(*key)) != sample->second.end())
+          AppendJoined(line, values->second);
+        else
+          line += '.';
+      }
+    }
+  }
+  line += '\n';
+}
@@ -27,6 +27,7 @@
 #include <stdlib.h>
 #include <Variant.h>
 #include "AlleleParser.h"
+#include "VariantAnnotation.h"
 
 using namespace std;
 
@@ -34,25 +35,29 @@ using namespace std;
 class ExtendParameters; 
 
 string getVCFHeader(const ExtendParameters *parameters, const vector<string>& sample_list);
-void clearInfoTags(vcf::Variant &var);
-void NullInfoFields(vcf::Variant &var, bool use_position_bias);
+void clearInfoTags(vcf::Variant &var, VariantAnnotation &annotation);
+void NullInfoFields(vcf::Variant &var, VariantAnnotation &annotation, bool use_position_bias);
 void SetUpFormatString(vcf::Variant &var);
 int CalculateWeightOfVariant(vcf::Variant &current_variant);
 void ClearVal(vcf::Variant &var, const char *clear_me);
 float RetrieveQualityTagValue(vcf::Variant &current_variant, const string &tag_wanted, int _allele_index);
+float RetrieveQualityTagValue(const VariantAnnotation &annotation, VariantAnnotation::Field tag_wanted, int _allele_index);
 
 // double-star pointer here
 void SetFilteredStatus(vcf::Variant & candidate_variant, bool isFiltered);
 void StoreGenotypeForOneSample(vcf::Variant & candidate_variant, const string &my_sample_name, string &my_genotype, float genotype_quality);
-void NullGenotypeAllSamples(vcf::Variant & candidate_variant);
+void NullGenotypeAllSamples(vcf::Variant & candidate_variant, VariantAnnotation &annotation);
 void OverwriteGenotypeForOneSample(vcf::Variant & candidate_variant, const string &my_sample_name, string &my_genotype, float genotype_quality);
 void NullFilterReason(vcf::Variant &candidate_variant);
 void AddFilterReason(vcf::Variant &candidate_variant, string &additional_reason);
 void DetectAndSetFilteredGenotype(vcf::Variant &candidate_variant, const string &sampleName);
 
 // generic variant manipulation
-void RemoveFilteredAlleles(vcf::Variant & candidate_variant, vector<int> &filtered_allele_index);
+void RemoveFilteredAlleles(vcf::Variant & candidate_variant, VariantAnnotation &annotation, vector<int> &filtered_allele_index);
 void AdjustAlleles(vcf::Variant & candidate_variant, int position_upper_bound);
 
+//! Format one record, annotation included, as vcflib's operator<< would and append it to line
+void WriteVcfRecord(string& line, vcf::Variant& var, const VariantAnnotation& annotation);
+
 
 #endif //VCFFORMAT_H
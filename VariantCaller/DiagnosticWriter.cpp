@@ -0,0 +1,284 @@
+/* Copyright (C) 2013 Ion Torrent Systems, Inc. All Rights Reserved */
+
+//! @file     DiagnosticWriter.cpp
+//! @ingroup  VariantCaller
+//! @brief    Asynchronous writer and reader for the indexed diagnostic container
+
+#include "DiagnosticWriter.h"
+
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <zlib.h>
+
+static const char kContainerMagic[] = "TVCDIAG1";
+static const char kIndexMagic[]     = "TVCDIDX1";
+static const int  kMagicLength = 8;
+static const int  kMaxQueuedRecords = 64;   // Rich diagnostic records can reach megabytes each
+
+static void PutUInt32(string& buffer, uint32_t value)
+{
+  for (int i = 0; i < 4; ++i)
+    buffer.push_back((char)((value >> (8*i)) & 0xff));
+}
+
+static void PutUInt64(string& buffer, uint64_t value)
+{
+  for (int i = 0; i < 8; ++i)
+    buffer.push_back((char)((value >> (8*i)) & 0xff));
+}
+
+static bool GetUInt32(FILE *input, uint32_t& value)
+{
+  unsigned char bytes[4];
+  if (fread(bytes, 1, 4, input) != 4)
+    return false;
+  value = 0;
+  for (int i = 3; i >= 0; --i)
+    value = (value << 8) | bytes[i];
+  return true;
+}
+
+static bool GetUInt64(FILE *input, uint64_t& value)
+{
+  unsigned char bytes[8];
+  if (fread(bytes, 1, 8, input) != 8)
+    return false;
+  value = 0;
+  for (int i = 7; i >= 0; --i)
+    value = (value << 8) | bytes[i];
+  return true;
+}
+
+// -------------------------------------------------------------------
+
+DiagnosticWriter::DiagnosticWriter()
+{
+  output_ = NULL;
+  file_offset_ = 0;
+  closing_ = false;
+  pthread_mutex_init(&queue_mutex_, NULL);
+  pthread_cond_init(&queue_not_empty_, NULL);
+  pthread_cond_init(&queue_not_full_, NULL);
+}
+
+DiagnosticWriter::~DiagnosticWriter()
+{
+  Close();
+  pthread_mutex_destroy(&queue_mutex_);
+  pthread_cond_destroy(&queue_not_empty_);
+  pthread_cond_destroy(&queue_not_full_);
+}
+
+
+void DiagnosticWriter::Initialize(const string& filename)
+{
+  filename_ = filename;
+  output_ = fopen(filename.c_str(), "wb");
+  if (not output_) {
+    cerr << "ERROR: Cannot open diagnostic file " << filename << " : " << strerror(errno) << endl;
+    exit(1);
+  }
+  setvbuf(output_, NULL, _IOFBF, 1<<20);
+  fwrite(kContainerMagic, 1, kMagicLength, output_);
+  file_offset_ = kMagicLength;
+  closing_ = false;
+
+  if (pthread_create(&writer_thread_, NULL, DiagnosticWriter::WriterThread, this)) {
+    cerr << "ERROR: Cannot start diagnostic writer thread" << endl;
+    exit(1);
+  }
+}
+
+
+void DiagnosticWriter::Write(const string& key, string& payload)
+{
+  pthread_mutex_lock(&queue_mutex_);
+  while (queue_.size() >= (unsigned int)kMaxQueuedRecords)
+    pthread_cond_wait(&queue_not_full_, &queue_mutex_);
+  queue_.push_back(DiagnosticRecord());
+  queue_.back().key = key;
+  queue_.back().payload.swap(payload);
+  pthread_mutex_unlock(&queue_mutex_);
+  pthread_cond_signal(&queue_not_empty_);
+}
+
+
+void * DiagnosticWriter::WriterThread(void *input)
+{
+  DiagnosticWriter& writer = *static_cast<DiagnosticWriter*>(input);
+  deque<DiagnosticRecord> batch;
+
+  while (true) {
+    pthread_mutex_lock(&writer.queue_mutex_);
+    while (writer.queue_.empty() and not writer.closing_)
+      pthread_cond_wait(&writer.queue_not_empty_, &writer.queue_mutex_);
+    bool done = writer.queue_.empty() and writer.closing_;
+    batch.swap(writer.queue_);
+    pthread_mutex_unlock(&writer.queue_mutex_);
+    pthread_cond_broadcast(&writer.queue_not_full_);
+
+    if (done)
+      break;
+    writer.WriteBatch(batch);
+    batch.clear();
+  }
+  return NULL;
+}
+
+
+void DiagnosticWriter::WriteBatch(deque<DiagnosticRecord>& batch)
+{
+  string header;
+  for (deque<DiagnosticRecord>::iterator record = batch.begin(); record != batch.end(); ++record) {
+    uLongf compressed_length = compressBound(record->payload.size());
+    if (compress_buffer_.size() < compressed_length)
+      compress_buffer_.resize(compressed_length);
+    if (compress2(&compress_buffer_[0], &compressed_length, (const Bytef*)record->payload.data(),
+        record->payload.size(), 1) != Z_OK) {
+      cerr << "ERROR: Cannot compress diagnostic record " << record->key << endl;
+      exit(1);
+    }
+
+    header.clear();
+    PutUInt32(header, record->key.size());
+    PutUInt32(header, record->payload.size());
+    PutUInt32(header, compressed_length);
+    header += record->key;
+
+    index_keys_.push_back(record->key);
+    index_offsets_.push_back(file_offset_);
+    fwrite(header.data(), 1, header.size(), output_);
+    fwrite(&compress_buffer_[0], 1, compressed_length, output_);
+    file_offset_ += header.size() + compressed_length;
+  }
+}
+
+
+void DiagnosticWriter::Close()
+{
+  if (not output_)
+    return;
+
+  pthread_mutex_lock(&queue_mutex_);
+  closing_ = true;
+  pthread_mutex_unlock(&queue_mutex_);
+  pthread_cond_signal(&queue_not_empty_);
+  pthread_join(writer_thread_, NULL);
+
+  string index;
+  PutUInt32(index, index_keys_.size());
+  for (unsigned int idx = 0; idx < index_keys_.size(); ++idx) {
+    PutUInt32(index, index_keys_[idx].size());
+    index += index_keys_[idx];
+    PutUInt64(index, index_offsets_[idx]);
+  }
+  PutUInt64(index, file_offset_);
+  index.append(kIndexMagic, kMagicLength);
+  fwrite(index.data(), 1, index.size(), output_);
+
+  if (fclose(output_))
+    cerr << "ERROR: Cannot finish writing diagnostic file " << filename_ << " : " << strerror(errno) << endl;
+  output_ = NULL;
+}
+
+// -------------------------------------------------------------------
+
+bool DiagnosticReader::Open(const string& filename)
+{
+  Close();
+  input_ = fopen(filename.c_str(), "rb");
+  if (not input_)
+    return false;
+
+  char magic[kMagicLength];
+  if (fread(magic, 1, kMagicLength, input_) != (size_t)kMagicLength or memcmp(magic, kContainerMagic, kMagicLength)) {
+    Close();
+    return false;
+  }
+  if (LoadIndex())
+    return true;
+  // No valid trailer: the run was probably interrupted, recover what was written
+  return ScanRecords();
+}
+
+void DiagnosticReader::Close()
+{
+  if (input_)
+    fclose(input_);
+  input_ = NULL;
+  keys_.clear();
+  offsets_.clear();
+}
+
+
+bool DiagnosticReader::LoadIndex()
+{
+  char magic[kMagicLength];
+  uint64_t index_offset = 0;
+  if (fseeko(input_, -(kMagicLength+8), SEEK_END) or not GetUInt64(input_, index_offset)
+      or fread(magic, 1, kMagicLength, input_) != (size_t)kMagicLength or memcmp(magic, kIndexMagic, kMagicLength))
+    return false;
+
+  uint32_t num_records = 0;
+  if (fseeko(input_, index_offset, SEEK_SET) or not GetUInt32(input_, num_records))
+    return false;
+  keys_.resize(num_records);
+  offsets_.resize(num_records);
+  for (uint32_t idx = 0; idx < num_records; ++idx) {
+    uint32_t key_length = 0;
+    if (not GetUInt32(input_, key_length))
+      return false;
+    keys_[idx].resize(key_length);
+    if (key_length and fread(&keys_[idx][0], 1, key_length, input_) != key_length)
+      return false;
+    if (not GetUInt64(input_, offsets_[idx]))
+      return false;
+  }
+  return true;
+}
+
+
+bool DiagnosticReader::ScanRecords()
+{
+  keys_.clear();
+  offsets_.clear();
+  uint64_t offset = kMagicLength;
+  while (fseeko(input_, offset, SEEK_SET) == 0) {
+    uint32_t key_length, payload_length, compressed_length;
+    if (not GetUInt32(input_, key_length) or not GetUInt32(input_, payload_length) or not GetUInt32(input_, compressed_length))
+      break;
+    string key(key_length, ' ');
+    if (key_length and fread(&key[0], 1, key_length, input_) != key_length)
+      break;
+    uint64_t next_offset = offset + 12 + key_length + compressed_length;
+    // Only accept records that were written completely
+    if (fseeko(input_, next_offset-1, SEEK_SET) or fgetc(input_) == EOF)
+      break;
+    keys_.push_back(key);
+    offsets_.push_back(offset);
+    offset = next_offset;
+  }
+  return true;
+}
+
+
+bool DiagnosticReader::ReadRecord(int idx, string& payload)
+{
+  uint32_t key_length, payload_length, compressed_length;
+  if (fseeko(input_, offsets_[idx], SEEK_SET) or not GetUInt32(input_, key_length)
+      or not GetUInt32(input_, payload_length) or not GetUInt32(input_, compressed_length)
+      or fseeko(input_, key_length, SEEK_CUR))
+    return false;
+
+  vector<unsigned char> compressed(compressed_length+1);
+  if (fread(&compressed[0], 1, compressed_length, input_) != compressed_length)
+    return false;
+
+  payload.resize(payload_length);
+  uLongf uncompressed_length = payload_length;
+  if (payload_length and uncompress((Bytef*)&payload[0], &uncompressed_length, &compressed[0], compressed_length) != Z_OK)
+    return false;
+  return uncompressed_length == payload_length;
+}
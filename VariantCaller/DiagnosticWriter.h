@@ -0,0 +1,94 @@
+/* Copyright (C) 2013 Ion Torrent Systems, Inc. All Rights Reserved */
+
+//! @file     DiagnosticWriter.h
+//! @ingroup  VariantCaller
+//! @brief    Asynchronous writer and reader for the indexed diagnostic container
+
+#ifndef DIAGNOSTICWRITER_H
+#define DIAGNOSTICWRITER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <pthread.h>
+
+using namespace std;
+
+// Container layout (all integers little endian):
+//   file header:  "TVCDIAG1"
+//   record:       uint32 key length, uint32 payload length, uint32 compressed length, key, zlib-compressed payload
+//   index:        uint32 number of records, then per record: uint32 key length, key, uint64 record offset
+//   trailer:      uint64 index offset, "TVCDIDX1"
+// A container without trailer (e.g. from an interrupted run) can still be read by scanning the records.
+
+
+struct DiagnosticRecord {
+  string              key;              //! Record name, the per-variant JSON file name of old
+  string              payload;          //! Serialized JSON
+};
+
+
+class DiagnosticWriter {
+public:
+  DiagnosticWriter();
+  ~DiagnosticWriter();
+
+  //! @brief  Open the container and start the writer thread
+  void Initialize(const string& filename);
+  bool IsOpen() const { return output_ != NULL; }
+
+  //! @brief  Queue one record for writing; payload is swapped out. Blocks only if the queue is full.
+  void Write(const string& key, string& payload);
+
+  //! @brief  Drain the queue, write the index and close the container
+  void Close();
+
+  int num_records() const { return index_keys_.size(); }
+
+private:
+  static void * WriterThread(void *input);
+  void WriteBatch(deque<DiagnosticRecord>& batch);
+
+  FILE *                        output_;            //! Container file
+  string                        filename_;          //! Container file name
+  uint64_t                      file_offset_;       //! Bytes written so far
+  deque<DiagnosticRecord>       queue_;             //! Records waiting for the writer thread
+  bool                          closing_;           //! No more records will be queued
+  pthread_t                     writer_thread_;     //! Single thread doing compression and file output
+  pthread_mutex_t               queue_mutex_;       //! Mutex protecting queue_ and closing_
+  pthread_cond_t                queue_not_empty_;   //! Signals the writer thread
+  pthread_cond_t                queue_not_full_;    //! Signals workers waiting for queue space
+  vector<string>                index_keys_;        //! Keys of written records, in file order
+  vector<uint64_t>              index_offsets_;     //! File offsets of written records
+  vector<unsigned char>         compress_buffer_;   //! Scratch space for zlib
+};
+
+
+class DiagnosticReader {
+public:
+  DiagnosticReader() : input_(NULL) {}
+  ~DiagnosticReader() { Close(); }
+
+  //! @brief  Open a container and load its index; returns false on error
+  bool Open(const string& filename);
+  void Close();
+
+  int num_records() const { return keys_.size(); }
+  const string& key(int idx) const { return keys_[idx]; }
+
+  //! @brief  Read and decompress one record; returns false on error
+  bool ReadRecord(int idx, string& payload);
+
+private:
+  bool LoadIndex();
+  bool ScanRecords();
+
+  FILE *                        input_;
+  vector<string>                keys_;
+  vector<uint64_t>              offsets_;
+};
+
+
+#endif // DIAGNOSTICWRITER_H
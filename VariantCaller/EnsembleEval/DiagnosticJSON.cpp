@@ -3,13 +3,11 @@
 #include "DiagnosticJson.h"
 //----------------------output some diagnostic information below---------------
 
-void DiagnosticWriteJson(const Json::Value & json, const std::string& filename_json) {
-  std::ofstream outJsonFile(filename_json.c_str(), std::ios::out);
-  if (outJsonFile.good())
-    outJsonFile << json.toStyledString();
-  else
-    std::cerr << "[tvc] diagnostic unable to write JSON file " << filename_json << std::endl;
-  outJsonFile.close();
+// Serialize compactly in the worker and leave compression and file output to the writer thread
+void DiagnosticWriteJson(const Json::Value & json, const std::string& record_name, DiagnosticWriter& diagnostic_writer) {
+  Json::FastWriter compact_writer;
+  string payload = compact_writer.write(json);
+  diagnostic_writer.Write(record_name, payload);
 }
 
 void DiagnosticJsonReadStack(Json::Value &json, const vector<const Alignment *>& read_stack, const InputStructures &global_context) {
@@ -167,11 +165,11 @@ void DiagnosticJsonHistory(Json::Value &json, const HypothesisStack &hypothesis_
 
 void TinyDiagnosticOutput(const vector<const Alignment *>& read_stack, const HypothesisStack &hypothesis_stack,
     const string& variant_contig, int variant_position, const string& ref_allele, const string& var_allele,
-    const InputStructures &global_context, const string &out_dir){
+    const InputStructures &global_context, DiagnosticWriter& diagnostic_writer){
   string outFile;
   Json::Value diagnostic_json;
 
-  outFile = out_dir + variant_contig + "."
+  outFile = variant_contig + "."
             + convertToString(variant_position) + "."
             + ref_allele + "." + var_allele + ".tiny.json";
   // just a little bit of data
@@ -179,16 +177,16 @@ void TinyDiagnosticOutput(const vector<const Alignment *>& read_stack, const Hyp
   TinyDiagnosticJsonCrossStack(diagnostic_json["CrossHypotheses"], hypothesis_stack);
   DiagnosticJsonBias(diagnostic_json["Latent"], hypothesis_stack.cur_state.bias_generator);
   // write it out
-  DiagnosticWriteJson(diagnostic_json, outFile);
+  DiagnosticWriteJson(diagnostic_json, outFile, diagnostic_writer);
 }
 
 void RichDiagnosticOutput(const vector<const Alignment *>& read_stack, const HypothesisStack &hypothesis_stack,
     const string& variant_contig, int variant_position, const string& ref_allele, const string& var_allele,
-    const InputStructures &global_context, const string  &out_dir) {
+    const InputStructures &global_context, DiagnosticWriter& diagnostic_writer) {
   string outFile;
   Json::Value diagnostic_json;
 
-  outFile = out_dir + variant_contig + "."
+  outFile = variant_contig + "."
             + convertToString(variant_position) + "."
             + ref_allele + "." + var_allele + ".diagnostic.json";
 
@@ -204,11 +202,11 @@ void RichDiagnosticOutput(const vector<const Alignment *>& read_stack, const Hyp
   DiagnosticJsonMisc(diagnostic_json["Misc"], hypothesis_stack.cur_state);
   DiagnosticJsonHistory(diagnostic_json["History"],hypothesis_stack);
 
-  DiagnosticWriteJson(diagnostic_json, outFile);
+  DiagnosticWriteJson(diagnostic_json, outFile, diagnostic_writer);
 }
 
 void JustOneDiagnosis(const EnsembleEval &my_ensemble, const InputStructures &global_context,
-    const string &out_dir, bool rich_diag)
+    DiagnosticWriter& diagnostic_writer, bool rich_diag)
 {
   //diagnose one particular variant
   // check against a list?
@@ -226,9 +224,9 @@ void JustOneDiagnosis(const EnsembleEval &my_ensemble, const InputStructures &gl
 
   if (rich_diag)
     RichDiagnosticOutput(my_ensemble.read_stack, my_ensemble.allele_eval,
-        variant_contig, variant_position, ref_allele, var_allele, global_context, out_dir);
+        variant_contig, variant_position, ref_allele, var_allele, global_context, diagnostic_writer);
   else
     TinyDiagnosticOutput(my_ensemble.read_stack, my_ensemble.allele_eval,
-        variant_contig, variant_position, ref_allele, var_allele, global_context, out_dir);
+        variant_contig, variant_position, ref_allele, var_allele, global_context, diagnostic_writer);
 }
 
@@ -14,10 +14,12 @@
 
 #include "StackEngine.h"
 #include "json/json.h"
+#include "DiagnosticWriter.h"
 
 using namespace std;
 
+//! @brief  Queue the diagnostic record of one variant; the record is named like the per-variant JSON file of old
 void JustOneDiagnosis(const EnsembleEval &my_ensemble, const InputStructures &global_context,
-    const string &out_dir, bool rich_diag);
+    DiagnosticWriter& diagnostic_writer, bool rich_diag);
 
 #endif // DIAGNOSTICJSON_H
@@ -22,10 +22,10 @@ void ShortStack::PropagateTuningParameters(EnsembleEvalTuningParameters &my_para
 
 // fill in predictions for each hypothesis
 void ShortStack::FillInPredictions(PersistingThreadObjects &thread_objects, vector<const Alignment *>& read_stack,
-    const InputStructures &global_context)
+    const InputStructures &global_context, unsigned int first_read)
 {
   //ion::FlowOrder flow_order(my_data.flow_order, my_data.flow_order.length());
-  for (unsigned int i_read = 0; i_read < my_hypotheses.size(); i_read++) {
+  for (unsigned int i_read = first_read; i_read < my_hypotheses.size(); i_read++) {
     my_hypotheses[i_read].FillInPrediction(thread_objects, *read_stack[i_read], global_context);
     my_hypotheses[i_read].start_flow = read_stack[i_read]->start_flow;
   }
@@ -38,9 +38,9 @@ void ShortStack::ResetQualities() {
   }
 }
 
-void ShortStack::InitTestFlow() {
+void ShortStack::InitTestFlow(unsigned int first_read) {
   // ! does not reset test flows or delta (correctly)
-  for (unsigned int i_read = 0; i_read < my_hypotheses.size(); i_read++) {
+  for (unsigned int i_read = first_read; i_read < my_hypotheses.size(); i_read++) {
     my_hypotheses[i_read].InitializeTestFlows();
   }
 };
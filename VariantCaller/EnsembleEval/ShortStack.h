@@ -26,9 +26,9 @@ class ShortStack{
   vector<int> valid_indexes;
   void FindValidIndexes(); // only loop over reads where we successfully filled in variants
   
-  void FillInPredictions(PersistingThreadObjects &thread_objects, vector<const Alignment *>& read_stack, const InputStructures &global_context);
+  void FillInPredictions(PersistingThreadObjects &thread_objects, vector<const Alignment *>& read_stack, const InputStructures &global_context, unsigned int first_read = 0);
   void ResetQualities();
-  void InitTestFlow();
+  void InitTestFlow(unsigned int first_read = 0);
   float PosteriorFrequencyLogLikelihood(const vector<float> &hyp_freq, const vector<float> &prior_frequency_weight, float prior_log_normalization, float my_reliability, int strand_key);
   void PropagateTuningParameters(EnsembleEvalTuningParameters &my_params);
     void ResetRelevantResiduals();
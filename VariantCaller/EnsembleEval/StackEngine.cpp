@@ -156,12 +156,12 @@ float HypothesisStack::ReturnMaxLL() {
   return(cur_state.cur_posterior.ReturnMaxLL());
 }
 
-void HypothesisStack::InitForInference(PersistingThreadObjects &thread_objects, vector<const Alignment *>& read_stack, const InputStructures &global_context, int num_hyp_no_null) {
+void HypothesisStack::InitForInference(PersistingThreadObjects &thread_objects, vector<const Alignment *>& read_stack, const InputStructures &global_context, int num_hyp_no_null, unsigned int first_read) {
   PropagateTuningParameters(num_hyp_no_null); // sub-objects need to know
 
-  // predict given hypotheses per read
-  total_theory.FillInPredictions(thread_objects, read_stack, global_context);
-  total_theory.InitTestFlow();
+  // predict given hypotheses per read; reads before first_read already hold their predictions
+  total_theory.FillInPredictions(thread_objects, read_stack, global_context, first_read);
+  total_theory.InitTestFlow(first_read);
   total_theory.FindValidIndexes();
   // how many alleles?
   AllocateFrequencyStarts(num_hyp_no_null);
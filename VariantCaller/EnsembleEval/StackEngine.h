@@ -90,7 +90,7 @@ public:
   void TriangulateRestart();
   float ExecuteOneRestart(vector<float> &restart_hyp, int max_detail_level = 0);
   void ExecuteInference( int max_detail_level = 0);
-  void InitForInference(PersistingThreadObjects &thread_objects, vector<const Alignment *>& read_stack, const InputStructures &global_context, int num_hyp_no_null);
+  void InitForInference(PersistingThreadObjects &thread_objects, vector<const Alignment *>& read_stack, const InputStructures &global_context, int num_hyp_no_null, unsigned int first_read = 0);
   
   // change estimates for variance
   
@@ -119,6 +119,9 @@ public:
   int                    multiallele_window_end;
   vector<string>         info_fields;
   bool                   doRealignment;
+  unsigned int           num_valid_reads;         //!< Reads with successfully spliced hypotheses
+  unsigned int           num_realigned_reads;     //!< Valid reads whose alignment was changed by realignment
+  int                    realignment_info_index;  //!< Entry of info_fields reporting the realignment, -1 if none
 
   // Allele evaluation information
 
@@ -134,6 +137,9 @@ public:
     multiallele_window_start = -1;
     multiallele_window_end = -1;
     doRealignment = false;
+    num_valid_reads = 0;
+    num_realigned_reads = 0;
+    realignment_info_index = -1;
   };
 
   //! @brief  Create a detailed picture about this variant and all its alleles
@@ -142,10 +148,15 @@ public:
 
   void FilterAllAlleles(const ClassifyFilters &filter_variant, const vector<VariantSpecificParams>& variant_specific_params);
 
+  //! @brief  Use candidate generator allele counts to decide whether evaluation can be skipped
+  bool PrescreenAllAlleles(const ControlCallAndFilters &my_controls, const vector<VariantSpecificParams>& variant_specific_params);
+
   void StackUpOneVariant(const ExtendParameters &parameters, const PositionInProgress& bam_position);
 
-  void SpliceAllelesIntoReads(PersistingThreadObjects &thread_objects, const InputStructures &global_context,
-                           const ExtendParameters &parameters, const ReferenceReader &ref_reader, int chr_idx);
+  //! @brief  Splice alleles into reads [first_read, read_stack.size()); returns the first read whose hypotheses changed
+  unsigned int SpliceAllelesIntoReads(PersistingThreadObjects &thread_objects, const InputStructures &global_context,
+                           const ExtendParameters &parameters, const ReferenceReader &ref_reader, int chr_idx,
+                           unsigned int first_read = 0);
 
   void ApproximateHardClassifierForReads(vector<int> &read_allele_id, vector<bool> &strand_id, vector<int> &dist_to_left, vector<int> &dist_to_right);
   void ApproximateHardClassifierForReadsFromMultiAlleles(vector<int> &read_allele_id, vector<bool> &strand_id, vector<int> &dist_to_left, vector<int> &dist_to_right);
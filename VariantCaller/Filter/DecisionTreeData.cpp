@@ -2,12 +2,13 @@
 
 #include "DecisionTreeData.h"
 
-void AutoFailTheCandidate(vcf::Variant &candidate_variant, bool use_position_bias) {
+void AutoFailTheCandidate(VariantCandidate &candidate, bool use_position_bias, const string &filter_reason) {
+  vcf::Variant &candidate_variant = candidate.variant;
   candidate_variant.quality = 0.0f;
-  NullInfoFields(candidate_variant, use_position_bias); // no information, destroy any spurious entries, add all needed tags
-  NullGenotypeAllSamples(candidate_variant);
+  NullInfoFields(candidate_variant, candidate.annotation, use_position_bias); // no information, destroy any spurious entries, add all needed tags
+  NullGenotypeAllSamples(candidate_variant, candidate.annotation);
   NullFilterReason(candidate_variant);
-  string my_reason = "NODATA";
+  string my_reason = filter_reason;
   AddFilterReason(candidate_variant, my_reason);
   SetFilteredStatus(candidate_variant, true);
 }
@@ -31,6 +32,23 @@ float FreqThresholdByType(AlleleIdentity &variant_identity, const ControlCallAnd
   return my_controls.filter_snps.min_allele_freq;
 }
 
+float QualThresholdByType(AlleleIdentity &variant_identity, const ControlCallAndFilters &my_controls,
+    const VariantSpecificParams& variant_specific_params)
+{
+  if (variant_specific_params.min_variant_score_override)
+    return variant_specific_params.min_variant_score;
+  if (variant_identity.status.isHotSpot)
+    return my_controls.filter_hotspot.min_quality_score;
+  if (variant_identity.ActAsSNP())
+    return my_controls.filter_snps.min_quality_score;
+  if (variant_identity.ActAsMNP())
+    return my_controls.filter_mnp.min_quality_score;
+  if (variant_identity.ActAsHPIndel())
+    return my_controls.filter_hp_indel.min_quality_score;
+
+  return my_controls.filter_snps.min_quality_score;
+}
+
 
 string EvaluatedGenotype::GenotypeAsString(){
   stringstream tmp_g;
@@ -47,23 +65,23 @@ bool EvaluatedGenotype::IsReference(){
 
 
 
-void PushAlleleCountsOntoStringMaps(map<string, vector<string> >& my_map, MultiBook &all_summary_stats){
-  my_map["FDP"].push_back(convertToString(all_summary_stats.TotalCount(-1)));
+void PushAlleleCounts(VariantAnnotation::Block& my_block, MultiBook &all_summary_stats){
+  VariantAnnotation::Push(my_block, VariantAnnotation::FDP, all_summary_stats.TotalCount(-1));
 
-  my_map["FRO"].push_back(convertToString(all_summary_stats.GetAlleleCount(-1,0)));
-  my_map["FSRF"].push_back(convertToString(all_summary_stats.GetAlleleCount(0,0)));
-  my_map["FSRR"].push_back(convertToString(all_summary_stats.GetAlleleCount(1,0)));
+  VariantAnnotation::Push(my_block, VariantAnnotation::FRO, all_summary_stats.GetAlleleCount(-1,0));
+  VariantAnnotation::Push(my_block, VariantAnnotation::FSRF, all_summary_stats.GetAlleleCount(0,0));
+  VariantAnnotation::Push(my_block, VariantAnnotation::FSRR, all_summary_stats.GetAlleleCount(1,0));
 
   // alternate allele count varies by allele
   for ( int i_alt=0; i_alt< all_summary_stats.NumAltAlleles(); i_alt++){
 
-    my_map["FAO"].push_back(convertToString(all_summary_stats.GetAlleleCount(-1,i_alt+1)));
-    my_map["FSAF"].push_back(convertToString(all_summary_stats.GetAlleleCount(0,i_alt+1)));
-    my_map["FSAR"].push_back(convertToString(all_summary_stats.GetAlleleCount(1,i_alt+1)));
+    VariantAnnotation::Push(my_block, VariantAnnotation::FAO, all_summary_stats.GetAlleleCount(-1,i_alt+1));
+    VariantAnnotation::Push(my_block, VariantAnnotation::FSAF, all_summary_stats.GetAlleleCount(0,i_alt+1));
+    VariantAnnotation::Push(my_block, VariantAnnotation::FSAR, all_summary_stats.GetAlleleCount(1,i_alt+1));
     if (all_summary_stats.TotalCount(-1) > 0)
-      my_map["AF"].push_back(convertToString((double)all_summary_stats.GetAlleleCount(-1,i_alt+1) / (double)all_summary_stats.TotalCount(-1)));
+      VariantAnnotation::Push(my_block, VariantAnnotation::AF, (double)all_summary_stats.GetAlleleCount(-1,i_alt+1) / (double)all_summary_stats.TotalCount(-1));
     else
-      my_map["AF"].push_back(convertToString(0));
+      VariantAnnotation::Push(my_block, VariantAnnotation::AF, 0);
   }
 }
 
@@ -356,7 +374,7 @@ void DecisionTreeData::SimplifySNPsIfNeeded(VariantCandidate &candidate_variant,
     }
     // and therefore will give a nonsense genotype if we do adjust
     if (!cannot_adjust){
-      RemoveFilteredAlleles(candidate_variant.variant, filteredAllelesIndex);
+      RemoveFilteredAlleles(candidate_variant.variant, candidate_variant.annotation, filteredAllelesIndex);
       AdjustAlleles(candidate_variant.variant, candidate_variant.position_upper_bound);
     }
   }
@@ -444,9 +462,9 @@ void DecisionTreeData::FilterSSE(vcf::Variant &candidate_variant, const Classify
     // change for 4.0:  store all allele information for multiallele clean filter application after VCF
     int _alt_allele_index = i_allele;
     float base_strand_bias = ComputeBaseStrandBiasForSSE(filter_variant.sse_relative_safety_level, candidate_variant, _alt_allele_index);
-    candidate_variant.info["SSSB"].push_back(convertToString(base_strand_bias));
-    candidate_variant.info["SSEP"].push_back(convertToString(allele_identity_vector[_alt_allele_index].sse_prob_positive_strand));
-    candidate_variant.info["SSEN"].push_back(convertToString(allele_identity_vector[_alt_allele_index].sse_prob_negative_strand));
+    annotation->Push(VariantAnnotation::SSSB, base_strand_bias);
+    annotation->Push(VariantAnnotation::SSEP, allele_identity_vector[_alt_allele_index].sse_prob_positive_strand);
+    annotation->Push(VariantAnnotation::SSEN, allele_identity_vector[_alt_allele_index].sse_prob_negative_strand);
 
     //@TODO: make sure this takes information from the tags in candidate variant and nowhere else
     // which forces us to be honest and only use information in the output
@@ -461,8 +479,8 @@ void DecisionTreeData::FilterSSE(vcf::Variant &candidate_variant, const Classify
 void DecisionTreeData::AddStrandBiasTags(vcf::Variant &candidate_variant){
   for ( int i_allele=0; i_allele<all_summary_stats.NumAltAlleles(); i_allele++){
     // ignore the ref allele, by convention allele 0, increment done all_summary_stats
-    candidate_variant.info["STB"].push_back(convertToString(all_summary_stats.OldStrandBias(i_allele, tune_sbias)));
-    candidate_variant.info["STBP"].push_back(convertToString(all_summary_stats.StrandBiasPval(i_allele, tune_sbias)));
+    annotation->Push(VariantAnnotation::STB, all_summary_stats.OldStrandBias(i_allele, tune_sbias));
+    annotation->Push(VariantAnnotation::STBP, all_summary_stats.StrandBiasPval(i_allele, tune_sbias));
 //    (*candidate_variant)->info["SXB"].push_back(convertToString(all_summary_stats.GetXBias(i_allele,tune_xbias)));  // variance zero = 0.1^2
     }
 }
@@ -477,13 +495,11 @@ void DecisionTreeData::AddPositionBiasTags(vcf::Variant &candidate_variant)
     int i_alt = i_allele+1;
     float v = all_summary_stats.GetPositionBias(i_alt);
     if ( isinitialized(v) ) {
-      string val = convertToString(v);
-      candidate_variant.info["PB"].push_back(val);
+      annotation->Push(VariantAnnotation::PB, v);
     }
     float v1 = all_summary_stats.GetPositionBiasPval(i_alt);
     if ( isinitialized(v1) ) {
-      string val1 = convertToString(all_summary_stats.GetPositionBiasPval(i_alt));
-      candidate_variant.info["PBP"].push_back(val1);
+      annotation->Push(VariantAnnotation::PBP, v1);
     }
   }
 }
@@ -497,15 +513,14 @@ void DecisionTreeData::AddCountInformationTags(vcf::Variant & candidate_variant,
 
   AddPositionBiasTags(candidate_variant);
 
-   map<string, vector<string> >& infoOutput = candidate_variant.info;
-   PushAlleleCountsOntoStringMaps(infoOutput,all_summary_stats);
+   PushAlleleCounts(annotation->InfoBlock(), all_summary_stats);
 
    // testing this field for filtering
-   infoOutput["FXX"].push_back(convertToString(all_summary_stats.GetFailedReadRatio()));
+   annotation->Push(VariantAnnotation::FXX, all_summary_stats.GetFailedReadRatio());
 
   if (!sampleName.empty()) {
-      map<string, vector<string> >& sampleOutput = candidate_variant.samples[sampleName];
-      PushAlleleCountsOntoStringMaps(sampleOutput, all_summary_stats);
+      candidate_variant.samples[sampleName];  // the sample column is written even if only typed values exist
+      PushAlleleCounts(annotation->Sample(sampleName), all_summary_stats);
   }
 
   // hrun fill in
@@ -515,15 +530,15 @@ void DecisionTreeData::AddCountInformationTags(vcf::Variant & candidate_variant,
   }
 }
 
-void SetQualityByDepth(vcf::Variant &candidate_variant){
+void SetQualityByDepth(vcf::Variant &candidate_variant, VariantAnnotation &annotation){
   float raw_qual_score= candidate_variant.quality;
-  unsigned int scan_read_depth = atoi(candidate_variant.info["FDP"][0].c_str());
+  unsigned int scan_read_depth = RetrieveQualityTagValue(annotation, VariantAnnotation::FDP, 0);
   // factor of 4 to put on similar scale to other data outputs.
   // depends on rounding of log-likleihood changes
   if (scan_read_depth > 0)
-    candidate_variant.info["QD"].push_back(convertToString(4.0*raw_qual_score/scan_read_depth));
+    annotation.Push(VariantAnnotation::QD, 4.0*raw_qual_score/scan_read_depth);
   else
-    candidate_variant.info["QD"].push_back(convertToString(0));
+    annotation.Push(VariantAnnotation::QD, 0);
 }
 
 void DecisionTreeData::GenotypeFromEvaluator(vcf::Variant & candidate_variant, const ExtendParameters &parameters){
@@ -540,7 +555,7 @@ void DecisionTreeData::GenotypeFromEvaluator(vcf::Variant & candidate_variant, c
 void DecisionTreeData::FilterOnStringency(vcf::Variant &candidate_variant, const float data_quality_stringency, int _check_allele_index) {
 
 
-  float filter_on_min_quality = RetrieveQualityTagValue(candidate_variant, "MLLD", _check_allele_index);
+  float filter_on_min_quality = RetrieveQualityTagValue(*annotation, VariantAnnotation::MLLD, _check_allele_index);
 
   if ((data_quality_stringency > filter_on_min_quality)) {
 
@@ -581,7 +596,7 @@ void DecisionTreeData::SpecializedFilterFromLatentVariables(vcf::Variant & candi
     bias_threshold = bias_radius; // fine now
 
 //  float radius_bias = hypothesis_stack.cur_state.bias_generator.RadiusOfBias();
-   float radius_bias = RetrieveQualityTagValue(candidate_variant, "RBI", _allele);
+   float radius_bias = RetrieveQualityTagValue(*annotation, VariantAnnotation::RBI, _allele);
 
   if (radius_bias > bias_threshold) {
     stringstream filterReasonStr;
@@ -623,8 +638,8 @@ void DecisionTreeData::SpecializedFilterFromHypothesisBias(vcf::Variant & candid
 
 //  float ref_bias = hypothesis_stack.cur_state.bias_generator.latent_bias_v[0];
 //  float var_bias = hypothesis_stack.cur_state.bias_generator.latent_bias_v[1];
-  float ref_bias = RetrieveQualityTagValue(candidate_variant, "REFB", _allele);
-  float var_bias = RetrieveQualityTagValue(candidate_variant, "VARB", _allele);
+  float ref_bias = RetrieveQualityTagValue(*annotation, VariantAnnotation::REFB, _allele);
+  float var_bias = RetrieveQualityTagValue(*annotation, VariantAnnotation::VARB, _allele);
 
   if (allele_identity.ActAsHPIndel()) {
     if (allele_identity.status.isDeletion) {
@@ -636,8 +651,8 @@ void DecisionTreeData::SpecializedFilterFromHypothesisBias(vcf::Variant & candid
   }
 }
 
-void FilterOnReadRejectionRate(vcf::Variant &candidate_variant, float read_rejection_threshold){
-  float observed_read_rejection = RetrieveQualityTagValue(candidate_variant, "FXX",0);
+void FilterOnReadRejectionRate(vcf::Variant &candidate_variant, const VariantAnnotation &annotation, float read_rejection_threshold){
+  float observed_read_rejection = RetrieveQualityTagValue(annotation, VariantAnnotation::FXX, 0);
   if (observed_read_rejection>read_rejection_threshold){
     SetFilteredStatus(candidate_variant, true);
     string my_reason = "REJECTION";
@@ -735,7 +750,7 @@ void DecisionTreeData::FilterMyCandidate(vcf::Variant &candidate_variant, const
   GenotypeAlleleFilterMyCandidate(candidate_variant, parameters);
 
   // whole candidate reason
-  FilterOnReadRejectionRate(candidate_variant, parameters.my_controls.read_rejection_threshold);
+  FilterOnReadRejectionRate(candidate_variant, *annotation, parameters.my_controls.read_rejection_threshold);
 }
 
 
@@ -804,7 +819,7 @@ void DecisionTreeData::DecisionTreeOutputToVariant(VariantCandidate &candidate_v
 
   GenotypeFromEvaluator(candidate_variant.variant, parameters);  // step 0
   // add a derived tag from the QUAL field and the depth counts
-  SetQualityByDepth(candidate_variant.variant);
+  SetQualityByDepth(candidate_variant.variant, candidate_variant.annotation);
 
   // no actual filters should be filled in yet, just all the information needed for filtering
   FillInFiltersAtEnd(candidate_variant, parameters);
@@ -43,6 +43,7 @@ class DecisionTreeData {
   public:
 
     vcf::Variant * variant;                         //!< VCF record of this variant position
+    VariantAnnotation * annotation;                 //!< Typed INFO/FORMAT values of this VCF record
     vector<AlleleIdentity> allele_identity_vector;  //!< Detailed information for each candidate allele
     vector<string>         info_fields;             //!< Additional information to be printed out in vcf FR tag
 
@@ -65,8 +66,9 @@ class DecisionTreeData {
     float tune_xbias; // not tuned, removed from filters
     float tune_sbias;
 
-    DecisionTreeData(vcf::Variant &candidate_variant) /*: multi_allele(candidate_variant)*/ {
+    DecisionTreeData(vcf::Variant &candidate_variant, VariantAnnotation &candidate_annotation) /*: multi_allele(candidate_variant)*/ {
       variant = &candidate_variant;
+      annotation = &candidate_annotation;
       best_allele_set = false;
       best_allele_index = 0;
       best_variant_filtered=false;
@@ -129,9 +131,10 @@ void FilterByBasicThresholds(stringstream &s, int i_alt, MultiBook &m_summary_st
                              VariantOutputInfo &l_summary_info,
                              const BasicFilters &basic_filter, float tune_xbias, float tune_bias);
 
-void AutoFailTheCandidate(vcf::Variant &candidate_variant, bool use_position_bias);
+void AutoFailTheCandidate(VariantCandidate &candidate, bool use_position_bias, const string &filter_reason = "NODATA");
 float FreqThresholdByType(AlleleIdentity &variant_identity, const ControlCallAndFilters &my_controls, const VariantSpecificParams& variant_specific_params);
+float QualThresholdByType(AlleleIdentity &variant_identity, const ControlCallAndFilters &my_controls, const VariantSpecificParams& variant_specific_params);
 void DetectSSEForNoCall(AlleleIdentity &var_identity, float sseProbThreshold, float minRatioReadsOnNonErrorStrand, float relative_safety_level, vcf::Variant &candidate_variant, unsigned _altAlleIndex);
-void SetQualityByDepth(vcf::Variant &candidate_variant);
+void SetQualityByDepth(vcf::Variant &candidate_variant, VariantAnnotation &annotation);
 
 #endif // DECISIONTREEDATA_H
@@ -184,20 +184,30 @@ int VariantAssist::MannWhitneyU(vector<float> &ref, vector<float> &var, bool deb
     fprintf(stdout, "\n");
    }
    
-   int U = ref.size()*var.size() + (ref.size()*(ref.size()+1))/2.0 - (int)VariantAssist::partial_sum(both, ref.size());
+   return VariantAssist::MannWhitneyUFromRankSum(VariantAssist::partial_sum(both, ref.size()), ref.size(), var.size());
+ }
+
+// U statistic given the sum of the (tied) ranks of the ref values within the pooled values
+int VariantAssist::MannWhitneyUFromRankSum(float ref_rank_sum, size_t n_ref, size_t n_var){
+   int U = n_ref*n_var + (n_ref*(n_ref+1))/2.0 - (int)ref_rank_sum;
    assert (U >= 0);
    return(U);
- }
+}
 
 // rho = estimate of P(ref) > var) + 0.5 P(var = ref)
 float VariantAssist::MannWhitneyURho(vector<float> &ref, vector<float> &var, bool debug) {
   float U1 =  MannWhitneyU(ref, var, debug);
-  float U2 = ref.size()*var.size()-U1; // large U2 means ranks(ref) > ranks(var)
-
-  float rho = U2/(ref.size()*var.size());
+  float rho = MannWhitneyURhoFromU(U1, ref.size(), var.size());
   if (debug) {
-    fprintf(stdout, "U1=%f, U2=%f, rho=%f\n", U1, U2, rho);
+    fprintf(stdout, "U1=%f, U2=%f, rho=%f\n", U1, ref.size()*var.size()-U1, rho);
   }
+  return (rho);
+}
+
+float VariantAssist::MannWhitneyURhoFromU(float U1, size_t n_ref, size_t n_var) {
+  float U2 = n_ref*n_var-U1; // large U2 means ranks(ref) > ranks(var)
+
+  float rho = U2/(n_ref*n_var);
   assert(rho >= 0);
   return (rho);
 }
@@ -236,6 +246,8 @@ void MultiBook::ComputePositionBias(int i_alt)
   //
   // Bootstrap is to generate a random permutation of the read indices and assign NR
   // to reference end positions, NV to end variant positions and calculate the metric
+  // The pooled positions are the same for every permutation, so they are ranked only once
+  // and each bootstrap sample just sums the ranks of the reads assigned to the reference
   //
   // Take i=0,..N-1 bootstrap samples of size count
   // assuming Null hypothesis is position on each type of read have the same
@@ -389,18 +401,33 @@ void MultiBook::ComputePositionBias(int i_alt)
   if (debug) {
     fprintf(stdout, "observed: %f\n", observed);
   }
+  // tied ranks of the pooled ref and var positions, looked up by read index
+  vector<float> pooled_rank(count);
+  for (unsigned int ii=0; ii<count; ii++)
+    pooled_rank[ii] = to_end[ix[ii]];
+  VariantAssist::tiedrank(pooled_rank);
+  vector<float> read_rank(to_end.size(), 0);
+  for (unsigned int ii=0; ii<count; ii++)
+    read_rank[ix[ii]] = pooled_rank[ii];
+
   long int N = 1000;
   double total = 0;
   for  (long int i=0; i<N; i++){    
     VariantAssist::randperm(ix, rand_generator);
-    for (unsigned int ii=0; ii<count_ref; ii++){
-      to_ref[ii] = to_end[ix[ii]];
-    }
-    for (unsigned int ii=count_ref; ii<count; ii++){
-      to_var[ii-count_ref] = to_end[ix[ii]];
-    }
+    // same summation order as MannWhitneyU on the permuted reference positions
+    float ref_rank_sum = 0;
+    for (unsigned int ii=0; ii<count_ref; ii++)
+      ref_rank_sum += read_rank[ix[ii]];
+    float bootstrap = VariantAssist::MannWhitneyURhoFromU(
+        VariantAssist::MannWhitneyUFromRankSum(ref_rank_sum, count_ref, count_var), count_ref, count_var);
 
     if (debug && i<10) {
+      for (unsigned int ii=0; ii<count_ref; ii++){
+        to_ref[ii] = to_end[ix[ii]];
+      }
+      for (unsigned int ii=count_ref; ii<count; ii++){
+        to_var[ii-count_ref] = to_end[ix[ii]];
+      }
       fprintf(stdout, "to_ref: ");
       for (int j=0; j< (int)to_ref.size(); j++){
 	fprintf(stdout, "%d ", (int)to_ref[j]);
@@ -411,9 +438,6 @@ void MultiBook::ComputePositionBias(int i_alt)
 	fprintf(stdout, "%d ", (int)to_var[j]);
       }
       fprintf(stdout, "\n");
-    }
-    float bootstrap =  VariantAssist::MannWhitneyURho(to_ref, to_var, (debug && i<10));
-    if (debug && i<10) {
       fprintf(stdout, "bootstrap: %f\n", bootstrap);
     }
 
@@ -538,15 +562,27 @@ float ComputeStrandBias(long int plus_var, long int plus_depth, long int neg_var
   return(strand_bias);
 }
 
-// Bootstrap from from both strands to see if observed variant counts on the
-// neg strand are significantly different
+// Log of the binomial probabilities P(X=k), k=0..depth, for X ~ Bin(depth, p) with 0 < p < 1
+static void BinomialLogProbabilities(long int depth, double p, vector<double> &log_prob){
+  log_prob.resize(depth+1);
+  double log_p = log(p);
+  double log_q = log(1.0-p);
+  double log_n_factorial = lgamma(depth+1.0);
+  for (long int k=0; k<=depth; k++)
+    log_prob[k] = log_n_factorial - lgamma(k+1.0) - lgamma(depth-k+1.0) + k*log_p + (depth-k)*log_q;
+}
+
+// Test whether observed variant counts on the two strands are significantly different
 //
-// Take i=0,..N-1 bootstrap samples of size plus_depth and neg_depth
-// assuming Null hypothesis is variant reads on each strand have equal
-// independent binomial probability p = (plus_var+neg_var)/(plus_depth+neg_depth)
+// Null hypothesis is variant reads on each strand have equal independent binomial
+// probability p = (plus_var+neg_var)/(plus_depth+neg_depth)
 //
-// return pval = proportion of times bootstrap strand bias >= observed strand bias
+// return pval = probability under the null that the strand bias is >= observed strand bias
 // rationale is that if this pval < threshold then there is real strand bias
+//
+// This used to be estimated from 1000 bootstrap samples, drawing depth random numbers each.
+// The transformed strand bias increases with plus_var for fixed neg_var, so for every neg strand
+// count the extreme plus strand counts form a lower and an upper tail that can be summed exactly.
 float BootstrapStrandBias(long int plus_var, long int plus_depth, long int neg_var, long int neg_depth, float tune_fish){
   if ((neg_depth == 0) || (plus_depth == 0))
     return 1.0;
@@ -556,32 +592,58 @@ float BootstrapStrandBias(long int plus_var, long int plus_depth, long int neg_v
   float observed = fabs(ComputeTransformStrandBias(plus_var, plus_depth, neg_var, neg_depth, tune_fish));
   double p = (plus_var+neg_var)/( (double)(plus_depth + neg_depth));
 
-  RandSchrange rand_generator;
-  rand_generator.SetSeed(1);
-
-  long int N = 1000;
-  double total = 0;
+  // every sample is at least as extreme as no bias at all
+  if (observed <= 0.0f)
+    return 1.0;
+  // degenerate null: the only possible sample is all reference or all variant
+  if (p <= 0.0 or p >= 1.0) {
+    long int fixed_plus = p <= 0.0 ? 0 : plus_depth;
+    long int fixed_neg  = p <= 0.0 ? 0 : neg_depth;
+    return (fabs(ComputeTransformStrandBias(fixed_plus, plus_depth, fixed_neg, neg_depth, tune_fish)) >= observed) ? 1.0f : 0.0f;
+  }
 
-  for  (long int i=0; i<N; i++){    
-    long int bootstrap_plus = 0;
-    long int bootstrap_neg = 0;
-    // bootstrap the sample
-    for (long int j=0; j < plus_depth; j++){
-      if ((double)(rand_generator.Rand())/rand_generator.RandMax < p)
-	bootstrap_plus++;
+  // tail sums of the plus strand distribution
+  vector<double> log_prob;
+  BinomialLogProbabilities(plus_depth, p, log_prob);
+  vector<double> lower_tail(plus_depth+2, 0.0);   // lower_tail[k] = P(X < k)
+  vector<double> upper_tail(plus_depth+2, 0.0);   // upper_tail[k] = P(X >= k)
+  for (long int k=0; k<=plus_depth; k++)
+    lower_tail[k+1] = lower_tail[k] + exp(log_prob[k]);
+  for (long int k=plus_depth; k>=0; k--)
+    upper_tail[k] = upper_tail[k+1] + exp(log_prob[k]);
+
+  BinomialLogProbabilities(neg_depth, p, log_prob);
+  double total = 0.0;
+  for (long int y=0; y<=neg_depth; y++){
+    double prob_y = exp(log_prob[y]);
+    if (prob_y < 1.0e-300)
+      continue;
+
+    // first plus strand count with bias >= observed
+    long int lo = 0, hi = plus_depth+1;
+    while (lo < hi) {
+      long int mid = (lo+hi)/2;
+      if (ComputeTransformStrandBias(mid, plus_depth, y, neg_depth, tune_fish) >= observed)
+        hi = mid;
+      else
+        lo = mid+1;
     }
-    for (long int j=0; j < neg_depth; j++){
-      if ((double)(rand_generator.Rand())/rand_generator.RandMax < p)
-	bootstrap_neg++;
+    double tail = upper_tail[lo];
+
+    // first plus strand count with bias > -observed
+    lo = 0; hi = plus_depth+1;
+    while (lo < hi) {
+      long int mid = (lo+hi)/2;
+      if (ComputeTransformStrandBias(mid, plus_depth, y, neg_depth, tune_fish) > -observed)
+        hi = mid;
+      else
+        lo = mid+1;
     }
-    // compute the bootstrap ratio given p
-    float bootstrap = fabs(ComputeTransformStrandBias(bootstrap_plus, plus_depth, bootstrap_neg, neg_depth, tune_fish));
-    // printf("obs=%f, bootstrap=%f, +=%ld, +depth=%ld, -=%ld, -depth=%ld\n", (observed+1.0f)/2.0f, (bootstrap+1.0f)/2.0f, bootstrap_plus, plus_depth, bootstrap_neg, neg_depth);
-    // greater or equal to what we saw?
-    if ( bootstrap >= observed)
-      total++;
+    tail += lower_tail[lo];
+
+    total += prob_y * tail;
   }
-  return (float) (total/N);
+  return (float) min(total, 1.0);
 }
 
 float ComputeTransformStrandBias(long int plus_var, long int plus_depth, long int neg_var, long int neg_depth, float tune_fish){
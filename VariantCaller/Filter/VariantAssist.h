@@ -121,6 +121,8 @@ namespace VariantAssist {
   void tiedrank(vector<float> &vals);
   float MannWhitneyURho(vector<float> &ref, vector<float> &var, bool debug);
   inline int MannWhitneyU(vector<float> &ref, vector<float> &var, bool debug);
+  int MannWhitneyUFromRankSum(float ref_rank_sum, size_t n_ref, size_t n_var);
+  float MannWhitneyURhoFromU(float U1, size_t n_ref, size_t n_var);
 
   struct mycomparison
   {
@@ -6,21 +6,26 @@
 
 #include "HandleVariant.h"
 #include "DecisionTreeData.h"
+#include "TraceWriter.h"
 
 
 
-void EnsembleEval::SpliceAllelesIntoReads(PersistingThreadObjects &thread_objects, const InputStructures &global_context,
-                                          const ExtendParameters &parameters, const ReferenceReader &ref_reader, int chr_idx)
+unsigned int EnsembleEval::SpliceAllelesIntoReads(PersistingThreadObjects &thread_objects, const InputStructures &global_context,
+                                          const ExtendParameters &parameters, const ReferenceReader &ref_reader, int chr_idx,
+                                          unsigned int first_read)
 {
   bool changed_alignment;
-  unsigned int  num_valid_reads = 0;
-  unsigned int  num_realigned = 0;
   int  num_hyp_no_null = allele_identity_vector.size()+1; // num alleles +1 for ref
 
+  if (first_read == 0) {
+    num_valid_reads = 0;
+    num_realigned_reads = 0;
+  }
+
   // generate null+ref+nr.alt hypotheses per read in the case of do_multiallele_eval
   allele_eval.total_theory.my_hypotheses.resize(read_stack.size());
 
-  for (unsigned int i_read = 0; i_read < allele_eval.total_theory.my_hypotheses.size(); i_read++) {
+  for (unsigned int i_read = first_read; i_read < allele_eval.total_theory.my_hypotheses.size(); i_read++) {
     // --- New splicing function ---
     allele_eval.total_theory.my_hypotheses[i_read].success =
         SpliceVariantHypotheses(*read_stack[i_read],
@@ -37,7 +42,7 @@ void EnsembleEval::SpliceAllelesIntoReads(PersistingThreadObjects &thread_object
     if (allele_eval.total_theory.my_hypotheses[i_read].success){
       num_valid_reads++;
       if (changed_alignment)
-        num_realigned++;
+        num_realigned_reads++;
     }
 
     // if we need to compare likelihoods across multiple possibilities
@@ -49,11 +54,12 @@ void EnsembleEval::SpliceAllelesIntoReads(PersistingThreadObjects &thread_object
   std::ostringstream my_info;
   my_info.precision(4);
   if (doRealignment and num_valid_reads>0){
-	float frac_realigned = (float)num_realigned / (float)num_valid_reads;
+	float frac_realigned = (float)num_realigned_reads / (float)num_valid_reads;
 	// And re-do splicing without realignment if we exceed the threshold
 	if (frac_realigned > parameters.my_controls.filter_variant.realignment_threshold){
       my_info << "SKIPREALIGNx" << frac_realigned;
       doRealignment = false;
+      first_read = 0;
       for (unsigned int i_read = 0; i_read < allele_eval.total_theory.my_hypotheses.size(); i_read++) {
           allele_eval.total_theory.my_hypotheses[i_read].success =
               SpliceVariantHypotheses(*read_stack[i_read],
@@ -71,21 +77,27 @@ void EnsembleEval::SpliceAllelesIntoReads(PersistingThreadObjects &thread_object
 	else {
       my_info << "REALIGNEDx" << frac_realigned;
 	}
-    info_fields.push_back(my_info.str());
+    // A growing read stack updates its earlier report
+    if (realignment_info_index < 0) {
+      realignment_info_index = info_fields.size();
+      info_fields.push_back(my_info.str());
+    }
+    else
+      info_fields[realignment_info_index] = my_info.str();
   }
-
+  return first_read;
 }
 
 
 
 
-void SummarizeInfoFieldsFromEnsemble(EnsembleEval &my_ensemble, vcf::Variant &candidate_variant, int _cur_allele_index) {
+void SummarizeInfoFieldsFromEnsemble(EnsembleEval &my_ensemble, VariantAnnotation &annotation, int _cur_allele_index) {
 
   float mean_ll_delta;
 
   my_ensemble.ScanSupportingEvidence(mean_ll_delta, _cur_allele_index);
 
-  candidate_variant.info["MLLD"].push_back(convertToString(mean_ll_delta));
+  annotation.Push(VariantAnnotation::MLLD, mean_ll_delta);
 
   float radius_bias, fwd_bias, rev_bias, ref_bias,var_bias;
   int fwd_strand = 0;
@@ -102,13 +114,13 @@ void SummarizeInfoFieldsFromEnsemble(EnsembleEval &my_ensemble, vcf::Variant &ca
   ref_bias = my_ensemble.allele_eval.cur_state.bias_checker.ref_bias_v[var_hyp];
   var_bias = my_ensemble.allele_eval.cur_state.bias_checker.variant_bias_v[var_hyp];
 
-  candidate_variant.info["RBI"].push_back(convertToString(radius_bias));
+  annotation.Push(VariantAnnotation::RBI, radius_bias);
   // this is by strand
-  candidate_variant.info["FWDB"].push_back(convertToString(fwd_bias));
-  candidate_variant.info["REVB"].push_back(convertToString(rev_bias));
+  annotation.Push(VariantAnnotation::FWDB, fwd_bias);
+  annotation.Push(VariantAnnotation::REVB, rev_bias);
   // this is by hypothesis
-  candidate_variant.info["REFB"].push_back(convertToString(ref_bias));
-  candidate_variant.info["VARB"].push_back(convertToString(var_bias));
+  annotation.Push(VariantAnnotation::REFB, ref_bias);
+  annotation.Push(VariantAnnotation::VARB, var_bias);
 
 }
 
@@ -118,7 +130,7 @@ void SummarizeInfoFieldsFromEnsemble(EnsembleEval &my_ensemble, vcf::Variant &ca
 void GlueOutputVariant(EnsembleEval &my_ensemble, VariantCandidate &candidate_variant, const ExtendParameters &parameters, int _best_allele_index)
 {
 
-  DecisionTreeData my_decision(*(my_ensemble.variant));
+  DecisionTreeData my_decision(*(my_ensemble.variant), candidate_variant.annotation);
   my_decision.tune_sbias = parameters.my_controls.sbias_tune;
 
   my_decision.SetupFromMultiAllele(my_ensemble);
@@ -149,7 +161,7 @@ void GlueOutputVariant(EnsembleEval &my_ensemble, VariantCandidate &candidate_va
             my_decision.summary_info_vector[_alt_allele_index].gt_quality_score,
             my_decision.summary_info_vector[_alt_allele_index].variant_qual_score);
 
-    SummarizeInfoFieldsFromEnsemble(my_ensemble, *(my_ensemble.variant), _alt_allele_index);
+    SummarizeInfoFieldsFromEnsemble(my_ensemble, candidate_variant.annotation, _alt_allele_index);
   }
 
   my_decision.best_allele_index = _best_allele_index;
@@ -181,6 +193,72 @@ void GlueOutputVariant(EnsembleEval &my_ensemble, VariantCandidate &candidate_va
 
 
 
+// Returns true if no alternate allele can pass the coverage and frequency filters,
+// judging by the allele counts (AO/SAF/SAR, SRF/SRR) left in INFO by the candidate generator.
+// Thresholds are relaxed by prescreen_margin since flow evaluation re-counts the reads.
+bool EnsembleEval::PrescreenAllAlleles(const ControlCallAndFilters &my_controls, const vector<VariantSpecificParams>& variant_specific_params)
+{
+  if (variant->isHotSpot)
+    return false;
+
+  map<string, vector<string> >::const_iterator srf = variant->info.find("SRF");
+  map<string, vector<string> >::const_iterator srr = variant->info.find("SRR");
+  map<string, vector<string> >::const_iterator saf = variant->info.find("SAF");
+  map<string, vector<string> >::const_iterator sar = variant->info.find("SAR");
+  if (srf == variant->info.end() or srr == variant->info.end() or saf == variant->info.end() or sar == variant->info.end())
+    return false;
+  if (srf->second.empty() or srr->second.empty())
+    return false;
+
+  unsigned int num_alt = allele_identity_vector.size();
+  if (saf->second.size() != num_alt or sar->second.size() != num_alt or variant_specific_params.size() != num_alt)
+    return false;
+
+  float margin = my_controls.prescreen_margin;
+  int ref_fwd = atoi(srf->second[0].c_str());
+  int ref_rev = atoi(srr->second[0].c_str());
+
+  for (unsigned int i_alt = 0; i_alt < num_alt; i_alt++) {
+    AlleleIdentity &identity = allele_identity_vector[i_alt];
+    const VariantSpecificParams &specific = variant_specific_params[i_alt];
+    if (identity.status.isHotSpot)
+      return false;
+
+    int alt_fwd = atoi(saf->second[i_alt].c_str());
+    int alt_rev = atoi(sar->second[i_alt].c_str());
+    int depth_fwd = ref_fwd + alt_fwd;
+    int depth_rev = ref_rev + alt_rev;
+    int depth = depth_fwd + depth_rev;
+
+    // same allele type dispatch as DecisionTreeData::FilterOneAllele
+    const BasicFilters *basic_filter = NULL;
+    if (identity.ActAsSNP())
+      basic_filter = &my_controls.filter_snps;
+    else if (identity.ActAsMNP())
+      basic_filter = &my_controls.filter_mnp;
+    else if (identity.ActAsHPIndel())
+      basic_filter = &my_controls.filter_hp_indel;
+
+    if (basic_filter) {
+      int min_cov = specific.min_coverage_override ? specific.min_coverage : basic_filter->min_cov;
+      if (depth < margin * min_cov)
+        continue;
+      int min_cov_each_strand = specific.min_coverage_each_strand_override ?
+          specific.min_coverage_each_strand : basic_filter->min_cov_each_strand;
+      if (depth_fwd < margin * min_cov_each_strand or depth_rev < margin * min_cov_each_strand)
+        continue;
+    }
+
+    float min_allele_freq = FreqThresholdByType(identity, my_controls, specific);
+    if (depth > 0 and alt_fwd + alt_rev < margin * min_allele_freq * depth)
+      continue;
+
+    return false;  // this allele has a chance, evaluate the candidate
+  }
+  return true;
+}
+
+
 // Read and process records appropriate for this variant; positions are zero based
 void EnsembleEval::StackUpOneVariant(const ExtendParameters &parameters, const PositionInProgress& bam_position)
 {
@@ -188,8 +266,13 @@ void EnsembleEval::StackUpOneVariant(const ExtendParameters &parameters, const P
   // Initialize random number generator for each stack -> ensure reproducibility
   RandSchrange RandGen(parameters.my_controls.RandSeed);
 
+  // Adaptive evaluation may use more reads for borderline calls
+  unsigned int max_coverage = parameters.my_controls.downSampleCoverage;
+  if (parameters.my_controls.adaptive_downsampling)
+    max_coverage = max(parameters.my_controls.adaptive_max_coverage, parameters.my_controls.downSampleCoverage);
+
   read_stack.clear();  // reset the stack
-  read_stack.reserve(parameters.my_controls.downSampleCoverage);
+  read_stack.reserve(max_coverage);
   int read_counter = 0;
 
   for (Alignment* rai = bam_position.begin; rai != bam_position.end; rai = rai->next) {
@@ -208,38 +291,122 @@ void EnsembleEval::StackUpOneVariant(const ExtendParameters &parameters, const P
       continue;
 
     // Reservoir Sampling
-    if (read_stack.size() < (unsigned int)parameters.my_controls.downSampleCoverage) {
+    if (read_stack.size() < max_coverage) {
       read_counter++;
       read_stack.push_back(rai);
     } else {
       read_counter++;
       // produces a uniformly distributed test_position between [0, read_counter-1]
       unsigned int test_position = ((double)RandGen.Rand() / ((double)RandGen.RandMax + 1.0)) * (double)read_counter;
-      if (test_position < (unsigned int)parameters.my_controls.downSampleCoverage)
+      if (test_position < max_coverage)
         read_stack[test_position] = rai;
     }
   }
+
+  // Adaptive evaluation consumes the stack in batches from the front: shuffle so every prefix is a uniform sample
+  if (parameters.my_controls.adaptive_downsampling) {
+    for (unsigned int i_read = read_stack.size(); i_read > 1; i_read--) {
+      unsigned int swap_position = ((double)RandGen.Rand() / ((double)RandGen.RandMax + 1.0)) * (double)i_read;
+      swap(read_stack[i_read-1], read_stack[swap_position]);
+    }
+  }
 }
 
 
 
 
-void EnsembleProcessOneVariant(PersistingThreadObjects &thread_objects, VariantCallerContext& vc,
+// Evaluate the read stack in batches, stopping as soon as QUAL and GQ of the call settle.
+// Settled calls stop at downsample-to-coverage reads at the latest; borderline calls, whose QUAL
+// is close to the min. variant score of one of the alleles, continue up to adaptive-max-coverage.
+void AdaptiveStackInference(PersistingThreadObjects &thread_objects, VariantCallerContext& vc, EnsembleEval &my_ensemble,
+    VariantCandidate &candidate_variant, int chr_idx)
+{
+  const ControlCallAndFilters &my_controls = vc.parameters->my_controls;
+  int num_hyp_no_null = my_ensemble.allele_identity_vector.size()+1; // num alleles +1 for ref
+
+  // The call is judged against the least restrictive thresholds amongst the alleles, as in GlueOutputVariant
+  float local_min_allele_freq = 1.0f;
+  float min_quality_score = -1.0f;
+  for (unsigned int i_alt = 0; i_alt < my_ensemble.allele_identity_vector.size(); i_alt++) {
+    local_min_allele_freq = min(local_min_allele_freq, FreqThresholdByType(my_ensemble.allele_identity_vector[i_alt],
+        my_controls, candidate_variant.variant_specific_params[i_alt]));
+    float allele_min_quality = QualThresholdByType(my_ensemble.allele_identity_vector[i_alt], my_controls,
+        candidate_variant.variant_specific_params[i_alt]);
+    if (min_quality_score < 0.0f or allele_min_quality < min_quality_score)
+      min_quality_score = allele_min_quality;
+  }
+
+  vector<const Alignment *> sampled_reads;
+  sampled_reads.swap(my_ensemble.read_stack);
+  my_ensemble.read_stack.reserve(sampled_reads.size());
+  my_ensemble.allele_eval.total_theory.my_hypotheses.reserve(sampled_reads.size());
+
+  float last_quality = 0.0f, last_gq = 0.0f;
+  bool  have_last = false;
+  vector<int> genotype_component(2);
+
+  while (true) {
+    unsigned int first_read = my_ensemble.read_stack.size();
+    unsigned int num_reads = min((unsigned int)sampled_reads.size(), first_read + my_controls.adaptive_batch_size);
+    my_ensemble.read_stack.insert(my_ensemble.read_stack.end(), sampled_reads.begin()+first_read, sampled_reads.begin()+num_reads);
+
+    // glue in variants; splicing may restart from the first read if realignment gets switched off
+    first_read = my_ensemble.SpliceAllelesIntoReads(thread_objects, *vc.global_context, *vc.parameters, *vc.ref_reader, chr_idx, first_read);
+
+    // inference starts from scratch on the grown stack, only predictions of earlier reads are kept
+    my_ensemble.allele_eval.cur_state = LatentSlate();
+    my_ensemble.allele_eval.my_params = vc.parameters->my_eval_control;
+    my_ensemble.allele_eval.InitForInference(thread_objects, my_ensemble.read_stack, *vc.global_context, num_hyp_no_null, first_read);
+    my_ensemble.allele_eval.ExecuteInference(vc.parameters->my_eval_control.max_detail_level);
+
+    if (num_reads == sampled_reads.size())
+      break;
+
+    float quality, gq;
+    my_ensemble.MultiAlleleGenotype(local_min_allele_freq, genotype_component, gq, quality, vc.parameters->my_eval_control.max_detail_level);
+
+    bool settled = have_last and fabs(quality - last_quality) <= my_controls.adaptive_tolerance
+                   and fabs(gq - last_gq) <= my_controls.adaptive_tolerance;
+    bool borderline = fabs(quality - min_quality_score) < my_controls.adaptive_borderline_margin;
+    if (not borderline and (settled or num_reads >= (unsigned int)my_controls.downSampleCoverage))
+      break;
+
+    last_quality = quality;
+    last_gq = gq;
+    have_last = true;
+  }
+}
+
+
+bool EnsembleProcessOneVariant(PersistingThreadObjects &thread_objects, VariantCallerContext& vc,
     VariantCandidate &candidate_variant, const PositionInProgress& bam_position)
 {
   int chr_idx = vc.ref_reader->chr_idx(candidate_variant.variant.sequenceName.c_str());
+  TraceBegin(thread_objects.trace, "evaluate", chr_idx, candidate_variant.variant.position - 1);
 
   EnsembleEval my_ensemble(candidate_variant.variant);
   my_ensemble.SetupAllAlleles(*vc.parameters, *vc.global_context, *vc.ref_reader, chr_idx);
   my_ensemble.FilterAllAlleles(vc.parameters->my_controls.filter_variant, candidate_variant.variant_specific_params); // put filtering here in case we want to skip below entries
 
+  if (vc.parameters->my_controls.prescreen_candidates and
+      my_ensemble.PrescreenAllAlleles(vc.parameters->my_controls, candidate_variant.variant_specific_params)) {
+    AutoFailTheCandidate(candidate_variant, vc.parameters->my_controls.use_position_bias, "PRESCREEN");
+    TraceFinish(thread_objects.trace, "evaluate", "prescreened", 1);
+    return false;
+  }
+
+  // Forget per-read work for reads this thread will not see again
+  if (bam_position.begin)
+    thread_objects.read_prefix_cache.Evict(bam_position.chr, bam_position.pos, bam_position.begin->read_number);
+
   // We read in one stack per multi-allele variant
   my_ensemble.StackUpOneVariant(*vc.parameters, bam_position);
 
   if (my_ensemble.read_stack.empty()) {
     cerr << "Nonfatal: No reads found for " << candidate_variant.variant.sequenceName << "\t" << my_ensemble.multiallele_window_start << endl;
-    AutoFailTheCandidate(candidate_variant.variant, vc.parameters->my_controls.use_position_bias);
-    return;
+    AutoFailTheCandidate(candidate_variant, vc.parameters->my_controls.use_position_bias);
+    TraceFinish(thread_objects.trace, "evaluate", "reads", 0);
+    return true;
   }
 
 
@@ -247,17 +414,22 @@ void EnsembleProcessOneVariant(PersistingThreadObjects &thread_objects, VariantC
   // try only ref vs alt allele here
   // leave ensemble in ref vs alt state
 
-  // glue in variants
-  my_ensemble.SpliceAllelesIntoReads(thread_objects, *vc.global_context, *vc.parameters, *vc.ref_reader, chr_idx);
+  if (vc.parameters->my_controls.adaptive_downsampling) {
+    AdaptiveStackInference(thread_objects, vc, my_ensemble, candidate_variant, chr_idx);
+  }
+  else {
+    // glue in variants
+    my_ensemble.SpliceAllelesIntoReads(thread_objects, *vc.global_context, *vc.parameters, *vc.ref_reader, chr_idx);
 
-  my_ensemble.allele_eval.my_params = vc.parameters->my_eval_control;
+    my_ensemble.allele_eval.my_params = vc.parameters->my_eval_control;
 
-  // fill in quantities derived from predictions
-  int num_hyp_no_null = my_ensemble.allele_identity_vector.size()+1; // num alleles +1 for ref
-  my_ensemble.allele_eval.InitForInference(thread_objects, my_ensemble.read_stack, *vc.global_context, num_hyp_no_null);
+    // fill in quantities derived from predictions
+    int num_hyp_no_null = my_ensemble.allele_identity_vector.size()+1; // num alleles +1 for ref
+    my_ensemble.allele_eval.InitForInference(thread_objects, my_ensemble.read_stack, *vc.global_context, num_hyp_no_null);
 
-  // do inference
-  my_ensemble.allele_eval.ExecuteInference(vc.parameters->my_eval_control.max_detail_level);
+    // do inference
+    my_ensemble.allele_eval.ExecuteInference(vc.parameters->my_eval_control.max_detail_level);
+  }
 
   // now we're in the guaranteed state of best index
   int best_allele = my_ensemble.DetectBestMultiAllelePair();
@@ -267,11 +439,12 @@ void EnsembleProcessOneVariant(PersistingThreadObjects &thread_objects, VariantC
 
   // test diagnostic output for this ensemble
   if (vc.parameters->program_flow.rich_json_diagnostic & (!(my_ensemble.variant->isFiltered) | my_ensemble.variant->isHotSpot)) // look at everything that came through
-    JustOneDiagnosis(my_ensemble, *vc.global_context, vc.parameters->program_flow.json_plot_dir, true);
+    JustOneDiagnosis(my_ensemble, *vc.global_context, *vc.diagnostic_writer, true);
   if (vc.parameters->program_flow.minimal_diagnostic & (!(my_ensemble.variant->isFiltered) | my_ensemble.variant->isHotSpot)) // look at everything that came through
-    JustOneDiagnosis(my_ensemble, *vc.global_context, vc.parameters->program_flow.json_plot_dir, false);
-
+    JustOneDiagnosis(my_ensemble, *vc.global_context, *vc.diagnostic_writer, false);
 
+  TraceFinish(thread_objects.trace, "evaluate", "reads", my_ensemble.read_stack.size());
+  return true;
 }
 
 
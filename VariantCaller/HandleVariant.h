@@ -55,7 +55,9 @@ using namespace ion;
 // ----------------------------------------------------------------------
 
 
-void EnsembleProcessOneVariant(PersistingThreadObjects &thread_objects, VariantCallerContext& vc,
+//! @brief  Evaluate one candidate and fill in its VCF record
+//! @return false if the candidate was failed by the pre-screen without evaluation
+bool EnsembleProcessOneVariant(PersistingThreadObjects &thread_objects, VariantCallerContext& vc,
     VariantCandidate &current_variant, const PositionInProgress& bam_position);
 
 
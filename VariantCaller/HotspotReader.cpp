@@ -2,12 +2,22 @@
 
 //! @file     HotspotReader.cpp
 //! @ingroup  VariantCaller
-//! @brief    Customized hotspot VCF parser
+//! @brief    Customized hotspot VCF parser, with a binary precompiled form and background prefetch
 
 #include "HotspotReader.h"
 
 #include <stdlib.h>
 #include <errno.h>
+#include <stdint.h>
+
+static const int kMaxPrefetchedLoci = 4096;
+
+// Override flags of the binary allele record, in the order the values are stored
+enum {
+  kMinAlleleFreq = 0, kStrandBias, kMinCoverage, kMinCoverageEachStrand, kMinVariantScore, kDataQualityStringency,
+  kHpMaxLength, kFilterUnusualPredictions, kFilterInsertionPredictions, kFilterDeletionPredictions, kSseProbThreshold,
+  kNumBinaryParams
+};
 
 
 HotspotReader::HotspotReader()
@@ -17,12 +27,34 @@ HotspotReader::HotspotReader()
   line_number_ = 0;
   next_chr_ = 0;
   next_pos_ = 0;
+  binary_input_ = NULL;
+  binary_contig_ = 0;
+  binary_remaining_ = 0;
+  binary_size_ = 0;
+  prefetch_running_ = false;
+  prefetch_done_ = false;
+  prefetch_stop_ = false;
+  pthread_mutex_init(&queue_mutex_, NULL);
+  pthread_cond_init(&queue_not_empty_, NULL);
+  pthread_cond_init(&queue_not_full_, NULL);
 }
 
 
 
 HotspotReader::~HotspotReader()
 {
+  if (prefetch_running_) {
+    pthread_mutex_lock(&queue_mutex_);
+    prefetch_stop_ = true;
+    pthread_mutex_unlock(&queue_mutex_);
+    pthread_cond_signal(&queue_not_full_);
+    pthread_join(prefetch_thread_, NULL);
+  }
+  if (binary_input_)
+    fclose(binary_input_);
+  pthread_mutex_destroy(&queue_mutex_);
+  pthread_cond_destroy(&queue_not_empty_);
+  pthread_cond_destroy(&queue_not_full_);
 }
 
 void HotspotReader::Initialize(const ReferenceReader &ref_reader, const string& hotspot_vcf_filename)
@@ -32,19 +64,66 @@ void HotspotReader::Initialize(const ReferenceReader &ref_reader, const string&
   ref_reader_ = &ref_reader;
   line_number_ = 0;
 
-  hotspot_vcf_.parseSamples = false;
-  string tmp = hotspot_vcf_filename;
-  hotspot_vcf_.open(tmp);
-  if (not hotspot_vcf_.is_open()) {
-    cerr << "ERROR: Could not open hotspot file : " << hotspot_vcf_filename << " : " << strerror(errno) << endl;
+  char magic[8] = {0};
+  FILE *probe = fopen(hotspot_vcf_filename.c_str(), "rb");
+  if (probe) {
+    if (fread(magic, 1, 8, probe) != 8)
+      magic[0] = 0;
+    fclose(probe);
+  }
+
+  if (memcmp(magic, BINARY_HOTSPOT_MAGIC, 8) == 0) {
+    OpenBinary(hotspot_vcf_filename);
+  } else {
+    hotspot_vcf_.parseSamples = false;
+    string tmp = hotspot_vcf_filename;
+    hotspot_vcf_.open(tmp);
+    if (not hotspot_vcf_.is_open()) {
+      cerr << "ERROR: Could not open hotspot file : " << hotspot_vcf_filename << " : " << strerror(errno) << endl;
+      exit(1);
+    }
+  }
+
+  if (pthread_create(&prefetch_thread_, NULL, HotspotReader::PrefetchThread, this)) {
+    cerr << "ERROR: Cannot start hotspot prefetch thread" << endl;
     exit(1);
   }
+  prefetch_running_ = true;
 
   has_more_variants_ = true;
   FetchNextVariant();
 }
 
 
+// Reads and parses hotspots ahead of the walker, so FetchNextVariant only takes a locus off the queue
+void * HotspotReader::PrefetchThread(void *input)
+{
+  HotspotReader *reader = static_cast<HotspotReader*>(input);
+  HotspotLocus locus;
+
+  while (true) {
+    locus.alleles.clear();
+    bool success = reader->binary_input_ ? reader->ReadBinaryLocus(locus) : reader->ReadVcfLocus(locus);
+
+    pthread_mutex_lock(&reader->queue_mutex_);
+    while (success and not reader->prefetch_stop_ and reader->queue_.size() >= (unsigned int)kMaxPrefetchedLoci)
+      pthread_cond_wait(&reader->queue_not_full_, &reader->queue_mutex_);
+    if (not success or reader->prefetch_stop_) {
+      reader->prefetch_done_ = true;
+      pthread_mutex_unlock(&reader->queue_mutex_);
+      pthread_cond_signal(&reader->queue_not_empty_);
+      return NULL;
+    }
+    reader->queue_.push_back(HotspotLocus());
+    reader->queue_.back().chr = locus.chr;
+    reader->queue_.back().pos = locus.pos;
+    reader->queue_.back().alleles.swap(locus.alleles);
+    pthread_mutex_unlock(&reader->queue_mutex_);
+    pthread_cond_signal(&reader->queue_not_empty_);
+  }
+}
+
+
 void HotspotReader::FetchNextVariant()
 {
   if (not has_more_variants_)
@@ -52,23 +131,38 @@ void HotspotReader::FetchNextVariant()
 
   next_.clear();
 
-  vcf::Variant current_hotspot(hotspot_vcf_);
+  pthread_mutex_lock(&queue_mutex_);
+  while (queue_.empty() and not prefetch_done_)
+    pthread_cond_wait(&queue_not_empty_, &queue_mutex_);
+  if (queue_.empty()) {
+    has_more_variants_ = false;
+  } else {
+    next_chr_ = queue_.front().chr;
+    next_pos_ = queue_.front().pos;
+    next_.swap(queue_.front().alleles);
+    queue_.pop_front();
+  }
+  pthread_mutex_unlock(&queue_mutex_);
+  pthread_cond_signal(&queue_not_full_);
+}
 
-  while (has_more_variants_) {
 
-    has_more_variants_ = hotspot_vcf_.getNextVariant(current_hotspot);
-    if (not has_more_variants_)
-      return;
+// Next VCF record with at least one usable allele; false at end of file
+bool HotspotReader::ReadVcfLocus(HotspotLocus& locus)
+{
+  vcf::Variant current_hotspot(hotspot_vcf_);
 
-    next_chr_ = ref_reader_->chr_idx(current_hotspot.sequenceName.c_str());
-    next_pos_ = current_hotspot.position - 1;
+  while (locus.alleles.empty()) {
+    if (not hotspot_vcf_.getNextVariant(current_hotspot))
+      return false;
+    locus.chr = ref_reader_->chr_idx(current_hotspot.sequenceName.c_str());
+    locus.pos = current_hotspot.position - 1;
 
-    if (next_chr_ < 0) {
+    if (locus.chr < 0) {
       cerr << "ERROR: invalid chromosome name in hotspot file " << current_hotspot.sequenceName << endl;
       exit(1);
     }
 
-
     vector<string>& min_allele_freq = current_hotspot.info["min_allele_freq"];
     vector<string>& strand_bias = current_hotspot.info["strand_bias"];
     vector<string>& min_coverage = current_hotspot.info["min_coverage"];
@@ -85,16 +179,16 @@ void HotspotReader::FetchNextVariant()
     // collect bad-strand info
     vector<string>& black_list_strand = current_hotspot.info["BSTRAND"];
 
-    next_.reserve(current_hotspot.alt.size());
+    locus.alleles.reserve(current_hotspot.alt.size());
     for (unsigned int alt_idx = 0; alt_idx < current_hotspot.alt.size(); ++alt_idx) {
       if (current_hotspot.ref == current_hotspot.alt[alt_idx])
         continue;
       
-      next_.push_back(HotspotAllele());
-      HotspotAllele& hotspot = next_.back();
+      locus.alleles.push_back(HotspotAllele());
+      HotspotAllele& hotspot = locus.alleles.back();
 
-      hotspot.chr = next_chr_;
-      hotspot.pos = next_pos_;
+      hotspot.chr = locus.chr;
+      hotspot.pos = locus.pos;
       hotspot.ref_length = current_hotspot.ref.length();
       hotspot.alt = current_hotspot.alt[alt_idx];
 
@@ -178,14 +272,234 @@ void HotspotReader::FetchNextVariant()
       hotspot.params.black_strand = alt_idx < black_list_strand.size() ? black_list_strand[alt_idx][0] : '.';
 
     }
+  }
+  return true;
+}
 
-    if (next_.empty())
-      continue;
 
-    break;
+// -------------------------------------------------------------------
+// Binary hotspot file
+
+static void ReadOrDie(void *data, size_t size, FILE *input)
+{
+  if (fread(data, 1, size, input) != size) {
+    cerr << "ERROR: Binary hotspot file is truncated" << endl;
+    exit(1);
+  }
+}
+
+// Lengths and counts are checked against the file size before anything is allocated for them
+static void CheckLength(long value, long limit)
+{
+  if (value < 0 or value > limit) {
+    cerr << "ERROR: Binary hotspot file is corrupt" << endl;
+    exit(1);
+  }
+}
+
+template <typename T>
+static void AppendBinary(string& output, T value) { output.append((const char *)&value, sizeof(T)); }
+
+
+void HotspotReader::OpenBinary(const string& filename)
+{
+  binary_input_ = fopen(filename.c_str(), "rb");
+  if (not binary_input_) {
+    cerr << "ERROR: Could not open hotspot file : " << filename << " : " << strerror(errno) << endl;
+    exit(1);
+  }
+  fseek(binary_input_, 0, SEEK_END);
+  binary_size_ = ftell(binary_input_);
+  rewind(binary_input_);
+
+  char magic[8];
+  int32_t contig_count, reserved;
+  ReadOrDie(magic, 8, binary_input_);
+  ReadOrDie(&contig_count, 4, binary_input_);
+  ReadOrDie(&reserved, 4, binary_input_);
+  CheckLength(contig_count, binary_size_);
+
+  for (int idx = 0; idx < contig_count; ++idx) {
+    int32_t name_length;
+    int64_t offset, count;
+    ReadOrDie(&name_length, 4, binary_input_);
+    CheckLength(name_length, binary_size_);
+    string name(name_length, ' ');
+    if (name_length > 0)
+      ReadOrDie(&name[0], name_length, binary_input_);
+    ReadOrDie(&offset, 8, binary_input_);
+    ReadOrDie(&count, 8, binary_input_);
+    CheckLength(offset, binary_size_);
+    CheckLength(count, binary_size_);
+    int chr = ref_reader_->chr_idx(name.c_str());
+    if (chr < 0) {
+      cerr << "ERROR: invalid chromosome name in hotspot file " << name << endl;
+      exit(1);
+    }
+    if (not binary_chr_.empty() and chr <= binary_chr_.back()) {
+      cerr << "ERROR: Contigs of binary hotspot file " << filename << " are not in reference order" << endl;
+      exit(1);
+    }
+    binary_chr_.push_back(chr);
+    binary_count_.push_back(count);
+    binary_offset_.push_back(offset);
+  }
+  binary_contig_ = 0;
+  binary_remaining_ = 0;
+  if (not binary_chr_.empty())
+    SeekBinaryContig(0);
+}
+
+
+void HotspotReader::SeekBinaryContig(int contig)
+{
+  binary_contig_ = contig;
+  binary_remaining_ = binary_count_[contig];
+  if (fseek(binary_input_, binary_offset_[contig], SEEK_SET) != 0) {
+    cerr << "ERROR: Binary hotspot file is truncated" << endl;
+    exit(1);
+  }
+}
+
+
+bool HotspotReader::ReadBinaryLocus(HotspotLocus& locus)
+{
+  while (binary_remaining_ == 0) {
+    if (binary_contig_ + 1 >= (int)binary_chr_.size())
+      return false;
+    SeekBinaryContig(binary_contig_ + 1);
+  }
+  --binary_remaining_;
+
+  int32_t pos, num_alleles;
+  ReadOrDie(&pos, 4, binary_input_);
+  ReadOrDie(&num_alleles, 4, binary_input_);
+  CheckLength(num_alleles, binary_size_);
+  locus.chr = binary_chr_[binary_contig_];
+  locus.pos = pos;
+  locus.alleles.resize(num_alleles);
+
+  for (int idx = 0; idx < num_alleles; ++idx) {
+    HotspotAllele& hotspot = locus.alleles[idx];
+    int32_t fields[4];
+    uint16_t overrides;
+    union { float f; int32_t i; } values[kNumBinaryParams];
+    ReadOrDie(fields, sizeof(fields), binary_input_);
+    hotspot.chr = locus.chr;
+    hotspot.pos = locus.pos;
+    hotspot.ref_length = fields[0];
+    hotspot.type = (AlleleType)fields[1];
+    hotspot.length = fields[2];
+    CheckLength(fields[3], binary_size_);
+    hotspot.alt.resize(fields[3]);
+    if (fields[3] > 0)
+      ReadOrDie(&hotspot.alt[0], fields[3], binary_input_);
+    ReadOrDie(&overrides, 2, binary_input_);
+    ReadOrDie(values, sizeof(values), binary_input_);
+    ReadOrDie(&hotspot.params.black_strand, 1, binary_input_);
+
+    VariantSpecificParams& params = hotspot.params;
+    params.min_allele_freq_override               = overrides & (1 << kMinAlleleFreq);
+    params.min_allele_freq                        = values[kMinAlleleFreq].f;
+    params.strand_bias_override                   = overrides & (1 << kStrandBias);
+    params.strand_bias                            = values[kStrandBias].f;
+    params.min_coverage_override                  = overrides & (1 << kMinCoverage);
+    params.min_coverage                           = values[kMinCoverage].i;
+    params.min_coverage_each_strand_override      = overrides & (1 << kMinCoverageEachStrand);
+    params.min_coverage_each_strand               = values[kMinCoverageEachStrand].i;
+    params.min_variant_score_override             = overrides & (1 << kMinVariantScore);
+    params.min_variant_score                      = values[kMinVariantScore].f;
+    params.data_quality_stringency_override       = overrides & (1 << kDataQualityStringency);
+    params.data_quality_stringency                = values[kDataQualityStringency].f;
+    params.hp_max_length_override                 = overrides & (1 << kHpMaxLength);
+    params.hp_max_length                          = values[kHpMaxLength].i;
+    params.filter_unusual_predictions_override    = overrides & (1 << kFilterUnusualPredictions);
+    params.filter_unusual_predictions             = values[kFilterUnusualPredictions].f;
+    params.filter_insertion_predictions_override  = overrides & (1 << kFilterInsertionPredictions);
+    params.filter_insertion_predictions           = values[kFilterInsertionPredictions].f;
+    params.filter_deletion_predictions_override   = overrides & (1 << kFilterDeletionPredictions);
+    params.filter_deletion_predictions            = values[kFilterDeletionPredictions].f;
+    params.sse_prob_threshold_override            = overrides & (1 << kSseProbThreshold);
+    params.sse_prob_threshold                     = values[kSseProbThreshold].f;
+  }
+  return true;
+}
+
+
+bool HotspotReader::WriteBinary(const string& filename, const ReferenceReader &ref_reader, const vector<HotspotLocus>& loci)
+{
+  // Contig table: one entry per run of loci on the same contig
+  vector<int> contigs;
+  vector<long> counts;
+  for (vector<HotspotLocus>::const_iterator locus = loci.begin(); locus != loci.end(); ++locus) {
+    if (contigs.empty() or contigs.back() != locus->chr) {
+      contigs.push_back(locus->chr);
+      counts.push_back(0);
+    }
+    counts.back()++;
+  }
+
+  string records;
+  vector<int64_t> offsets;
+  for (vector<HotspotLocus>::const_iterator locus = loci.begin(); locus != loci.end(); ++locus) {
+    if (locus == loci.begin() or locus->chr != (locus-1)->chr)
+      offsets.push_back(records.size());
+    AppendBinary<int32_t>(records, locus->pos);
+    AppendBinary<int32_t>(records, locus->alleles.size());
+    for (vector<HotspotAllele>::const_iterator hotspot = locus->alleles.begin(); hotspot != locus->alleles.end(); ++hotspot) {
+      const VariantSpecificParams& params = hotspot->params;
+      AppendBinary<int32_t>(records, hotspot->ref_length);
+      AppendBinary<int32_t>(records, hotspot->type);
+      AppendBinary<int32_t>(records, hotspot->length);
+      AppendBinary<int32_t>(records, hotspot->alt.size());
+      records += hotspot->alt;
+      uint16_t overrides = 0;
+      if (params.min_allele_freq_override)              overrides |= 1 << kMinAlleleFreq;
+      if (params.strand_bias_override)                  overrides |= 1 << kStrandBias;
+      if (params.min_coverage_override)                 overrides |= 1 << kMinCoverage;
+      if (params.min_coverage_each_strand_override)     overrides |= 1 << kMinCoverageEachStrand;
+      if (params.min_variant_score_override)            overrides |= 1 << kMinVariantScore;
+      if (params.data_quality_stringency_override)      overrides |= 1 << kDataQualityStringency;
+      if (params.hp_max_length_override)                overrides |= 1 << kHpMaxLength;
+      if (params.filter_unusual_predictions_override)   overrides |= 1 << kFilterUnusualPredictions;
+      if (params.filter_insertion_predictions_override) overrides |= 1 << kFilterInsertionPredictions;
+      if (params.filter_deletion_predictions_override)  overrides |= 1 << kFilterDeletionPredictions;
+      if (params.sse_prob_threshold_override)           overrides |= 1 << kSseProbThreshold;
+      AppendBinary<uint16_t>(records, overrides);
+      AppendBinary<float>(records, params.min_allele_freq);
+      AppendBinary<float>(records, params.strand_bias);
+      AppendBinary<int32_t>(records, params.min_coverage);
+      AppendBinary<int32_t>(records, params.min_coverage_each_strand);
+      AppendBinary<float>(records, params.min_variant_score);
+      AppendBinary<float>(records, params.data_quality_stringency);
+      AppendBinary<int32_t>(records, params.hp_max_length);
+      AppendBinary<float>(records, params.filter_unusual_predictions);
+      AppendBinary<float>(records, params.filter_insertion_predictions);
+      AppendBinary<float>(records, params.filter_deletion_predictions);
+      AppendBinary<float>(records, params.sse_prob_threshold);
+      records.push_back(params.black_strand);
+    }
+  }
 
+  string header(BINARY_HOTSPOT_MAGIC, 8);
+  AppendBinary<int32_t>(header, contigs.size());
+  AppendBinary<int32_t>(header, 0);
+  int64_t table_size = 0;
+  for (unsigned int idx = 0; idx < contigs.size(); ++idx)
+    table_size += 20 + ref_reader.chr_str(contigs[idx]).size();
+  for (unsigned int idx = 0; idx < contigs.size(); ++idx) {
+    AppendBinary<int32_t>(header, ref_reader.chr_str(contigs[idx]).size());
+    header += ref_reader.chr_str(contigs[idx]);
+    AppendBinary<int64_t>(header, 16 + table_size + offsets[idx]);
+    AppendBinary<int64_t>(header, counts[idx]);
   }
 
+  FILE *output = fopen(filename.c_str(), "wb");
+  if (not output)
+    return false;
+  bool success = fwrite(header.data(), 1, header.size(), output) == header.size()
+      and fwrite(records.data(), 1, records.size(), output) == records.size();
+  return fclose(output) == 0 and success;
 }
 
 
@@ -2,7 +2,7 @@
 
 //! @file     HotspotReader.h
 //! @ingroup  VariantCaller
-//! @brief    Customized hotspot VCF parser
+//! @brief    Customized hotspot VCF parser, with a binary precompiled form and background prefetch
 
 
 #ifndef HOTSPOTREADER_H
@@ -11,6 +11,9 @@
 #include <string>
 #include <vector>
 #include <fstream>
+#include <deque>
+#include <stdio.h>
+#include <pthread.h>
 #include <Variant.h>
 #include "ReferenceReader.h"
 #include "InputStructures.h"
@@ -30,12 +33,29 @@ struct HotspotAllele {
   VariantSpecificParams params;
 };
 
+//! All alleles of one hotspot VCF record
+struct HotspotLocus {
+  int chr;
+  int pos;
+  vector<HotspotAllele> alleles;
+};
+
+
+//! Binary hotspot file written by "tvcutils compile_hotspots":
+//!   magic[8], int32 contig count, int32 reserved,
+//!   per contig in reference order: int32 name length, name, int64 record offset, int64 record count,
+//!   where the offset is from the start of the file and is where the reader seeks to for that contig,
+//!   then the records of each contig sorted by position: int32 pos, int32 allele count, and per allele
+//!   int32 ref_length, type, length, alt length, alt, uint16 override mask, 11 four-byte values, black_strand.
+#define BINARY_HOTSPOT_MAGIC    "TVCHSP1"
+
 
 class HotspotReader {
 public:
   HotspotReader();
   ~HotspotReader();
 
+  //! @brief  Open a hotspot VCF, or a binary hotspot file, and start the prefetch thread
   void Initialize(const ReferenceReader &ref_reader, const string& hotspot_vcf_filename);
 
   bool HasMoreVariants() const { return has_more_variants_; }
@@ -45,7 +65,16 @@ public:
   int next_chr() const { return next_chr_; }
   int next_pos() const { return next_pos_; }
 
+  //! @brief  Write loci, sorted by chr and pos, as a binary hotspot file
+  static bool WriteBinary(const string& filename, const ReferenceReader &ref_reader, const vector<HotspotLocus>& loci);
+
 private:
+  static void * PrefetchThread(void *input);
+  bool ReadVcfLocus(HotspotLocus& locus);
+  bool ReadBinaryLocus(HotspotLocus& locus);
+  void OpenBinary(const string& filename);
+  void SeekBinaryContig(int contig);
+
   const ReferenceReader * ref_reader_;
   vector<HotspotAllele>   next_;
   int                     next_chr_;
@@ -58,6 +87,24 @@ private:
 
   int                     line_number_;
 
+  // Binary input
+  FILE *                  binary_input_;        //! Open binary hotspot file, NULL when reading VCF
+  vector<int>             binary_chr_;          //! Reference index of each contig in the binary file
+  vector<long>            binary_count_;        //! Records of each contig in the binary file
+  vector<long>            binary_offset_;       //! File offset of the records of each contig
+  long                    binary_size_;         //! Size of the binary file, bounds lengths read from it
+  int                     binary_contig_;       //! Contig being read
+  long                    binary_remaining_;    //! Records left in that contig
+
+  // Prefetch
+  deque<HotspotLocus>     queue_;               //! Loci read ahead of the walker
+  bool                    prefetch_running_;    //! Prefetch thread was started
+  bool                    prefetch_done_;       //! Prefetch thread read the last locus
+  bool                    prefetch_stop_;       //! Prefetch thread should quit early
+  pthread_t               prefetch_thread_;
+  pthread_mutex_t         queue_mutex_;         //! Mutex protecting queue_ and the flags
+  pthread_cond_t          queue_not_empty_;
+  pthread_cond_t          queue_not_full_;
 };
 
 
@@ -27,10 +27,23 @@ int CalculateHypPredictions(
 
     BasecallerRead master_read;
     master_read.SetData(my_read.measurements, global_context.treePhaserFlowOrder.num_flows());
+
     InitializeBasecallers(thread_objects, my_read, global_context);
 
+    // Read prefix does not depend on the variant: reuse it from earlier candidates
+    ReadPrefixCache::Entry *read_cache = thread_objects.read_prefix_cache.Find(my_read.read_number);
+    if (read_cache == NULL)
+      read_cache = &thread_objects.read_prefix_cache.Insert(my_read.read_number, my_read.alignment.RefID, my_read.end);
+
     // --- Step 2: Solve beginning of the read
-    prefix_flow = GetStartOfMasterRead(thread_objects, my_read, global_context, Hypotheses, nFlows, master_read);
+    if (read_cache->prefix_flow < 0) {
+      prefix_flow = GetStartOfMasterRead(thread_objects, my_read, global_context, Hypotheses, nFlows, master_read);
+      read_cache->prefix = master_read.sequence;
+      read_cache->prefix_flow = prefix_flow;
+    } else {
+      master_read.sequence = read_cache->prefix;
+      prefix_flow = read_cache->prefix_flow;
+    }
     unsigned int prefix_size = master_read.sequence.size();
 
     // --- Step 3: creating predictions for the individual hypotheses
@@ -108,27 +121,18 @@ void InitializeBasecallers(PersistingThreadObjects &thread_objects,
                            const Alignment         &my_read,
                            const InputStructures   &global_context) {
 
-  // Set phasing parameters
-  if (global_context.use_SSE_basecaller)
+  // Set phasing parameters and the HP recalibration model looked up when the read was loaded.
+  // Only the treephaser that is going to solve the read is touched.
+  if (global_context.use_SSE_basecaller) {
     thread_objects.treephaser_sse.SetModelParameters(my_read.phase_params[0], my_read.phase_params[1]);
-  else
+    thread_objects.treephaser_sse.DisableRecalibration();   // Disable use of a previously loaded recalibration model
+    if (my_read.recal_ab.table != 0)
+      thread_objects.treephaser_sse.SetAsBs(my_read.recal_ab.table);
+  } else {
     thread_objects.dpTreephaser.SetModelParameters(my_read.phase_params[0], my_read.phase_params[1], my_read.phase_params[2]);
-
-  // Set up HP recalibration model: hide the recal object behind a mask so we can use the map to select
-  thread_objects.dpTreephaser.DisableRecalibration();   // Disable use of a previously loaded recalibration model
-  thread_objects.treephaser_sse.DisableRecalibration();
-
-  if (global_context.do_recal.recal_is_live()) {
-    // query recalibration structure using row, column, entity
-    // look up entity here: using row, col, runid
-    // note: perhaps do this when we first get the read, exploit here
-    string found_key = global_context.do_recal.FindKey(my_read.runid, my_read.well_rowcol[1], my_read.well_rowcol[0]);
-    MultiAB multi_ab;
-    global_context.do_recal.getAB(multi_ab, found_key, my_read.well_rowcol[1], my_read.well_rowcol[0]);
-    if (multi_ab.Valid()) {
-      thread_objects.dpTreephaser.SetAsBs(multi_ab.aPtr, multi_ab.bPtr);
-      thread_objects.treephaser_sse.SetAsBs(multi_ab.aPtr, multi_ab.bPtr);
-    }
+    thread_objects.dpTreephaser.DisableRecalibration();
+    if (my_read.recal_ab.table != 0)
+      thread_objects.dpTreephaser.SetAsBs(my_read.recal_ab.table);
   }
 }
 
@@ -10,6 +10,13 @@
 #include <fstream>
 #include "json/json.h"
 
+// Json key fragments, in PipelineStage and LockWait order
+static const char *kStageNames[kNumPipelineStages] = {
+    "read_removal", "read_loading", "read_processing", "candidate_generation", "evaluation", "output", "metrics_collection" };
+static const char *kLockWaitNames[kNumLockWaits] = {
+    "bam_walker_mutex", "read_loading_mutex", "candidate_generation_mutex", "memory_contention_cond", "alignment_tail_cond" };
+
+
 MetricsAccumulator& MetricsManager::NewAccumulator()
 {
   accumulators_.push_back(MetricsAccumulator());
@@ -108,6 +115,30 @@ void MetricsManager::FinalizeAndSave(const string& output_json)
   json["metrics"]["T>C"] = (Json::Int64)final.substitution_events[('T'&7) + (('C'&7)<<3)];
   json["metrics"]["T>G"] = (Json::Int64)final.substitution_events[('T'&7) + (('G'&7)<<3)];
 
+  json["metrics"]["candidates_evaluated"] = (Json::Int64)final.candidates_evaluated;
+  json["metrics"]["candidates_prescreened"] = (Json::Int64)final.candidates_prescreened;
+  json["metrics"]["read_prefix_cache_hits"] = (Json::Int64)final.read_prefix_cache_hits;
+  json["metrics"]["read_prefix_cache_misses"] = (Json::Int64)final.read_prefix_cache_misses;
+  json["metrics"]["realignment_cache_hits"] = (Json::Int64)final.realignment_cache_hits;
+  json["metrics"]["realignment_cache_misses"] = (Json::Int64)final.realignment_cache_misses;
+  json["metrics"]["output_delayed_slots"] = (Json::Int64)final.output_delayed_slots;
+  json["metrics"]["output_reorder_wait_seconds"] = final.output_reorder_wait;
+  json["metrics"]["output_max_reorder_wait_seconds"] = final.output_max_reorder_wait;
+  json["metrics"]["output_capacity_stalls"] = (Json::Int64)final.output_capacity_stalls;
+  json["metrics"]["output_capacity_stall_seconds"] = final.output_capacity_stall;
+
+  // Summed over worker threads
+  json["metrics"]["worker_wall_seconds"] = final.worker_wall;
+  json["metrics"]["worker_cpu_seconds"] = final.worker_cpu;
+  for (int stage = 0; stage < kNumPipelineStages; ++stage) {
+    json["metrics"][string("stage_") + kStageNames[stage] + "_wall_seconds"] = final.stage_wall[stage];
+    json["metrics"][string("stage_") + kStageNames[stage] + "_cpu_seconds"] = final.stage_cpu[stage];
+  }
+  for (int which = 0; which < kNumLockWaits; ++which) {
+    json["metrics"][string(kLockWaitNames[which]) + "_wait_seconds"] = final.lock_wait[which];
+    json["metrics"][string(kLockWaitNames[which]) + "_waits"] = (Json::Int64)final.lock_contentions[which];
+  }
+
   ofstream out(output_json.c_str(), ios::out);
   if (out.good())
     out << json.toStyledString();
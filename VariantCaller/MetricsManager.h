@@ -10,25 +10,141 @@
 
 #include <string>
 #include <list>
+#include <pthread.h>
+#include <time.h>
 #include "ReferenceReader.h"
 #include "BAMWalkerEngine.h"
 
 using namespace std;
 
+//! Stages of the worker thread loop, timed separately in wall and thread CPU seconds
+enum PipelineStage {
+  kStageReadRemoval = 0,        //! Saving finished reads to the postprocessed bam and freeing them
+  kStageReadLoading,            //! Bam decoding under read_loading_mutex
+  kStageReadProcessing,         //! Read filters, primer trimming and flow signal unpacking
+  kStageCandidateGeneration,    //! Candidate generation and advancing to the next position
+  kStageEvaluation,             //! Ensemble evaluation of the candidates
+  kStageOutput,                 //! Reserving and filling ordered vcf writer slots
+  kStageMetricsCollection,      //! Substitution counts for the deamination metric
+  kNumPipelineStages
+};
+
+//! Shared locks and conditions the worker threads block on
+enum LockWait {
+  kWaitBamWalkerMutex = 0,
+  kWaitReadLoadingMutex,
+  kWaitCandidateGenerationMutex,
+  kWaitMemoryContentionCond,
+  kWaitAlignmentTailCond,
+  kNumLockWaits
+};
+
+inline double MetricsClock(clockid_t clock_id)
+{
+  struct timespec now;
+  clock_gettime(clock_id, &now);
+  return now.tv_sec + 1e-9 * now.tv_nsec;
+}
+
 struct MetricsAccumulator {
 
   // Counters used for computing the deamination metric
   long int substitution_events[64];
 
+  // Candidates that went through full evaluation vs. failed by the pre-screen
+  long int candidates_evaluated;
+  long int candidates_prescreened;
+
+  // Lookups of solved read prefixes and of local realignment outcomes
+  long int read_prefix_cache_hits;
+  long int read_prefix_cache_misses;
+  long int realignment_cache_hits;
+  long int realignment_cache_misses;
+
+  // Ordered VCF output: slots that finished ahead of an earlier one, and reservations held back by a full reorder ring
+  long int output_delayed_slots;
+  double   output_reorder_wait;
+  double   output_max_reorder_wait;
+  long int output_capacity_stalls;
+  double   output_capacity_stall;
+
+  // Worker thread time, per stage and in total. Stage times include lock waits within the stage
+  double   stage_wall[kNumPipelineStages];
+  double   stage_cpu[kNumPipelineStages];
+  double   worker_wall;
+  double   worker_cpu;
+
+  // Time blocked on shared locks and conditions, and how many acquisitions blocked
+  double   lock_wait[kNumLockWaits];
+  long int lock_contentions[kNumLockWaits];
+
 
   MetricsAccumulator() {
     for (int i = 0; i < 64; ++i)
       substitution_events[i] = 0;
+    candidates_evaluated = 0;
+    candidates_prescreened = 0;
+    read_prefix_cache_hits = 0;
+    read_prefix_cache_misses = 0;
+    realignment_cache_hits = 0;
+    realignment_cache_misses = 0;
+    output_delayed_slots = 0;
+    output_reorder_wait = 0;
+    output_max_reorder_wait = 0;
+    output_capacity_stalls = 0;
+    output_capacity_stall = 0;
+    for (int i = 0; i < kNumPipelineStages; ++i)
+      stage_wall[i] = stage_cpu[i] = 0;
+    worker_wall = 0;
+    worker_cpu = 0;
+    for (int i = 0; i < kNumLockWaits; ++i) {
+      lock_wait[i] = 0;
+      lock_contentions[i] = 0;
+    }
   }
 
   void operator+= (const MetricsAccumulator& other) {
     for (int i = 0; i < 64; ++i)
       substitution_events[i] += other.substitution_events[i];
+    candidates_evaluated += other.candidates_evaluated;
+    candidates_prescreened += other.candidates_prescreened;
+    read_prefix_cache_hits += other.read_prefix_cache_hits;
+    read_prefix_cache_misses += other.read_prefix_cache_misses;
+    realignment_cache_hits += other.realignment_cache_hits;
+    realignment_cache_misses += other.realignment_cache_misses;
+    output_delayed_slots += other.output_delayed_slots;
+    output_reorder_wait += other.output_reorder_wait;
+    output_max_reorder_wait = max(output_max_reorder_wait, other.output_max_reorder_wait);
+    output_capacity_stalls += other.output_capacity_stalls;
+    output_capacity_stall += other.output_capacity_stall;
+    for (int i = 0; i < kNumPipelineStages; ++i) {
+      stage_wall[i] += other.stage_wall[i];
+      stage_cpu[i] += other.stage_cpu[i];
+    }
+    worker_wall += other.worker_wall;
+    worker_cpu += other.worker_cpu;
+    for (int i = 0; i < kNumLockWaits; ++i) {
+      lock_wait[i] += other.lock_wait[i];
+      lock_contentions[i] += other.lock_contentions[i];
+    }
+  }
+
+  //! @brief  pthread_mutex_lock that only reads the clock when the mutex is already taken
+  void LockMutex(pthread_mutex_t *mutex, LockWait which) {
+    if (pthread_mutex_trylock(mutex) == 0)
+      return;
+    double start = MetricsClock(CLOCK_MONOTONIC);
+    pthread_mutex_lock(mutex);
+    lock_wait[which] += MetricsClock(CLOCK_MONOTONIC) - start;
+    lock_contentions[which]++;
+  }
+
+  //! @brief  pthread_cond_wait, timed including reacquisition of the mutex
+  void WaitCondition(pthread_cond_t *cond, pthread_mutex_t *mutex, LockWait which) {
+    double start = MetricsClock(CLOCK_MONOTONIC);
+    pthread_cond_wait(cond, mutex);
+    lock_wait[which] += MetricsClock(CLOCK_MONOTONIC) - start;
+    lock_contentions[which]++;
   }
 
 
@@ -37,6 +153,36 @@ struct MetricsAccumulator {
 };
 
 
+//! @brief  Charges wall and thread CPU time to pipeline stages of one worker thread
+class StageTimer {
+public:
+  StageTimer(MetricsAccumulator& metrics) : metrics_(metrics) { Restart(); }
+
+  void Restart() {
+    wall_start_ = MetricsClock(CLOCK_MONOTONIC);
+    cpu_start_ = MetricsClock(CLOCK_THREAD_CPUTIME_ID);
+  }
+
+  //! Add the time since construction or the previous lap to a stage, and restart
+  void Lap(PipelineStage stage) {
+    double wall_now = MetricsClock(CLOCK_MONOTONIC);
+    double cpu_now = MetricsClock(CLOCK_THREAD_CPUTIME_ID);
+    metrics_.stage_wall[stage] += wall_now - wall_start_;
+    metrics_.stage_cpu[stage] += cpu_now - cpu_start_;
+    wall_start_ = wall_now;
+    cpu_start_ = cpu_now;
+  }
+
+  double WallElapsed() const { return MetricsClock(CLOCK_MONOTONIC) - wall_start_; }
+  double CpuElapsed() const { return MetricsClock(CLOCK_THREAD_CPUTIME_ID) - cpu_start_; }
+
+private:
+  MetricsAccumulator& metrics_;
+  double              wall_start_;
+  double              cpu_start_;
+};
+
+
 class MetricsManager {
 public:
   MetricsManager() {}
@@ -0,0 +1,421 @@
+/* Copyright (C) 2013 Ion Torrent Systems, Inc. All Rights Reserved */
+
+//! @file     NormalizedVCFWriter.cpp
+//! @ingroup  VariantCaller
+//! @brief    Sorted, left-aligned and optionally target-restricted copy of the main VCF
+
+#include "NormalizedVCFWriter.h"
+
+#include <algorithm>
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <limits.h>
+
+static const int  kMaxLeftAlignLength = 200;   // LeftAlignVariants leaves longer indels alone
+static const int  kLeftAlignWindow = 200;      // and looks at most this far to the left
+static const size_t kOutputBlockSize = 1<<20;
+static const long kSortWindow = 1000;          // Records this far behind the called positions can no longer be overtaken
+static const unsigned int kFlushBatch = 1024;  // Records added between attempts to write some out
+
+
+NormalizedVCFWriter::NormalizedVCFWriter()
+{
+  ref_reader_ = NULL;
+  restrict_to_targets_ = false;
+  num_left_aligned_ = 0;
+  num_off_target_ = 0;
+  num_written_ = 0;
+  num_out_of_order_ = 0;
+  input_chr_ = -1;
+  input_position_ = 0;
+  flushed_chr_ = -1;
+  flushed_position_ = 0;
+}
+
+
+bool NormalizedVCFWriter::Record::operator<(const Record& other) const
+{
+  if (chr != other.chr)
+    return chr < other.chr;
+  if (position != other.position)
+    return position < other.position;
+  // sort_vcf.py breaks ties by the line text
+  if (original_position != other.original_position)
+    return original_position < other.original_position;
+  return line < other.line;
+}
+
+
+void NormalizedVCFWriter::Initialize(const string& filename, const string& vcf_header, const ExtendParameters& parameters,
+    const ReferenceReader& ref_reader, const TargetsManager& targets_manager)
+{
+  ref_reader_ = &ref_reader;
+  if (parameters.output_bgzip)
+    output_.Initialize(filename + ".gz", true);
+  else
+    output_.Initialize(filename, false);
+
+  // Same regions as the BED filter of the pipeline: the target file, or its effective
+  // (primer-trimmed) version when primers are trimmed
+  restrict_to_targets_ = parameters.normalized_vcf_targets and not parameters.targets.empty();
+  if (restrict_to_targets_) {
+    targets_.resize(ref_reader.chr_count());
+    for (vector<TargetsManager::UnmergedTarget>::const_iterator target = targets_manager.unmerged.begin();
+        target != targets_manager.unmerged.end(); ++target) {
+      long begin = target->begin;
+      long end = target->end;
+      if (targets_manager.trim_ampliseq_primers) {
+        begin += target->trim_left;
+        end -= target->trim_right;
+      }
+      if (begin < end)
+        targets_[target->chr].push_back(make_pair(begin, end));
+    }
+    for (int chr = 0; chr < (int)targets_.size(); ++chr) {
+      vector<pair<long,long> >& intervals = targets_[chr];
+      sort(intervals.begin(), intervals.end());
+      int num_merged = 0;
+      for (int idx = 0; idx < (int)intervals.size(); ++idx) {
+        if (num_merged and intervals[num_merged-1].second >= intervals[idx].first)
+          intervals[num_merged-1].second = max(intervals[num_merged-1].second, intervals[idx].second);
+        else
+          intervals[num_merged++] = intervals[idx];
+      }
+      intervals.resize(num_merged);
+    }
+  }
+
+  WriteHeader(vcf_header, parameters.fasta);
+}
+
+
+// GATK writes the meta lines as a sorted set, adds the reference contigs and the reference file URL
+void NormalizedVCFWriter::WriteHeader(const string& vcf_header, const string& fasta)
+{
+  vector<string> meta_lines;
+  string fileformat_line, column_line;
+  for (size_t line_start = 0; line_start < vcf_header.size(); ) {
+    size_t line_end = vcf_header.find('\n', line_start);
+    if (line_end == string::npos)
+      line_end = vcf_header.size();
+    string line = vcf_header.substr(line_start, line_end - line_start);
+    line_start = line_end + 1;
+    if (line.empty())
+      continue;
+    if (line.compare(0, 13, "##fileformat=") == 0)
+      fileformat_line = line;
+    else if (line.compare(0, 2, "##") == 0)
+      meta_lines.push_back(line);
+    else
+      column_line = line;
+  }
+
+  string reference_path = fasta;
+  if (reference_path.empty() or reference_path[0] != '/') {
+    char cwd[4096];
+    if (getcwd(cwd, sizeof(cwd)))
+      reference_path = string(cwd) + "/" + reference_path;
+  }
+  meta_lines.push_back("##reference=file://" + reference_path);
+  sort(meta_lines.begin(), meta_lines.end());
+  meta_lines.erase(unique(meta_lines.begin(), meta_lines.end()), meta_lines.end());
+
+  string assembly;
+  if (fasta.find("b37") != string::npos)
+    assembly = "b37";
+  else if (fasta.find("b36") != string::npos)
+    assembly = "b36";
+  else if (fasta.find("hg18") != string::npos)
+    assembly = "hg18";
+  else if (fasta.find("hg19") != string::npos)
+    assembly = "hg19";
+
+  string header = fileformat_line + "\n";
+  vector<string>::iterator contigs_here = lower_bound(meta_lines.begin(), meta_lines.end(), string("##contig=<"));
+  for (vector<string>::iterator line = meta_lines.begin(); line != contigs_here; ++line)
+    header += *line + "\n";
+  // Contig lines stay in reference order
+  for (int chr = 0; chr < ref_reader_->chr_count(); ++chr) {
+    header += "##contig=<ID=";
+    header += ref_reader_->chr_str(chr);
+    header += ",length=";
+    AppendVcfInteger(header, ref_reader_->chr_size(chr));
+    if (not assembly.empty())
+      header += ",assembly=" + assembly;
+    header += ">\n";
+  }
+  for (vector<string>::iterator line = contigs_here; line != meta_lines.end(); ++line)
+    header += *line + "\n";
+  header += column_line + "\n";
+  output_.Write(header);
+}
+
+
+// LeftAlignVariants: a biallelic insertion or deletion with a shared padding base is shifted left
+// while the haplotype stays the same, and the padding base becomes the reference base before it.
+bool NormalizedVCFWriter::LeftAlign(int chr, long& position, string& ref, string& alt) const
+{
+  if (ref.empty() or alt.empty() or ref.size() == alt.size() or (ref.size() != 1 and alt.size() != 1))
+    return false;
+  if (alt.find_first_of(",<>[]*.") != string::npos or toupper(ref[0]) != toupper(alt[0]))
+    return false;
+
+  bool deletion = ref.size() > alt.size();
+  int indel_length = deletion ? ref.size() - 1 : alt.size() - 1;
+  if (indel_length > kMaxLeftAlignLength)
+    return false;
+
+  // 0-based start of the event, i.e. the base after the padding base
+  long start = position;
+  long min_start = max(0L, position - kLeftAlignWindow - 1) + 1;
+  long chr_size = ref_reader_->chr_size(chr);
+  if (start + (deletion ? indel_length : 0) > chr_size)
+    return false;
+
+  string inserted;
+  if (not deletion)
+    for (int idx = 1; idx <= indel_length; ++idx)
+      inserted.push_back(toupper(alt[idx]));
+
+  long shifted = start;
+  while (shifted > min_start) {
+    char before = toupper(ref_reader_->base(chr, shifted-1));
+    if (deletion) {
+      if (before != toupper(ref_reader_->base(chr, shifted+indel_length-1)))
+        break;
+    } else {
+      if (before != inserted[indel_length-1])
+        break;
+      inserted.erase(indel_length-1);
+      inserted.insert(inserted.begin(), before);
+    }
+    shifted--;
+  }
+  if (shifted == start)
+    return false;
+
+  char padding = toupper(ref_reader_->base(chr, shifted-1));
+  if (deletion) {
+    ref.assign(1, padding);
+    for (long pos = shifted; pos < shifted + indel_length; ++pos)
+      ref.push_back(toupper(ref_reader_->base(chr, pos)));
+    alt.assign(1, padding);
+  } else {
+    ref.assign(1, padding);
+    alt = padding + inserted;
+  }
+  position = shifted;
+  return true;
+}
+
+
+bool NormalizedVCFWriter::IsOnTarget(int chr, long position) const
+{
+  // vcftools --bed keeps a record if start < POS <= end
+  const vector<pair<long,long> >& intervals = targets_[chr];
+  vector<pair<long,long> >::const_iterator after = upper_bound(intervals.begin(), intervals.end(),
+      make_pair(position-1, LONG_MAX));
+  if (after == intervals.begin())
+    return false;
+  --after;
+  return position-1 < after->second;
+}
+
+
+// GATK keeps QUAL as log10 error probability and prints it with Java's %.2f, which rounds half up
+// on the shortest decimal representation, then drops a ".00" suffix
+static void AppendGatkQuality(string& line, const string& quality)
+{
+  if (quality == ".") {
+    line += quality;
+    return;
+  }
+  // Not a no-op: reproduces GATK's round trip through log10PError, which turns e.g. 0.055 into 0.05499...
+  double phred = (strtod(quality.c_str(), NULL) / -10.0) * -10.0;
+
+  char buffer[40];
+  for (int precision = 0; precision < 17; ++precision) {
+    snprintf(buffer, sizeof(buffer), "%.*e", precision, phred);
+    if (strtod(buffer, NULL) == phred)
+      break;
+  }
+  // buffer is [-]d.ddde[+-]xx
+  const char *mantissa = buffer;
+  bool negative = (*mantissa == '-');
+  if (negative)
+    mantissa++;
+  string digits;
+  const char *c = mantissa;
+  for (; *c and *c != 'e'; ++c)
+    if (isdigit(*c))
+      digits.push_back(*c);
+  int integer_digits = (*c == 'e') ? atoi(c+1) + 1 : 1;
+  if (integer_digits < 1) {
+    digits.insert(0, 1 - integer_digits, '0');
+    integer_digits = 1;
+  }
+  int kept = integer_digits + 2;
+  if ((int)digits.size() < kept + 1)
+    digits.resize(kept + 1, '0');
+  bool round_up = digits[kept] >= '5';
+  digits.resize(kept);
+  for (int idx = kept-1; round_up and idx >= 0; --idx) {
+    if (digits[idx] == '9')
+      digits[idx] = '0';
+    else {
+      digits[idx]++;
+      round_up = false;
+    }
+  }
+  if (round_up) {
+    digits.insert(digits.begin(), '1');
+    integer_digits++;
+  }
+  size_t first_nonzero = digits.find_first_not_of('0');
+  if (negative and first_nonzero != string::npos)
+    line += '-';
+  size_t integer_start = min(digits.find_first_not_of('0'), (size_t)integer_digits-1);
+  line.append(digits, integer_start, integer_digits - integer_start);
+  if (digits.compare(integer_digits, 2, "00")) {
+    line += '.';
+    line.append(digits, integer_digits, 2);
+  }
+}
+
+
+// GATK writes INFO as a sorted map, flags included
+static void AppendSortedInfo(string& line, const string& info)
+{
+  vector<pair<string,string> > entries;
+  for (size_t entry_start = 0; entry_start <= info.size(); ) {
+    size_t entry_end = info.find(';', entry_start);
+    if (entry_end == string::npos)
+      entry_end = info.size();
+    string entry = info.substr(entry_start, entry_end - entry_start);
+    entries.push_back(make_pair(entry.substr(0, entry.find('=')), entry));
+    entry_start = entry_end + 1;
+  }
+  stable_sort(entries.begin(), entries.end());
+  for (unsigned int idx = 0; idx < entries.size(); ++idx) {
+    if (idx)
+      line += ';';
+    line += entries[idx].second;
+  }
+}
+
+
+void NormalizedVCFWriter::AddRecord(const string& text, size_t record_start)
+{
+  // CHROM POS ID REF ALT QUAL FILTER INFO, then FORMAT and samples untouched
+  size_t line_end = text.find('\n', record_start);
+  if (line_end == string::npos)
+    line_end = text.size();
+  vector<string> fields;
+  size_t field_start = record_start;
+  while (fields.size() < 8) {
+    size_t field_end = text.find('\t', field_start);
+    if (field_end == string::npos or field_end > line_end)
+      field_end = line_end;
+    fields.push_back(text.substr(field_start, field_end - field_start));
+    field_start = min(field_end + 1, line_end);
+  }
+
+  Record record;
+  record.chr = ref_reader_->chr_idx(fields[0].c_str());
+  if (record.chr < 0 or ref_reader_->chr_str(record.chr) != fields[0]) {
+    cerr << "WARNING: Record on contig " << fields[0] << " is not in the reference and is left out of the normalized VCF" << endl;
+    return;
+  }
+  record.original_position = atol(fields[1].c_str());
+  record.position = record.original_position;
+  if (LeftAlign(record.chr, record.position, fields[3], fields[4]))
+    num_left_aligned_++;
+
+  if (restrict_to_targets_ and not IsOnTarget(record.chr, record.position)) {
+    num_off_target_++;
+    return;
+  }
+
+  string& line = record.line;
+  line.reserve(line_end - record_start + 16);
+  line += fields[0];
+  line += '\t';
+  AppendVcfInteger(line, record.position);
+  line += '\t';
+  line += fields[2];
+  line += '\t';
+  line += fields[3];
+  line += '\t';
+  line += fields[4];
+  line += '\t';
+  AppendGatkQuality(line, fields[5]);
+  line += '\t';
+  line += fields[6];
+  line += '\t';
+  AppendSortedInfo(line, fields[7]);
+  if (field_start < line_end) {
+    line += '\t';
+    line.append(text, field_start, line_end - field_start);
+  }
+  line += '\n';
+
+  // Records arrive in calling order, which is reference order up to the reach of left alignment
+  // and of multi-base haplotypes, so only a window behind the latest called position stays in memory
+  if (record.chr != input_chr_) {
+    input_chr_ = record.chr;
+    input_position_ = record.original_position;
+  } else
+    input_position_ = max(input_position_, record.original_position);
+  if (record.chr < flushed_chr_ or (record.chr == flushed_chr_ and record.position < flushed_position_))
+    num_out_of_order_++;
+
+  records_.push_back(Record());
+  records_.back().chr = record.chr;
+  records_.back().position = record.position;
+  records_.back().original_position = record.original_position;
+  records_.back().line.swap(record.line);
+
+  if (records_.size() >= kFlushBatch)
+    Flush(false);
+}
+
+
+void NormalizedVCFWriter::Flush(bool all)
+{
+  sort(records_.begin(), records_.end());
+  vector<Record>::iterator record = records_.begin();
+  for (; record != records_.end(); ++record) {
+    if (not all and record->chr == input_chr_ and record->position >= input_position_ - kSortWindow)
+      break;
+    output_text_ += record->line;
+    if (output_text_.size() >= kOutputBlockSize)
+      output_.Write(output_text_);
+    flushed_chr_ = record->chr;
+    flushed_position_ = record->position;
+    num_written_++;
+  }
+  records_.erase(records_.begin(), record);
+}
+
+
+void NormalizedVCFWriter::Close()
+{
+  if (not IsOpen())
+    return;
+
+  Flush(true);
+  output_.Write(output_text_);
+  output_.Close();
+
+  cout << "NormalizedVCFWriter: " << num_written_ << " record(s) written, " << num_left_aligned_ << " left-aligned";
+  if (restrict_to_targets_)
+    cout << ", " << num_off_target_ << " outside targets";
+  cout << endl;
+  if (num_out_of_order_)
+    cerr << "WARNING: " << num_out_of_order_ << " record(s) arrived more than " << kSortWindow
+         << " bases behind the calling position and are out of order in the normalized VCF" << endl;
+  records_.clear();
+  ref_reader_ = NULL;
+}
@@ -0,0 +1,72 @@
+/* Copyright (C) 2013 Ion Torrent Systems, Inc. All Rights Reserved */
+
+//! @file     NormalizedVCFWriter.h
+//! @ingroup  VariantCaller
+//! @brief    Sorted, left-aligned and optionally target-restricted copy of the main VCF
+
+#ifndef NORMALIZEDVCFWRITER_H
+#define NORMALIZEDVCFWRITER_H
+
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "ReferenceReader.h"
+#include "TargetsManager.h"
+#include "ExtendParameters.h"
+#include "AsyncTextWriter.h"
+#include "VariantAnnotation.h"
+
+using namespace std;
+
+
+//! Produces in-process what the pipeline got from sort_vcf.py followed by GATK LeftAlignVariants:
+//! records in reference order, biallelic indels shifted to their leftmost position, and header,
+//! QUAL and INFO laid out the way GATK writes them. Optionally drops records outside the targets,
+//! like the vcftools --bed step.
+class NormalizedVCFWriter {
+public:
+  NormalizedVCFWriter();
+
+  void Initialize(const string& filename, const string& vcf_header, const ExtendParameters& parameters,
+      const ReferenceReader& ref_reader, const TargetsManager& targets_manager);
+  bool IsOpen() const { return ref_reader_ != NULL; }
+
+  //! @brief  Take a copy of the record that starts at record_start in text. Called by one thread at a time.
+  void AddRecord(const string& text, size_t record_start);
+
+  //! @brief  Sort and write the remaining records
+  void Close();
+
+private:
+  struct Record {
+    int     chr;                //! Contig index in the reference
+    long    position;           //! POS after left alignment
+    long    original_position;  //! POS as called
+    string  line;               //! Normalized record, with newline
+    bool operator<(const Record& other) const;
+  };
+
+  void WriteHeader(const string& vcf_header, const string& fasta);
+  bool LeftAlign(int chr, long& position, string& ref, string& alt) const;
+  bool IsOnTarget(int chr, long position) const;
+  void Flush(bool all);
+
+  const ReferenceReader *       ref_reader_;
+  AsyncTextWriter               output_;
+  string                        output_text_;   //! Sorted records waiting for a full output block
+  vector<Record>                records_;       //! Records that may still be overtaken by a later, left-aligned one
+  int                           input_chr_;     //! Contig of the latest record added
+  long                          input_position_; //! Furthest called POS added on that contig
+  int                           flushed_chr_;   //! Sort key of the last record written
+  long                          flushed_position_;
+  vector<vector<pair<long,long> > > targets_;   //! Half-open target intervals by contig, empty if not restricting
+  bool                          restrict_to_targets_;
+  int                           num_left_aligned_;
+  int                           num_off_target_;
+  int                           num_written_;
+  int                           num_out_of_order_; //! Records that arrived after a later record was written
+};
+
+
+#endif // NORMALIZEDVCFWRITER_H
@@ -7,132 +7,230 @@
 #ifndef ORDEREDVCFWRITER_H
 #define ORDEREDVCFWRITER_H
 
-#include <fstream>
 #include <deque>
 #include <pthread.h>
 #include <Variant.h>
 #include <errno.h>
+#include <unistd.h>
+#include <sys/time.h>
 
 #include "VcfFormat.h"
+#include "BcfFormat.h"
 #include "InputStructures.h"
+#include "AsyncTextWriter.h"
+#include "NormalizedVCFWriter.h"
+#include "TraceWriter.h"
 
 using namespace std;
 
 
+// Finished slots are published into a fixed ring with atomic flags, and drained in slot order
+// by whichever worker wins the writing duty. A worker that reserves a slot more than kReorderCapacity
+// ahead of the oldest unwritten one waits until the ring drains.
+struct ReorderSlot {
+  ReorderSlot() : ready(0), delayed(false), publish_time(0) {}
+  deque<VariantCandidate>   variants;         //! Variants of this slot, valid once ready is set
+  volatile int              ready;            //! Set by the worker that filled the slot, cleared when written
+  bool                      delayed;          //! An earlier slot was still unwritten when this one became ready
+  double                    publish_time;     //! When the slot became ready
+};
+
+
 class OrderedVCFWriter {
 public:
   OrderedVCFWriter() {
     num_slots_ = 0;
     num_slots_written_ = 0;
-    slot_ready_.push_back(false);
+    ring_.resize(kReorderCapacity);
     suppress_no_calls_ = true;
-    pthread_mutex_init(&slot_mutex_, NULL);
+    output_bcf_ = false;
     pthread_mutex_init(&write_mutex_, NULL);
+    num_delayed_slots_ = 0;
+    total_reorder_wait_ = 0;
+    max_reorder_wait_ = 0;
+    num_capacity_stalls_ = 0;
+    total_capacity_stall_ = 0;
   }
   ~OrderedVCFWriter() {
-    pthread_mutex_destroy(&slot_mutex_);
     pthread_mutex_destroy(&write_mutex_);
   }
 
 
-  void Initialize(const string& output_vcf, const ExtendParameters& parameters, const SampleManager& sample_manager) {
+  void Initialize(const string& output_vcf, const ExtendParameters& parameters, const SampleManager& sample_manager,
+      const ReferenceReader& ref_reader, const TargetsManager& targets_manager) {
 
-    string filtered_vcf;
+    string output_base = output_vcf;
     size_t pos = output_vcf.rfind(".");
     if (pos != string::npos)
-      filtered_vcf = output_vcf.substr(0, pos);
-    else
-      filtered_vcf = output_vcf;
-    filtered_vcf += "_filtered.vcf";
-
-    output_vcf_stream_.open(output_vcf.c_str());
-    if (not output_vcf_stream_.is_open()) {
-      cerr << "ERROR: Cannot open output vcf file " << output_vcf << " : " << strerror(errno) << endl;
-      exit(1);
-    }
-    filtered_vcf_stream_.open(filtered_vcf.c_str());
-    if (not filtered_vcf_stream_.is_open()) {
-      cerr << "ERROR: Cannot open filtered vcf file " << filtered_vcf << " : " << strerror(errno) << endl;
-      exit(1);
+      output_base = output_vcf.substr(0, pos);
+    string filtered_vcf = output_base + "_filtered.vcf";
+    output_bcf_ = parameters.output_bcf;
+
+    if (output_bcf_) {
+      // BCF2 in place of VCF: BGZF-compressed with --output-bgzip, uncompressed otherwise. Not indexed.
+      output_vcf_stream_.Initialize(output_base + ".bcf", parameters.output_bgzip, false);
+      filtered_vcf_stream_.Initialize(output_base + "_filtered.bcf", parameters.output_bgzip, false);
+    } else if (parameters.output_bgzip) {
+      // With --output-bgzip the files are written as block-gzipped vcf.gz, each with a tabix index
+      output_vcf_stream_.Initialize(output_vcf + ".gz", true);
+      filtered_vcf_stream_.Initialize(filtered_vcf + ".gz", true);
+    } else {
+      output_vcf_stream_.Initialize(output_vcf, false);
+      filtered_vcf_stream_.Initialize(filtered_vcf, false);
     }
     suppress_no_calls_ = parameters.my_controls.suppress_no_calls;
 
     string vcf_header = getVCFHeader(&parameters, sample_manager.sample_names_);
-    output_vcf_stream_ << vcf_header << endl;
-    filtered_vcf_stream_ << vcf_header << endl;
+    if (output_bcf_) {
+      bcf_header_.Initialize(vcf_header, ref_reader);
+      bcf_header_.AppendFileStart(output_text_);
+      bcf_header_.AppendFileStart(filtered_text_);
+    } else {
+      output_text_ = vcf_header + "\n";
+      filtered_text_ = vcf_header + "\n";
+    }
     variant_initializer_.parseHeader(vcf_header);
+
+    if (not parameters.normalized_vcf.empty())
+      normalized_vcf_.Initialize(parameters.outputDir + "/" + parameters.normalized_vcf, vcf_header,
+          parameters, ref_reader, targets_manager);
   }
 
   vcf::VariantCallFile& VariantInitializer() { return variant_initializer_; }
 
   void Close() {
-
-    while (num_slots_written_ < num_slots_) {
-      for (deque<VariantCandidate>::iterator current_variant = slot_dropbox_[num_slots_written_].begin();
-          current_variant != slot_dropbox_[num_slots_written_].end(); ++current_variant) {
-        if (current_variant->variant.isFiltered and !current_variant->variant.isHotSpot and suppress_no_calls_)
-          filtered_vcf_stream_ << current_variant->variant << endl;
-        else
-          output_vcf_stream_ << current_variant->variant << endl;
-      }
-      slot_dropbox_[num_slots_written_].clear();
-      num_slots_written_++;
-
-    }
-    output_vcf_stream_.close();
-    filtered_vcf_stream_.close();
+    // All workers are done, so every reserved slot is ready
+    while (SlotsWritten() < num_slots_)
+      WriteOneSlot();
+    output_vcf_stream_.Write(output_text_);
+    filtered_vcf_stream_.Write(filtered_text_);
+    output_vcf_stream_.Close();
+    filtered_vcf_stream_.Close();
+    normalized_vcf_.Close();
   }
 
+  //! @brief  Reserve the next slot in output order. Called with candidate generation serialized.
   int ReserveSlot() {
-    pthread_mutex_lock(&slot_mutex_);
     int my_slot = num_slots_;
-    ++num_slots_;
-    slot_ready_.push_back(false);
-    slot_dropbox_.push_back(deque<VariantCandidate>());
-    pthread_mutex_unlock(&slot_mutex_);
+    if (my_slot - SlotsWritten() >= kReorderCapacity) {
+      // Back-pressure: one position is holding up output and the ring is full
+      double stall_start = WallTime();
+      while (my_slot - SlotsWritten() >= kReorderCapacity)
+        usleep(100);
+      num_capacity_stalls_++;
+      total_capacity_stall_ += WallTime() - stall_start;
+    }
+    num_slots_ = my_slot + 1;
     return my_slot;
   }
 
-  void WriteSlot(int slot, deque<VariantCandidate> &variant_batch) {
-    // Deposit results in the dropbox
-    pthread_mutex_lock(&slot_mutex_);
-    slot_dropbox_[slot].swap(variant_batch);
-    slot_ready_[slot] = true;
-    pthread_mutex_unlock(&slot_mutex_);
+  void WriteSlot(int slot, deque<VariantCandidate> &variant_batch, TraceBuffer *trace = NULL) {
+    // Publish the results
+    ReorderSlot& my_slot = ring_[slot & (kReorderCapacity-1)];
+    my_slot.variants.swap(variant_batch);
+    my_slot.delayed = (slot != SlotsWritten());
+    my_slot.publish_time = WallTime();
+    __sync_fetch_and_or(&my_slot.ready, 1);
+
+    // Attempt writing duty. Whoever holds it checks the head slot again after letting go,
+    // so a slot published while the writer was finishing up is not left behind.
+    while (NextSlotReady()) {
+      if (pthread_mutex_trylock(&write_mutex_))
+        return;
+      double trace_start = TraceStart(trace);
+      int first_slot = SlotsWritten();
+      while (NextSlotReady())
+        WriteOneSlot();
+      // Formatting happens here, disk I/O on the output threads
+      if (output_text_.size() >= kOutputBlockSize)
+        output_vcf_stream_.Write(output_text_);
+      if (filtered_text_.size() >= kOutputBlockSize)
+        filtered_vcf_stream_.Write(filtered_text_);
+      TraceEnd(trace, "vcf flush", trace_start, -1, -1, "slots", SlotsWritten() - first_slot);
+      pthread_mutex_unlock(&write_mutex_);
+    }
+  }
+
+  //! @brief  Reorder buffer statistics, for tvc_metrics.json
+  int     num_delayed_slots() const { return num_delayed_slots_; }       //! Slots that finished before an earlier slot
+  double  total_reorder_wait() const { return total_reorder_wait_; }     //! Seconds those slots waited for output
+  double  max_reorder_wait() const { return max_reorder_wait_; }         //! Longest wait of a single slot
+  int     num_capacity_stalls() const { return num_capacity_stalls_; }   //! Reservations that waited for a full ring
+  double  total_capacity_stall() const { return total_capacity_stall_; } //! Seconds spent waiting for ring space
 
-    // Attempt writing duty
-    if (pthread_mutex_trylock(&write_mutex_))
+private:
+  static const int kReorderCapacity = 4096;     // Power of two
+  static const size_t kOutputBlockSize = 1<<20;
+
+  static double WallTime() {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return now.tv_sec + 1e-6 * now.tv_usec;
+  }
+
+  // The counter is advanced by the writing worker and read by all others
+  int SlotsWritten() { return __sync_fetch_and_add(&num_slots_written_, 0); }
+
+  bool NextSlotReady() {
+    int next_slot = SlotsWritten();
+    return __sync_fetch_and_add(&ring_[next_slot & (kReorderCapacity-1)].ready, 0) != 0;
+  }
+
+  void WriteOneSlot() {
+    ReorderSlot& head_slot = ring_[SlotsWritten() & (kReorderCapacity-1)];
+    if (head_slot.delayed) {
+      double wait = WallTime() - head_slot.publish_time;
+      num_delayed_slots_++;
+      total_reorder_wait_ += wait;
+      max_reorder_wait_ = max(max_reorder_wait_, wait);
+    }
+    for (deque<VariantCandidate>::iterator current_variant = head_slot.variants.begin();
+        current_variant != head_slot.variants.end(); ++current_variant)
+      WriteVariant(*current_variant);
+    head_slot.variants.clear();
+    __sync_lock_release(&head_slot.ready);
+    __sync_fetch_and_add(&num_slots_written_, 1);
+  }
+
+  void WriteVariant(VariantCandidate& candidate) {
+    bool filtered = candidate.variant.isFiltered and !candidate.variant.isHotSpot and suppress_no_calls_;
+    string& text = filtered ? filtered_text_ : output_text_;
+    size_t record_start = text.size();
+    if (output_bcf_)
+      WriteBcfRecord(text, bcf_header_, candidate.variant, candidate.annotation);
+    else
+      WriteVcfRecord(text, candidate.variant, candidate.annotation);
+
+    if (filtered or not normalized_vcf_.IsOpen())
+      return;
+    if (not output_bcf_) {
+      normalized_vcf_.AddRecord(text, record_start);
       return;
-    while (true) {
-      pthread_mutex_lock(&slot_mutex_);
-      bool cannot_write = !slot_ready_[num_slots_written_];
-      pthread_mutex_unlock(&slot_mutex_);
-      if (cannot_write)
-        break;
-      for (deque<VariantCandidate>::iterator current_variant = slot_dropbox_[num_slots_written_].begin();
-          current_variant != slot_dropbox_[num_slots_written_].end(); ++current_variant) {
-        if (current_variant->variant.isFiltered and !current_variant->variant.isHotSpot and suppress_no_calls_)
-          filtered_vcf_stream_ << current_variant->variant << endl;
-        else
-          output_vcf_stream_ << current_variant->variant << endl;
-      }
-      slot_dropbox_[num_slots_written_].clear();
-      num_slots_written_++;
     }
-    pthread_mutex_unlock(&write_mutex_);
+    normalized_text_.clear();
+    WriteVcfRecord(normalized_text_, candidate.variant, candidate.annotation);
+    normalized_vcf_.AddRecord(normalized_text_, 0);
   }
 
-private:
   int                           num_slots_;             //! Total number of slots reserved so far
-  int                           num_slots_written_;     //! Number of slots physically written so far
-  deque<bool>                   slot_ready_;            //! Which slots are ready for writing?
-  deque<deque<VariantCandidate> >   slot_dropbox_;      //! Slots for variants that are ready for writing
-  pthread_mutex_t               slot_mutex_;            //! Mutex controlling access to the dropbox
-  pthread_mutex_t               write_mutex_;           //! Mutex controlling VCF writing
-  ofstream                      output_vcf_stream_;     //! Main output VCF file
-  ofstream                      filtered_vcf_stream_;   //! Filtered VCF file
+  volatile int                  num_slots_written_;     //! Number of slots physically written so far
+  vector<ReorderSlot>           ring_;                  //! Slots for variants that are ready for writing, by slot modulo capacity
+  pthread_mutex_t               write_mutex_;           //! Held by the worker currently on writing duty
+  AsyncTextWriter               output_vcf_stream_;     //! Main output VCF (or BCF) file
+  AsyncTextWriter               filtered_vcf_stream_;   //! Filtered VCF (or BCF) file
+  string                        output_text_;           //! Formatted records not yet handed to output_vcf_stream_
+  string                        filtered_text_;         //! Formatted records not yet handed to filtered_vcf_stream_
+  NormalizedVCFWriter           normalized_vcf_;        //! Optional sorted and left-aligned copy of the main VCF
+  string                        normalized_text_;       //! VCF text of one record for normalized_vcf_, in BCF mode
+  bool                          output_bcf_;            //! Write BCF2 instead of VCF text
+  BcfHeader                     bcf_header_;            //! Dictionaries for BCF2 records
   bool                          suppress_no_calls_;     //! If false, filtered variants also go to main VCF
   vcf::VariantCallFile          variant_initializer_;   //! Fake writer to initialize new Variant objects
+  int                           num_delayed_slots_;
+  double                        total_reorder_wait_;
+  double                        max_reorder_wait_;
+  int                           num_capacity_stalls_;
+  double                        total_capacity_stall_;
 };
 
 
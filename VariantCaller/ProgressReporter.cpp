@@ -0,0 +1,201 @@
+/* Copyright (C) 2014 Ion Torrent Systems, Inc. All Rights Reserved */
+
+//! @file     ProgressReporter.cpp
+//! @ingroup  VariantCaller
+//! @brief    Periodically rewritten json file with the progress of a running tvc
+
+#include "ProgressReporter.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/time.h>
+#include "json/json.h"
+#include "InputStructures.h"
+#include "ReferenceReader.h"
+#include "TargetsManager.h"
+#include "BAMWalkerEngine.h"
+
+// The finished state is only written once every output file is complete, wrappers may act on it
+static const char *kWorkerStateNames[kNumWorkerStates] = {
+    "starting", "removing_reads", "waiting_for_memory", "loading_reads", "processing_reads",
+    "waiting_for_reads", "generating_candidates", "evaluating", "writing_output", "done" };
+
+static double WallTime()
+{
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return now.tv_sec + 1e-6 * now.tv_usec;
+}
+
+
+ProgressReporter::ProgressReporter()
+{
+  interval_ = 0;
+  vc_ = NULL;
+  worker_states_ = NULL;
+  num_workers_ = 0;
+  num_registered_ = 0;
+  start_time_ = last_time_ = 0;
+  last_reads_ = last_candidates_ = 0;
+  closing_ = false;
+  stopped_ = false;
+  target_idx_ = 0;
+  position_ = reads_loaded_ = reads_in_memory_ = 0;
+  pthread_mutex_init(&mutex_, NULL);
+  pthread_cond_init(&wakeup_, NULL);
+}
+
+ProgressReporter::~ProgressReporter()
+{
+  Finish();
+  delete [] worker_states_;
+  pthread_mutex_destroy(&mutex_);
+  pthread_cond_destroy(&wakeup_);
+}
+
+
+void ProgressReporter::Initialize(const string& filename, int interval, VariantCallerContext& vc, int num_workers)
+{
+  filename_ = filename;
+  interval_ = interval;
+  vc_ = &vc;
+
+  // Fraction of targets done is measured in bases of the merged targets walked so far
+  const vector<MergedTarget>& merged = vc.targets_manager->merged;
+  target_offset_.assign(1, 0);
+  for (vector<MergedTarget>::const_iterator target = merged.begin(); target != merged.end(); ++target)
+    target_offset_.push_back(target_offset_.back() + target->end - target->begin);
+
+  num_workers_ = num_workers;
+  worker_states_ = new int[num_workers_];
+  for (int worker = 0; worker < num_workers_; ++worker)
+    worker_states_[worker] = kWorkerStarting;
+
+  start_time_ = last_time_ = WallTime();
+  closing_ = false;
+  stopped_ = false;
+  WriteProgress("running");
+
+  if (pthread_create(&reporter_thread_, NULL, ProgressReporter::ReporterThread, this)) {
+    cerr << "ERROR: Cannot start progress reporter thread" << endl;
+    exit(1);
+  }
+}
+
+
+volatile int * ProgressReporter::NewWorker()
+{
+  if (not IsOpen())
+    return NULL;
+  int worker = __sync_fetch_and_add(&num_registered_, 1);
+  return worker < num_workers_ ? &worker_states_[worker] : NULL;
+}
+
+
+void * ProgressReporter::ReporterThread(void *input)
+{
+  ProgressReporter& reporter = *static_cast<ProgressReporter*>(input);
+
+  pthread_mutex_lock(&reporter.mutex_);
+  while (not reporter.closing_) {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    struct timespec deadline;
+    deadline.tv_sec = now.tv_sec + reporter.interval_;
+    deadline.tv_nsec = now.tv_usec * 1000;
+    while (not reporter.closing_ and pthread_cond_timedwait(&reporter.wakeup_, &reporter.mutex_, &deadline) != ETIMEDOUT)
+      ;
+    if (reporter.closing_)
+      break;
+    pthread_mutex_unlock(&reporter.mutex_);
+    reporter.WriteProgress("running");
+    pthread_mutex_lock(&reporter.mutex_);
+  }
+  pthread_mutex_unlock(&reporter.mutex_);
+  return NULL;
+}
+
+
+void ProgressReporter::WriteProgress(const char *state)
+{
+  if (not stopped_) {
+    pthread_mutex_lock(&vc_->bam_walker_mutex);
+    vc_->bam_walker->GetProgress(target_idx_, position_, reads_loaded_, reads_in_memory_);
+    pthread_mutex_unlock(&vc_->bam_walker_mutex);
+  }
+  int target_idx = target_idx_;
+  long position = position_, reads_loaded = reads_loaded_, reads_in_memory = reads_in_memory_;
+  long candidates = vc_->candidate_counter;
+  bool finished = (strcmp(state, "finished") == 0);
+
+  // Rates cover the last interval while running, and the whole run once finished
+  if (finished) {
+    last_time_ = start_time_;
+    last_reads_ = last_candidates_ = 0;
+  }
+  double now = WallTime();
+  double elapsed = max(now - last_time_, 1e-3);
+
+  Json::Value json(Json::objectValue);
+  json["state"] = state;
+  json["elapsed_seconds"] = now - start_time_;
+  json["update_interval_seconds"] = interval_;
+
+  const MergedTarget& target = vc_->targets_manager->merged[target_idx];
+  json["contig"] = vc_->ref_reader->chr(target.chr);
+  json["position"] = (Json::Int64)(position + 1);
+  long bases_done = target_offset_[target_idx] + min(max(position - target.begin, 0L), (long)(target.end - target.begin));
+  json["targets_fraction_done"] = finished ? 1.0 : bases_done / (double)max(target_offset_.back(), 1L);
+
+  json["reads_loaded"] = (Json::Int64)reads_loaded;
+  json["reads_in_memory"] = (Json::Int64)reads_in_memory;
+  json["reads_per_second"] = (reads_loaded - last_reads_) / elapsed;
+  json["candidates_generated"] = (Json::Int64)candidates;
+  json["candidates_per_second"] = (candidates - last_candidates_) / elapsed;
+
+  json["threads"] = Json::Value(Json::arrayValue);
+  for (int worker = 0; worker < num_workers_; ++worker)
+    json["threads"][worker] = kWorkerStateNames[worker_states_[worker]];
+
+  last_time_ = now;
+  last_reads_ = reads_loaded;
+  last_candidates_ = candidates;
+
+  // Readers never see a partial file
+  string temp_filename = filename_ + ".tmp";
+  ofstream out(temp_filename.c_str(), ios::out);
+  if (out.good())
+    out << json.toStyledString();
+  out.close();
+  if (out.fail() or rename(temp_filename.c_str(), filename_.c_str()) != 0)
+    cerr << "WARNING: Unable to write progress file " << filename_ << endl;
+}
+
+
+void ProgressReporter::Stop()
+{
+  if (not IsOpen() or stopped_)
+    return;
+  pthread_mutex_lock(&mutex_);
+  closing_ = true;
+  pthread_mutex_unlock(&mutex_);
+  pthread_cond_signal(&wakeup_);
+  pthread_join(reporter_thread_, NULL);
+  WriteProgress("finalizing");
+  stopped_ = true;
+}
+
+
+void ProgressReporter::Finish()
+{
+  if (not IsOpen())
+    return;
+  Stop();
+  WriteProgress("finished");
+  filename_.clear();
+}
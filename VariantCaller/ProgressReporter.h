@@ -0,0 +1,83 @@
+/* Copyright (C) 2014 Ion Torrent Systems, Inc. All Rights Reserved */
+
+//! @file     ProgressReporter.h
+//! @ingroup  VariantCaller
+//! @brief    Periodically rewritten json file with the progress of a running tvc
+
+#ifndef PROGRESSREPORTER_H
+#define PROGRESSREPORTER_H
+
+#include <string>
+#include <vector>
+#include <pthread.h>
+
+using namespace std;
+
+struct VariantCallerContext;
+
+//! What a worker thread is doing, as shown in the progress file
+enum WorkerState {
+  kWorkerStarting = 0,
+  kWorkerRemovingReads,
+  kWorkerWaitingForMemory,
+  kWorkerLoadingReads,
+  kWorkerProcessingReads,
+  kWorkerWaitingForReads,
+  kWorkerGeneratingCandidates,
+  kWorkerEvaluating,
+  kWorkerWritingOutput,
+  kWorkerDone,
+  kNumWorkerStates
+};
+
+// Progress reporting is off when a worker has no state slot
+inline void ReportWorkerState(volatile int *state, WorkerState value) { if (state) *state = value; }
+
+
+class ProgressReporter {
+public:
+  ProgressReporter();
+  ~ProgressReporter();
+
+  //! @brief  Start the thread that rewrites the progress file every interval seconds
+  void Initialize(const string& filename, int interval, VariantCallerContext& vc, int num_workers);
+  bool IsOpen() const { return not filename_.empty(); }
+
+  //! @brief  State slot for a new worker thread, or NULL if progress reporting is off
+  volatile int * NewWorker();
+
+  //! @brief  Stop the reporter thread and write the finalizing state. Workers must be done, and
+  //!         bam_walker_mutex must still exist, as this takes the last read counters.
+  void Stop();
+
+  //! @brief  Write the finished state, once all outputs are complete. Stops the reporter first if needed.
+  void Finish();
+
+private:
+  static void * ReporterThread(void *input);
+  void WriteProgress(const char *state);
+
+  string                    filename_;            //! Progress file, replaced atomically on each update
+  int                       interval_;            //! Seconds between updates
+  VariantCallerContext *    vc_;                  //! Source of the reported state
+  vector<long>              target_offset_;       //! Bases in merged targets before each target, plus the total
+  volatile int *            worker_states_;       //! WorkerState of each worker
+  int                       num_workers_;         //! Size of worker_states_
+  int                       num_registered_;      //! Workers that received a state slot
+  double                    start_time_;          //! Wall time of Initialize
+  double                    last_time_;           //! Wall time of the previous update
+  long                      last_reads_;          //! Reads loaded at the previous update
+  long                      last_candidates_;     //! Candidates generated at the previous update
+  bool                      closing_;             //! Reporter thread should exit
+  bool                      stopped_;             //! Reporter thread is gone, the read counters below are final
+  int                       target_idx_;          //! Read counters of the latest update
+  long                      position_;
+  long                      reads_loaded_;
+  long                      reads_in_memory_;
+  pthread_t                 reporter_thread_;
+  pthread_mutex_t           mutex_;               //! Protects closing_
+  pthread_cond_t            wakeup_;              //! Signals the reporter thread to exit early
+};
+
+
+#endif // PROGRESSREPORTER_H
@@ -171,6 +171,10 @@ void UnpackOnLoad(Alignment *rai, const InputStructures &global_context, const E
     // extract runid while we are at it
     int end_runid = rai->alignment.Name.find(":");
     rai->runid  = rai->alignment.Name.substr(0,end_runid);
+
+    // resolve the HP recalibration model for this read's chip block once, evaluator reuses it for every candidate
+    if (global_context.do_recal.recal_is_live())
+      global_context.do_recal.getAB(rai->recal_ab, global_context.do_recal.RunIndex(rai->runid), rai->well_rowcol[1], rai->well_rowcol[0]);
   }
 
   // Populate read_bases (bases without rev-comp on reverse-mapped reads) and flow_index
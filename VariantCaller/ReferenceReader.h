@@ -2,13 +2,14 @@
 
 //! @file     ReferenceReader.h
 //! @ingroup  VariantCaller
-//! @brief    Memory-mapped reader for fasta+fai reference
+//! @brief    Memory-mapped reader for fasta+fai reference, or for its precompiled binary form
 
 #ifndef REFERENCEREADER_H
 #define REFERENCEREADER_H
 
 #include <vector>
 #include <map>
+#include <algorithm>
 #include <string>
 #include <iostream>
 #include <stdio.h>
@@ -20,50 +21,48 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <stdint.h>
 
 using namespace std;
 
 #define FAST_TO_UPPER(c)  ((c)&0x5F)
 
+//! Binary reference written by "tvcutils prepare_reference" next to the fasta as <fasta>.tvcref:
+//!   magic[8], int64 fasta size, int64 fasta mtime, int32 contig count, int32 reserved,
+//!   per contig: int64 sequence offset, int64 size, int32 name length, name,
+//!   then each contig's sequence as upper-case bases, one byte per base, without line breaks.
+#define BINARY_REFERENCE_MAGIC    "TVCREF1"
+#define BINARY_REFERENCE_SUFFIX   ".tvcref"
+
 class ReferenceReader {
 public:
-  ReferenceReader () : initialized_(false), ref_handle_(0), ref_mmap_(0) {}
+  ReferenceReader () : initialized_(false), is_binary_(false), ref_handle_(0), ref_mmap_(0) {}
   ~ReferenceReader () { Cleanup(); }
 
-  void Initialize(const string& fasta_filename) {
+  //! @brief  Map the reference. The binary form is used when present and newer than the fasta,
+  //!         unless use_binary is false.
+  void Initialize(const string& fasta_filename, bool use_binary = true) {
     Cleanup();
 
-    ref_handle_ = open(fasta_filename.c_str(),O_RDONLY);
-    if (ref_handle_ < 0) {
+    struct stat fasta_stat;
+    if (stat(fasta_filename.c_str(), &fasta_stat) < 0) {
       cerr << "ERROR: Cannot open fasta file " << fasta_filename << " : " << strerror(errno) << endl;
       exit(1);
     }
 
-    fstat(ref_handle_, &ref_stat_);
-    ref_mmap_ = (char *)mmap(0, ref_stat_.st_size, PROT_READ, MAP_SHARED, ref_handle_, 0);
+    if (not use_binary or not InitializeBinary(fasta_filename + BINARY_REFERENCE_SUFFIX, fasta_stat))
+      InitializeFasta(fasta_filename);
 
-    string fai_filename = fasta_filename + ".fai";
-    FILE *fai = fopen(fai_filename.c_str(), "r");
-    if (!fai) {
-      cerr << "ERROR: Cannot open fasta index file " << fai_filename << " : " << strerror(errno) << endl;
-      exit(1);
+    hash_table_.assign(8, -1);
+    while (hash_table_.size() < 2*ref_index_.size())
+      hash_table_.resize(2*hash_table_.size(), -1);
+    // A repeated contig name resolves to its last occurrence, as it did with the name map
+    for (int idx = 0; idx < (int)ref_index_.size(); ++idx) {
+      size_t slot = HashSlot(ref_index_[idx].chr.c_str());
+      while (hash_table_[slot] >= 0 and ref_index_[hash_table_[slot]].chr != ref_index_[idx].chr)
+        slot = (slot + 1) & (hash_table_.size() - 1);
+      hash_table_[slot] = idx;
     }
-
-    char line[1024], chrom_name[1024];
-    while (fgets(line, 1024, fai) != NULL) {
-      Reference ref_entry;
-      long chr_start;
-      if (5 != sscanf(line, "%1020s\t%ld\t%ld\t%d\t%d", chrom_name, &ref_entry.size, &chr_start,
-                      &ref_entry.bases_per_line, &ref_entry.bytes_per_line))
-        continue;
-      ref_entry.chr = chrom_name;
-      ref_entry.start = ref_mmap_ + chr_start;
-      ref_entry.begin_ = ref_entry.iter(0);
-      ref_entry.end_ = ref_entry.iter(ref_entry.size);
-      ref_index_.push_back(ref_entry);
-      ref_map_[ref_entry.chr] = (int) ref_index_.size() - 1;
-    }
-    fclose(fai);
     initialized_ = true;
   }
 
@@ -74,21 +73,21 @@ public:
   char base(int chr_idx, long pos) const { return ref_index_[chr_idx].base(pos); }
   long chr_size(int idx) const { return ref_index_[idx].size; }
 
+  bool is_binary() const { return is_binary_; }
+
   int chr_idx(const char *chr_name) const {
+    int idx = FindChr(chr_name);
+    if (idx >= 0)
+      return idx;
     string string_chr(chr_name);
-    map<string,int>::const_iterator I = ref_map_.find(string_chr);
-    if (I != ref_map_.end())
-      return I->second;
-    I = ref_map_.find("chr"+string_chr);
-    if (I != ref_map_.end())
-      return I->second;
-    if (string_chr == "MT") {
-      I = ref_map_.find("chrM");
-      if (I != ref_map_.end())
-        return I->second;
-    }
+    idx = FindChr(("chr"+string_chr).c_str());
+    if (idx >= 0)
+      return idx;
+    if (string_chr == "MT")
+      return FindChr("chrM");
     return -1;
   }
+  int chr_idx(const string& chr_name) const { return chr_idx(chr_name.c_str()); }
 
 
   class iterator {
@@ -170,23 +169,146 @@ private:
       munmap(ref_mmap_, ref_stat_.st_size);
       close(ref_handle_);
       ref_index_.clear();
-      ref_map_.clear();
+      hash_table_.clear();
       initialized_ = false;
     }
   }
 
+  void MapFile(const string& filename, const char *description) {
+    ref_handle_ = open(filename.c_str(),O_RDONLY);
+    if (ref_handle_ < 0) {
+      cerr << "ERROR: Cannot open " << description << " " << filename << " : " << strerror(errno) << endl;
+      exit(1);
+    }
+    fstat(ref_handle_, &ref_stat_);
+    ref_mmap_ = (char *)mmap(0, ref_stat_.st_size, PROT_READ, MAP_SHARED, ref_handle_, 0);
+    if (ref_mmap_ == MAP_FAILED) {
+      cerr << "ERROR: Cannot map " << description << " " << filename << " : " << strerror(errno) << endl;
+      exit(1);
+    }
+  }
+
+  void InitializeFasta(const string& fasta_filename) {
+    MapFile(fasta_filename, "fasta file");
+    is_binary_ = false;
+
+    string fai_filename = fasta_filename + ".fai";
+    FILE *fai = fopen(fai_filename.c_str(), "r");
+    if (!fai) {
+      cerr << "ERROR: Cannot open fasta index file " << fai_filename << " : " << strerror(errno) << endl;
+      exit(1);
+    }
+
+    char line[1024], chrom_name[1024];
+    while (fgets(line, 1024, fai) != NULL) {
+      Reference ref_entry;
+      long chr_start;
+      if (5 != sscanf(line, "%1020s\t%ld\t%ld\t%d\t%d", chrom_name, &ref_entry.size, &chr_start,
+                      &ref_entry.bases_per_line, &ref_entry.bytes_per_line))
+        continue;
+      ref_entry.chr = chrom_name;
+      ref_entry.start = ref_mmap_ + chr_start;
+      ref_entry.flat = false;
+      ref_entry.begin_ = ref_entry.iter(0);
+      ref_entry.end_ = ref_entry.iter(ref_entry.size);
+      ref_index_.push_back(ref_entry);
+    }
+    fclose(fai);
+  }
+
+  // Returns false, leaving nothing mapped, if the file is absent or does not match the fasta
+  bool InitializeBinary(const string& binary_filename, const struct stat& fasta_stat) {
+    struct stat binary_stat;
+    if (stat(binary_filename.c_str(), &binary_stat) < 0)
+      return false;
+    if (binary_stat.st_size < 32) {
+      cerr << "WARNING: Binary reference " << binary_filename << " is truncated and is ignored" << endl;
+      return false;
+    }
+    MapFile(binary_filename, "binary reference");
+    is_binary_ = true;
+
+    const char *header = ref_mmap_;
+    const char *header_end = ref_mmap_ + ref_stat_.st_size;
+    int64_t fasta_size = 0, fasta_mtime = 0;
+    int32_t chr_count = 0;
+    bool valid = header + 32 <= header_end and memcmp(header, BINARY_REFERENCE_MAGIC, 8) == 0;
+    if (valid) {
+      memcpy(&fasta_size, header + 8, 8);
+      memcpy(&fasta_mtime, header + 16, 8);
+      memcpy(&chr_count, header + 24, 4);
+      header += 32;
+      valid = fasta_size == (int64_t)fasta_stat.st_size and fasta_mtime == (int64_t)fasta_stat.st_mtime;
+    }
+
+    for (int idx = 0; valid and idx < chr_count; ++idx) {
+      int64_t offset = 0, size = 0;
+      int32_t name_length = 0;
+      if (header + 20 > header_end) {
+        valid = false;
+        break;
+      }
+      memcpy(&offset, header, 8);
+      memcpy(&size, header + 8, 8);
+      memcpy(&name_length, header + 16, 4);
+      header += 20;
+      if (name_length <= 0 or header + name_length > header_end or offset < 0 or offset + size > ref_stat_.st_size) {
+        valid = false;
+        break;
+      }
+      Reference ref_entry;
+      ref_entry.chr.assign(header, name_length);
+      header += name_length;
+      ref_entry.size = size;
+      ref_entry.start = ref_mmap_ + offset;
+      ref_entry.bases_per_line = max(size, (int64_t)1);
+      ref_entry.bytes_per_line = ref_entry.bases_per_line;
+      ref_entry.flat = true;
+      ref_entry.begin_ = ref_entry.iter(0);
+      ref_entry.end_ = ref_entry.iter(ref_entry.size);
+      ref_index_.push_back(ref_entry);
+    }
+
+    if (not valid) {
+      cerr << "WARNING: Binary reference " << binary_filename << " does not match the fasta file and is ignored" << endl;
+      munmap(ref_mmap_, ref_stat_.st_size);
+      close(ref_handle_);
+      ref_index_.clear();
+    }
+    return valid;
+  }
+
+  size_t HashSlot(const char *name) const {
+    size_t hash = 2166136261u;      // FNV-1a
+    for (; *name; ++name)
+      hash = (hash ^ (unsigned char)*name) * 16777619u;
+    return hash & (hash_table_.size() - 1);
+  }
+
+  int FindChr(const char *name) const {
+    if (hash_table_.empty())
+      return -1;
+    for (size_t slot = HashSlot(name); hash_table_[slot] >= 0; slot = (slot + 1) & (hash_table_.size() - 1))
+      if (strcmp(ref_index_[hash_table_[slot]].chr.c_str(), name) == 0)
+        return hash_table_[slot];
+    return -1;
+  }
+
   struct Reference {
     string            chr;
     long              size;
     const char *      start;
     int               bases_per_line;
     int               bytes_per_line;
+    bool              flat;           //! Binary reference: upper-case bases without line breaks
     iterator          begin_;
     iterator          end_;
 
     char base(long pos) const {
       if (pos < 0 or pos >= size)
         return 'N';
+      if (flat)
+        return start[pos];
       long ref_line_idx = pos / bases_per_line;
       long ref_line_pos = pos % bases_per_line;
       return toupper(start[ref_line_idx*bytes_per_line + ref_line_pos]);
@@ -208,11 +330,12 @@ private:
 
 
   bool                initialized_;
+  bool                is_binary_;
   int                 ref_handle_;
   struct stat         ref_stat_;
   char *              ref_mmap_;
   vector<Reference>   ref_index_;
-  map<string,int>     ref_map_;
+  vector<int>         hash_table_;    //! Open-addressing contig name table, power-of-two size
 
 };
 
@@ -52,17 +52,75 @@ void TIonMotifSet::add_motif(string motif, const TMetaData &mdata) {
 
 
 //-----------------------------------------------------
-unsigned TIonMotifSet::make_hashkey(string motif) const {
-  unsigned hashKey = 1;
-  for (unsigned i = 0;i < motif.length(); i++) {
-    hashKey <<= 2;
-    switch (motif[i]) {
-      case 'C': hashKey|=1; break;
-      case 'G': hashKey|=2; break;
-      case 'T': hashKey|=3; break;
+void TIonMotif::add(const string &motif, const TMetaData &mdata) {
+  int node = 0;
+  for (unsigned i = 0; i < motif.length(); i++) {
+    int code = base_code(motif[i]);
+    if (nodes[node].next[code] < 0) {
+      nodes[node].next[code] = nodes.size();
+      nodes.push_back(TNode(nodes[node].length + 1));
+    }
+    node = nodes[node].next[code];
+  }
+
+  if (!nodes[node].is_motif) {
+    nodes[node].is_motif = true;
+    nodes[node].mdata = mdata;
+  } else if (nodes[node].mdata.calculate_probability() > mdata.calculate_probability())
+    nodes[node].mdata = mdata;
+}
+
+
+//-----------------------------------------------------
+void TIonMotif::compile() {
+  // Breadth-first, so a node's failure target is final before the node is visited
+  vector<int> queue;
+  queue.reserve(nodes.size());
+  for (int code = 0; code < 4; code++) {
+    int child = nodes[0].next[code];
+    if (child < 0)
+      nodes[0].next[code] = 0;
+    else {
+      nodes[child].fail = 0;
+      queue.push_back(child);
+    }
+  }
+
+  for (unsigned head = 0; head < queue.size(); head++) {
+    int node = queue[head];
+    int fail = nodes[node].fail;
+    nodes[node].dict_link = nodes[fail].is_motif ? fail : nodes[fail].dict_link;
+    for (int code = 0; code < 4; code++) {
+      int child = nodes[node].next[code];
+      if (child < 0)
+        nodes[node].next[code] = nodes[fail].next[code];
+      else {
+        nodes[child].fail = nodes[fail].next[code];
+        queue.push_back(child);
+      }
     }
   }
-  return hashKey;
+}
+
+
+//-----------------------------------------------------
+float TIonMotif::max_probability(const char *prefix, int prefix_length, const char *suffix, int suffix_length) const {
+  float weight = 0;
+  int node = 0;
+  for (int i = 0; i < prefix_length; i++)
+    node = nodes[node].next[base_code(prefix[i])];
+
+  // Every match ending from the placeholder on must start at or before it
+  for (int end = prefix_length + 1; end <= prefix_length + 1 + suffix_length; end++) {
+    node = nodes[node].next[end == prefix_length + 1 ? 0 : base_code(suffix[end - prefix_length - 2])];
+    for (int match = nodes[node].is_motif ? node : nodes[node].dict_link;
+         match >= 0 and nodes[match].length >= end - prefix_length; match = nodes[match].dict_link) {
+      float tmp_weight = nodes[match].mdata.calculate_probability();
+      if (tmp_weight > weight)
+        weight = tmp_weight;
+    }
+  }
+  return weight;
 }
 
 
@@ -77,7 +135,7 @@ void TIonMotifSet::add_my_motif(short key, string motif, const TMetaData &mdata,
       return;
     }
   //cout << key << "-" << motif << " " << mdata->covered_sse << " " << mdata->covered_nonsse << endl;
-  motif_table.at(key).add(make_hashkey(motif), mdata);
+  motif_table.at(key).add(motif, mdata);
 }
 
 
@@ -127,9 +185,11 @@ void TIonMotifSet::load_from_file(const char * fname) {
 
   infile.close();
 
+  for (unsigned key = 0; key < motif_table.size(); key++)
+    motif_table[key].compile();
 }
 //-----------------------------------------------------
-float TIonMotifSet::get_sse_probability(string context, unsigned err_base_pos) const {
+float TIonMotifSet::get_sse_probability(const string &context, unsigned err_base_pos) const {
 
   if (err_base_pos >= context.length()) {
     cout << "TIonMotifSet::get_sse_probability() position is out of context. context='" << context << "' pos=" << err_base_pos << endl;
@@ -153,23 +213,12 @@ float TIonMotifSet::get_sse_probability(string context, unsigned err_base_pos) c
     unsigned left_size = motif_table.at(key).left_size;
     unsigned right_size = motif_table.at(key).right_size;
 
-    string prefix = i < 0 ? "" : context.substr(0, i + 1);
-    string suffix = j >= (int)context.length() ? "" : context.substr(j);
-
-    if (prefix.length() > left_size)
-      prefix = prefix.substr(prefix.length() - left_size);
-    if (suffix.length() > right_size)
-      suffix = suffix.substr(0, right_size);
-    //cout << prefix << " " << (char) context[err_base_pos] << hpLen << " " << suffix << endl;
-
-    TMetaData md(0, 0);
-    for (i = 0;i <= (int)prefix.length();i++)
-      for (j = 0;j <= (int)suffix.length();j++)
-        if (motif_table.at(key).has_hashkey(make_hashkey((i < (int)prefix.length() ? prefix.substr(i) : "") + "|" + (j > 0 ? suffix.substr(0, j) : "")), md)) {
-          float tmp_weight = md.calculate_probability();
-          if (tmp_weight > weight)
-            weight = tmp_weight;
-        }
+    // Up to left_size bases before the homopolymer and right_size bases after it
+    int prefix_length = min(i + 1, (int)left_size);
+    int suffix_length = j >= (int)context.length() ? 0 : min((int)context.length() - j, (int)right_size);
+
+    weight = motif_table.at(key).max_probability(context.data() + i + 1 - prefix_length, prefix_length,
+        context.data() + j, suffix_length);
   }
   return weight;
 }
@@ -48,42 +48,53 @@ struct TMetaData
 };
 
 //-----------------------------------------------------
+// All motifs of one homopolymer key, as an Aho-Corasick automaton over {A,C,G,T}.
+// A motif is its prefix, one placeholder base for the homopolymer, and its suffix;
+// the placeholder and any base other than C, G or T are stored as A.
 class TIonMotif
 {
-
-  map <unsigned, TMetaData> motif_list;
+  struct TNode {
+    int       next[4];        // Goto transitions, completed into a full DFA by compile()
+    int       fail;           // Longest proper suffix that is also a trie node
+    int       dict_link;      // Longest proper suffix that ends a motif, -1 if none
+    int       length;         // Depth in the trie
+    bool      is_motif;
+    TMetaData mdata;
+    TNode(int len) : fail(0), dict_link(-1), length(len), is_motif(false), mdata(0,0) {
+      next[0] = next[1] = next[2] = next[3] = -1;
+    }
+  };
+
+  vector<TNode> nodes;
 
   public:
     short left_size;
     short right_size;
 
-    TIonMotif(){ left_size = 0; right_size = 0; };
-
-    inline void add(unsigned hashKey, const TMetaData &mdata) {
-      map <unsigned, TMetaData>::iterator itr;
-      itr = motif_list.find(hashKey);
-
-      if (itr == motif_list.end())
-        motif_list.insert(make_pair(hashKey, mdata));
-      else if (itr->second.calculate_probability() > mdata.calculate_probability())
-        motif_list.at(hashKey) = mdata;
-     };
-
-     inline bool has_hashkey(unsigned hashKey, TMetaData &md) const {
-       map <unsigned, TMetaData>::const_iterator itr;
-       itr = motif_list.find(hashKey);
-
-       if (itr == motif_list.end())
-         return false;
-       else {
-         md = itr->second;
-         return true;
-       }
-     };
-
-     inline bool isEmpty() const {
-       return (motif_list.size()==0);
-     };
+    TIonMotif(){ left_size = 0; right_size = 0; nodes.push_back(TNode(0)); };
+
+    static inline int base_code(char base) {
+      switch (base) {
+        case 'C': return 1;
+        case 'G': return 2;
+        case 'T': return 3;
+      }
+      return 0;
+    };
+
+    //! Add a motif without wildcards; a repeated motif keeps the lower probability
+    void add(const string &motif, const TMetaData &mdata);
+
+    //! Build failure and dictionary links; call after the last add()
+    void compile();
+
+    //! Highest probability among motifs that occur in prefix + placeholder + suffix
+    //! covering the placeholder, or 0 if there are none
+    float max_probability(const char *prefix, int prefix_length, const char *suffix, int suffix_length) const;
+
+    inline bool isEmpty() const {
+      return nodes.size() == 1;
+    };
 };
 
 //-----------------------------------------------------
@@ -104,9 +115,8 @@ class TIonMotifSet
     void     load_from_file(const char * fname);
     void     add_motif(string motif, const TMetaData &mdata);
     short    get_key(char hpChar, int hpSize) const;
-    unsigned make_hashkey(string motif) const;
 
-    float    get_sse_probability(string context, unsigned err_base_pos) const;
+    float    get_sse_probability(const string &context, unsigned err_base_pos) const;
 
     inline bool isEmpty() { return isempty; };
 };
@@ -395,7 +395,8 @@ string SpliceDoRealignement (PersistingThreadObjects &thread_objects, const Alig
 		                     bool &changed_alignment, int DEBUG, const ReferenceReader &ref_reader, int chr_idx) {
 
   // We do not allow any clipping since we align a short substring
-  thread_objects.realigner.SetClipping(0, true);
+  const static int kClipping = 0;
+  thread_objects.realigner.SetClipping(kClipping, true);
   string new_alignment;
 
 
@@ -497,10 +498,24 @@ string SpliceDoRealignement (PersistingThreadObjects &thread_objects, const Alig
   }
 
   string old_alignment = current_read.pretty_aln.substr(pretty_left, pretty_right-pretty_left);
-  thread_objects.realigner.SetSequences(current_read.alignment.QueryBases.substr(read_left, read_right-read_left),
-                         ref_reader.substr(chr_idx, ref_left, ref_right-ref_left), old_alignment, true);
+  string query_window  = current_read.alignment.QueryBases.substr(read_left, read_right-read_left);
+  string ref_window    = ref_reader.substr(chr_idx, ref_left, ref_right-ref_left);
+  string realigned;
+  bool   success = false;
+
+  // Identical windows recur for reads sharing an amplicon start; bypass the cache when debug output is requested
+  bool use_cache = (DEBUG <= 1);
+  if (not use_cache or not thread_objects.realignment_cache.Find(query_window, ref_window, old_alignment,
+                                                                 kClipping, true, success, realigned)) {
+    thread_objects.realigner.SetSequences(query_window, ref_window, old_alignment, true);
+    success = thread_objects.realigner.computeSWalignment(new_cigar_data, new_md_data, start_position_shift);
+    if (success)
+      realigned = thread_objects.realigner.pretty_aln();
+    if (use_cache)
+      thread_objects.realignment_cache.Insert(query_window, ref_window, old_alignment, kClipping, true, success, realigned);
+  }
 
-  if (!thread_objects.realigner.computeSWalignment(new_cigar_data, new_md_data, start_position_shift)) {
+  if (!success) {
     if (DEBUG > 1)
       cout << "ERROR: realignment failed! " << endl;
     return new_alignment;
@@ -508,11 +523,11 @@ string SpliceDoRealignement (PersistingThreadObjects &thread_objects, const Alig
 
   // --- Fuse realigned partial sequence back into pretty_aln string
   new_alignment = current_read.pretty_aln;
-  if (old_alignment == thread_objects.realigner.pretty_aln()) {
+  if (old_alignment == realigned) {
     changed_alignment = false;
   }
   else {
-    new_alignment.replace(pretty_left, (pretty_right-pretty_left), thread_objects.realigner.pretty_aln());
+    new_alignment.replace(pretty_left, (pretty_right-pretty_left), realigned);
     changed_alignment = true;
   }
   return new_alignment;
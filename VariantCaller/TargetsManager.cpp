@@ -95,6 +95,8 @@ void TargetsManager::Initialize(const ReferenceReader& ref_reader, const ExtendP
 
 
 
+  BuildIntervalIndex(ref_reader.chr_count());
+
   //
   // Step 3. Merge targets and link merged/unmerged entries
   //
@@ -248,7 +250,102 @@ void TargetsManager::AddExtraTrim(UnmergedTarget& target, char *line, int num_fi
 }
 
 
-void TargetsManager::TrimAmpliseqPrimers(Alignment *rai, int unmerged_target_hint) const
+// Interval index after H. Li's cgranges: each contig's sorted slice of unmerged is an implicit
+// binary tree, so the index is a single array of subtree maxima and needs no pointers.
+void TargetsManager::BuildIntervalIndex(int chr_count)
+{
+  chr_first_unmerged_.assign(chr_count+1, (int)unmerged.size());
+  chr_root_level_.assign(chr_count, -1);
+  subtree_end_.assign(unmerged.size(), 0);
+
+  for (int idx = (int)unmerged.size()-1; idx >= 0; --idx)
+    chr_first_unmerged_[unmerged[idx].chr] = idx;
+  for (int chr = chr_count-1; chr >= 0; --chr)
+    chr_first_unmerged_[chr] = min(chr_first_unmerged_[chr], chr_first_unmerged_[chr+1]);
+
+  for (int chr = 0; chr < chr_count; ++chr) {
+    int first = chr_first_unmerged_[chr];
+    int size = chr_first_unmerged_[chr+1] - first;
+    if (size <= 0)
+      continue;
+    const UnmergedTarget *target = &unmerged[first];
+    int *max_end = &subtree_end_[first];
+
+    // Leaves, then each level up. last_node/last_end track the subtree holding the final target,
+    // whose parent may lie beyond the end of the slice.
+    int last_node = 0, last_end = 0;
+    for (int idx = 0; idx < size; idx += 2) {
+      last_node = idx;
+      last_end = max_end[idx] = target[idx].end;
+    }
+    int level = 1;
+    for (; (1 << level) <= size; ++level) {
+      int half = 1 << (level-1);
+      for (int idx = 2*half - 1; idx < size; idx += 4*half) {
+        int left_end = max_end[idx - half];
+        int right_end = idx + half < size ? max_end[idx + half] : last_end;
+        max_end[idx] = max(target[idx].end, max(left_end, right_end));
+      }
+      last_node = (last_node >> level & 1) ? last_node - half : last_node + half;
+      if (last_node < size)
+        last_end = max(last_end, max_end[last_node]);
+    }
+    chr_root_level_[chr] = level - 1;
+  }
+}
+
+
+void TargetsManager::FindOverlappingTargets(int chr, int begin, int end, vector<int>& overlaps) const
+{
+  overlaps.clear();
+  if (chr < 0 or chr >= (int)chr_root_level_.size() or chr_root_level_[chr] < 0)
+    return;
+
+  int first = chr_first_unmerged_[chr];
+  int size = chr_first_unmerged_[chr+1] - first;
+  const UnmergedTarget *target = &unmerged[first];
+  const int *max_end = &subtree_end_[first];
+
+  // Depth-first, left subtree before node before right subtree, so overlaps come out sorted
+  struct { int node, level; bool left_done; } stack[64];
+  int depth = 0;
+  stack[depth].node = (1 << chr_root_level_[chr]) - 1;
+  stack[depth].level = chr_root_level_[chr];
+  stack[depth++].left_done = false;
+
+  while (depth) {
+    int node = stack[--depth].node;
+    int level = stack[depth].level;
+
+    if (level <= 3) {
+      // Small subtree: scan it linearly
+      int scan_begin = node >> level << level;
+      int scan_end = min(scan_begin + (1 << (level+1)) - 1, size);
+      for (int idx = scan_begin; idx < scan_end and target[idx].begin < end; ++idx)
+        if (begin < target[idx].end)
+          overlaps.push_back(first + idx);
+
+    } else if (not stack[depth].left_done) {
+      int left = node - (1 << (level-1));
+      stack[depth++].left_done = true;
+      if (left >= size or max_end[left] > begin) {
+        stack[depth].node = left;
+        stack[depth].level = level - 1;
+        stack[depth++].left_done = false;
+      }
+
+    } else if (node < size and target[node].begin < end) {
+      if (begin < target[node].end)
+        overlaps.push_back(first + node);
+      stack[depth].node = node + (1 << (level-1));
+      stack[depth].level = level - 1;
+      stack[depth++].left_done = false;
+    }
+  }
+}
+
+
+void TargetsManager::TrimAmpliseqPrimers(Alignment *rai) const
 {
   // set these before any trimming
   rai->align_start = rai->alignment.Position;
@@ -257,16 +354,11 @@ void TargetsManager::TrimAmpliseqPrimers(Alignment *rai, int unmerged_target_hin
   if (not trim_ampliseq_primers)
     return;
 
-  // Step 1: Find the first potential target region
+  // Step 1: Find the target regions the read overlaps
 
-  int target_idx = unmerged_target_hint;
-  while (target_idx and (rai->alignment.RefID < unmerged[target_idx].chr or
-          (rai->alignment.RefID == unmerged[target_idx].chr and rai->alignment.Position < unmerged[target_idx].end)))
-    --target_idx;
-
-  while (target_idx < (int)unmerged.size() and (rai->alignment.RefID > unmerged[target_idx].chr or
-          (rai->alignment.RefID == unmerged[target_idx].chr and rai->alignment.Position >= unmerged[target_idx].end)))
-    ++target_idx;
+  vector<int> candidates;
+  candidates.reserve(8);
+  FindOverlappingTargets(rai->alignment.RefID, rai->alignment.Position, rai->end, candidates);
 
 
   // Step 2: Iterate over potential target regions, evaluate fit, pick the best fit
@@ -275,8 +367,9 @@ void TargetsManager::TrimAmpliseqPrimers(Alignment *rai, int unmerged_target_hin
   int best_fit_penalty = 100;
   int best_overlap = 0;
 
-  while (target_idx < (int)unmerged.size() and rai->alignment.RefID == unmerged[target_idx].chr and rai->end >= unmerged[target_idx].begin) {
+  for (vector<int>::const_iterator candidate = candidates.begin(); candidate != candidates.end(); ++candidate) {
 
+    int target_idx = *candidate;
     int read_start = rai->alignment.Position;
     int read_end = rai->end;
     int read_prefix_size = unmerged[target_idx].begin - read_start;
@@ -303,8 +396,6 @@ void TargetsManager::TrimAmpliseqPrimers(Alignment *rai, int unmerged_target_hin
       best_target_idx = target_idx;
       best_overlap = overlap;
     }
-
-    ++target_idx;
   }
 
   if (best_target_idx == -1) {
@@ -318,7 +409,7 @@ void TargetsManager::TrimAmpliseqPrimers(Alignment *rai, int unmerged_target_hin
   //
   // For now, only adjust Position and Cigar.
   // Later, also adjust MD tag.
-  // Even later, ensure the reads stay sorted, so no extra sorting is required outside of tvc
+  // Position only moves forward; BAMWalkerEngine relies on this to write the reads back sorted.
 
   vector<CigarOp>& old_cigar = rai->alignment.CigarData;
   vector<CigarOp> new_cigar;
@@ -44,12 +44,24 @@ public:
 
   void LoadRawTargets(const ReferenceReader& ref_reader, const string& bed_filename, list<UnmergedTarget>& raw_targets);
   void AddExtraTrim(UnmergedTarget& target, char *region_name, int num_fields);
-  void TrimAmpliseqPrimers(Alignment *rai, int unmerged_target_hint) const;
+  void TrimAmpliseqPrimers(Alignment *rai) const;
+
+  //! @brief  Indices of unmerged targets on chr overlapping [begin,end), in ascending order.
+  //!         Safe to call from several threads at once.
+  void FindOverlappingTargets(int chr, int begin, int end, vector<int>& overlaps) const;
 
   vector<UnmergedTarget>  unmerged;
   vector<MergedTarget>    merged;
   bool  trim_ampliseq_primers;
 
+private:
+  void BuildIntervalIndex(int chr_count);
+
+  // Implicit interval tree over each contig's slice of unmerged: node idx at level k has its
+  // children at idx -/+ 2^(k-1), and subtree_end[idx] is the largest end in its subtree
+  vector<int>   chr_first_unmerged_;    //! Slice of unmerged for each contig, chr_count+1 entries
+  vector<int>   chr_root_level_;        //! Level of the root node for each contig, -1 if no targets
+  vector<int>   subtree_end_;           //! Per unmerged target, the largest end in its subtree
 };
 
 
@@ -0,0 +1,209 @@
+/* Copyright (C) 2014 Ion Torrent Systems, Inc. All Rights Reserved */
+
+//! @file     TraceWriter.cpp
+//! @ingroup  VariantCaller
+//! @brief    Per-thread timeline of worker activity in Chrome trace-event format
+
+#include "TraceWriter.h"
+
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "ReferenceReader.h"
+
+
+const double TraceBuffer::kFlushInterval = 1e6;
+
+TraceBuffer::TraceBuffer(TraceWriter& writer, int thread_id)
+  : writer_(writer), thread_id_(thread_id)
+{
+  events_.reserve(kCapacity);
+  last_flush_ = Now();
+}
+
+
+double TraceBuffer::Now() const
+{
+  return writer_.Now();
+}
+
+
+TraceEvent& TraceBuffer::Push(char phase, const char *name, double start)
+{
+  events_.push_back(TraceEvent());
+  TraceEvent& event = events_.back();
+  event.phase = phase;
+  event.name = name;
+  event.start = start;
+  event.duration = 0;
+  event.chr = -1;
+  event.pos = -1;
+  event.count_name = NULL;
+  event.count = 0;
+  return event;
+}
+
+
+void TraceBuffer::Add(const char *name, double start, int chr, long pos, const char *count_name, long count)
+{
+  double now = Now();
+  TraceEvent& event = Push('X', name, start);
+  event.duration = now - start;
+  event.chr = chr;
+  event.pos = pos;
+  event.count_name = count_name;
+  event.count = count;
+  FlushIfDue(now);
+}
+
+
+void TraceBuffer::Begin(const char *name, int chr, long pos)
+{
+  double now = Now();
+  TraceEvent& event = Push('B', name, now);
+  event.chr = chr;
+  event.pos = pos;
+  FlushIfDue(now);
+}
+
+
+void TraceBuffer::End(const char *name, const char *count_name, long count)
+{
+  double now = Now();
+  TraceEvent& event = Push('E', name, now);
+  event.count_name = count_name;
+  event.count = count;
+  FlushIfDue(now);
+}
+
+
+void TraceBuffer::FlushIfDue(double now)
+{
+  if (events_.size() >= (unsigned int)kCapacity or now - last_flush_ >= kFlushInterval)
+    Flush();
+}
+
+
+void TraceBuffer::Flush()
+{
+  if (events_.empty())
+    return;
+  writer_.Write(thread_id_, events_);
+  events_.clear();
+  last_flush_ = Now();
+}
+
+// -------------------------------------------------------------------
+
+TraceWriter::TraceWriter()
+{
+  output_ = NULL;
+  ref_reader_ = NULL;
+  first_event_ = true;
+  origin_.tv_sec = 0;
+  origin_.tv_nsec = 0;
+  pthread_mutex_init(&mutex_, NULL);
+}
+
+TraceWriter::~TraceWriter()
+{
+  Close();
+  pthread_mutex_destroy(&mutex_);
+}
+
+
+void TraceWriter::Initialize(const string& filename, const ReferenceReader& ref_reader)
+{
+  output_ = fopen(filename.c_str(), "w");
+  if (not output_) {
+    cerr << "ERROR: Cannot open trace file " << filename << " : " << strerror(errno) << endl;
+    exit(1);
+  }
+  ref_reader_ = &ref_reader;
+  clock_gettime(CLOCK_MONOTONIC, &origin_);
+  fprintf(output_, "[\n");
+  first_event_ = true;
+}
+
+
+double TraceWriter::Now() const
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - origin_.tv_sec) * 1e6 + (now.tv_nsec - origin_.tv_nsec) * 1e-3;
+}
+
+
+TraceBuffer * TraceWriter::NewBuffer(const string& thread_name)
+{
+  if (not output_)
+    return NULL;
+  pthread_mutex_lock(&mutex_);
+  int thread_id = buffers_.size() + 1;
+  buffers_.push_back(new TraceBuffer(*this, thread_id));
+  fprintf(output_, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s %d\"}}",
+      first_event_ ? "" : ",\n", thread_id, thread_name.c_str(), thread_id);
+  fflush(output_);
+  first_event_ = false;
+  TraceBuffer *buffer = buffers_.back();
+  pthread_mutex_unlock(&mutex_);
+  return buffer;
+}
+
+
+void TraceWriter::Write(int thread_id, const vector<TraceEvent>& events)
+{
+  // Format outside the lock, the other threads keep going meanwhile
+  string text;
+  text.reserve(events.size() * 128);
+  char line[512];
+  for (vector<TraceEvent>::const_iterator event = events.begin(); event != events.end(); ++event) {
+    int length = snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":1,\"tid\":%d,\"ts\":%.1f,",
+        event->name, event->phase, thread_id, event->start);
+    text.append(line, length);
+    if (event->phase == 'X') {
+      length = snprintf(line, sizeof(line), "\"dur\":%.1f,", event->duration);
+      text.append(line, length);
+    }
+    text += "\"args\":{";
+    const char *separator = "";
+    if (event->chr >= 0) {
+      length = snprintf(line, sizeof(line), ":%ld\"", event->pos + 1);
+      text += "\"position\":\"";
+      text += ref_reader_->chr(event->chr);
+      text.append(line, length);
+      separator = ",";
+    }
+    if (event->count_name) {
+      length = snprintf(line, sizeof(line), "%s\"%s\":%ld", separator, event->count_name, event->count);
+      text.append(line, length);
+    }
+    text += "}}";
+  }
+
+  pthread_mutex_lock(&mutex_);
+  if (output_) {
+    // Metadata events always come first, so the leading separator is never out of place
+    // Flushed right away, a killed run loses nothing it already handed over
+    fwrite(text.data(), 1, text.size(), output_);
+    fflush(output_);
+    first_event_ = false;
+  }
+  pthread_mutex_unlock(&mutex_);
+}
+
+
+void TraceWriter::Close()
+{
+  if (not output_)
+    return;
+  for (vector<TraceBuffer*>::iterator buffer = buffers_.begin(); buffer != buffers_.end(); ++buffer) {
+    (*buffer)->Flush();
+    delete *buffer;
+  }
+  buffers_.clear();
+  fprintf(output_, "\n]\n");
+  fclose(output_);
+  output_ = NULL;
+}
@@ -0,0 +1,125 @@
+/* Copyright (C) 2014 Ion Torrent Systems, Inc. All Rights Reserved */
+
+//! @file     TraceWriter.h
+//! @ingroup  VariantCaller
+//! @brief    Per-thread timeline of worker activity in Chrome trace-event format
+
+#ifndef TRACEWRITER_H
+#define TRACEWRITER_H
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <time.h>
+
+using namespace std;
+
+class ReferenceReader;
+class TraceWriter;
+
+// The file is a JSON array of trace events, one thread track per worker, as read by chrome://tracing,
+// Perfetto and speedscope. Short stages are complete ("ph":"X") events written when they end. Variant
+// evaluation is a begin/end ("ph":"B"/"E") pair. Buffers are written when full or when an event arrives
+// a second after their previous write, so each thread's track trails its work by about a second while
+// the thread makes progress. A thread stuck on a variant shows as an open slice if its begin event was
+// written, otherwise as a track that stops within a second before the stuck variant.
+// Viewers accept the array without its closing bracket, so the trace of a killed run is still usable.
+
+struct TraceEvent {
+  char              phase;            //! 'X' complete, 'B' begin or 'E' end
+  const char *      name;             //! Static event name
+  double            start;            //! Microseconds since the trace was opened
+  double            duration;         //! Microseconds, complete events only
+  int               chr;              //! Reference position the event refers to, or -1
+  long              pos;              //! 0-based
+  const char *      count_name;       //! Static name of the count argument, or NULL
+  long              count;
+};
+
+
+//! @brief  Events of one thread. Written out when full or stale, so memory stays bounded on long runs.
+class TraceBuffer {
+public:
+  TraceBuffer(TraceWriter& writer, int thread_id);
+
+  double Now() const;
+
+  //! Record an event that began at start, as returned by Now()
+  void Add(const char *name, double start, int chr = -1, long pos = -1, const char *count_name = NULL, long count = 0);
+
+  //! Open a stage, closed by the next End
+  void Begin(const char *name, int chr = -1, long pos = -1);
+
+  //! Close the stage opened by the latest Begin
+  void End(const char *name, const char *count_name = NULL, long count = 0);
+
+  void Flush();
+
+private:
+  static const int kCapacity = 8192;
+  static const double kFlushInterval;   //! Microseconds a buffered event may wait for the file
+
+  TraceEvent& Push(char phase, const char *name, double start);
+  void FlushIfDue(double now);   //! Flush when full or stale
+
+  TraceWriter&              writer_;
+  int                       thread_id_;
+  vector<TraceEvent>        events_;
+  double                    last_flush_;      //! Now() of the previous write
+};
+
+// Tracing is off when a thread has no buffer; these keep the call sites free of checks
+
+inline double TraceStart(TraceBuffer *trace) { return trace ? trace->Now() : 0; }
+
+inline void TraceEnd(TraceBuffer *trace, const char *name, double start, int chr = -1, long pos = -1,
+    const char *count_name = NULL, long count = 0)
+{
+  if (trace)
+    trace->Add(name, start, chr, pos, count_name, count);
+}
+
+inline void TraceBegin(TraceBuffer *trace, const char *name, int chr = -1, long pos = -1)
+{
+  if (trace)
+    trace->Begin(name, chr, pos);
+}
+
+inline void TraceFinish(TraceBuffer *trace, const char *name, const char *count_name = NULL, long count = 0)
+{
+  if (trace)
+    trace->End(name, count_name, count);
+}
+
+
+class TraceWriter {
+public:
+  TraceWriter();
+  ~TraceWriter();
+
+  void Initialize(const string& filename, const ReferenceReader& ref_reader);
+  bool IsOpen() const { return output_ != NULL; }
+
+  //! @brief  Buffer for a new thread track named thread_name and its number, or NULL if tracing is off. Owned by the writer.
+  TraceBuffer * NewBuffer(const string& thread_name);
+
+  //! @brief  Flush all buffers and close the file. Threads must be done adding events.
+  void Close();
+
+  double Now() const;
+
+private:
+  friend class TraceBuffer;
+  void Write(int thread_id, const vector<TraceEvent>& events);
+
+  FILE *                    output_;          //! Trace file
+  const ReferenceReader *   ref_reader_;      //! Resolves chromosome names of event positions
+  struct timespec           origin_;          //! Time zero of the trace
+  vector<TraceBuffer*>      buffers_;         //! One per thread track
+  pthread_mutex_t           mutex_;           //! Protects output_ and buffers_
+  bool                      first_event_;     //! No event written yet, so no separator needed
+};
+
+
+#endif // TRACEWRITER_H
@@ -24,6 +24,9 @@
 #include "TargetsManager.h"
 #include "HotspotReader.h"
 #include "MetricsManager.h"
+#include "DiagnosticWriter.h"
+#include "TraceWriter.h"
+#include "ProgressReporter.h"
 
 #include "IonVersion.h"
 
@@ -58,10 +61,11 @@ int main(int argc, char* argv[])
 
   mkdir(parameters.outputDir.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
 
+  // All per-variant diagnostics go into one container, use "tvcutils extract_diagnostic" to retrieve json files
+  DiagnosticWriter diagnostic_writer;
   if (parameters.program_flow.rich_json_diagnostic || parameters.program_flow.minimal_diagnostic) {
-    // make output directory "side effect bad"
-    parameters.program_flow.json_plot_dir = parameters.outputDir + "/json_diagnostic/";
-    mkdir(parameters.program_flow.json_plot_dir.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+    parameters.program_flow.json_plot_dir = parameters.outputDir + "/json_diagnostic.tvcdiag";
+    diagnostic_writer.Initialize(parameters.program_flow.json_plot_dir);
   }
 
 
@@ -69,11 +73,15 @@ int main(int argc, char* argv[])
   ReferenceReader ref_reader;
   ref_reader.Initialize(parameters.fasta);
 
+  TraceWriter trace_writer;
+  if (not parameters.trace_file.empty())
+    trace_writer.Initialize(parameters.trace_file, ref_reader);
+
   TargetsManager targets_manager;
   targets_manager.Initialize(ref_reader, parameters);
 
   BAMWalkerEngine bam_walker;
-  bam_walker.Initialize(ref_reader, targets_manager, parameters.bams, parameters.postprocessed_bam);
+  bam_walker.Initialize(ref_reader, targets_manager, parameters.bams, parameters.postprocessed_bam, parameters.program_flow.nThreads);
   bam_walker.GetProgramVersions(parameters.basecaller_version, parameters.tmap_version);
 
   SampleManager sample_manager;
@@ -83,7 +91,7 @@ int main(int argc, char* argv[])
   global_context.Initialize(parameters, ref_reader, bam_walker.GetBamHeader());
 
   OrderedVCFWriter vcf_writer;
-  vcf_writer.Initialize(parameters.outputDir + "/" + parameters.outputFile, parameters, sample_manager);
+  vcf_writer.Initialize(parameters.outputDir + "/" + parameters.outputFile, parameters, sample_manager, ref_reader, targets_manager);
 
   HotspotReader hotspot_reader;
   hotspot_reader.Initialize(ref_reader, parameters.variantPriorsFile);
@@ -102,6 +110,8 @@ int main(int argc, char* argv[])
   vc.candidate_generator = &candidate_generator;
   vc.vcf_writer = &vcf_writer;
   vc.metrics_manager = &metrics_manager;
+  vc.diagnostic_writer = &diagnostic_writer;
+  vc.trace_writer = &trace_writer;
   pthread_mutex_init(&vc.candidate_generation_mutex, NULL);
   pthread_mutex_init(&vc.read_loading_mutex, NULL);
   pthread_mutex_init(&vc.bam_walker_mutex, NULL);
@@ -112,6 +122,11 @@ int main(int argc, char* argv[])
   vc.candidate_counter = 0;
   vc.candidate_dot = 0;
 
+  ProgressReporter progress_reporter;
+  vc.progress_reporter = &progress_reporter;
+  if (not parameters.progress_file.empty())
+    progress_reporter.Initialize(parameters.progress_file, parameters.progress_interval, vc, parameters.program_flow.nThreads);
+
   pthread_t worker_id[parameters.program_flow.nThreads];
   for (int worker = 0; worker < parameters.program_flow.nThreads; worker++)
     if (pthread_create(&worker_id[worker], NULL, VariantCallerWorker, &vc)) {
@@ -122,16 +137,28 @@ int main(int argc, char* argv[])
   for (int worker = 0; worker < parameters.program_flow.nThreads; worker++)
     pthread_join(worker_id[worker], NULL);
 
+  // The reporter thread takes bam_walker_mutex, stop it before the mutex goes away
+  progress_reporter.Stop();
+
   pthread_mutex_destroy(&vc.candidate_generation_mutex);
   pthread_mutex_destroy(&vc.read_loading_mutex);
   pthread_mutex_destroy(&vc.bam_walker_mutex);
   pthread_mutex_destroy(&vc.read_removal_mutex);
   pthread_cond_destroy(&vc.memory_contention_cond);
   pthread_cond_destroy(&vc.alignment_tail_cond);
+  trace_writer.Close();
 
   vcf_writer.Close();
+  MetricsAccumulator& output_metrics = metrics_manager.NewAccumulator();
+  output_metrics.output_delayed_slots = vcf_writer.num_delayed_slots();
+  output_metrics.output_reorder_wait = vcf_writer.total_reorder_wait();
+  output_metrics.output_max_reorder_wait = vcf_writer.max_reorder_wait();
+  output_metrics.output_capacity_stalls = vcf_writer.num_capacity_stalls();
+  output_metrics.output_capacity_stall = vcf_writer.total_capacity_stall();
   bam_walker.Close();
+  diagnostic_writer.Close();
   metrics_manager.FinalizeAndSave(parameters.outputDir + "/tvc_metrics.json");
+  progress_reporter.Finish();
 
   cerr << endl;
   cout << endl;
@@ -160,6 +187,9 @@ void * VariantCallerWorker(void *input)
   pthread_mutex_lock(&vc.bam_walker_mutex);
   MetricsAccumulator& metrics_accumulator = vc.metrics_manager->NewAccumulator();
   pthread_mutex_unlock(&vc.bam_walker_mutex);
+  thread_objects.trace = vc.trace_writer->NewBuffer("worker");
+  volatile int *progress_state = vc.progress_reporter->NewWorker();
+  StageTimer worker_timer(metrics_accumulator);
 
   while (more_positions) {
 
@@ -168,8 +198,10 @@ void * VariantCallerWorker(void *input)
     if (vc.bam_walker->EligibleForReadRemoval()) {
       if (pthread_mutex_trylock(&vc.read_removal_mutex) == 0) {
 
+        StageTimer removal_timer(metrics_accumulator);
+        ReportWorkerState(progress_state, kWorkerRemovingReads);
         Alignment *removal_list = NULL;
-        pthread_mutex_lock(&vc.bam_walker_mutex);
+        metrics_accumulator.LockMutex(&vc.bam_walker_mutex, kWaitBamWalkerMutex);
         vc.bam_walker->RequestReadRemovalTask(removal_list);
         pthread_mutex_unlock(&vc.bam_walker_mutex);
 	//In rare case, the Eligible check pass, but another thread got to remove reads, then when this thread get the lock, it find there
@@ -177,11 +209,12 @@ void * VariantCallerWorker(void *input)
 	// ZM tags. To prevent that, we need to check for empty.
         if (removal_list) {
 	    vc.bam_walker->SaveAlignments(removal_list); 
-            pthread_mutex_lock(&vc.bam_walker_mutex);
+            metrics_accumulator.LockMutex(&vc.bam_walker_mutex, kWaitBamWalkerMutex);
             vc.bam_walker->FinishReadRemovalTask(removal_list);
             pthread_mutex_unlock(&vc.bam_walker_mutex);
 	}
         pthread_mutex_unlock(&vc.read_removal_mutex);
+        removal_timer.Lap(kStageReadRemoval);
 
         pthread_cond_broadcast(&vc.memory_contention_cond);
       }
@@ -190,9 +223,10 @@ void * VariantCallerWorker(void *input)
     // If too many reads in memory and at least one candidate evaluator in progress, pause this thread
     // Wake up when the oldest candidate evaluator task is completed.
 
-    pthread_mutex_lock(&vc.bam_walker_mutex);
+    metrics_accumulator.LockMutex(&vc.bam_walker_mutex, kWaitBamWalkerMutex);
     if (vc.bam_walker->MemoryContention()) {
-      pthread_cond_wait (&vc.memory_contention_cond, &vc.bam_walker_mutex);
+      ReportWorkerState(progress_state, kWorkerWaitingForMemory);
+      metrics_accumulator.WaitCondition(&vc.memory_contention_cond, &vc.bam_walker_mutex, kWaitMemoryContentionCond);
       pthread_mutex_unlock(&vc.bam_walker_mutex);
       continue;
     }
@@ -207,7 +241,7 @@ void * VariantCallerWorker(void *input)
     if (vc.bam_walker->EligibleForGreedyRead()) {
       // Greedy reading allowed: if candidate generation in progress, just grab a new read
       if (pthread_mutex_trylock(&vc.candidate_generation_mutex) == 0) {
-        pthread_mutex_lock(&vc.bam_walker_mutex);
+        metrics_accumulator.LockMutex(&vc.bam_walker_mutex, kWaitBamWalkerMutex);
         ready_for_next_position = vc.bam_walker->ReadyForNextPosition();
         if (not ready_for_next_position) {
           pthread_mutex_unlock(&vc.bam_walker_mutex);
@@ -218,8 +252,8 @@ void * VariantCallerWorker(void *input)
     } else {
       // Greedy reading disallowed: if candidate generation in progress,
       // wait for it to finish before deciding what to do.
-      pthread_mutex_lock(&vc.candidate_generation_mutex);
-      pthread_mutex_lock(&vc.bam_walker_mutex);
+      metrics_accumulator.LockMutex(&vc.candidate_generation_mutex, kWaitCandidateGenerationMutex);
+      metrics_accumulator.LockMutex(&vc.bam_walker_mutex, kWaitBamWalkerMutex);
       ready_for_next_position = vc.bam_walker->ReadyForNextPosition();
       if (not ready_for_next_position) {
         pthread_mutex_unlock(&vc.bam_walker_mutex);
@@ -233,28 +267,35 @@ void * VariantCallerWorker(void *input)
 
     if (not ready_for_next_position) {
 
-      pthread_mutex_lock(&vc.read_loading_mutex);
+      StageTimer read_timer(metrics_accumulator);
+      ReportWorkerState(progress_state, kWorkerLoadingReads);
+      double trace_start = TraceStart(thread_objects.trace);
+      metrics_accumulator.LockMutex(&vc.read_loading_mutex, kWaitReadLoadingMutex);
 
-      pthread_mutex_lock(&vc.bam_walker_mutex);
+      metrics_accumulator.LockMutex(&vc.bam_walker_mutex, kWaitBamWalkerMutex);
       for (int i = 0; i < kReadBatchSize; ++i) {
         vc.bam_walker->RequestReadProcessingTask(new_read[i]);
         success[i] = false;
       }
       pthread_mutex_unlock(&vc.bam_walker_mutex);
 
-      for (int i = 0; i < kReadBatchSize; ++i) {
-        success[i] = vc.bam_walker->GetNextAlignmentCore(new_read[i]);
-        if (not success[i])
+      int num_loaded = 0;
+      for (; num_loaded < kReadBatchSize; ++num_loaded) {
+        success[num_loaded] = vc.bam_walker->GetNextAlignmentCore(new_read[num_loaded]);
+        if (not success[num_loaded])
           break;
       }
       pthread_mutex_unlock(&vc.read_loading_mutex);
-
+      read_timer.Lap(kStageReadLoading);
+      TraceEnd(thread_objects.trace, "load reads", trace_start, -1, -1, "reads", num_loaded);
+      trace_start = TraceStart(thread_objects.trace);
+      ReportWorkerState(progress_state, kWorkerProcessingReads);
 
       for (int i = 0; i < kReadBatchSize and success[i]; ++i) {
         vc.candidate_generator->BasicFilters(*new_read[i]);
         if (new_read[i]->filtered)
           continue;
-        vc.targets_manager->TrimAmpliseqPrimers(new_read[i], vc.bam_walker->GetRecentUnmergedTarget());
+        vc.targets_manager->TrimAmpliseqPrimers(new_read[i]);
         if (new_read[i]->filtered)
           continue;
 
@@ -262,10 +303,12 @@ void * VariantCallerWorker(void *input)
         UnpackOnLoad(new_read[i], *vc.global_context, *vc.parameters);
       }
 
-      pthread_mutex_lock(&vc.bam_walker_mutex);
+      metrics_accumulator.LockMutex(&vc.bam_walker_mutex, kWaitBamWalkerMutex);
       for (int i = 0; i < kReadBatchSize; ++i)
         vc.bam_walker->FinishReadProcessingTask(new_read[i], success[i]);
       pthread_mutex_unlock(&vc.bam_walker_mutex);
+      read_timer.Lap(kStageReadProcessing);
+      TraceEnd(thread_objects.trace, "process reads", trace_start, -1, -1, "reads", num_loaded);
 
       if (not vc.bam_walker->HasMoreAlignments() and not vc.bam_walker->ReadProcessingTasksInProgress())
         pthread_cond_broadcast(&vc.alignment_tail_cond);
@@ -280,18 +323,22 @@ void * VariantCallerWorker(void *input)
     // Protect against the race condition where has_more_alignments = false, but not all alignments finished processing
     if (not vc.bam_walker->HasMoreAlignments() and vc.bam_walker->ReadProcessingTasksInProgress()) {
       pthread_mutex_unlock(&vc.candidate_generation_mutex);
-      pthread_cond_wait (&vc.alignment_tail_cond, &vc.bam_walker_mutex);
+      ReportWorkerState(progress_state, kWorkerWaitingForReads);
+      metrics_accumulator.WaitCondition(&vc.alignment_tail_cond, &vc.bam_walker_mutex, kWaitAlignmentTailCond);
       pthread_mutex_unlock(&vc.bam_walker_mutex);
       continue;
     }
 
+    StageTimer position_timer(metrics_accumulator);
+    ReportWorkerState(progress_state, kWorkerGeneratingCandidates);
+    double trace_start = TraceStart(thread_objects.trace);
     vc.bam_walker->BeginPositionProcessingTask(position_ticket);
     pthread_mutex_unlock(&vc.bam_walker_mutex);
 
     int haplotype_length = 1;
     vc.candidate_generator->GenerateCandidates(variant_candidates, position_ticket, haplotype_length);
 
-    pthread_mutex_lock(&vc.bam_walker_mutex);
+    metrics_accumulator.LockMutex(&vc.bam_walker_mutex, kWaitBamWalkerMutex);
     int next_hotspot_chr = -1;
     long next_hotspot_position = -1;
     if (vc.candidate_generator->GetNextHotspotLocation(next_hotspot_chr, next_hotspot_position))
@@ -299,13 +346,17 @@ void * VariantCallerWorker(void *input)
     else
       more_positions = vc.bam_walker->AdvancePosition(haplotype_length);
     pthread_mutex_unlock(&vc.bam_walker_mutex);
+    position_timer.Lap(kStageCandidateGeneration);
+    TraceEnd(thread_objects.trace, "candidate generation", trace_start, position_ticket->chr, position_ticket->pos,
+        "candidates", variant_candidates.size());
 
     if (not variant_candidates.empty()) {
 
       int vcf_writer_slot = vc.vcf_writer->ReserveSlot();
       vc.candidate_counter += variant_candidates.size();
       while (vc.candidate_counter > vc.candidate_dot) {
-        cerr << ".";
+        if (not vc.progress_reporter->IsOpen())
+          cerr << ".";
         /*
         pthread_mutex_lock(&vc.bam_walker_mutex);
         vc.bam_walker->PrintStatus();
@@ -316,14 +367,22 @@ void * VariantCallerWorker(void *input)
       }
 
       pthread_mutex_unlock(&vc.candidate_generation_mutex);
+      position_timer.Lap(kStageOutput);
+      ReportWorkerState(progress_state, kWorkerEvaluating);
 
       // separate queuing of variants from >actual work< of calling variants
       for (deque<VariantCandidate>::iterator v = variant_candidates.begin(); v != variant_candidates.end(); ++v) {
-        EnsembleProcessOneVariant(thread_objects, vc, *v, *position_ticket);
+        if (EnsembleProcessOneVariant(thread_objects, vc, *v, *position_ticket))
+          metrics_accumulator.candidates_evaluated++;
+        else
+          metrics_accumulator.candidates_prescreened++;
         //v->isFiltered = true;
       }
+      position_timer.Lap(kStageEvaluation);
+      ReportWorkerState(progress_state, kWorkerWritingOutput);
 
-      vc.vcf_writer->WriteSlot(vcf_writer_slot, variant_candidates);
+      vc.vcf_writer->WriteSlot(vcf_writer_slot, variant_candidates, thread_objects.trace);
+      position_timer.Lap(kStageOutput);
 
       variant_candidates.clear();
     } else {
@@ -331,8 +390,9 @@ void * VariantCallerWorker(void *input)
     }
 
     metrics_accumulator.CollectMetrics(position_ticket, haplotype_length, vc.ref_reader);
+    position_timer.Lap(kStageMetricsCollection);
 
-    pthread_mutex_lock(&vc.bam_walker_mutex);
+    metrics_accumulator.LockMutex(&vc.bam_walker_mutex, kWaitBamWalkerMutex);
     bool signal_contention_removal = vc.bam_walker->IsEarlierstPositionProcessingTask(position_ticket);
     vc.bam_walker->FinishPositionProcessingTask(position_ticket);
     pthread_mutex_unlock(&vc.bam_walker_mutex);
@@ -344,7 +404,19 @@ void * VariantCallerWorker(void *input)
 
   }
 
-  if (pthread_mutex_trylock(&vc.read_removal_mutex) == 0)  vc.bam_walker->SaveAlignments(NULL);
+  if (pthread_mutex_trylock(&vc.read_removal_mutex) == 0) {
+    StageTimer removal_timer(metrics_accumulator);
+    vc.bam_walker->SaveAlignments(NULL);
+    removal_timer.Lap(kStageReadRemoval);
+  }
+
+  metrics_accumulator.read_prefix_cache_hits = thread_objects.read_prefix_cache.num_hits();
+  metrics_accumulator.read_prefix_cache_misses = thread_objects.read_prefix_cache.num_misses();
+  metrics_accumulator.realignment_cache_hits = thread_objects.realignment_cache.num_hits();
+  metrics_accumulator.realignment_cache_misses = thread_objects.realignment_cache.num_misses();
+  metrics_accumulator.worker_wall = worker_timer.WallElapsed();
+  metrics_accumulator.worker_cpu = worker_timer.CpuElapsed();
+  ReportWorkerState(progress_state, kWorkerDone);
 
   return NULL;
 }
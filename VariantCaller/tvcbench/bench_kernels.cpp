@@ -0,0 +1,386 @@
+/* Copyright (C) 2014 Ion Torrent Systems, Inc. All Rights Reserved */
+
+#include "tvcbench.h"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <math.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <limits.h>
+#include <sys/time.h>
+
+#include "OptArgs.h"
+#include "IonVersion.h"
+#include "DPTreephaser.h"
+#include "TreephaserSSE.h"
+#include "RecalibrationModel.h"
+#include "InputStructures.h"
+#include "BAMWalkerEngine.h"
+#include "HypothesisEvaluator.h"
+
+using namespace std;
+
+
+void BenchKernelsHelp()
+{
+  printf ("\n");
+  printf ("tvcbench %s-%s (%s) - Benchmarks for Torrent Variant Caller.\n",
+      IonVersion::GetVersion().c_str(), IonVersion::GetRelease().c_str(), IonVersion::GetGitHash().c_str());
+  printf ("\n");
+  printf ("Usage:   tvcbench kernels [options]\n");
+  printf ("\n");
+  printf ("Workload options:\n");
+  printf ("     --flow-order              STRING     flow order cycle [TACGTACGTCTGAGCATCGATCGATGTACAGC]\n");
+  printf ("     --num-flows               INT        number of flows per read [400]\n");
+  printf ("     --read-length             INT        bases per read, cut short where the flows run out [200]\n");
+  printf ("     --num-reads               INT        number of synthetic reads [1000]\n");
+  printf ("     --seed                    INT        random seed; equal seeds give equal workloads on any platform [1]\n");
+  printf ("     --cf                      FLOAT      carry forward rate [0.01]\n");
+  printf ("     --ie                      FLOAT      incomplete extension rate [0.008]\n");
+  printf ("     --dr                      FLOAT      droop, used by the DPTreephaser kernels only [0.0015]\n");
+  printf ("     --noise                   FLOAT      standard deviation of the gaussian signal noise [0.05]\n");
+  printf ("     --recalibration           on/off     apply a synthetic HP recalibration table [off]\n");
+  printf ("\n");
+  printf ("Run options:\n");
+  printf ("     --kernels                 LIST       comma separated subset of simulate,dp_solve,sse_solve,hyp_dp,hyp_sse\n");
+  printf ("                                          [simulate,dp_solve,sse_solve,hyp_dp,hyp_sse]\n");
+  printf ("     --repeat                  INT        passes over the reads per kernel [1]\n");
+  printf ("     --output-results          FILE       write the kernel outputs of the last pass to a results file []\n");
+  printf ("     --check-results           FILE       compare the kernel outputs of the last pass to a results file\n");
+  printf ("                                          written earlier with the same options; exit code 1 on mismatch []\n");
+  printf ("\n");
+}
+
+
+struct SyntheticRead {
+  vector<char>    sequence;         //! True base sequence
+  vector<float>   measurements;     //! Simulated flow signal with noise
+  vector<string>  hypotheses;       //! Read as called, reference, and the middle homopolymer one base longer
+};
+
+
+//! One kernel output of one read, compact enough to keep a results file small
+struct BenchRecord {
+  string          kernel;
+  int             read;             //! Read index
+  int             item;             //! Hypothesis index, 0 for the other kernels
+  string          sequence;         //! Called sequence of the solvers, - for the others
+  int             last_flow;        //! Last evaluated flow of the hypothesis evaluator, number of bases otherwise
+  double          prediction_sum;   //! Sum of the predicted signal
+  double          prediction_sumsq; //! Sum of squares of the predicted signal
+};
+
+
+static double Now()
+{
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return now.tv_sec + 1e-6 * now.tv_usec;
+}
+
+
+static void AddRecord(vector<BenchRecord>& records, const string& kernel, int read, int item,
+    const vector<char> *sequence, int last_flow, const vector<float>& prediction, int num_flows)
+{
+  records.push_back(BenchRecord());
+  BenchRecord& record = records.back();
+  record.kernel = kernel;
+  record.read = read;
+  record.item = item;
+  record.sequence = sequence ? string(sequence->begin(), sequence->end()) : string("-");
+  if (record.sequence.empty())
+    record.sequence = "-";
+  record.last_flow = last_flow;
+  record.prediction_sum = 0;
+  record.prediction_sumsq = 0;
+  for (int flow = 0; flow < num_flows and flow < (int)prediction.size(); ++flow) {
+    record.prediction_sum += prediction[flow];
+    record.prediction_sumsq += prediction[flow] * prediction[flow];
+  }
+}
+
+
+static bool WriteResults(const string& filename, const string& workload, const vector<BenchRecord>& records)
+{
+  FILE *output = fopen(filename.c_str(), "w");
+  if (!output)
+    return false;
+  fprintf(output, "%s\n", workload.c_str());
+  for (vector<BenchRecord>::const_iterator record = records.begin(); record != records.end(); ++record)
+    fprintf(output, "%s\t%d\t%d\t%s\t%d\t%.6f\t%.6f\n", record->kernel.c_str(), record->read, record->item,
+        record->sequence.c_str(), record->last_flow, record->prediction_sum, record->prediction_sumsq);
+  return fclose(output) == 0;
+}
+
+
+// Sequences and flows must match exactly, signal sums to a relative tolerance that absorbs compiler differences
+static int CheckResults(const string& filename, const string& workload, const vector<BenchRecord>& records)
+{
+  const double kTolerance = 1e-4;
+  const int kMaxReported = 10;
+
+  ifstream input(filename.c_str());
+  if (!input.is_open()) {
+    fprintf(stderr, "ERROR: Cannot open %s\n", filename.c_str());
+    return -1;
+  }
+  string line;
+  getline(input, line);
+  if (line != workload) {
+    fprintf(stderr, "ERROR: %s was written for a different workload:\n  %s\n", filename.c_str(), line.c_str());
+    return -1;
+  }
+
+  int num_mismatches = 0;
+  unsigned int num_expected = 0;
+  BenchRecord expected;
+  while (input >> expected.kernel >> expected.read >> expected.item >> expected.sequence
+      >> expected.last_flow >> expected.prediction_sum >> expected.prediction_sumsq) {
+    bool match = false;
+    if (num_expected < records.size()) {
+      const BenchRecord& actual = records[num_expected];
+      match = actual.kernel == expected.kernel and actual.read == expected.read and actual.item == expected.item
+          and actual.sequence == expected.sequence and actual.last_flow == expected.last_flow
+          and fabs(actual.prediction_sum - expected.prediction_sum) <= kTolerance * max(1.0, fabs(expected.prediction_sum))
+          and fabs(actual.prediction_sumsq - expected.prediction_sumsq) <= kTolerance * max(1.0, fabs(expected.prediction_sumsq));
+    }
+    if (not match and num_mismatches++ < kMaxReported)
+      printf("Mismatch: %s read %d item %d\n", expected.kernel.c_str(), expected.read, expected.item);
+    num_expected++;
+  }
+  if (num_expected != records.size()) {
+    printf("Mismatch: %s has %u results, this run has %u\n", filename.c_str(), num_expected, (unsigned int)records.size());
+    num_mismatches++;
+  }
+  return num_mismatches;
+}
+
+
+// Random per flow, nuc and hp gains and offsets, mild enough to leave the reads solvable
+static void MakeRecalibrationTable(RecalibrationTable& table, int num_flows, BenchRandom& random)
+{
+  const int num_hps = 12;
+  vector<vector<vector<float> > > As(num_flows, vector<vector<float> >(4, vector<float>(num_hps)));
+  vector<vector<vector<float> > > Bs(num_flows, vector<vector<float> >(4, vector<float>(num_hps)));
+  for (int flow = 0; flow < num_flows; ++flow) {
+    for (int nuc = 0; nuc < 4; ++nuc) {
+      for (int hp = 0; hp < num_hps; ++hp) {
+        As[flow][nuc][hp] = 1.0 + 0.04 * (random.Uniform() - 0.5);
+        Bs[flow][nuc][hp] = 0.04 * (random.Uniform() - 0.5);
+      }
+    }
+  }
+  table.Compile(As, Bs);
+}
+
+
+static void MakeReads(vector<SyntheticRead>& reads, int num_reads, int read_length, const ion::FlowOrder& flow_order,
+    DPTreephaser& dp_treephaser, double noise, BenchRandom& random)
+{
+  static const char kBases[4] = {'A','C','G','T'};
+  // Keep some flows past the last base, so that every kernel sees the end of the read
+  const int last_flow = max(1, flow_order.num_flows() - 20);
+
+  reads.resize(num_reads);
+  for (int i_read = 0; i_read < num_reads; ++i_read) {
+    SyntheticRead& read = reads[i_read];
+    read.sequence.clear();
+    int flow = 0;
+    while ((int)read.sequence.size() < read_length) {
+      char base = kBases[random.Next() & 3];
+      int next_flow = flow;
+      while (next_flow < last_flow and flow_order.nuc_at(next_flow) != base)
+        next_flow++;
+      if (next_flow >= last_flow)
+        break;
+      read.sequence.push_back(base);
+      flow = next_flow;
+    }
+
+    BasecallerRead bc_read;
+    bc_read.sequence = read.sequence;
+    dp_treephaser.Simulate(bc_read, flow_order.num_flows());
+    read.measurements.assign(flow_order.num_flows(), 0);
+    for (int flow = 0; flow < flow_order.num_flows(); ++flow)
+      read.measurements[flow] = bc_read.prediction[flow] + noise * random.Gaussian();
+
+    string called(read.sequence.begin(), read.sequence.end());
+    string longer = called;
+    longer.insert(called.size() / 2, 1, called[called.size() / 2]);
+    read.hypotheses.clear();
+    read.hypotheses.push_back(called);
+    read.hypotheses.push_back(called);
+    read.hypotheses.push_back(longer);
+  }
+}
+
+
+int BenchKernels(int argc, const char *argv[])
+{
+  OptArgs opts;
+  opts.ParseCmdLine(argc, argv);
+  bool help               = opts.GetFirstBoolean('h', "help", false);
+  string flow_cycle       = opts.GetFirstString ('-', "flow-order", "TACGTACGTCTGAGCATCGATCGATGTACAGC");
+  int num_flows           = opts.GetFirstInt    ('-', "num-flows", 400);
+  int read_length         = opts.GetFirstInt    ('-', "read-length", 200);
+  int num_reads           = opts.GetFirstInt    ('-', "num-reads", 1000);
+  int seed                = opts.GetFirstInt    ('-', "seed", 1);
+  double cf               = opts.GetFirstDouble ('-', "cf", 0.01);
+  double ie               = opts.GetFirstDouble ('-', "ie", 0.008);
+  double dr               = opts.GetFirstDouble ('-', "dr", 0.0015);
+  double noise            = opts.GetFirstDouble ('-', "noise", 0.05);
+  bool use_recalibration  = opts.GetFirstBoolean('-', "recalibration", false);
+  vector<string> kernels  = opts.GetFirstStringVector ('-', "kernels", "simulate,dp_solve,sse_solve,hyp_dp,hyp_sse");
+  int repeat              = opts.GetFirstInt    ('-', "repeat", 1);
+  string output_results   = opts.GetFirstString ('-', "output-results", "");
+  string check_results    = opts.GetFirstString ('-', "check-results", "");
+  opts.CheckNoLeftovers();
+
+  if (help) {
+    BenchKernelsHelp();
+    return 0;
+  }
+  if (flow_cycle.empty() or num_flows < 40 or read_length < 1 or num_reads < 1 or repeat < 1) {
+    BenchKernelsHelp();
+    return 1;
+  }
+  for (unsigned int i_kernel = 0; i_kernel < kernels.size(); ++i_kernel) {
+    if (kernels[i_kernel] != "simulate" and kernels[i_kernel] != "dp_solve" and kernels[i_kernel] != "sse_solve"
+        and kernels[i_kernel] != "hyp_dp" and kernels[i_kernel] != "hyp_sse") {
+      fprintf(stderr, "ERROR: unrecognized kernel '%s'\n", kernels[i_kernel].c_str());
+      return 1;
+    }
+  }
+
+  printf("tvcbench %s-%s (%s) - Treephaser kernel benchmark\n\n",
+         IonVersion::GetVersion().c_str(), IonVersion::GetRelease().c_str(), IonVersion::GetGitHash().c_str());
+
+  // Only the fields of InputStructures that the hypothesis evaluator reads; tvc takes the rest from BAM and parameters
+  InputStructures global_context;
+  global_context.flowOrder = flow_cycle;
+  global_context.nFlows = num_flows;
+  global_context.treePhaserFlowOrder.SetFlowOrder(flow_cycle, num_flows);
+  const ion::FlowOrder& flow_order = global_context.treePhaserFlowOrder;
+
+  PersistingThreadObjects thread_objects(global_context);
+  DPTreephaser& dp_treephaser = thread_objects.dpTreephaser;
+  TreephaserSSE& treephaser_sse = thread_objects.treephaser_sse;
+
+  BenchRandom random(seed);
+  RecalibrationTable recal_table;
+  if (use_recalibration)
+    MakeRecalibrationTable(recal_table, num_flows, random);
+  const RecalibrationTable *recal = use_recalibration ? &recal_table : NULL;
+
+  dp_treephaser.SetModelParameters(cf, ie, dr);
+  dp_treephaser.SetAsBs(recal);
+  treephaser_sse.SetModelParameters(cf, ie);
+  treephaser_sse.SetAsBs(recal);
+
+  vector<SyntheticRead> reads;
+  MakeReads(reads, num_reads, read_length, flow_order, dp_treephaser, noise, random);
+
+  long num_bases = 0;
+  for (int i_read = 0; i_read < num_reads; ++i_read)
+    num_bases += reads[i_read].sequence.size();
+
+  char workload[1024];
+  snprintf(workload, sizeof(workload), "# tvcbench reads=%d read-length=%d flows=%d flow-order=%s cf=%g ie=%g dr=%g noise=%g recalibration=%s seed=%d",
+      num_reads, read_length, num_flows, flow_cycle.c_str(), cf, ie, dr, noise, use_recalibration ? "on" : "off", seed);
+  printf("Workload: %d reads, %.1f bases per read, %d flows of %s, cf=%g ie=%g dr=%g noise=%g, recalibration %s, seed %d\n\n",
+      num_reads, (double)num_bases / num_reads, num_flows, flow_cycle.c_str(), cf, ie, dr, noise,
+      use_recalibration ? "on" : "off", seed);
+
+  // Alignments for the hypothesis evaluator: unclipped reads starting at flow 0
+  vector<Alignment> alignments(num_reads);
+  for (int i_read = 0; i_read < num_reads; ++i_read) {
+    alignments[i_read].read_number = i_read;
+    alignments[i_read].measurements = reads[i_read].measurements;
+    alignments[i_read].measurements_length = num_flows;
+    alignments[i_read].phase_params.push_back(cf);
+    alignments[i_read].phase_params.push_back(ie);
+    alignments[i_read].phase_params.push_back(dr);
+    alignments[i_read].recal_ab.table = recal;
+  }
+
+  vector<BenchRecord> records;
+  BasecallerRead bc_read;
+  vector<vector<float> > predictions;
+  vector<vector<float> > normalized_measurements;
+
+  printf("%-10s %12s %14s %12s\n", "kernel", "reads/s", "flows/s", "seconds");
+
+  for (unsigned int i_kernel = 0; i_kernel < kernels.size(); ++i_kernel) {
+    const string& kernel = kernels[i_kernel];
+    double seconds = 0;
+    double flows = 0;
+
+    for (int pass = 0; pass < repeat; ++pass) {
+      bool last_pass = (pass == repeat - 1);
+      // Every pass starts cold, as the first candidate on a read does in tvc
+      thread_objects.read_prefix_cache.Evict(0, 0, INT_MAX);
+
+      double start_time = Now();
+
+      if (kernel == "simulate") {
+        for (int i_read = 0; i_read < num_reads; ++i_read) {
+          bc_read.sequence = reads[i_read].sequence;
+          dp_treephaser.Simulate(bc_read, num_flows);
+          if (last_pass)
+            AddRecord(records, kernel, i_read, 0, NULL, bc_read.sequence.size(), bc_read.prediction, num_flows);
+        }
+        flows += (double)num_reads * num_flows;
+
+      } else if (kernel == "dp_solve" or kernel == "sse_solve") {
+        for (int i_read = 0; i_read < num_reads; ++i_read) {
+          bc_read.SetData(reads[i_read].measurements, num_flows);
+          if (kernel == "dp_solve")
+            dp_treephaser.Solve(bc_read, num_flows);
+          else
+            treephaser_sse.SolveRead(bc_read, 0, num_flows);
+          if (last_pass)
+            AddRecord(records, kernel, i_read, 0, &bc_read.sequence, bc_read.sequence.size(), bc_read.prediction, num_flows);
+        }
+        flows += (double)num_reads * num_flows;
+
+      } else {
+        global_context.use_SSE_basecaller = (kernel == "hyp_sse");
+        for (int i_read = 0; i_read < num_reads; ++i_read) {
+          const vector<string>& hypotheses = reads[i_read].hypotheses;
+          int last_flow = CalculateHypPredictions(thread_objects, alignments[i_read], global_context, hypotheses,
+              predictions, normalized_measurements, num_flows);
+          flows += (double)last_flow * hypotheses.size();
+          if (last_pass)
+            for (unsigned int i_hyp = 0; i_hyp < hypotheses.size(); ++i_hyp)
+              AddRecord(records, kernel, i_read, i_hyp, NULL, last_flow, predictions[i_hyp], num_flows);
+        }
+      }
+
+      seconds += Now() - start_time;
+    }
+
+    printf("%-10s %12.0f %14.0f %12.3f\n", kernel.c_str(), seconds > 0 ? num_reads * repeat / seconds : 0,
+        seconds > 0 ? flows / seconds : 0, seconds);
+  }
+
+  if (not output_results.empty()) {
+    if (not WriteResults(output_results, workload, records)) {
+      fprintf(stderr, "ERROR: Failed writing %s\n", output_results.c_str());
+      return 1;
+    }
+    printf("\nWrote %d results to %s\n", (int)records.size(), output_results.c_str());
+  }
+
+  if (not check_results.empty()) {
+    int num_mismatches = CheckResults(check_results, workload, records);
+    if (num_mismatches < 0)
+      return 1;
+    printf("\nCheck against %s %s: %d of %d results differ\n", check_results.c_str(),
+        num_mismatches ? "FAILED" : "passed", num_mismatches, (int)records.size());
+    if (num_mismatches)
+      return 1;
+  }
+  return 0;
+}
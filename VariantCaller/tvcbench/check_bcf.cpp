@@ -0,0 +1,646 @@
+/* Copyright (C) 2014 Ion Torrent Systems, Inc. All Rights Reserved */
+
+#include "tvcbench.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <fstream>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "OptArgs.h"
+#include "IonVersion.h"
+#include "ReferenceReader.h"
+#include "VariantAnnotation.h"
+#include "VcfFormat.h"
+#include "BcfFormat.h"
+#include <Variant.h>
+
+using namespace std;
+
+
+void CheckBcfHelp()
+{
+  printf ("\n");
+  printf ("tvcbench %s-%s (%s) - Benchmarks for Torrent Variant Caller.\n",
+      IonVersion::GetVersion().c_str(), IonVersion::GetRelease().c_str(), IonVersion::GetGitHash().c_str());
+  printf ("\n");
+  printf ("Usage:   tvcbench bcf [options]\n");
+  printf ("\n");
+  printf ("Writes the records of a tvc vcf, followed by random records with typed annotations, both as VCF text and\n");
+  printf ("as BCF2. Decodes the BCF2 records and compares them field by field to the text. Exit code 1 on mismatch.\n");
+  printf ("\n");
+  printf ("Options:\n");
+  printf ("     --reference               FILE       reference fasta the vcf was called against [required]\n");
+  printf ("     --vcf                     FILE       tvc vcf providing the header and the first records [required]\n");
+  printf ("     --num-records             INT        number of random records [10000]\n");
+  printf ("     --seed                    INT        random seed; equal seeds give equal records on any platform [1]\n");
+  printf ("     --output-bcf              FILE       also write the BCF2 encoding to a file []\n");
+  printf ("\n");
+}
+
+
+// Typed value encoding of BCF2.2, as far as the decoder needs it
+enum { kTypeNull = 0, kTypeInt8 = 1, kTypeInt16 = 2, kTypeInt32 = 3, kTypeFloat = 5, kTypeChar = 7 };
+
+
+//! Dictionaries read back from the BCF2 header text, independently of BcfHeader
+struct DecodedHeader {
+  vector<string>          dictionary;   //! FILTER, INFO and FORMAT IDs, PASS first
+  vector<string>          contigs;
+  map<string,string>      info_type;    //! INFO ID to declared Type
+  map<string,string>      format_type;  //! FORMAT ID to declared Type
+  vector<string>          samples;
+};
+
+//! One typed vector; integers and floats in numbers, missing values flagged, vector-end padding dropped
+struct DecodedValues {
+  int                     type;
+  vector<double>          numbers;
+  vector<char>            missing;
+  string                  text;
+};
+
+struct DecodedRecord {
+  int                     contig;
+  long                    position;     //! 0-based
+  long                    ref_length;
+  float                   quality;
+  string                  id;
+  vector<string>          alleles;
+  vector<int>             filters;
+  vector<pair<int,DecodedValues> >  info;
+  vector<int>             format_keys;
+  vector<vector<DecodedValues> >    format;   //! Per key, per sample
+};
+
+
+//! Reads little endian values from a BCF2 buffer; any read past the end clears ok
+class BcfCursor {
+public:
+  BcfCursor(const string& data, size_t start, size_t end) : data_(data), pos_(start), end_(end), ok(true) {}
+
+  uint32_t Get(int num_bytes) {
+    if (pos_ + num_bytes > end_) {
+      ok = false;
+      pos_ = end_;
+      return 0;
+    }
+    uint32_t value = 0;
+    for (int i = 0; i < num_bytes; ++i)
+      value |= (uint32_t)(unsigned char)data_[pos_++] << (8*i);
+    return value;
+  }
+
+  // Type byte and size, with sizes of 15 and more in a following typed integer
+  void GetSize(int& size, int& type) {
+    uint32_t descriptor = Get(1);
+    size = descriptor >> 4;
+    type = descriptor & 15;
+    if (size == 15) {
+      DecodedValues values;
+      GetValues(values);
+      size = values.numbers.empty() ? -1 : (int)values.numbers[0];
+    }
+  }
+
+  void GetValues(DecodedValues& values, int size, int type) {
+    values.type = type;
+    values.numbers.clear();
+    values.missing.clear();
+    values.text.clear();
+    if (type == kTypeChar) {
+      for (int i = 0; i < size; ++i)
+        values.text.push_back((char)Get(1));
+      return;
+    }
+    if (type != kTypeInt8 and type != kTypeInt16 and type != kTypeInt32 and type != kTypeFloat) {
+      ok = ok and (type == kTypeNull);
+      return;
+    }
+    int num_bytes = (type == kTypeInt8) ? 1 : (type == kTypeInt16 ? 2 : 4);
+    for (int i = 0; i < size; ++i) {
+      uint32_t raw = Get(num_bytes);
+      if (type == kTypeFloat) {
+        if (raw == 0x7F800002)
+          continue;
+        float value;
+        memcpy(&value, &raw, 4);
+        values.numbers.push_back(value);
+        values.missing.push_back(raw == 0x7F800001);
+        continue;
+      }
+      uint32_t sign = 1u << (8*num_bytes-1);
+      if (raw == sign + 1)
+        continue;
+      int64_t value = (raw & sign) ? (int64_t)raw - 2 * (int64_t)sign : (int64_t)raw;
+      values.numbers.push_back((double)value);
+      values.missing.push_back(raw == sign);
+    }
+  }
+
+  void GetValues(DecodedValues& values) {
+    int size, type;
+    GetSize(size, type);
+    GetValues(values, size, type);
+  }
+
+  int GetInteger() {
+    DecodedValues values;
+    GetValues(values);
+    if (values.numbers.size() != 1)
+      ok = false;
+    return values.numbers.empty() ? -1 : (int)values.numbers[0];
+  }
+
+  bool AtEnd() const { return pos_ == end_; }
+
+private:
+  const string&   data_;
+  size_t          pos_;
+  size_t          end_;
+public:
+  bool            ok;
+};
+
+
+static string DeclaredType(const string& line)
+{
+  size_t type_start = line.find(",Type=");
+  if (type_start == string::npos)
+    return "String";
+  type_start += 6;
+  return line.substr(type_start, line.find_first_of(",>", type_start) - type_start);
+}
+
+static bool DecodeHeader(const string& bcf, DecodedHeader& header, size_t& records_start)
+{
+  if (bcf.size() < 9 or bcf.compare(0, 5, string("BCF\2\2", 5)) != 0)
+    return false;
+  BcfCursor cursor(bcf, 5, 9);
+  size_t text_length = cursor.Get(4);
+  if (text_length == 0 or 9 + text_length > bcf.size() or bcf[9 + text_length - 1] != '\0')
+    return false;
+  records_start = 9 + text_length;
+
+  header.dictionary.assign(1, "PASS");
+  string text = bcf.substr(9, text_length - 1);
+  for (size_t line_start = 0; line_start < text.size(); ) {
+    size_t line_end = text.find('\n', line_start);
+    if (line_end == string::npos)
+      line_end = text.size();
+    string line = text.substr(line_start, line_end - line_start);
+    line_start = line_end + 1;
+
+    if (line.compare(0, 6, "#CHROM") == 0) {
+      size_t column_start = 0;
+      for (int column = 0; column_start != string::npos; ++column) {
+        size_t column_end = line.find('\t', column_start);
+        if (column >= 9)
+          header.samples.push_back(line.substr(column_start, column_end == string::npos ? string::npos : column_end - column_start));
+        column_start = (column_end == string::npos) ? column_end : column_end + 1;
+      }
+      continue;
+    }
+    size_t kind_end = line.find("=<ID=");
+    if (line.compare(0, 2, "##") != 0 or kind_end == string::npos)
+      continue;
+    string kind = line.substr(2, kind_end - 2);
+    string id = line.substr(kind_end + 5, line.find_first_of(",>", kind_end + 5) - kind_end - 5);
+    if (kind == "contig") {
+      header.contigs.push_back(id);
+      continue;
+    }
+    if (kind != "FILTER" and kind != "INFO" and kind != "FORMAT")
+      continue;
+    if (find(header.dictionary.begin(), header.dictionary.end(), id) == header.dictionary.end())
+      header.dictionary.push_back(id);
+    if (kind == "INFO")
+      header.info_type[id] = DeclaredType(line);
+    else if (kind == "FORMAT")
+      header.format_type[id] = DeclaredType(line);
+  }
+  return true;
+}
+
+static bool DecodeRecord(const string& bcf, size_t& offset, const DecodedHeader& header, DecodedRecord& record)
+{
+  BcfCursor lengths(bcf, offset, min(offset + 8, bcf.size()));
+  size_t shared_length = lengths.Get(4);
+  size_t individual_length = lengths.Get(4);
+  if (not lengths.ok or offset + 8 + shared_length + individual_length > bcf.size())
+    return false;
+
+  BcfCursor shared(bcf, offset + 8, offset + 8 + shared_length);
+  record.contig = (int32_t)shared.Get(4);
+  record.position = (int32_t)shared.Get(4);
+  record.ref_length = (int32_t)shared.Get(4);
+  uint32_t quality_bits = shared.Get(4);
+  memcpy(&record.quality, &quality_bits, 4);
+  uint32_t allele_info = shared.Get(4);
+  uint32_t format_sample = shared.Get(4);
+  int num_alleles = allele_info >> 16;
+  int num_info = allele_info & 0xffff;
+  int num_format = format_sample >> 24;
+  if ((format_sample & 0xffffff) != header.samples.size())
+    return false;
+
+  DecodedValues values;
+  shared.GetValues(values);
+  record.id = values.text.empty() ? "." : values.text;
+  record.alleles.clear();
+  for (int allele = 0; allele < num_alleles; ++allele) {
+    shared.GetValues(values);
+    record.alleles.push_back(values.text);
+  }
+  shared.GetValues(values);
+  record.filters.assign(values.numbers.begin(), values.numbers.end());
+  record.info.resize(num_info);
+  for (int info = 0; info < num_info; ++info) {
+    record.info[info].first = shared.GetInteger();
+    shared.GetValues(record.info[info].second);
+  }
+  if (not shared.ok or not shared.AtEnd())
+    return false;
+
+  BcfCursor individual(bcf, offset + 8 + shared_length, offset + 8 + shared_length + individual_length);
+  record.format_keys.resize(num_format);
+  record.format.resize(num_format);
+  for (int format = 0; format < num_format; ++format) {
+    record.format_keys[format] = individual.GetInteger();
+    int size, type;
+    individual.GetSize(size, type);
+    record.format[format].resize(header.samples.size());
+    for (unsigned int sample = 0; sample < header.samples.size(); ++sample)
+      individual.GetValues(record.format[format][sample], size, type);
+  }
+  if (not individual.ok or not individual.AtEnd())
+    return false;
+
+  offset += 8 + shared_length + individual_length;
+  return true;
+}
+
+// -------------------------------------------------------------------
+
+static void Split(const string& text, char separator, vector<string>& fields)
+{
+  fields.clear();
+  for (size_t field_start = 0; field_start <= text.size(); ) {
+    size_t field_end = text.find(separator, field_start);
+    if (field_end == string::npos)
+      field_end = text.size();
+    fields.push_back(text.substr(field_start, field_end - field_start));
+    field_start = field_end + 1;
+  }
+}
+
+// BCF2 keeps floats in single precision
+static bool CloseTo(double text_value, double bcf_value)
+{
+  return text_value == bcf_value or fabs(text_value - bcf_value) <= 1e-5 * max(fabs(text_value), fabs(bcf_value)) + 1e-37;
+}
+
+static bool SameValues(const string& type, const string& text, const DecodedValues& values)
+{
+  if (type == "String" or type == "Flag")
+    return values.type == kTypeChar and text == values.text.substr(0, values.text.find('\0'));
+
+  if ((text.empty() or text == ".") and values.numbers.size() == 1 and values.missing[0])
+    return true;
+  vector<string> text_values;
+  Split(text, ',', text_values);
+  if (text_values.size() != values.numbers.size())
+    return false;
+  for (unsigned int idx = 0; idx < text_values.size(); ++idx) {
+    if (text_values[idx].empty() or text_values[idx] == ".") {
+      if (not values.missing[idx])
+        return false;
+    } else if (values.missing[idx])
+      return false;
+    else if (type == "Integer" and strtol(text_values[idx].c_str(), NULL, 10) != (long)values.numbers[idx])
+      return false;
+    else if (type != "Integer" and not CloseTo(strtod(text_values[idx].c_str(), NULL), values.numbers[idx]))
+      return false;
+  }
+  return true;
+}
+
+static bool SameGenotype(const string& text, const DecodedValues& values)
+{
+  string genotype;
+  for (unsigned int idx = 0; idx < values.numbers.size(); ++idx) {
+    int allele = (int)values.numbers[idx];
+    if (idx)
+      genotype += (allele & 1) ? '|' : '/';
+    if ((allele >> 1) == 0)
+      genotype += '.';
+    else {
+      char number[16];
+      snprintf(number, sizeof(number), "%d", (allele >> 1) - 1);
+      genotype += number;
+    }
+  }
+  if ((text.empty() or text == ".") and genotype == ".")
+    return true;
+  return genotype == text;
+}
+
+//! Compare one VCF text line to the decoded BCF2 record
+static bool SameRecord(const string& line, const DecodedHeader& header, const DecodedRecord& record)
+{
+  vector<string> columns;
+  Split(line.substr(0, line.find('\n')), '\t', columns);
+  if (columns.size() < 8 or record.contig < 0 or record.contig >= (int)header.contigs.size())
+    return false;
+
+  vector<string> alts;
+  Split(columns[4], ',', alts);
+  alts.insert(alts.begin(), columns[3]);
+  if (columns[0] != header.contigs[record.contig] or atol(columns[1].c_str()) != record.position + 1
+      or columns[2] != record.id or alts != record.alleles or (long)columns[3].size() != record.ref_length
+      or not CloseTo(strtod(columns[5].c_str(), NULL), record.quality))
+    return false;
+
+  vector<string> filters;
+  if (columns[6] != ".")
+    Split(columns[6], ';', filters);
+  if (filters.size() != record.filters.size())
+    return false;
+  for (unsigned int idx = 0; idx < filters.size(); ++idx)
+    if (record.filters[idx] < 0 or record.filters[idx] >= (int)header.dictionary.size()
+        or header.dictionary[record.filters[idx]] != filters[idx])
+      return false;
+
+  // vcflib may leave empty entries between INFO separators
+  vector<string> entries, info;
+  Split(columns[7], ';', entries);
+  for (unsigned int idx = 0; idx < entries.size(); ++idx)
+    if (not entries[idx].empty() and entries[idx] != ".")
+      info.push_back(entries[idx]);
+  if (info.size() != record.info.size())
+    return false;
+  for (unsigned int idx = 0; idx < info.size(); ++idx) {
+    int key = record.info[idx].first;
+    if (key < 0 or key >= (int)header.dictionary.size())
+      return false;
+    size_t equals = info[idx].find('=');
+    if (info[idx].substr(0, equals) != header.dictionary[key])
+      return false;
+    map<string,string>::const_iterator type = header.info_type.find(header.dictionary[key]);
+    if (type == header.info_type.end())
+      return false;
+    if (type->second == "Flag") {
+      if (equals != string::npos or record.info[idx].second.type != kTypeNull)
+        return false;
+    } else if (equals == string::npos or not SameValues(type->second, info[idx].substr(equals + 1), record.info[idx].second))
+      return false;
+  }
+
+  if (columns.size() == 8)
+    return record.format_keys.empty();
+  if (columns.size() != 9 + header.samples.size())
+    return false;
+  vector<string> keys;
+  Split(columns[8], ':', keys);
+  if (keys.size() != record.format_keys.size())
+    return false;
+  for (unsigned int sample = 0; sample < header.samples.size(); ++sample) {
+    vector<string> sample_values;
+    Split(columns[9 + sample], ':', sample_values);
+    sample_values.resize(keys.size(), ".");
+    for (unsigned int idx = 0; idx < keys.size(); ++idx) {
+      int key = record.format_keys[idx];
+      if (key < 0 or key >= (int)header.dictionary.size() or header.dictionary[key] != keys[idx])
+        return false;
+      map<string,string>::const_iterator type = header.format_type.find(keys[idx]);
+      if (type == header.format_type.end())
+        return false;
+      const DecodedValues& values = record.format[idx][sample];
+      if (keys[idx] == "GT" ? not SameGenotype(sample_values[idx], values)
+                            : not SameValues(type->second, sample_values[idx], values))
+        return false;
+    }
+  }
+  return true;
+}
+
+// -------------------------------------------------------------------
+
+// Integers around the limits of the 8, 16 and 32 bit encodings
+static long RandomInteger(BenchRandom& random)
+{
+  static const long kRanges[3] = { 130, 33000, 2000000000 };
+  long range = kRanges[random.Next() % 3];
+  return (long)(random.Next() % (2 * range + 1)) - range;
+}
+
+static string RandomNumber(BenchRandom& random, bool is_integer)
+{
+  char text[64];
+  if (random.Next() % 10 == 0)
+    return ".";
+  if (is_integer)
+    snprintf(text, sizeof(text), "%ld", RandomInteger(random));
+  else
+    snprintf(text, sizeof(text), "%g", (random.Uniform() - 0.2) * pow(10.0, (int)(random.Next() % 12) - 6));
+  return text;
+}
+
+static double RandomAnnotation(BenchRandom& random, bool is_integer)
+{
+  if (is_integer)
+    return (double)RandomInteger(random);
+  switch (random.Next() % 4) {
+    case 0:  return 0.0;
+    case 1:  return random.Uniform();
+    case 2:  return ((long)(random.Next() % 2000000) - 1000000) / 7.0;
+    default: return (random.Uniform() - 0.5) * 1e-4;
+  }
+}
+
+//! A record with vcf::Variant strings and typed annotations in all the places WriteVcfRecord takes them from
+static void RandomRecord(BenchRandom& random, const ReferenceReader& ref_reader, const DecodedHeader& header,
+    vcf::Variant& var, VariantAnnotation& annotation)
+{
+  static const char *kBases = "ACGT";
+  static const char *kGenotypes[] = { "0/1", "1/1", "./.", ".", "0|1", "1/2", "0" };
+
+  int chr = random.Next() % ref_reader.chr_count();
+  var.sequenceName = ref_reader.chr_str(chr);
+  var.position = 1 + random.Next() % ref_reader.chr_size(chr);
+  var.id = (random.Next() % 5) ? "." : "rs12345";
+  var.ref = string(1 + random.Next() % 3, 'A');
+  var.alt.clear();
+  for (int num_alts = 1 + random.Next() % 3; num_alts > 0; --num_alts) {
+    var.alt.push_back("");
+    for (int length = 1 + random.Next() % 30; length > 0; --length)
+      var.alt.back() += kBases[random.Next() % 4];
+  }
+  var.quality = (random.Next() % 3) ? fabs(RandomAnnotation(random, false)) : 0.0;
+  var.filter = (random.Next() % 2) ? "PASS" : "NOCALL";
+
+  var.info.clear();
+  var.infoFlags.clear();
+  for (map<string,string>::const_iterator key = header.info_type.begin(); key != header.info_type.end(); ++key) {
+    if (random.Next() % 3)
+      continue;
+    if (key->second == "Flag") {
+      var.infoFlags[key->first] = true;
+      continue;
+    }
+    vector<string>& values = var.info[key->first];
+    for (int num_values = random.Next() % 3; num_values > 0; --num_values)
+      values.push_back(key->second == "String" ? string(random.Next() % 2 ? "." : "REALIGNEDx0.87")
+                                               : RandomNumber(random, key->second == "Integer"));
+  }
+
+  annotation = VariantAnnotation();
+  for (int field = 0; field < VariantAnnotation::NUM_INFO_FIELDS; ++field) {
+    int choice = random.Next() % 6;
+    if (choice < 2)
+      continue;
+    if (choice == 2) {
+      annotation.Push((VariantAnnotation::Field)field, 0);
+      annotation.Clear((VariantAnnotation::Field)field);
+      continue;
+    }
+    for (int num_values = 1 + random.Next() % 2; num_values > 0; --num_values)
+      annotation.Push((VariantAnnotation::Field)field, RandomAnnotation(random, VariantAnnotation::IsInteger(field)));
+  }
+
+  var.format.clear();
+  var.samples.clear();
+  var.outputSampleNames = header.samples;
+  if (random.Next() % 5 == 0)
+    return;
+  for (map<string,string>::const_iterator key = header.format_type.begin(); key != header.format_type.end(); ++key)
+    if (key->first == "GT" or random.Next() % 2)
+      var.format.push_back(key->first);
+  for (unsigned int sample = 0; sample < header.samples.size(); ++sample) {
+    int mode = random.Next() % 4;
+    if (mode == 0)
+      continue;
+    map<string, vector<string> >& values = var.samples[header.samples[sample]];
+    if (mode == 1)
+      continue;
+    if (random.Next() % 2)
+      values["GT"].push_back(kGenotypes[random.Next() % 7]);
+    if (random.Next() % 2)
+      values["GQ"].push_back(RandomNumber(random, true));
+    if (random.Next() % 2) {
+      values["AO"].push_back(RandomNumber(random, true));
+      values["AO"].push_back(RandomNumber(random, true));
+    }
+    if (mode == 3) {
+      VariantAnnotation::Block& block = annotation.Sample(header.samples[sample]);
+      for (int field = 0; field < VariantAnnotation::NUM_FORMAT_FIELDS; ++field)
+        if (random.Next() % 2)
+          for (int num_values = 1 + random.Next() % 2; num_values > 0; --num_values)
+            VariantAnnotation::Push(block, (VariantAnnotation::Field)field,
+                RandomAnnotation(random, VariantAnnotation::IsInteger(field)));
+    }
+  }
+}
+
+// -------------------------------------------------------------------
+
+int CheckBcf(int argc, const char *argv[])
+{
+  OptArgs opts;
+  opts.ParseCmdLine(argc, argv);
+  bool help               = opts.GetFirstBoolean('h', "help", false);
+  string reference        = opts.GetFirstString ('-', "reference", "");
+  string vcf_filename     = opts.GetFirstString ('-', "vcf", "");
+  int num_records         = opts.GetFirstInt    ('-', "num-records", 10000);
+  int seed                = opts.GetFirstInt    ('-', "seed", 1);
+  string output_bcf       = opts.GetFirstString ('-', "output-bcf", "");
+  opts.CheckNoLeftovers();
+
+  if (help) {
+    CheckBcfHelp();
+    return 0;
+  }
+  if (reference.empty() or vcf_filename.empty() or num_records < 0) {
+    CheckBcfHelp();
+    return 1;
+  }
+
+  ReferenceReader ref_reader;
+  ref_reader.Initialize(reference);
+
+  vcf::VariantCallFile vcf_file;
+  if (not vcf_file.open(vcf_filename)) {
+    fprintf(stderr, "ERROR: Cannot open %s\n", vcf_filename.c_str());
+    return 1;
+  }
+
+  // The text header as OrderedVCFWriter hands it over, without the trailing newline
+  string vcf_header = vcf_file.header;
+  while (not vcf_header.empty() and vcf_header[vcf_header.size()-1] == '\n')
+    vcf_header.erase(vcf_header.size()-1);
+  BcfHeader bcf_header;
+  bcf_header.Initialize(vcf_header, ref_reader);
+
+  string bcf;
+  bcf_header.AppendFileStart(bcf);
+  DecodedHeader header;
+  size_t offset = 0;
+  if (not DecodeHeader(bcf, header, offset)) {
+    fprintf(stderr, "ERROR: Cannot decode the BCF2 header\n");
+    return 1;
+  }
+
+  vector<string> lines;
+  vcf::Variant var(vcf_file);
+  VariantAnnotation no_annotation;
+  int num_vcf_records = 0;
+  while (vcf_file.getNextVariant(var)) {
+    lines.push_back("");
+    WriteVcfRecord(lines.back(), var, no_annotation);
+    WriteBcfRecord(bcf, bcf_header, var, no_annotation);
+    num_vcf_records++;
+  }
+
+  BenchRandom random(seed);
+  for (int record = 0; record < num_records; ++record) {
+    VariantAnnotation annotation;
+    RandomRecord(random, ref_reader, header, var, annotation);
+    lines.push_back("");
+    WriteVcfRecord(lines.back(), var, annotation);
+    WriteBcfRecord(bcf, bcf_header, var, annotation);
+  }
+
+  if (not output_bcf.empty()) {
+    ofstream out(output_bcf.c_str(), ios::out | ios::binary);
+    out.write(bcf.data(), bcf.size());
+    out.close();
+    if (out.fail()) {
+      fprintf(stderr, "ERROR: Failed writing %s\n", output_bcf.c_str());
+      return 1;
+    }
+  }
+
+  int num_mismatches = 0;
+  DecodedRecord record;
+  for (unsigned int idx = 0; idx < lines.size(); ++idx) {
+    bool decoded = DecodeRecord(bcf, offset, header, record);
+    if (decoded and SameRecord(lines[idx], header, record))
+      continue;
+    if (++num_mismatches <= 3)
+      fprintf(stderr, "%s record %d differs from its text:\n%s", decoded ? "BCF2" : "Undecodable BCF2", idx + 1, lines[idx].c_str());
+    if (not decoded)
+      break;
+  }
+  if (num_mismatches == 0 and offset != bcf.size())
+    num_mismatches = 1;
+
+  printf("BCF2 check against %s %s: %d of %d records differ (%d from the vcf, %d random)\n", vcf_filename.c_str(),
+      num_mismatches ? "FAILED" : "passed", num_mismatches, (int)lines.size(), num_vcf_records, num_records);
+  return num_mismatches ? 1 : 0;
+}
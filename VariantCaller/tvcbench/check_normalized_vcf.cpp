@@ -0,0 +1,386 @@
+/* Copyright (C) 2014 Ion Torrent Systems, Inc. All Rights Reserved */
+
+#include "tvcbench.h"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fstream>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#include "OptArgs.h"
+#include "IonVersion.h"
+#include "ReferenceReader.h"
+#include "TargetsManager.h"
+#include "ExtendParameters.h"
+#include "NormalizedVCFWriter.h"
+
+using namespace std;
+
+
+void CheckNormalizedVcfHelp()
+{
+  printf ("\n");
+  printf ("tvcbench %s-%s (%s) - Benchmarks for Torrent Variant Caller.\n",
+      IonVersion::GetVersion().c_str(), IonVersion::GetRelease().c_str(), IonVersion::GetGitHash().c_str());
+  printf ("\n");
+  printf ("Usage:   tvcbench normalize [options]\n");
+  printf ("\n");
+  printf ("Checks the --output-normalized-vcf writer. Random insertions and deletions on generated repeat-rich contigs\n");
+  printf ("must come out at the leftmost position a brute-force haplotype comparison finds, sorted, with QUAL rounded\n");
+  printf ("the way GATK rounds it. With --vcf, the normalized vcf must match --expected line by line, except for the\n");
+  printf ("##reference=file:// line, which holds the absolute reference path. Exit code 1 on any difference.\n");
+  printf ("\n");
+  printf ("Options:\n");
+  printf ("     --num-indels              INT        number of random insertions and deletions [20000]\n");
+  printf ("     --seed                    INT        random seed; equal seeds give equal indels on any platform [1]\n");
+  printf ("  -o,--output-dir              DIRECTORY  directory for the generated reference and the normalized vcfs [.]\n");
+  printf ("     --reference               FILE       reference fasta the vcf was called against []\n");
+  printf ("     --vcf                     FILE       tvc vcf to normalize []\n");
+  printf ("     --expected                FILE       expected normalized vcf [required with --vcf]\n");
+  printf ("\n");
+}
+
+
+// The same limits as LeftAlignVariants
+static const int kMaxLeftAlignLength = 200;
+static const int kLeftAlignWindow = 200;
+
+static const int kNumContigs = 3;
+static const int kContigLength = 3000;
+
+//! QUAL as tvc writes it and as GATK prints it after the round trip through log10PError
+static const char *kQualities[][2] = {
+  { "0", "0" },             { "37.5", "37.50" },      { "0.1", "0.10" },          { "12.345", "12.35" },
+  { "0.055", "0.05" },      { "0.105", "0.10" },      { "0.435", "0.43" },        { "2.675", "2.68" },
+  { "0.125", "0.13" },      { "0.995", "1" },         { "99.995", "100" },        { "5e-05", "0" },
+  { "1e+06", "1000000" },   { "18.6454", "18.65" },   { ".", "." }
+};
+static const int kNumQualities = sizeof(kQualities) / sizeof(kQualities[0]);
+
+//! INFO as tvc writes it and sorted by key, flags included, as GATK writes it
+static const char *kInfos[][2] = {
+  { "TYPE=del;AF=0.5;HS", "AF=0.5;HS;TYPE=del" },
+  { "AF=1", "AF=1" },
+  { "HS;AO=3;FR=.", "AO=3;FR=.;HS" },
+  { "LEN=2;HRUN=1;HS;FRO=3", "FRO=3;HRUN=1;HS;LEN=2" }
+};
+static const int kNumInfos = sizeof(kInfos) / sizeof(kInfos[0]);
+
+
+struct Indel {
+  int     chr;
+  long    position;           //! POS as called
+  long    expected_position;  //! POS after left alignment
+  string  line;               //! Record as tvc writes it
+  string  expected;           //! Record as GATK writes it
+  bool operator<(const Indel& other) const {
+    if (chr != other.chr)
+      return chr < other.chr;
+    return position < other.position;
+  }
+};
+
+//! Expected output order: reference order of the left-aligned records, then as sort_vcf.py breaks ties
+static bool ExpectedOrder(const Indel& a, const Indel& b)
+{
+  if (a.chr != b.chr)
+    return a.chr < b.chr;
+  if (a.expected_position != b.expected_position)
+    return a.expected_position < b.expected_position;
+  if (a.position != b.position)
+    return a.position < b.position;
+  return a.expected < b.expected;
+}
+
+
+static string ContigName(int chr)
+{
+  return string("chr") + char('1' + chr);
+}
+
+static bool IsRecordLine(const string& line)
+{
+  return line.empty() or line[0] != '#';
+}
+
+
+//! Short units repeated a few times, and now and then many times
+static string RepeatRichContig(BenchRandom& random)
+{
+  static const char kBases[4] = {'A','C','G','T'};
+  string sequence;
+  while ((int)sequence.size() < kContigLength) {
+    string unit;
+    for (int length = 1 + random.Next() % 4; length > 0; --length)
+      unit += kBases[random.Next() % 4];
+    int num_copies = 1 + random.Next() % ((random.Next() % 10) ? 4 : 80);
+    for (int copy = 0; copy < num_copies; ++copy)
+      sequence += unit;
+  }
+  sequence.resize(kContigLength);
+  return sequence;
+}
+
+// Base k (0-based) of the contig after deleting length bases at start
+static char DeletionHaplotype(const string& contig, long start, int length, long k)
+{
+  return k < start ? contig[k] : contig[k + length];
+}
+
+// Base k (0-based) of the contig after inserting inserted before start
+static char InsertionHaplotype(const string& contig, long start, const string& inserted, long k)
+{
+  if (k < start)
+    return contig[k];
+  if (k < start + (long)inserted.size())
+    return inserted[k - start];
+  return contig[k - inserted.size()];
+}
+
+//! Leftmost POS within the window whose indel leaves the same haplotype, by comparing haplotypes base by base.
+//! Left of the leftmost position and right of the rightmost event both haplotypes are the reference, so the
+//! comparison covers the stretch in between.
+static long LeftmostEquivalent(const string& contig, long position, bool deletion, const string& indel, string& shifted)
+{
+  int length = indel.size();
+  shifted = indel;
+  if (length > kMaxLeftAlignLength)
+    return position;
+  for (long candidate = max(0L, position - kLeftAlignWindow - 1) + 1; candidate < position; ++candidate) {
+    string candidate_indel;
+    if (deletion)
+      candidate_indel = contig.substr(candidate, length);
+    else
+      for (long k = candidate; k < candidate + length; ++k)
+        candidate_indel += InsertionHaplotype(contig, position, indel, k);
+
+    bool same = true;
+    long end = deletion ? position : position + length;
+    for (long k = candidate; same and k < end; ++k) {
+      if (deletion)
+        same = DeletionHaplotype(contig, candidate, length, k) == DeletionHaplotype(contig, position, length, k);
+      else
+        same = InsertionHaplotype(contig, candidate, candidate_indel, k) == InsertionHaplotype(contig, position, indel, k);
+    }
+    if (same) {
+      shifted = candidate_indel;
+      return candidate;
+    }
+  }
+  return position;
+}
+
+static void RandomIndel(BenchRandom& random, const vector<string>& contigs, Indel& indel)
+{
+  static const char kBases[4] = {'A','C','G','T'};
+  static const int kLengths[] = { 1, 1, 2, 3, 4, 5, 8, 150, 200, 201, 250 };
+
+  indel.chr = random.Next() % contigs.size();
+  const string& contig = contigs[indel.chr];
+  int length = kLengths[random.Next() % (sizeof(kLengths) / sizeof(kLengths[0]))];
+  indel.position = 1 + random.Next() % (contig.size() - 260);
+  long start = indel.position;   // 0-based start of the event, after the padding base
+  bool deletion = random.Next() % 2;
+
+  string event;
+  if (deletion)
+    event = contig.substr(start, length);
+  else if (random.Next() % 2 or start < length)
+    for (int idx = 0; idx < length; ++idx)
+      event += kBases[random.Next() % 4];
+  else
+    event = contig.substr(start - length, length);   // a copy of the bases before it, so it has room to move
+
+  string shifted;
+  indel.expected_position = LeftmostEquivalent(contig, start, deletion, event, shifted);
+
+  const char **quality = kQualities[random.Next() % kNumQualities];
+  const char **info = kInfos[random.Next() % kNumInfos];
+  char padding = contig[start - 1];
+  char expected_padding = contig[indel.expected_position - 1];
+  char position_text[24];
+
+  snprintf(position_text, sizeof(position_text), "%ld", indel.position);
+  indel.line = ContigName(indel.chr) + "\t" + position_text + "\t.\t";
+  indel.line += deletion ? padding + event : string(1, padding);
+  indel.line += "\t";
+  indel.line += deletion ? string(1, padding) : padding + event;
+  indel.line += string("\t") + quality[0] + "\tPASS\t" + info[0] + "\tGT\t0/1\n";
+
+  snprintf(position_text, sizeof(position_text), "%ld", indel.expected_position);
+  indel.expected = ContigName(indel.chr) + "\t" + position_text + "\t.\t";
+  indel.expected += deletion ? expected_padding + shifted : string(1, expected_padding);
+  indel.expected += "\t";
+  indel.expected += deletion ? string(1, expected_padding) : expected_padding + shifted;
+  indel.expected += string("\t") + quality[1] + "\tPASS\t" + info[1] + "\tGT\t0/1\n";
+}
+
+// -------------------------------------------------------------------
+
+static bool ReadLines(const string& filename, vector<string>& lines)
+{
+  ifstream input(filename.c_str());
+  if (not input.is_open())
+    return false;
+  string line;
+  while (getline(input, line))
+    lines.push_back(line + "\n");
+  return true;
+}
+
+// Lines that differ, with the ##reference=file:// line skipped on both sides
+static int CountDifferences(const vector<string>& lines, const vector<string>& expected_lines, const string& filename)
+{
+  vector<string> found, expected;
+  for (unsigned int idx = 0; idx < lines.size(); ++idx)
+    if (lines[idx].compare(0, 19, "##reference=file://") != 0)
+      found.push_back(lines[idx]);
+  for (unsigned int idx = 0; idx < expected_lines.size(); ++idx)
+    if (expected_lines[idx].compare(0, 19, "##reference=file://") != 0)
+      expected.push_back(expected_lines[idx]);
+
+  int num_differences = max(found.size(), expected.size()) - min(found.size(), expected.size());
+  for (unsigned int idx = 0; idx < min(found.size(), expected.size()); ++idx) {
+    if (found[idx] == expected[idx])
+      continue;
+    if (++num_differences <= 3)
+      fprintf(stderr, "Line %d of %s differs:\n%s  expected:\n%s", idx + 1, filename.c_str(),
+          found[idx].c_str(), expected[idx].c_str());
+  }
+  return num_differences;
+}
+
+static int CheckRandomIndels(ExtendParameters& parameters, int num_indels, int seed, const string& output_dir)
+{
+  BenchRandom random(seed);
+  vector<string> names, contigs;
+  for (int chr = 0; chr < kNumContigs; ++chr) {
+    names.push_back(ContigName(chr));
+    contigs.push_back(RepeatRichContig(random));
+  }
+  string reference = output_dir + "normalize_reference.fasta";
+  if (not WriteFasta(reference, names, contigs)) {
+    fprintf(stderr, "ERROR: Failed writing %s\n", reference.c_str());
+    return 1;
+  }
+
+  vector<Indel> indels(num_indels);
+  for (int idx = 0; idx < num_indels; ++idx)
+    RandomIndel(random, contigs, indels[idx]);
+  // tvc writes its records in calling order
+  sort(indels.begin(), indels.end());
+
+  ReferenceReader ref_reader;
+  ref_reader.Initialize(reference);
+  TargetsManager targets_manager;
+  parameters.fasta = reference;
+  string normalized_vcf = output_dir + "normalize_random.vcf";
+  NormalizedVCFWriter writer;
+  writer.Initialize(normalized_vcf, "##fileformat=VCFv4.1\n#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT\tsample",
+      parameters, ref_reader, targets_manager);
+  for (int idx = 0; idx < num_indels; ++idx)
+    writer.AddRecord(indels[idx].line, 0);
+  writer.Close();
+
+  sort(indels.begin(), indels.end(), ExpectedOrder);
+  vector<string> lines, expected_lines;
+  if (not ReadLines(normalized_vcf, lines)) {
+    fprintf(stderr, "ERROR: Cannot open %s\n", normalized_vcf.c_str());
+    return 1;
+  }
+  lines.erase(lines.begin(), find_if(lines.begin(), lines.end(), IsRecordLine));
+  for (int idx = 0; idx < num_indels; ++idx)
+    expected_lines.push_back(indels[idx].expected);
+  int num_differences = CountDifferences(lines, expected_lines, normalized_vcf);
+
+  int num_shifted = 0;
+  for (int idx = 0; idx < num_indels; ++idx)
+    if (indels[idx].expected_position != indels[idx].position)
+      num_shifted++;
+  printf("Normalized VCF check of random indels %s: %d of %d records differ (%d left-aligned, %d QUAL values)\n",
+      num_differences ? "FAILED" : "passed", num_differences, num_indels, num_shifted, kNumQualities);
+  return num_differences ? 1 : 0;
+}
+
+static int CheckExpectedVcf(ExtendParameters& parameters, const string& reference, const string& vcf_filename, const string& expected_filename,
+    const string& output_dir)
+{
+  vector<string> input_lines, expected_lines;
+  if (not ReadLines(vcf_filename, input_lines)) {
+    fprintf(stderr, "ERROR: Cannot open %s\n", vcf_filename.c_str());
+    return 1;
+  }
+  if (not ReadLines(expected_filename, expected_lines)) {
+    fprintf(stderr, "ERROR: Cannot open %s\n", expected_filename.c_str());
+    return 1;
+  }
+
+  // The header as OrderedVCFWriter hands it over, without the trailing newline
+  string vcf_header;
+  unsigned int first_record = 0;
+  for (; first_record < input_lines.size() and not IsRecordLine(input_lines[first_record]); ++first_record)
+    vcf_header += input_lines[first_record];
+  if (not vcf_header.empty())
+    vcf_header.erase(vcf_header.size() - 1);
+
+  ReferenceReader ref_reader;
+  ref_reader.Initialize(reference);
+  TargetsManager targets_manager;
+  parameters.fasta = reference;
+  string normalized_vcf = output_dir + "normalize_expected.vcf";
+  NormalizedVCFWriter writer;
+  writer.Initialize(normalized_vcf, vcf_header, parameters, ref_reader, targets_manager);
+  for (unsigned int idx = first_record; idx < input_lines.size(); ++idx)
+    writer.AddRecord(input_lines[idx], 0);
+  writer.Close();
+
+  vector<string> lines;
+  if (not ReadLines(normalized_vcf, lines)) {
+    fprintf(stderr, "ERROR: Cannot open %s\n", normalized_vcf.c_str());
+    return 1;
+  }
+  int num_differences = CountDifferences(lines, expected_lines, normalized_vcf);
+  printf("Normalized VCF check of %s against %s %s: %d of %d lines differ\n", vcf_filename.c_str(),
+      expected_filename.c_str(), num_differences ? "FAILED" : "passed", num_differences, (int)expected_lines.size());
+  return num_differences ? 1 : 0;
+}
+
+// -------------------------------------------------------------------
+
+int CheckNormalizedVcf(int argc, const char *argv[])
+{
+  OptArgs opts;
+  opts.ParseCmdLine(argc, argv);
+  bool help               = opts.GetFirstBoolean('h', "help", false);
+  int num_indels          = opts.GetFirstInt    ('-', "num-indels", 20000);
+  int seed                = opts.GetFirstInt    ('-', "seed", 1);
+  string output_dir       = opts.GetFirstString ('o', "output-dir", ".");
+  string reference        = opts.GetFirstString ('-', "reference", "");
+  string vcf_filename     = opts.GetFirstString ('-', "vcf", "");
+  string expected         = opts.GetFirstString ('-', "expected", "");
+  opts.CheckNoLeftovers();
+
+  if (help) {
+    CheckNormalizedVcfHelp();
+    return 0;
+  }
+  if (num_indels < 0 or output_dir.empty() or vcf_filename.empty() != expected.empty()
+      or vcf_filename.empty() != reference.empty()) {
+    CheckNormalizedVcfHelp();
+    return 1;
+  }
+
+  mkdir(output_dir.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+  output_dir += "/";
+
+  // tvc defaults: no bgzip and no target restriction; the reference is set per check
+  const char *tvc_argv[] = { "tvc", "--reference", "unused.fasta", "--input-bam", "unused.bam", "--output-vcf", "unused.vcf" };
+  ExtendParameters parameters(7, (char **)tvc_argv);
+
+  int result = CheckRandomIndels(parameters, num_indels, seed, output_dir);
+  if (not vcf_filename.empty())
+    result |= CheckExpectedVcf(parameters, reference, vcf_filename, expected, output_dir);
+  return result;
+}
@@ -0,0 +1,127 @@
+/* Copyright (C) 2014 Ion Torrent Systems, Inc. All Rights Reserved */
+
+#include "tvcbench.h"
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+#include "OptArgs.h"
+#include "IonVersion.h"
+#include "Realigner.h"
+
+using namespace std;
+
+
+void CheckRealignerHelp()
+{
+  printf ("\n");
+  printf ("tvcbench %s-%s (%s) - Benchmarks for Torrent Variant Caller.\n",
+      IonVersion::GetVersion().c_str(), IonVersion::GetRelease().c_str(), IonVersion::GetGitHash().c_str());
+  printf ("\n");
+  printf ("Usage:   tvcbench realigner [options]\n");
+  printf ("\n");
+  printf ("Realigns random reads with the banded Smith-Waterman of the Realigner and its cross check against the\n");
+  printf ("full matrix reference implementation. Exit code 1 if any alignment differs.\n");
+  printf ("\n");
+  printf ("Options:\n");
+  printf ("     --num-alignments          INT        number of random alignments [10000]\n");
+  printf ("     --max-length              INT        longest reference window [60]\n");
+  printf ("     --seed                    INT        random seed; equal seeds give equal alignments on any platform [1]\n");
+  printf ("\n");
+}
+
+
+//! Random reference window, a read derived from it by edits and the alignment path of those edits
+static void RandomAlignment(BenchRandom& random, int max_length, string& query, string& target, string& path)
+{
+  static const char *kBases = "ACGT";
+  static const char *kIupac = "ACGTNRYKMSWBDHV";
+
+  query.clear();
+  target.clear();
+  path.clear();
+  int length = 1 + random.Next() % max_length;
+  for (int i = 0; i < length; ++i)
+    target += kBases[random.Next() % 4];
+
+  for (int i = 0; i < length; ++i) {
+    int edit = random.Next() % 20;
+    if (edit == 0)
+      path += '-';
+    else if (edit == 1) {
+      query += kBases[random.Next() % 4];
+      path += '+';
+      query += target[i];
+      path += '|';
+    } else if (edit == 2) {
+      char base = kBases[random.Next() % 4];
+      query += base;
+      path += (base == target[i]) ? '|' : ' ';
+    } else {
+      query += target[i];
+      path += '|';
+    }
+  }
+  // Ambiguity codes on either side, as found in references and in hypotheses
+  if (random.Next() % 10 == 0 and not query.empty())
+    query[random.Next() % query.size()] = kIupac[random.Next() % 15];
+  if (random.Next() % 10 == 0)
+    target[random.Next() % target.size()] = kIupac[random.Next() % 15];
+  if (query.empty()) {
+    query = "A";
+    path = "|" + path;
+  }
+}
+
+
+int CheckRealigner(int argc, const char *argv[])
+{
+  OptArgs opts;
+  opts.ParseCmdLine(argc, argv);
+  bool help               = opts.GetFirstBoolean('h', "help", false);
+  int num_alignments      = opts.GetFirstInt    ('-', "num-alignments", 10000);
+  int max_length          = opts.GetFirstInt    ('-', "max-length", 60);
+  int seed                = opts.GetFirstInt    ('-', "seed", 1);
+  opts.CheckNoLeftovers();
+
+  if (help) {
+    CheckRealignerHelp();
+    return 0;
+  }
+  if (num_alignments < 1 or max_length < 1) {
+    CheckRealignerHelp();
+    return 1;
+  }
+
+  BenchRandom random(seed);
+  Realigner realigner(1000, 1);
+  realigner.cross_check_ = true;
+
+  string query, target, path;
+  vector<CigarOp> cigar;
+  vector<MDelement> md;
+  int num_aligned = 0;
+
+  for (int i_alignment = 0; i_alignment < num_alignments; ++i_alignment) {
+    RandomAlignment(random, max_length, query, target, path);
+
+    // Vary clipping, strand and tube width the way callers do
+    int clipping = random.Next() % 5;
+    bool is_forward = random.Next() % 2;
+    int bandwidth = (random.Next() % 3 == 0) ? 20 : random.Next() % 8;
+    realigner.SetClipping(clipping, is_forward);
+    realigner.SetStrand(is_forward);
+    realigner.SetAlignmentBandwidth(bandwidth);
+    realigner.SetSequences(query, target, path, is_forward);
+
+    unsigned int start_position_shift = 0;
+    if (realigner.computeSWalignment(cigar, md, start_position_shift))
+      num_aligned++;
+  }
+
+  printf("Realigner cross check %s: %d of %d alignments differ, %d outside the tube were skipped\n",
+      realigner.num_cross_check_diffs_ ? "FAILED" : "passed", realigner.num_cross_check_diffs_, num_aligned,
+      num_alignments - num_aligned);
+  return realigner.num_cross_check_diffs_ ? 1 : 0;
+}
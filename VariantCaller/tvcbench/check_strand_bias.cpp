@@ -0,0 +1,178 @@
+/* Copyright (C) 2014 Ion Torrent Systems, Inc. All Rights Reserved */
+
+#include "tvcbench.h"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <assert.h>
+
+#include "OptArgs.h"
+#include "IonVersion.h"
+#include "RandSchrange.h"
+#include "VariantAssist.h"
+
+using namespace std;
+
+
+void CheckStrandBiasHelp()
+{
+  printf ("\n");
+  printf ("tvcbench %s-%s (%s) - Benchmarks for Torrent Variant Caller.\n",
+      IonVersion::GetVersion().c_str(), IonVersion::GetRelease().c_str(), IonVersion::GetGitHash().c_str());
+  printf ("\n");
+  printf ("Usage:   tvcbench strandbias [options]\n");
+  printf ("\n");
+  printf ("Compares the strand bias p-value of BootstrapStrandBias on random count tables to an exact sum over all\n");
+  printf ("pairs of strand counts, and to the 1000 sample bootstrap it replaced. Exit code 1 if the exact sums differ\n");
+  printf ("or the bootstrap deviates by more than its Monte-Carlo error.\n");
+  printf ("\n");
+  printf ("Options:\n");
+  printf ("     --num-tables              INT        number of random count tables [1000]\n");
+  printf ("     --max-depth               INT        largest depth per strand [200]\n");
+  printf ("     --tune-sbias              FLOAT      strand bias tuning, as tvc --tune-sbias [0.01]\n");
+  printf ("     --seed                    INT        random seed; equal seeds give equal tables on any platform [1]\n");
+  printf ("\n");
+}
+
+
+// Bootstrap samples of the old estimator
+static const int kNumBootstrap = 1000;
+
+
+//! The estimator BootstrapStrandBias used to be: proportion of 1000 binomial resamples at least as biased as observed
+static float BootstrapStrandBiasSampled(long int plus_var, long int plus_depth, long int neg_var, long int neg_depth, float tune_fish)
+{
+  if ((neg_depth == 0) || (plus_depth == 0))
+    return 1.0;
+  float observed = fabs(ComputeTransformStrandBias(plus_var, plus_depth, neg_var, neg_depth, tune_fish));
+  double p = (plus_var+neg_var)/( (double)(plus_depth + neg_depth));
+
+  RandSchrange rand_generator;
+  rand_generator.SetSeed(1);
+  double total = 0;
+  for (long int i=0; i<kNumBootstrap; i++){
+    long int bootstrap_plus = 0;
+    long int bootstrap_neg = 0;
+    for (long int j=0; j < plus_depth; j++)
+      if ((double)(rand_generator.Rand())/rand_generator.RandMax < p)
+        bootstrap_plus++;
+    for (long int j=0; j < neg_depth; j++)
+      if ((double)(rand_generator.Rand())/rand_generator.RandMax < p)
+        bootstrap_neg++;
+    float bootstrap = fabs(ComputeTransformStrandBias(bootstrap_plus, plus_depth, bootstrap_neg, neg_depth, tune_fish));
+    if ( bootstrap >= observed)
+      total++;
+  }
+  return (float) (total/kNumBootstrap);
+}
+
+
+// Same null distribution as the bootstrap, summed over every pair of strand counts
+static double StrandBiasExhaustive(long int plus_var, long int plus_depth, long int neg_var, long int neg_depth, float tune_fish)
+{
+  if ((neg_depth == 0) || (plus_depth == 0))
+    return 1.0;
+  float observed = fabs(ComputeTransformStrandBias(plus_var, plus_depth, neg_var, neg_depth, tune_fish));
+  double p = (plus_var+neg_var)/( (double)(plus_depth + neg_depth));
+
+  vector<double> plus_prob(plus_depth+1), neg_prob(neg_depth+1);
+  for (long int k = 0; k <= plus_depth; ++k)
+    plus_prob[k] = exp(lgamma(plus_depth+1.0) - lgamma(k+1.0) - lgamma(plus_depth-k+1.0)
+        + (k ? k*log(p) : 0.0) + (plus_depth-k ? (plus_depth-k)*log(1.0-p) : 0.0));
+  for (long int k = 0; k <= neg_depth; ++k)
+    neg_prob[k] = exp(lgamma(neg_depth+1.0) - lgamma(k+1.0) - lgamma(neg_depth-k+1.0)
+        + (k ? k*log(p) : 0.0) + (neg_depth-k ? (neg_depth-k)*log(1.0-p) : 0.0));
+
+  double total = 0.0;
+  for (long int x = 0; x <= plus_depth; ++x)
+    for (long int y = 0; y <= neg_depth; ++y)
+      if (fabs(ComputeTransformStrandBias(x, plus_depth, y, neg_depth, tune_fish)) >= observed)
+        total += plus_prob[x] * neg_prob[y];
+  return min(total, 1.0);
+}
+
+
+//! Random count table: depths from 0 to max_depth, strand frequencies near or apart from each other
+static void RandomCounts(BenchRandom& random, int max_depth, long int& plus_var, long int& plus_depth,
+    long int& neg_var, long int& neg_depth)
+{
+  plus_depth = random.Next() % (max_depth + 1);
+  neg_depth = random.Next() % (max_depth + 1);
+  double frequency = random.Uniform();
+  double plus_frequency = frequency, neg_frequency = frequency;
+  if (random.Next() % 2)
+    plus_frequency = min(1.0, frequency * 2 * random.Uniform());
+  plus_var = (long int)(plus_frequency * plus_depth + 0.5);
+  neg_var = (long int)(neg_frequency * neg_depth + 0.5);
+  switch (random.Next() % 8) {
+    case 0:  plus_var = 0; break;
+    case 1:  neg_var = neg_depth; break;
+  }
+}
+
+
+int CheckStrandBias(int argc, const char *argv[])
+{
+  OptArgs opts;
+  opts.ParseCmdLine(argc, argv);
+  bool help               = opts.GetFirstBoolean('h', "help", false);
+  int num_tables          = opts.GetFirstInt    ('-', "num-tables", 1000);
+  int max_depth           = opts.GetFirstInt    ('-', "max-depth", 200);
+  double tune_fish        = opts.GetFirstDouble ('-', "tune-sbias", 0.01);
+  int seed                = opts.GetFirstInt    ('-', "seed", 1);
+  opts.CheckNoLeftovers();
+
+  if (help) {
+    CheckStrandBiasHelp();
+    return 0;
+  }
+  if (num_tables < 1 or max_depth < 0) {
+    CheckStrandBiasHelp();
+    return 1;
+  }
+
+  BenchRandom random(seed);
+  int num_exact_diffs = 0, num_outliers = 0, num_flips = 0;
+  double max_exact_diff = 0, sum_z2 = 0;
+
+  for (int table = 0; table < num_tables; ++table) {
+    long int plus_var, plus_depth, neg_var, neg_depth;
+    RandomCounts(random, max_depth, plus_var, plus_depth, neg_var, neg_depth);
+
+    float pval = BootstrapStrandBias(plus_var, plus_depth, neg_var, neg_depth, tune_fish);
+    double exhaustive = StrandBiasExhaustive(plus_var, plus_depth, neg_var, neg_depth, tune_fish);
+    float sampled = BootstrapStrandBiasSampled(plus_var, plus_depth, neg_var, neg_depth, tune_fish);
+
+    double exact_diff = fabs(pval - exhaustive);
+    max_exact_diff = max(max_exact_diff, exact_diff);
+    if (exact_diff > 1e-5) {
+      if (++num_exact_diffs <= 3)
+        fprintf(stderr, "Strand bias of %ld/%ld %ld/%ld is %g, exhaustive sum %g\n",
+            plus_var, plus_depth, neg_var, neg_depth, pval, exhaustive);
+    }
+
+    // Deviation from the old estimator in units of its binomial standard error
+    double error = sqrt(max(pval * (1.0 - pval), 0.25 / kNumBootstrap) / kNumBootstrap);
+    double z = (sampled - pval) / error;
+    sum_z2 += z * z;
+    if (fabs(z) > 5.0) {
+      if (++num_outliers <= 3)
+        fprintf(stderr, "Strand bias of %ld/%ld %ld/%ld is %g, the bootstrap gave %g\n",
+            plus_var, plus_depth, neg_var, neg_depth, pval, sampled);
+    }
+    if ((pval < 0.05f) != (sampled < 0.05f))
+      num_flips++;
+  }
+
+  // The bootstrap is an unbiased estimate, so its standardized deviations have a mean square near 1
+  double rms_z = sqrt(sum_z2 / num_tables);
+  bool failed = num_exact_diffs or num_outliers or rms_z > 1.5;
+  printf("Strand bias check %s: %d of %d tables differ from the exhaustive sum (largest difference %g),\n",
+      failed ? "FAILED" : "passed", num_exact_diffs, num_tables, max_exact_diff);
+  printf("  bootstrap deviation %.2f standard errors rms, %d beyond 5, %d on the other side of 0.05\n",
+      rms_z, num_outliers, num_flips);
+  return failed ? 1 : 0;
+}
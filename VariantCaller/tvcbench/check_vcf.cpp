@@ -0,0 +1,388 @@
+/* Copyright (C) 2014 Ion Torrent Systems, Inc. All Rights Reserved */
+
+#include "tvcbench.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <sstream>
+#include <math.h>
+#include <stdio.h>
+
+#include "OptArgs.h"
+#include "IonVersion.h"
+#include "MiscUtil.h"
+#include "VariantAnnotation.h"
+#include "VcfFormat.h"
+#include <Variant.h>
+
+using namespace std;
+
+
+void CheckVcfHelp()
+{
+  printf ("\n");
+  printf ("tvcbench %s-%s (%s) - Benchmarks for Torrent Variant Caller.\n",
+      IonVersion::GetVersion().c_str(), IonVersion::GetRelease().c_str(), IonVersion::GetGitHash().c_str());
+  printf ("\n");
+  printf ("Usage:   tvcbench vcf [options]\n");
+  printf ("\n");
+  printf ("Formats fixed edge cases and random records with typed annotations by WriteVcfRecord, and the same records\n");
+  printf ("with the annotation converted to strings by vcflib's operator<<. Exit code 1 unless all are byte identical.\n");
+  printf ("\n");
+  printf ("Options:\n");
+  printf ("     --num-records             INT        number of random records [10000]\n");
+  printf ("     --seed                    INT        random seed; equal seeds give equal records on any platform [1]\n");
+  printf ("\n");
+}
+
+
+static const char *kSampleNames[] = { "85", "NA12878" };
+static const int kNumSamples = 2;
+
+// Values where %g rounds, switches notation, or would show binary noise at higher precision
+static const double kRealEdges[] = { 1e-05, 123456.7, 0.1 + 0.2, 1234567.0, 0.0001, 999999.5, -0.0, -2.5e-7, 1.0/3.0, 0.0 };
+static const int kNumRealEdges = sizeof(kRealEdges) / sizeof(kRealEdges[0]);
+
+
+//! The annotation written into the vcf::Variant string maps, as convertToString did before VariantAnnotation
+static void MirrorAnnotation(vcf::Variant& var, const VariantAnnotation& annotation)
+{
+  for (int field = 0; field < VariantAnnotation::NUM_INFO_FIELDS; ++field) {
+    const AnnotationValues& values = annotation.Info((VariantAnnotation::Field)field);
+    if (not values.present)
+      continue;
+    vector<string>& text = var.info[VariantAnnotation::Key(field)];
+    text.clear();
+    for (unsigned int idx = 0; idx < values.values.size(); ++idx)
+      text.push_back(VariantAnnotation::IsInteger(field) ? convertToString((long)values.values[idx])
+                                                         : convertToString(values.values[idx]));
+  }
+  for (vector<string>::const_iterator sample = var.outputSampleNames.begin(); sample != var.outputSampleNames.end(); ++sample) {
+    const VariantAnnotation::Block *block = annotation.FindSample(*sample);
+    if (not block)
+      continue;
+    for (int field = 0; field < VariantAnnotation::NUM_FORMAT_FIELDS; ++field) {
+      if (not block->field[field].present)
+        continue;
+      vector<string>& text = var.samples[*sample][VariantAnnotation::Key(field)];
+      text.clear();
+      for (unsigned int idx = 0; idx < block->field[field].values.size(); ++idx)
+        text.push_back(VariantAnnotation::IsInteger(field) ? convertToString((long)block->field[field].values[idx])
+                                                           : convertToString(block->field[field].values[idx]));
+    }
+  }
+}
+
+static void StartRecord(vcf::Variant& var, VariantAnnotation& annotation, const char *ref, const char *alts)
+{
+  var = vcf::Variant();
+  annotation = VariantAnnotation();
+  var.sequenceName = "chr7";
+  var.position = 55259515;
+  var.id = ".";
+  var.ref = ref;
+  var.alt.clear();
+  string alts_text = alts;
+  for (size_t start = 0; start <= alts_text.size(); ) {
+    size_t end = alts_text.find(',', start);
+    if (end == string::npos)
+      end = alts_text.size();
+    var.alt.push_back(alts_text.substr(start, end - start));
+    start = end + 1;
+  }
+  var.quality = 37.5;
+  var.filter = "PASS";
+  var.sampleNames.assign(kSampleNames, kSampleNames + kNumSamples);
+  var.outputSampleNames = var.sampleNames;
+}
+
+//! The cases the two writers are most likely to disagree on; returns NULL past the last one
+static const char * FixedRecord(int index, vcf::Variant& var, VariantAnnotation& annotation)
+{
+  switch (index) {
+    case 0:
+      StartRecord(var, annotation, "TC", "T,TCC,AC");
+      var.info["TYPE"].push_back("del");
+      var.info["TYPE"].push_back("ins");
+      var.info["TYPE"].push_back("snp");
+      var.info["HRUN"].assign(3, "2");
+      for (int alt = 0; alt < 3; ++alt) {
+        annotation.Push(VariantAnnotation::AF, 0.25 * alt);
+        annotation.Push(VariantAnnotation::FAO, 10 * alt);
+        annotation.Push(VariantAnnotation::STB, 0.5 + 0.1 * alt);
+      }
+      annotation.Push(VariantAnnotation::FDP, 120);
+      var.format.push_back("GT");
+      var.format.push_back("GQ");
+      var.format.push_back("AF");
+      var.format.push_back("FAO");
+      var.samples["85"]["GT"].push_back("1/2");
+      var.samples["85"]["GQ"].push_back("99");
+      for (int alt = 0; alt < 3; ++alt) {
+        VariantAnnotation::Push(annotation.Sample("85"), VariantAnnotation::AF, 0.25 * alt);
+        VariantAnnotation::Push(annotation.Sample("85"), VariantAnnotation::FAO, 10 * alt);
+      }
+      return "multi-allelic";
+
+    case 1:
+      StartRecord(var, annotation, "A", "G");
+      var.infoFlags["HS"] = true;
+      return "flag without INFO values";
+
+    case 2:
+      StartRecord(var, annotation, "A", "G");
+      var.infoFlags["HS"] = true;
+      var.infoFlags["SOMATIC"] = true;
+      annotation.Push(VariantAnnotation::QD, 12.5);
+      return "flags after annotation only";
+
+    case 3:
+      StartRecord(var, annotation, "A", "G");
+      var.info["AA"];
+      annotation.Push(VariantAnnotation::AF, 0.5);
+      var.info["TYPE"].push_back("snp");
+      return "empty first key from the variant";
+
+    case 4:
+      StartRecord(var, annotation, "A", "G");
+      annotation.Push(VariantAnnotation::AF, 0);
+      annotation.Clear(VariantAnnotation::AF);
+      annotation.Push(VariantAnnotation::FAO, 7);
+      var.infoFlags["HS"] = true;
+      return "empty first key from the annotation";
+
+    case 5:
+      StartRecord(var, annotation, "A", "G");
+      var.info["TYPE"];
+      annotation.Push(VariantAnnotation::QD, 0);
+      annotation.Clear(VariantAnnotation::QD);
+      var.infoFlags["HS"] = true;
+      return "only empty keys, then a flag";
+
+    case 6:
+      StartRecord(var, annotation, "A", "G");
+      var.info["AF"].push_back("0.1");
+      var.info["FAO"].push_back("3");
+      annotation.Push(VariantAnnotation::AF, 0.125);
+      return "annotation replacing a string value of the same key";
+
+    case 7:
+      StartRecord(var, annotation, "A", "G");
+      var.info["TYPE"].push_back(".");
+      var.info["OID"].push_back(".");
+      var.info["OID"].push_back("");
+      annotation.Push(VariantAnnotation::FAO, 0);
+      var.format.push_back("GT");
+      var.format.push_back("GQ");
+      var.format.push_back("FDP");
+      var.samples["85"]["GT"].push_back("0/1");
+      var.samples["85"]["GQ"].push_back(".");
+      var.samples["NA12878"];
+      return "missing values and an empty sample";
+
+    case 8:
+      StartRecord(var, annotation, "A", "G");
+      var.format.push_back("GT");
+      var.format.push_back("FDP");
+      VariantAnnotation::Push(annotation.Sample("NA12878"), VariantAnnotation::FDP, 40);
+      VariantAnnotation::Push(annotation.Sample("85"), VariantAnnotation::FRO, 0);
+      VariantAnnotation::Push(annotation.Sample("unlisted"), VariantAnnotation::FDP, 41);
+      return "sample values only in the annotation";
+
+    case 9:
+      StartRecord(var, annotation, "A", "G,T");
+      var.quality = 123456.7;
+      for (int edge = 0; edge < kNumRealEdges; ++edge)
+        annotation.Push(VariantAnnotation::RBI, kRealEdges[edge]);
+      annotation.Push(VariantAnnotation::AF, 1e-05);
+      annotation.Push(VariantAnnotation::AF, 0.1 + 0.2);
+      annotation.Push(VariantAnnotation::QD, 123456.7);
+      annotation.Push(VariantAnnotation::FDP, 2147483647.0);
+      annotation.Push(VariantAnnotation::FRO, -2147483647.0);
+      var.format.push_back("AF");
+      VariantAnnotation::Push(annotation.Sample("85"), VariantAnnotation::AF, 1e-05);
+      VariantAnnotation::Push(annotation.Sample("85"), VariantAnnotation::AF, 123456.7);
+      return "%g edge values";
+
+    case 10:
+      StartRecord(var, annotation, "AT", "A");
+      var.quality = 0;
+      var.filter = "NOCALL";
+      var.info["FR"].push_back(".");
+      var.format.push_back("GT");
+      var.format.push_back("GQ");
+      var.format.push_back("FDP");
+      var.format.push_back("FRO");
+      var.format.push_back("AF");
+      var.format.push_back("FAO");
+      NullGenotypeAllSamples(var, annotation);
+      return "no-call genotypes";
+
+    case 11: {
+      StartRecord(var, annotation, "C", "CA");
+      var.quality = 12.25;
+      var.format.push_back("GT");
+      var.format.push_back("GQ");
+      var.format.push_back("FDP");
+      string genotype = "0/1";
+      StoreGenotypeForOneSample(var, "85", genotype, 12.25);
+      VariantAnnotation::Push(annotation.Sample("85"), VariantAnnotation::FDP, 300);
+      string reason = "STDBIAS0.987>0.95";
+      SetFilteredStatus(var, true);
+      AddFilterReason(var, reason);
+      DetectAndSetFilteredGenotype(var, "85");
+      return "filtered genotype";
+    }
+
+    case 12:
+      StartRecord(var, annotation, "G", "A");
+      var.format.push_back("GT");
+      return "format without any sample values";
+  }
+  return NULL;
+}
+
+// -------------------------------------------------------------------
+
+static double RandomReal(BenchRandom& random)
+{
+  switch (random.Next() % 4) {
+    case 0:  return kRealEdges[random.Next() % kNumRealEdges];
+    case 1:  return random.Uniform();
+    case 2:  return ((long)(random.Next() % 2000000) - 1000000) / 7.0;
+    default: return (random.Uniform() - 0.5) * pow(10.0, (int)(random.Next() % 16) - 8);
+  }
+}
+
+static double RandomValue(BenchRandom& random, int field)
+{
+  if (VariantAnnotation::IsInteger(field))
+    return (double)((long)(random.Next() % 4000001) - 2000000);
+  return RandomReal(random);
+}
+
+// Empty fields only in INFO: vcflib's join reads past an empty FORMAT vector, so tvc never produced those
+static void RandomAnnotationBlock(BenchRandom& random, VariantAnnotation::Block& block, int num_fields, bool allow_empty)
+{
+  for (int field = 0; field < num_fields; ++field) {
+    int choice = random.Next() % 6;
+    if (choice < 3)
+      continue;
+    block.field[field].present = true;
+    if (choice == 3 and allow_empty)
+      continue;
+    for (int num_values = random.Next() % 3 + 1; num_values > 0; --num_values)
+      block.field[field].values.push_back(RandomValue(random, field));
+  }
+}
+
+//! Random mix of variant strings, flags and annotation, with keys interleaving and overlapping
+static void RandomRecord(BenchRandom& random, vcf::Variant& var, VariantAnnotation& annotation)
+{
+  static const char *kInfoKeys[] = { "AA", "AF", "FR", "HRUN", "HS_ONLY", "LEN", "OID", "QD", "TYPE", "ZZ" };
+  static const char *kInfoValues[] = { "0", ".", "", "snp", "REALIGNEDx0.87", "1e-05", "NODATA" };
+  static const char *kFlags[] = { "HS", "SOMATIC", "AAA_FIRST" };
+  static const char *kFormatKeys[] = { "GT", "GQ", "DP", "AF", "FAO", "FDP", "FRO", "FSAF", "FSRR" };
+  static const char *kGenotypes[] = { "0/1", "1/1", "./.", ".", "0|1", "1/2", "0/0" };
+
+  StartRecord(var, annotation, "A", (random.Next() % 3) ? "C" : "C,GT,TTT");
+  var.position = 1 + random.Next() % 250000000;
+  var.id = (random.Next() % 5) ? "." : "rs12345";
+  var.quality = (random.Next() % 4) ? fabs(RandomReal(random)) : 0.0;
+  var.filter = (random.Next() % 2) ? "PASS" : "NOCALL";
+
+  for (int key = 0; key < 10; ++key) {
+    if (random.Next() % 3)
+      continue;
+    vector<string>& values = var.info[kInfoKeys[key]];
+    for (int num_values = random.Next() % 3; num_values > 0; --num_values)
+      values.push_back(kInfoValues[random.Next() % 7]);
+  }
+  for (int flag = 0; flag < 3; ++flag)
+    if (random.Next() % 3 == 0)
+      var.infoFlags[kFlags[flag]] = true;
+  RandomAnnotationBlock(random, annotation.InfoBlock(), VariantAnnotation::NUM_INFO_FIELDS, true);
+
+  if (random.Next() % 5 == 0)
+    return;
+  for (int key = 0; key < 9; ++key)
+    if (key == 0 or random.Next() % 2)
+      var.format.push_back(kFormatKeys[key]);
+  for (int sample = 0; sample < kNumSamples; ++sample) {
+    int mode = random.Next() % 5;
+    if (mode == 0)
+      continue;
+    if (mode == 1) {
+      var.samples[kSampleNames[sample]];
+      continue;
+    }
+    map<string, vector<string> >& values = var.samples[kSampleNames[sample]];
+    if (random.Next() % 2)
+      values["GT"].push_back(kGenotypes[random.Next() % 7]);
+    if (random.Next() % 2)
+      values["GQ"].push_back(random.Next() % 4 ? convertToString(random.Next() % 100) : string("."));
+    if (random.Next() % 2)
+      values["AF"].push_back("0.5");
+    if (mode >= 3)
+      RandomAnnotationBlock(random, annotation.Sample(kSampleNames[sample]), VariantAnnotation::NUM_FORMAT_FIELDS, false);
+  }
+}
+
+// -------------------------------------------------------------------
+
+//! Both writers on one record; prints the first few differences
+static bool SameText(const char *description, vcf::Variant& var, const VariantAnnotation& annotation, int& num_mismatches)
+{
+  string line;
+  WriteVcfRecord(line, var, annotation);
+
+  vcf::Variant mirror = var;
+  MirrorAnnotation(mirror, annotation);
+  ostringstream expected;
+  expected << mirror << endl;
+
+  if (line == expected.str())
+    return true;
+  if (++num_mismatches <= 3)
+    fprintf(stderr, "WriteVcfRecord differs from vcflib for %s:\n%s%s", description, line.c_str(), expected.str().c_str());
+  return false;
+}
+
+int CheckVcf(int argc, const char *argv[])
+{
+  OptArgs opts;
+  opts.ParseCmdLine(argc, argv);
+  bool help               = opts.GetFirstBoolean('h', "help", false);
+  int num_records         = opts.GetFirstInt    ('-', "num-records", 10000);
+  int seed                = opts.GetFirstInt    ('-', "seed", 1);
+  opts.CheckNoLeftovers();
+
+  if (help) {
+    CheckVcfHelp();
+    return 0;
+  }
+  if (num_records < 0) {
+    CheckVcfHelp();
+    return 1;
+  }
+
+  vcf::Variant var;
+  VariantAnnotation annotation;
+  int num_mismatches = 0;
+  int num_fixed = 0;
+  for (const char *description; (description = FixedRecord(num_fixed, var, annotation)) != NULL; ++num_fixed)
+    SameText(description, var, annotation, num_mismatches);
+
+  BenchRandom random(seed);
+  for (int record = 0; record < num_records; ++record) {
+    RandomRecord(random, var, annotation);
+    char description[64];
+    snprintf(description, sizeof(description), "random record %d", record + 1);
+    SameText(description, var, annotation, num_mismatches);
+  }
+
+  printf("VCF record check %s: %d of %d records differ from vcflib (%d fixed cases, %d random)\n",
+      num_mismatches ? "FAILED" : "passed", num_mismatches, num_fixed + num_records, num_fixed, num_records);
+  return num_mismatches ? 1 : 0;
+}
@@ -0,0 +1,469 @@
+/* Copyright (C) 2014 Ion Torrent Systems, Inc. All Rights Reserved */
+
+#include "tvcbench.h"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "api/BamReader.h"
+#include "api/BamWriter.h"
+
+#include "OptArgs.h"
+#include "IonVersion.h"
+#include "DPTreephaser.h"
+
+using namespace std;
+using namespace BamTools;
+
+
+void GenerateDatasetHelp()
+{
+  printf ("\n");
+  printf ("tvcbench %s-%s (%s) - Benchmarks for Torrent Variant Caller.\n",
+      IonVersion::GetVersion().c_str(), IonVersion::GetRelease().c_str(), IonVersion::GetGitHash().c_str());
+  printf ("\n");
+  printf ("Usage:   tvcbench generate [options]\n");
+  printf ("\n");
+  printf ("Writes reference.fasta(.fai), targets.bed, reads.bam(.bai) and truth.vcf into the output directory.\n");
+  printf ("\n");
+  printf ("General options:\n");
+  printf ("  -o,--output-dir                DIRECTORY  output directory, created if needed [required]\n");
+  printf ("     --seed                      INT        random seed [1]\n");
+  printf ("\n");
+  printf ("Layout options:\n");
+  printf ("     --num-contigs               INT        number of reference contigs [2]\n");
+  printf ("     --num-amplicons             INT        number of amplicons, spread evenly over the contigs [200]\n");
+  printf ("     --amplicon-length           INT        amplicon length including primers [200]\n");
+  printf ("     --primer-length             INT        primer length; targets exclude the primers [20]\n");
+  printf ("     --depth                     INT        reads per amplicon, half of them on each strand [500]\n");
+  printf ("     --read-length               INT        maximum read length, reads are cut short where the flows run out [200]\n");
+  printf ("\n");
+  printf ("Signal options:\n");
+  printf ("     --flow-order                STRING     flow order cycle [TACGTACGTCTGAGCATCGATCGATGTACAGC]\n");
+  printf ("     --num-flows                 INT        number of flows [520]\n");
+  printf ("     --key                       STRING     key sequence [TCAG]\n");
+  printf ("     --cf                        FLOAT      carry forward rate [0.006]\n");
+  printf ("     --ie                        FLOAT      incomplete extension rate [0.004]\n");
+  printf ("     --dr                        FLOAT      droop [0.0005]\n");
+  printf ("     --noise                     FLOAT      standard deviation of the gaussian signal noise [0.07]\n");
+  printf ("     --error-rate                FLOAT      per base rate of homopolymer indel errors in the called bases [0.005]\n");
+  printf ("\n");
+  printf ("Variant options:\n");
+  printf ("     --variant-rate              FLOAT      fraction of amplicons with a spiked SNP or homopolymer indel [0.5]\n");
+  printf ("     --variant-af                FLOAT      fraction of reads carrying the spiked variant [0.5]\n");
+  printf ("\n");
+}
+
+
+// One entry of a read in reference orientation: an aligned base, an inserted base, or a deleted reference base
+struct ReadEntry {
+  ReadEntry(char _op, char _base) : op(_op), base(_base) {}
+  char  op;     //! 'M', 'I' or 'D'
+  char  base;   //! Read base, 0 for 'D'
+};
+
+struct SpikedVariant {
+  SpikedVariant() : type(0), pos(-1), alt(0) {}
+  char  type;   //! 'X' for SNP, 'I' for one more copy of ref[pos], 'D' for deletion of ref[pos], 0 for none
+  long  pos;    //! Reference position of the event
+  char  alt;    //! SNP base
+};
+
+struct Amplicon {
+  int           chr;
+  long          begin;
+  long          end;
+  SpikedVariant variant;
+};
+
+
+static char Complement(char base)
+{
+  switch (base) {
+    case 'A': return 'T';
+    case 'C': return 'G';
+    case 'G': return 'C';
+    case 'T': return 'A';
+    default:  return 'N';
+  }
+}
+
+
+// Walk the reference span, applying the variant and the error events
+static void BuildEntries(const string& chr_seq, long begin, long end, const SpikedVariant& variant,
+    const vector<SpikedVariant>& errors, vector<ReadEntry>& entries)
+{
+  entries.clear();
+  vector<SpikedVariant>::const_iterator error = errors.begin();
+  for (long pos = begin; pos < end; ++pos) {
+    const SpikedVariant *event = NULL;
+    if (variant.pos == pos)
+      event = &variant;
+    while (error != errors.end() and error->pos < pos)
+      ++error;
+    if (event == NULL and error != errors.end() and error->pos == pos)
+      event = &(*error);
+
+    if (event and event->type == 'D') {
+      entries.push_back(ReadEntry('D', 0));
+      continue;
+    }
+    entries.push_back(ReadEntry('M', (event and event->type == 'X') ? event->alt : chr_seq[pos]));
+    if (event and event->type == 'I')
+      entries.push_back(ReadEntry('I', chr_seq[pos]));
+  }
+}
+
+
+static bool CompareAlignmentPositions(const BamAlignment& a, const BamAlignment& b)
+{
+  return a.Position < b.Position;
+}
+
+
+static void AdvanceFlow(const ion::FlowOrder& flow_order, char base, int& flow)
+{
+  while (flow < flow_order.num_flows() and flow_order.nuc_at(flow) != base)
+    flow++;
+}
+
+
+bool WriteFasta(const string& filename, const vector<string>& names, const vector<string>& sequences)
+{
+  FILE *fasta = fopen(filename.c_str(), "w");
+  FILE *fai = fopen((filename + ".fai").c_str(), "w");
+  if (!fasta or !fai) {
+    if (fasta) fclose(fasta);
+    if (fai) fclose(fai);
+    return false;
+  }
+  const int kLineLength = 60;
+  long offset = 0;
+  for (unsigned int chr = 0; chr < names.size(); ++chr) {
+    offset += fprintf(fasta, ">%s\n", names[chr].c_str());
+    fprintf(fai, "%s\t%ld\t%ld\t%d\t%d\n", names[chr].c_str(), (long)sequences[chr].size(), offset, kLineLength, kLineLength + 1);
+    for (long pos = 0; pos < (long)sequences[chr].size(); pos += kLineLength)
+      offset += fprintf(fasta, "%s\n", sequences[chr].substr(pos, kLineLength).c_str());
+  }
+  bool success = (fclose(fai) == 0);
+  return (fclose(fasta) == 0) and success;
+}
+
+
+int GenerateDataset(int argc, const char *argv[])
+{
+  OptArgs opts;
+  opts.ParseCmdLine(argc, argv);
+  string output_dir       = opts.GetFirstString ('o', "output-dir", "");
+  int seed                = opts.GetFirstInt    ('-', "seed", 1);
+  int num_contigs         = opts.GetFirstInt    ('-', "num-contigs", 2);
+  int num_amplicons       = opts.GetFirstInt    ('-', "num-amplicons", 200);
+  int amplicon_length     = opts.GetFirstInt    ('-', "amplicon-length", 200);
+  int primer_length       = opts.GetFirstInt    ('-', "primer-length", 20);
+  int depth               = opts.GetFirstInt    ('-', "depth", 500);
+  int read_length         = opts.GetFirstInt    ('-', "read-length", 200);
+  string flow_cycle       = opts.GetFirstString ('-', "flow-order", "TACGTACGTCTGAGCATCGATCGATGTACAGC");
+  int num_flows           = opts.GetFirstInt    ('-', "num-flows", 520);
+  string key              = opts.GetFirstString ('-', "key", "TCAG");
+  double cf               = opts.GetFirstDouble ('-', "cf", 0.006);
+  double ie               = opts.GetFirstDouble ('-', "ie", 0.004);
+  double dr               = opts.GetFirstDouble ('-', "dr", 0.0005);
+  double noise            = opts.GetFirstDouble ('-', "noise", 0.07);
+  double error_rate       = opts.GetFirstDouble ('-', "error-rate", 0.005);
+  double variant_rate     = opts.GetFirstDouble ('-', "variant-rate", 0.5);
+  double variant_af       = opts.GetFirstDouble ('-', "variant-af", 0.5);
+  opts.CheckNoLeftovers();
+
+  if (output_dir.empty() or num_contigs < 1 or num_amplicons < 1 or depth < 1 or flow_cycle.empty() or key.empty()
+      or amplicon_length < 2 * primer_length + 40 or read_length < 20) {
+    GenerateDatasetHelp();
+    return 1;
+  }
+
+  mkdir(output_dir.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+  output_dir += "/";
+
+  BenchRandom random(seed);
+  static const char kBases[4] = {'A','C','G','T'};
+  const int kSpacing = 300;   // Reference bases between neighboring amplicons
+
+  //
+  // Step 1. Reference and amplicon layout
+  //
+
+  vector<string> chr_names(num_contigs);
+  vector<string> chr_seqs(num_contigs);
+  vector<Amplicon> amplicons;
+  amplicons.reserve(num_amplicons);
+  int amplicons_per_contig = (num_amplicons + num_contigs - 1) / num_contigs;
+
+  for (int chr = 0; chr < num_contigs; ++chr) {
+    char name[32];
+    snprintf(name, sizeof(name), "chr%d", chr + 1);
+    chr_names[chr] = name;
+    int contig_amplicons = min(amplicons_per_contig, num_amplicons - (int)amplicons.size());
+    long chr_size = (long)max(contig_amplicons, 0) * (kSpacing + amplicon_length) + kSpacing;
+    chr_seqs[chr].resize(chr_size);
+    for (long pos = 0; pos < chr_size; ++pos)
+      chr_seqs[chr][pos] = kBases[random.Next() & 3];
+
+    for (int idx = 0; idx < contig_amplicons; ++idx) {
+      amplicons.push_back(Amplicon());
+      Amplicon& amplicon = amplicons.back();
+      amplicon.chr = chr;
+      amplicon.begin = kSpacing + (long)idx * (kSpacing + amplicon_length);
+      amplicon.end = amplicon.begin + amplicon_length;
+      if (random.Uniform() >= variant_rate)
+        continue;
+      long interior = amplicon_length - 2 * primer_length - 20;
+      amplicon.variant.pos = amplicon.begin + primer_length + 10 + (long)(random.Uniform() * interior);
+      double type = random.Uniform();
+      amplicon.variant.type = type < 0.6 ? 'X' : (type < 0.8 ? 'I' : 'D');
+      char ref_base = chr_seqs[chr][amplicon.variant.pos];
+      do {
+        amplicon.variant.alt = kBases[random.Next() & 3];
+      } while (amplicon.variant.alt == ref_base);
+    }
+  }
+
+  if (not WriteFasta(output_dir + "reference.fasta", chr_names, chr_seqs)) {
+    fprintf(stderr, "ERROR: Failed writing %sreference.fasta\n", output_dir.c_str());
+    return 1;
+  }
+
+  //
+  // Step 2. Targets and truth, homopolymer indels left-aligned the way tvc reports them
+  //
+
+  FILE *bed = fopen((output_dir + "targets.bed").c_str(), "w");
+  FILE *vcf = fopen((output_dir + "truth.vcf").c_str(), "w");
+  if (!bed or !vcf) {
+    fprintf(stderr, "ERROR: Cannot open targets.bed or truth.vcf in %s for writing\n", output_dir.c_str());
+    return 1;
+  }
+  fprintf(bed, "track type=bedDetail\n");
+  fprintf(vcf, "##fileformat=VCFv4.1\n");
+  fprintf(vcf, "##source=\"tvcbench generate --seed %d --variant-af %g\"\n", seed, variant_af);
+  for (int chr = 0; chr < num_contigs; ++chr)
+    fprintf(vcf, "##contig=<ID=%s,length=%ld>\n", chr_names[chr].c_str(), (long)chr_seqs[chr].size());
+  fprintf(vcf, "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\n");
+
+  int num_variants = 0;
+  for (unsigned int idx = 0; idx < amplicons.size(); ++idx) {
+    const Amplicon& amplicon = amplicons[idx];
+    const string& chr_seq = chr_seqs[amplicon.chr];
+    fprintf(bed, "%s\t%ld\t%ld\tAMP_%u\t0\t+\t.\t.\n", chr_names[amplicon.chr].c_str(),
+        amplicon.begin + primer_length, amplicon.end - primer_length, idx + 1);
+
+    const SpikedVariant& variant = amplicon.variant;
+    if (variant.type == 0)
+      continue;
+    num_variants++;
+    long anchor = variant.pos;
+    string ref, alt;
+    if (variant.type == 'X') {
+      ref = chr_seq[variant.pos];
+      alt = variant.alt;
+    } else {
+      while (anchor > 0 and chr_seq[anchor - 1] == chr_seq[variant.pos])
+        anchor--;
+      anchor--;
+      ref = chr_seq[anchor];
+      alt = chr_seq[anchor];
+      if (variant.type == 'I')
+        alt += chr_seq[variant.pos];
+      else
+        ref += chr_seq[variant.pos];
+    }
+    fprintf(vcf, "%s\t%ld\t.\t%s\t%s\t.\t.\tAF=%g\n", chr_names[amplicon.chr].c_str(), anchor + 1,
+        ref.c_str(), alt.c_str(), variant_af);
+  }
+  fclose(bed);
+  fclose(vcf);
+
+  //
+  // Step 3. Reads
+  //
+
+  ion::FlowOrder flow_order(flow_cycle, num_flows);
+  DPTreephaser treephaser(flow_order);
+  treephaser.SetModelParameters(cf, ie, dr);
+
+  int key_flow = 0;
+  for (unsigned int idx = 0; idx < key.size(); ++idx)
+    AdvanceFlow(flow_order, key[idx], key_flow);
+  // Leave some flows after the last base, as the basecaller would
+  const int last_usable_flow = num_flows - 20;
+  if (key_flow >= last_usable_flow) {
+    fprintf(stderr, "ERROR: Key %s does not fit into %d flows\n", key.c_str(), num_flows);
+    return 1;
+  }
+
+  string sam_header = "@HD\tVN:1.4\tSO:coordinate\n";
+  RefVector references;
+  for (int chr = 0; chr < num_contigs; ++chr) {
+    char line[256];
+    snprintf(line, sizeof(line), "@SQ\tSN:%s\tLN:%ld\n", chr_names[chr].c_str(), (long)chr_seqs[chr].size());
+    sam_header += line;
+    references.push_back(RefData(chr_names[chr], chr_seqs[chr].size()));
+  }
+  sam_header += "@RG\tID:BENCH\tSM:bench\tPL:IONTORRENT\tKS:" + key + "\tFO:";
+  for (int flow = 0; flow < num_flows; ++flow)
+    sam_header += flow_order.nuc_at(flow);
+  sam_header += "\n";
+
+  string bam_filename = output_dir + "reads.bam";
+  BamWriter bam_writer;
+  if (not bam_writer.Open(bam_filename, sam_header, references)) {
+    fprintf(stderr, "ERROR: Could not open %s for writing : %s\n", bam_filename.c_str(), bam_writer.GetErrorString().c_str());
+    return 1;
+  }
+
+  vector<float> phase_params(3);
+  phase_params[0] = cf;
+  phase_params[1] = ie;
+  phase_params[2] = dr;
+
+  long num_reads = 0;
+  long num_bases = 0;
+  vector<BamAlignment> amplicon_reads;
+  vector<ReadEntry> called;
+  vector<ReadEntry> truth;
+  vector<SpikedVariant> errors;
+  vector<SpikedVariant> no_errors;
+  BasecallerRead bc_read;
+
+  for (unsigned int idx = 0; idx < amplicons.size(); ++idx) {
+    const Amplicon& amplicon = amplicons[idx];
+    const string& chr_seq = chr_seqs[amplicon.chr];
+    amplicon_reads.clear();
+
+    for (int i_read = 0; i_read < depth; ++i_read) {
+      bool is_reverse = (i_read & 1);
+      long span_begin = is_reverse ? max(amplicon.begin, amplicon.end - read_length) : amplicon.begin;
+      long span_end = is_reverse ? amplicon.end : min(amplicon.end, amplicon.begin + read_length);
+      SpikedVariant variant;
+      if (amplicon.variant.type and random.Uniform() < variant_af)
+        variant = amplicon.variant;
+
+      // Homopolymer over- and under-calls, away from the read ends and the variant
+      errors.clear();
+      for (long pos = span_begin + 2; pos < span_end - 2; ++pos) {
+        if (pos == variant.pos or random.Uniform() >= error_rate)
+          continue;
+        errors.push_back(SpikedVariant());
+        errors.back().type = (random.Next() & 1) ? 'I' : 'D';
+        errors.back().pos = pos;
+      }
+      BuildEntries(chr_seq, span_begin, span_end, variant, errors, called);
+      BuildEntries(chr_seq, span_begin, span_end, variant, no_errors, truth);
+
+      // Keep the called bases that fit into the flows, counting from the 5' end of the read
+      int num_entries = called.size();
+      int flow = key_flow;
+      int num_kept = 0;
+      int start_flow = -1;
+      int last_flow = key_flow;
+      for (int i_entry = 0; i_entry < num_entries; ++i_entry) {
+        const ReadEntry& entry = called[is_reverse ? num_entries - 1 - i_entry : i_entry];
+        if (entry.op == 'D')
+          continue;
+        char base = is_reverse ? Complement(entry.base) : entry.base;
+        AdvanceFlow(flow_order, base, flow);
+        if (flow >= last_usable_flow)
+          break;
+        if (start_flow < 0)
+          start_flow = flow;
+        last_flow = flow;
+        num_kept = i_entry + 1;
+      }
+      // A cut through an indel error would leave the alignment ending in I or D
+      while (num_kept > 0 and called[is_reverse ? num_entries - num_kept : num_kept - 1].op != 'M')
+        num_kept--;
+      if (start_flow < 0 or num_kept == 0)
+        continue;
+
+      // Alignment from the kept entries, in reference orientation
+      int first_kept = is_reverse ? num_entries - num_kept : 0;
+      long position = span_begin;
+      for (int i_entry = 0; i_entry < first_kept; ++i_entry)
+        if (called[i_entry].op != 'I')
+          position++;
+
+      BamAlignment alignment;
+      vector<CigarOp> cigar;
+      for (int i_entry = first_kept; i_entry < first_kept + num_kept; ++i_entry) {
+        const ReadEntry& entry = called[i_entry];
+        if (entry.op != 'D')
+          alignment.QueryBases += entry.base;
+        if (cigar.empty() or cigar.back().Type != entry.op)
+          cigar.push_back(CigarOp(entry.op, 0));
+        cigar.back().Length++;
+      }
+
+      // Signal of the true template, read orientation, key included
+      string true_bases;
+      for (vector<ReadEntry>::const_iterator entry = truth.begin(); entry != truth.end(); ++entry)
+        if (entry->op != 'D')
+          true_bases += entry->base;
+      bc_read.sequence.assign(key.begin(), key.end());
+      if (is_reverse)
+        for (string::reverse_iterator base = true_bases.rbegin(); base != true_bases.rend(); ++base)
+          bc_read.sequence.push_back(Complement(*base));
+      else
+        bc_read.sequence.insert(bc_read.sequence.end(), true_bases.begin(), true_bases.end());
+      treephaser.Simulate(bc_read, num_flows);
+
+      int num_measurements = min(num_flows, last_flow + 20);
+      vector<int16_t> measurements(num_measurements);
+      for (int flow = 0; flow < num_measurements; ++flow) {
+        double signal = (bc_read.prediction[flow] + noise * random.Gaussian()) * 256;
+        measurements[flow] = (int16_t)max(-32768.0, min(32767.0, floor(signal + 0.5)));
+      }
+
+      char name[64];
+      snprintf(name, sizeof(name), "BENCH:%ld:%ld", num_reads / 10000, num_reads % 10000);
+      alignment.Name = name;
+      alignment.Qualities.assign(alignment.QueryBases.size(), (char)(33 + 20));
+      alignment.RefID = amplicon.chr;
+      alignment.Position = position;
+      alignment.MapQuality = 60;
+      alignment.AlignmentFlag = 0;
+      alignment.SetIsReverseStrand(is_reverse);
+      alignment.CigarData = cigar;
+      alignment.MateRefID = -1;
+      alignment.MatePosition = -1;
+      alignment.InsertSize = 0;
+      alignment.AddTag("RG", "Z", string("BENCH"));
+      alignment.AddTag("ZF", "i", (int32_t)start_flow);
+      alignment.AddTag("ZP", phase_params);
+      alignment.AddTag("ZM", measurements);
+
+      amplicon_reads.push_back(alignment);
+      num_reads++;
+      num_bases += alignment.QueryBases.size();
+    }
+
+    // Amplicons do not overlap, so sorting within each one keeps the whole file sorted
+    stable_sort(amplicon_reads.begin(), amplicon_reads.end(), CompareAlignmentPositions);
+    for (vector<BamAlignment>::const_iterator read = amplicon_reads.begin(); read != amplicon_reads.end(); ++read)
+      bam_writer.SaveAlignment(*read);
+  }
+  bam_writer.Close();
+
+  BamReader index_reader;
+  if (not index_reader.Open(bam_filename) or not index_reader.CreateIndex(BamIndex::STANDARD)) {
+    fprintf(stderr, "ERROR: Could not index %s : %s\n", bam_filename.c_str(), index_reader.GetErrorString().c_str());
+    return 1;
+  }
+  index_reader.Close();
+
+  printf("Wrote %ld reads (%.1f bases per read) over %d amplicons on %d contigs, with %d spiked variants, to %s\n",
+      num_reads, num_reads ? (double)num_bases / num_reads : 0.0, (int)amplicons.size(), num_contigs,
+      num_variants, output_dir.c_str());
+  return 0;
+}
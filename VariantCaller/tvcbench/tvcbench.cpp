@@ -0,0 +1,54 @@
+/* Copyright (C) 2014 Ion Torrent Systems, Inc. All Rights Reserved */
+
+#include "tvcbench.h"
+
+#include <string>
+#include <stdio.h>
+
+#include "IonVersion.h"
+
+using namespace std;
+
+
+void TVCBenchHelp()
+{
+  printf ("\n");
+  printf ("tvcbench %s-%s (%s) - Benchmarks for Torrent Variant Caller.\n",
+      IonVersion::GetVersion().c_str(), IonVersion::GetRelease().c_str(), IonVersion::GetGitHash().c_str());
+  printf ("\n");
+  printf ("Usage:   tvcbench <command> [options]\n");
+  printf ("\n");
+  printf ("Commands:\n");
+  printf ("         kernels           Time the treephaser kernels on synthetic reads, optionally check their output\n");
+  printf ("         generate          Write a synthetic flow-space BAM, reference, targets and truth vcf for tvc\n");
+  printf ("         realigner         Check the banded realigner against its full matrix reference on random alignments\n");
+  printf ("         bcf               Check BCF2 output against the VCF text of the same records\n");
+  printf ("         strandbias        Check the strand bias p-value against an exhaustive sum and the former bootstrap\n");
+  printf ("         vcf               Check VCF records with typed annotations against vcflib's text output\n");
+  printf ("         normalize         Check the normalized VCF against brute-force left alignment and an expected VCF\n");
+  printf ("\n");
+}
+
+
+int main(int argc, const char *argv[])
+{
+  if(argc < 2) {
+    TVCBenchHelp();
+    return 1;
+  }
+
+  string tvcbench_command = argv[1];
+
+  if      (tvcbench_command == "kernels") return BenchKernels(argc-1, argv+1);
+  else if (tvcbench_command == "generate") return GenerateDataset(argc-1, argv+1);
+  else if (tvcbench_command == "realigner") return CheckRealigner(argc-1, argv+1);
+  else if (tvcbench_command == "bcf")      return CheckBcf(argc-1, argv+1);
+  else if (tvcbench_command == "strandbias") return CheckStrandBias(argc-1, argv+1);
+  else if (tvcbench_command == "vcf")      return CheckVcf(argc-1, argv+1);
+  else if (tvcbench_command == "normalize") return CheckNormalizedVcf(argc-1, argv+1);
+  else {
+      fprintf(stderr, "ERROR: unrecognized tvcbench command '%s'\n", tvcbench_command.c_str());
+      return 1;
+  }
+  return 0;
+}
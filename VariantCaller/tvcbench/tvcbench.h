@@ -0,0 +1,41 @@
+/* Copyright (C) 2014 Ion Torrent Systems, Inc. All Rights Reserved */
+
+#ifndef TVCBENCH_H
+#define TVCBENCH_H
+
+#include <math.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+int BenchKernels(int argc, const char *argv[]);
+int GenerateDataset(int argc, const char *argv[]);
+int CheckRealigner(int argc, const char *argv[]);
+int CheckBcf(int argc, const char *argv[]);
+int CheckStrandBias(int argc, const char *argv[]);
+int CheckVcf(int argc, const char *argv[]);
+int CheckNormalizedVcf(int argc, const char *argv[]);
+
+//! Write sequences as a fasta file with its .fai index
+bool WriteFasta(const std::string& filename, const std::vector<std::string>& names, const std::vector<std::string>& sequences);
+
+
+//! Small xorshift generator, so that a seed reproduces the same workload regardless of libc
+class BenchRandom {
+public:
+  BenchRandom(int seed) : state_(0x9E3779B97F4A7C15ULL * (uint64_t)(seed + 1)) {}
+
+  uint32_t Next() {
+    state_ ^= state_ >> 12;
+    state_ ^= state_ << 25;
+    state_ ^= state_ >> 27;
+    return (uint32_t)((state_ * 0x2545F4914F6CDD1DULL) >> 32);
+  }
+  double Uniform() { return (Next() + 0.5) / 4294967296.0; }
+  double Gaussian() { return sqrt(-2.0 * log(Uniform())) * cos(2.0 * M_PI * Uniform()); }
+
+private:
+  uint64_t state_;
+};
+
+#endif // TVCBENCH_H
@@ -0,0 +1,84 @@
+/* Copyright (C) 2014 Ion Torrent Systems, Inc. All Rights Reserved */
+
+#include "tvcutils.h"
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdio.h>
+
+#include "OptArgs.h"
+#include "IonVersion.h"
+#include "ReferenceReader.h"
+#include "HotspotReader.h"
+
+using namespace std;
+
+
+void CompileHotspotsHelp()
+{
+  printf ("\n");
+  printf ("tvcutils %s-%s (%s) - Miscellaneous tools used by Torrent Variant Caller plugin and workflow.\n",
+      IonVersion::GetVersion().c_str(), IonVersion::GetRelease().c_str(), IonVersion::GetGitHash().c_str());
+  printf ("\n");
+  printf ("Usage:   tvcutils compile_hotspots [options]\n");
+  printf ("\n");
+  printf ("General options:\n");
+  printf ("  -i,--input-vcf                 FILE       hotspot vcf, as written by prepare_hotspots [required]\n");
+  printf ("  -r,--reference                 FILE       reference fasta file the hotspots refer to [required]\n");
+  printf ("  -o,--output                    FILE       binary hotspot file, accepted by tvc --input-vcf [required]\n");
+  printf ("\n");
+}
+
+
+static bool CompareLoci(const HotspotLocus& a, const HotspotLocus& b)
+{
+  if (a.chr != b.chr)
+    return a.chr < b.chr;
+  return a.pos < b.pos;
+}
+
+
+int CompileHotspots(int argc, const char *argv[])
+{
+  OptArgs opts;
+  opts.ParseCmdLine(argc, argv);
+  string input_vcf        = opts.GetFirstString ('i', "input-vcf", "");
+  string reference        = opts.GetFirstString ('r', "reference", "");
+  string output           = opts.GetFirstString ('o', "output", "");
+  opts.CheckNoLeftovers();
+
+  if (input_vcf.empty() or reference.empty() or output.empty()) {
+    CompileHotspotsHelp();
+    return 1;
+  }
+
+  ReferenceReader ref_reader;
+  ref_reader.Initialize(reference);
+
+  // Parse with the same reader tvc uses, so the binary file carries exactly what tvc would have seen
+  HotspotReader hotspot_reader;
+  hotspot_reader.Initialize(ref_reader, input_vcf);
+
+  vector<HotspotLocus> loci;
+  int num_alleles = 0;
+  while (hotspot_reader.HasMoreVariants()) {
+    loci.push_back(HotspotLocus());
+    loci.back().chr = hotspot_reader.next_chr();
+    loci.back().pos = hotspot_reader.next_pos();
+    loci.back().alleles = hotspot_reader.next();
+    num_alleles += hotspot_reader.next().size();
+    hotspot_reader.FetchNextVariant();
+  }
+  stable_sort(loci.begin(), loci.end(), CompareLoci);
+
+  if (not HotspotReader::WriteBinary(output, ref_reader, loci)) {
+    fprintf(stderr, "ERROR: Failed writing %s\n", output.c_str());
+    remove(output.c_str());
+    return 1;
+  }
+
+  printf("Wrote %d hotspot alleles at %d positions to %s\n", num_alleles, (int)loci.size(), output.c_str());
+  return 0;
+}
+
@@ -0,0 +1,98 @@
+/* Copyright (C) 2013 Ion Torrent Systems, Inc. All Rights Reserved */
+
+#include "tvcutils.h"
+
+#include <string>
+#include <fstream>
+#include <stdio.h>
+
+#include "OptArgs.h"
+#include "IonVersion.h"
+#include "json/json.h"
+#include "DiagnosticWriter.h"
+
+using namespace std;
+
+
+void ExtractDiagnosticHelp()
+{
+  printf ("\n");
+  printf ("tvcutils %s-%s (%s) - Miscellaneous tools used by Torrent Variant Caller plugin and workflow.\n",
+      IonVersion::GetVersion().c_str(), IonVersion::GetRelease().c_str(), IonVersion::GetGitHash().c_str());
+  printf ("\n");
+  printf ("Usage:   tvcutils extract_diagnostic [options]\n");
+  printf ("\n");
+  printf ("General options:\n");
+  printf ("  -i,--input                     FILE       diagnostic container written by tvc [required]\n");
+  printf ("  -v,--variant                   STRING     extract only variants at this location, as contig:position [all]\n");
+  printf ("  -o,--output-dir                DIR        directory for the extracted json files [.]\n");
+  printf ("  -l,--list                      on/off     only list the records in the container [off]\n");
+  printf ("\n");
+}
+
+
+int ExtractDiagnostic(int argc, const char *argv[])
+{
+  OptArgs opts;
+  opts.ParseCmdLine(argc, argv);
+  string input_file       = opts.GetFirstString ('i', "input", "");
+  string variant          = opts.GetFirstString ('v', "variant", "");
+  string output_dir       = opts.GetFirstString ('o', "output-dir", ".");
+  bool list_only          = opts.GetFirstBoolean('l', "list", false);
+  opts.CheckNoLeftovers();
+
+  if (input_file.empty()) {
+    ExtractDiagnosticHelp();
+    return 1;
+  }
+
+  // Records are named contig.position.ref.alt.{diagnostic,tiny}.json
+  string key_prefix;
+  if (not variant.empty()) {
+    size_t colon = variant.rfind(':');
+    if (colon == string::npos) {
+      fprintf(stderr, "ERROR: --variant should be of the form contig:position\n");
+      return 1;
+    }
+    key_prefix = variant.substr(0, colon) + "." + variant.substr(colon+1) + ".";
+  }
+
+  DiagnosticReader reader;
+  if (not reader.Open(input_file)) {
+    fprintf(stderr, "ERROR: Cannot read diagnostic container %s\n", input_file.c_str());
+    return 1;
+  }
+
+  int num_extracted = 0;
+  string payload;
+  for (int idx = 0; idx < reader.num_records(); ++idx) {
+    const string& key = reader.key(idx);
+    if (key.compare(0, key_prefix.size(), key_prefix))
+      continue;
+    if (list_only) {
+      printf("%s\n", key.c_str());
+      continue;
+    }
+
+    Json::Value json;
+    Json::Reader json_reader;
+    if (not reader.ReadRecord(idx, payload) or not json_reader.parse(payload, json)) {
+      fprintf(stderr, "ERROR: Corrupt diagnostic record %s\n", key.c_str());
+      return 1;
+    }
+    string output_file = output_dir + "/" + key;
+    ofstream out(output_file.c_str());
+    if (not out.good()) {
+      fprintf(stderr, "ERROR: Cannot open %s\n", output_file.c_str());
+      return 1;
+    }
+    out << json.toStyledString();
+    num_extracted++;
+  }
+
+  if (not list_only and not variant.empty() and num_extracted == 0) {
+    fprintf(stderr, "ERROR: No diagnostic records found for %s\n", variant.c_str());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,117 @@
+/* Copyright (C) 2013 Ion Torrent Systems, Inc. All Rights Reserved */
+
+#include "tvcutils.h"
+
+#include <string>
+#include <vector>
+#include <set>
+#include <stdio.h>
+#include <stdint.h>
+
+#include "OptArgs.h"
+#include "IonVersion.h"
+#include "ReferenceReader.h"
+
+using namespace std;
+
+
+void PrepareReferenceHelp()
+{
+  printf ("\n");
+  printf ("tvcutils %s-%s (%s) - Miscellaneous tools used by Torrent Variant Caller plugin and workflow.\n",
+      IonVersion::GetVersion().c_str(), IonVersion::GetRelease().c_str(), IonVersion::GetGitHash().c_str());
+  printf ("\n");
+  printf ("Usage:   tvcutils prepare_reference [options]\n");
+  printf ("\n");
+  printf ("General options:\n");
+  printf ("  -r,--reference                 FILE       reference fasta file, with .fai index [required]\n");
+  printf ("  -o,--output                    FILE       binary reference file; tvc only picks it up as FASTA%s [FASTA%s]\n",
+      BINARY_REFERENCE_SUFFIX, BINARY_REFERENCE_SUFFIX);
+  printf ("\n");
+}
+
+
+int PrepareReference(int argc, const char *argv[])
+{
+  OptArgs opts;
+  opts.ParseCmdLine(argc, argv);
+  string fasta_filename   = opts.GetFirstString ('r', "reference", "");
+  string output_filename  = opts.GetFirstString ('o', "output", fasta_filename + BINARY_REFERENCE_SUFFIX);
+  opts.CheckNoLeftovers();
+
+  if (fasta_filename.empty()) {
+    PrepareReferenceHelp();
+    return 1;
+  }
+
+  ReferenceReader ref_reader;
+  ref_reader.Initialize(fasta_filename, false);
+
+  set<string> contig_names;
+  for (int chr = 0; chr < ref_reader.chr_count(); ++chr) {
+    if (not contig_names.insert(ref_reader.chr_str(chr)).second) {
+      fprintf(stderr, "ERROR: Contig name %s appears more than once in %s.fai\n", ref_reader.chr(chr), fasta_filename.c_str());
+      return 1;
+    }
+  }
+
+  struct stat fasta_stat;
+  stat(fasta_filename.c_str(), &fasta_stat);
+
+  // Header, then the contig table, then the sequences in contig order
+
+  string header(BINARY_REFERENCE_MAGIC, 8);
+  int64_t fasta_size = fasta_stat.st_size;
+  int64_t fasta_mtime = fasta_stat.st_mtime;
+  int32_t chr_count = ref_reader.chr_count();
+  int32_t reserved = 0;
+  header.append((const char *)&fasta_size, 8);
+  header.append((const char *)&fasta_mtime, 8);
+  header.append((const char *)&chr_count, 4);
+  header.append((const char *)&reserved, 4);
+
+  int64_t offset = header.size();
+  for (int chr = 0; chr < chr_count; ++chr)
+    offset += 20 + ref_reader.chr_str(chr).size();
+
+  for (int chr = 0; chr < chr_count; ++chr) {
+    int64_t size = ref_reader.chr_size(chr);
+    int32_t name_length = ref_reader.chr_str(chr).size();
+    header.append((const char *)&offset, 8);
+    header.append((const char *)&size, 8);
+    header.append((const char *)&name_length, 4);
+    header.append(ref_reader.chr_str(chr));
+    offset += size;
+  }
+
+  FILE *output = fopen(output_filename.c_str(), "wb");
+  if (!output) {
+    fprintf(stderr, "ERROR: Cannot open %s for writing\n", output_filename.c_str());
+    return 1;
+  }
+  bool success = fwrite(header.data(), 1, header.size(), output) == header.size();
+
+  vector<char> buffer(1 << 20);
+  for (int chr = 0; success and chr < chr_count; ++chr) {
+    size_t fill = 0;
+    for (long pos = 0; pos < ref_reader.chr_size(chr); ++pos) {
+      buffer[fill++] = ref_reader.base(chr, pos);
+      if (fill == buffer.size()) {
+        success = fwrite(&buffer[0], 1, fill, output) == fill;
+        fill = 0;
+      }
+    }
+    if (fill)
+      success = success and fwrite(&buffer[0], 1, fill, output) == fill;
+  }
+
+  if (fclose(output) != 0 or not success) {
+    fprintf(stderr, "ERROR: Failed writing %s\n", output_filename.c_str());
+    remove(output_filename.c_str());
+    return 1;
+  }
+
+  printf("Wrote %d contigs to %s\n", chr_count, output_filename.c_str());
+  return 0;
+}
+
@@ -23,6 +23,9 @@ void TVCUtilsHelp()
   printf ("Commands:\n");
   printf ("         prepare_hotspots  Convert BED or VCF file into a valid hotspot file\n");
   printf ("         validate_bed      Validate targets or hotspots file\n");
+  printf ("         extract_diagnostic  Retrieve per-variant json diagnostics from a tvc diagnostic container\n");
+  printf ("         prepare_reference  Compile a fasta reference into the binary form tvc maps directly\n");
+  printf ("         compile_hotspots  Compile a hotspot vcf into the sorted binary form tvc streams directly\n");
   printf ("\n");
 }
 
@@ -38,6 +41,9 @@ int main(int argc, const char *argv[])
 
   if      (tvcutils_command == "prepare_hotspots") return PrepareHotspots(argc-1, argv+1);
   else if (tvcutils_command == "validate_bed") return ValidateBed(argc-1, argv+1);
+  else if (tvcutils_command == "extract_diagnostic") return ExtractDiagnostic(argc-1, argv+1);
+  else if (tvcutils_command == "prepare_reference") return PrepareReference(argc-1, argv+1);
+  else if (tvcutils_command == "compile_hotspots") return CompileHotspots(argc-1, argv+1);
   else {
       fprintf(stderr, "ERROR: unrecognized tvcutils command '%s'\n", tvcutils_command.c_str());
       return 1;
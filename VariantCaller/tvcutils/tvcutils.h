@@ -5,5 +5,8 @@
 
 int PrepareHotspots(int argc, const char *argv[]);
 int ValidateBed(int argc, const char *argv[]);
+int ExtractDiagnostic(int argc, const char *argv[]);
+int PrepareReference(int argc, const char *argv[]);
+int CompileHotspots(int argc, const char *argv[]);
 
 #endif // TVCUTILS_H
@@ -73,6 +73,7 @@ def main():
     parser.add_option(      '--primer-trim-bed',  help='Perform primer trimming using provided BED file. (optional)', dest='ptrim_bed')
     parser.add_option(      '--postprocessed-bam',help='Perform primer trimming, storing the results in provided BAM file name (optional)', dest='postprocessed_bam')
     parser.add_option(      '--error-motifs',     help='Error motifs file', dest='errormotifsfile')
+    parser.add_option(      '--tvc-left-align',   help='Sort and left-align within tvc instead of with sort_vcf.py and GATK LeftAlignVariants (optional)', dest='tvc_left_align', action='store_true', default=False)
     (options, args) = parser.parse_args()
 
     if options.tvcrootdir:
@@ -150,8 +151,7 @@ def main():
     elif options.bedfile:
         tvc_command +=          '   --target-file %s' % options.bedfile
     if options.postprocessed_bam:
-        postprocessed_bam_tmp = options.postprocessed_bam + '.tmp.bam'
-        tvc_command +=          '   --postprocessed-bam %s' % postprocessed_bam_tmp
+        tvc_command +=          '   --postprocessed-bam %s' % options.postprocessed_bam
     if options.hotspot_vcf:
         tvc_command +=          '   --input-vcf %s' % options.hotspot_vcf
     if options.paramfile:
@@ -159,29 +159,35 @@ def main():
     tvc_command +=              '   --num-threads %s' % options.numthreads
     if options.errormotifsfile:
         tvc_command +=              '   --error-motifs %s' % options.errormotifsfile
+    if options.tvc_left_align:
+        tvc_command +=              '   --output-normalized-vcf small_variants.left.vcf'
 
     RunCommand(tvc_command,'Call small indels and SNPs')
 
 
-    if options.postprocessed_bam:
+    # tvc writes the postprocessed bam sorted and indexed; it leaves out the index only if it could not keep it sorted
+    if options.postprocessed_bam and not os.path.exists(options.postprocessed_bam + '.bai'):
+        postprocessed_bam_tmp = options.postprocessed_bam + '.tmp.bam'
+        RunCommand('mv %s %s' % (options.postprocessed_bam, postprocessed_bam_tmp), 'Move unsorted postprocessed bam')
         bamsort_command = 'samtools sort %s %s' % (postprocessed_bam_tmp, options.postprocessed_bam[:-4])
         RunCommand(bamsort_command,'Sort postprocessed bam')
         bamindex_command = 'samtools index %s' % options.postprocessed_bam
         RunCommand(bamindex_command,'Index postprocessed bam')
         RunCommand('rm -f ' + postprocessed_bam_tmp, 'Remove unsorted postprocessed bam')
 
-    vcfsort_command =           '%s/share/TVC/scripts/sort_vcf.py' % tvcrootdir
-    vcfsort_command +=          '   --input-vcf %s/small_variants.vcf' % options.outdir
-    vcfsort_command +=          '   --output-vcf %s/small_variants.sorted.vcf' % options.outdir
-    vcfsort_command +=          '   --index-fai %s.fai' % options.reference
-    RunCommand(vcfsort_command, 'Sort small variant vcf')
-
-    left_align_command =        'java -Xmx8G -jar %s/share/TVC/jar/GenomeAnalysisTK.jar' % tvcrootdir
-    left_align_command +=       '   -T LeftAlignVariants'
-    left_align_command +=       '   -R %s' % options.reference
-    left_align_command +=       '   --variant %s/small_variants.sorted.vcf' % options.outdir
-    left_align_command +=       '   -o %s/small_variants.left.vcf' % options.outdir
-    RunCommand(left_align_command, 'Ensure left-alignment of indels')
+    if not options.tvc_left_align:
+        vcfsort_command =           '%s/share/TVC/scripts/sort_vcf.py' % tvcrootdir
+        vcfsort_command +=          '   --input-vcf %s/small_variants.vcf' % options.outdir
+        vcfsort_command +=          '   --output-vcf %s/small_variants.sorted.vcf' % options.outdir
+        vcfsort_command +=          '   --index-fai %s.fai' % options.reference
+        RunCommand(vcfsort_command, 'Sort small variant vcf')
+
+        left_align_command =        'java -Xmx8G -jar %s/share/TVC/jar/GenomeAnalysisTK.jar' % tvcrootdir
+        left_align_command +=       '   -T LeftAlignVariants'
+        left_align_command +=       '   -R %s' % options.reference
+        left_align_command +=       '   --variant %s/small_variants.sorted.vcf' % options.outdir
+        left_align_command +=       '   -o %s/small_variants.left.vcf' % options.outdir
+        RunCommand(left_align_command, 'Ensure left-alignment of indels')
 
     # write effective bed file
     if options.ptrim_bed and options.bedfile:
@@ -8,6 +8,7 @@
 #include <ctype.h>
 #include <stdio.h>
 #include <iostream>
+#include <emmintrin.h>
 
 
 void AlignmentCell::initialize(int init_score) {
@@ -73,6 +74,9 @@ void Realigner::InitializeRealigner(unsigned int reserve_size, unsigned int clip
   isForwardStrandRead_   = true;
   verbose_               = false;
   invalid_cigar_in_input = false;
+  cross_check_           = false;
+  num_cross_check_diffs_ = 0;
+  matrix_is_current_     = false;
   
   alignment_bandwidth_   = 20;
   q_limit_minus_.reserve(reserve_size);
@@ -87,10 +91,24 @@ void Realigner::InitializeRealigner(unsigned int reserve_size, unsigned int clip
   pretty_aln_.reserve(reserve_size);
   q_seq_.reserve(reserve_size);
   t_seq_.reserve(reserve_size);
-  DP_matrix.resize(reserve_size);
-  for (unsigned int i=0; i<DP_matrix.size(); i++)
-    DP_matrix[i].resize(reserve_size);
-  
+  // The full cell matrix is only allocated if the reference implementation is used
+  for (int i=0; i<2; i++) {
+    band_.score_M[i].reserve(reserve_size+5);
+    band_.score_X[i].reserve(reserve_size+5);
+    band_.score_D[i].reserve(reserve_size+5);
+    band_.best[i].reserve(reserve_size+5);
+    band_.best_dir[i].reserve(reserve_size+5);
+  }
+  band_.dir_D.reserve(reserve_size+5);
+  band_.q_mask.reserve(reserve_size+5);
+  band_.row_offset.reserve(reserve_size+1);
+  band_.trace.reserve(reserve_size*(2*alignment_bandwidth_+2));
+  band_.row0_trace.reserve(reserve_size+1);
+  band_.col0_trace.reserve(reserve_size+1);
+  band_.col0_best.reserve(reserve_size+1);
+  band_.row0_blocked.reserve(reserve_size+1);
+  band_.col0_blocked.reserve(reserve_size+1);
+
   cr_error = CR_SUCCESS;
 }
 
@@ -215,6 +233,33 @@ vector<bool> Realigner::getNucMatches(char nuc)
 
 // -------------------------------------------------------------------
 
+// Bit mask of the nucleotides matching a (complex) symbol; consistent with getNucMatches
+static int getNucMask(char nuc)
+{
+  switch(toupper(nuc)) {
+    case 'A': return 1;
+    case 'C': return 2;
+    case 'G': return 4;
+    case 'T':
+    case 'U': return 8;
+    case 'W': return 1|8;
+    case 'S': return 2|4;
+    case 'M': return 1|2;
+    case 'K': return 4|8;
+    case 'R': return 1|4;
+    case 'Y': return 2|8;
+    case 'B': return 2|4|8;
+    case 'D': return 1|4|8;
+    case 'H':
+    case 'I': return 1|2|8;
+    case 'V': return 1|2|4;
+    case 'N': return 1|2|4|8;
+  }
+  return 0;
+}
+
+// -------------------------------------------------------------------
+
 void Realigner::SetSequences(const string& q_seq, const string& t_seq, const string& aln_path, const bool isForward)
 {
   if (debug_ and verbose_)
@@ -230,18 +275,6 @@ void Realigner::SetSequences(const string& q_seq, const string& t_seq, const str
     isForwardStrandRead_ = isForward;
   }
 
-  // Resize DP_matrix if necessary
-  if (t_seq_.size() > DP_matrix.size()-1)
-    DP_matrix.resize(t_seq_.size()+1);
-  // initialize first row and column of DP matrix
-  for (unsigned int t_idx=0; t_idx<t_seq_.size()+1; t_idx++) {
-    if (DP_matrix[t_idx].size() < q_seq_.size() +1)
-      DP_matrix[t_idx].resize(q_seq_.size()+1);
-    DP_matrix[t_idx][0].initialize(0);
-  }
-  for (unsigned int q_idx=0; q_idx<q_seq_.size()+1; q_idx++)
-    DP_matrix[0][q_idx].initialize(0);
-  
   if (debug_ and verbose_)
     cout << "Successfully set sequences." << endl;
 }
@@ -250,11 +283,13 @@ void Realigner::SetSequences(const string& q_seq, const string& t_seq, const str
 // -------------------------------------------------------------------
 
 
-bool Realigner::ComputeTubedAlignmentBoundaries()
+bool Realigner::ComputeTubedAlignmentBoundaries(bool init_matrix_borders)
 {
     // Compute boundaries for tubed alignment around previously found alignment
   q_limit_minus_.assign(t_seq_.size()+1, 0);
   q_limit_plus_.assign(t_seq_.size()+1, q_seq_.size()+1);
+  band_.row0_blocked.assign(q_seq_.size()+1, 0);
+  band_.col0_blocked.assign(t_seq_.size()+1, 0);
   
   int center_point_q = 0;
   int center_point_t = 0;
@@ -279,8 +314,14 @@ bool Realigner::ComputeTubedAlignmentBoundaries()
     if (t_idx >= 0 and t_idx <= (int)t_seq_.size()) {
       if (q_idx < (int)q_limit_plus_[t_idx])
         q_limit_plus_[t_idx] = (unsigned int)q_idx;  // exclusive limit
-      if (q_idx <= (int)q_seq_.size())
-        DP_matrix[t_idx][q_idx].initialize(kNotApplicable);
+      if (q_idx <= (int)q_seq_.size()) {
+        if (init_matrix_borders)
+          DP_matrix[t_idx][q_idx].initialize(kNotApplicable);
+        if (t_idx == 0)
+          band_.row0_blocked[q_idx] = 1;
+        if (q_idx == 0)
+          band_.col0_blocked[t_idx] = 1;
+      }
     }
     // Check lower diagonal point
     q_idx = center_point_q - (int)alignment_bandwidth_ - 1;
@@ -288,7 +329,12 @@ bool Realigner::ComputeTubedAlignmentBoundaries()
     if (q_idx >= 0 and q_idx <= (int)q_seq_.size()) {
       if (t_idx <= (int)t_seq_.size()) {
         q_limit_minus_[t_idx] = (unsigned int)(q_idx+1); // inclusive limit
-        DP_matrix[t_idx][q_idx].initialize(kNotApplicable);
+        if (init_matrix_borders)
+          DP_matrix[t_idx][q_idx].initialize(kNotApplicable);
+        if (t_idx == 0)
+          band_.row0_blocked[q_idx] = 1;
+        if (q_idx == 0)
+          band_.col0_blocked[t_idx] = 1;
       }
     }
   }
@@ -317,13 +363,357 @@ bool Realigner::ComputeTubedAlignmentBoundaries()
 // -------------------------------------------------------------------
 
 
+// Selects a where mask is set and b elsewhere
+static inline __m128i SelectEpi32(__m128i mask, __m128i a, __m128i b)
+{
+  return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// -------------------------------------------------------------------
+
 bool Realigner::computeSWalignment(vector<CigarOp>& CigarData, vector<MDelement>& MD_data,
                        unsigned int& start_pos_update) {
 
+  // The backtrack overwrites the alignment path the tube was built around
+  string aln_path;
+  if (cross_check_)
+    aln_path = pretty_aln_;
+
+  // Compute boundaries for tubed alignment around previously found alignment
+  if (!ComputeTubedAlignmentBoundaries(false))
+    return false;
+
+  unsigned int best_t_idx = 0, best_q_idx = 0;
+  FillBandedMatrix(best_t_idx, best_q_idx);
+  matrix_is_current_ = false;
+
+  // Backtrack alignment in the banded traceback store, generate cigar string / MD tag
+  backtrackAlignment(best_t_idx, best_q_idx, CigarData, MD_data, start_pos_update);
+
+  if (cross_check_)
+    CrossCheckAlignment(aln_path, CigarData, MD_data, start_pos_update);
+  return true;
+}
+
+// -------------------------------------------------------------------
+// The banded aligner performs exactly the same recursion (including the tie breaking between
+// moves and the arithmetic on kNotApplicable scores) as computeSWalignmentReference, but only
+// keeps two rows of scores and a packed traceback word for each cell inside the tube.
+// Match, mismatch and deletion scores only depend on the previous row and are computed four
+// cells at a time; the insertion state depends on the cell to the left and is resolved in a
+// scalar sweep over the row together with the choice of the best move.
+
+void Realigner::FillBandedMatrix(unsigned int& best_t_idx, unsigned int& best_q_idx)
+{
+  const int t_size = t_seq_.size();
+  const int q_size = q_seq_.size();
+  const int row_size = q_size + 5; // Padding to load four lanes at the last query index
+  const unsigned short na_trace = PackTrace(FROM_NOWHERE, FROM_NOWHERE, FROM_NOWHERE, FROM_NOWHERE, false);
+
+  for (int i=0; i<2; i++) {
+    band_.score_M[i].resize(row_size);
+    band_.score_X[i].resize(row_size);
+    band_.score_D[i].resize(row_size);
+    band_.best[i].resize(row_size);
+    band_.best_dir[i].resize(row_size);
+  }
+  band_.dir_D.resize(row_size);
+  band_.q_mask.assign(row_size, 0);
+  for (int q_idx=0; q_idx<q_size; q_idx++)
+    band_.q_mask[q_idx] = getNucMask(q_seq_[q_idx]);
+
+  // Layout of the traceback store: row t holds the query indices [max(1,q_limit_minus_), q_limit_plus_)
+  band_.row_offset.resize(t_size+1);
+  int trace_size = 0;
+  for (int t_idx=1; t_idx<=t_size; t_idx++) {
+    int q_lo = max((int)q_limit_minus_[t_idx], 1);
+    int q_hi = min((int)q_limit_plus_[t_idx], q_size+1);
+    band_.row_offset[t_idx] = trace_size - q_lo;
+    if (q_hi > q_lo)
+      trace_size += q_hi - q_lo;
+  }
+  band_.trace.resize(trace_size);
+
+  int prev = 0, curr = 1;
+
+  // --- First row of the matrix; moving horizontally for insertions
+  band_.row0_trace.assign(q_size+1, na_trace);
+  for (int q_idx=0; q_idx<=q_size; q_idx++) {
+    band_.score_M[prev][q_idx] = kNotApplicable;
+    band_.score_X[prev][q_idx] = kNotApplicable;
+    band_.score_D[prev][q_idx] = kNotApplicable;
+    band_.best[prev][q_idx] = band_.row0_blocked[q_idx] ? kNotApplicable : 0;
+    band_.best_dir[prev][q_idx] = FROM_NOWHERE;
+  }
+  if (!soft_clip_left_ and q_size > 0) {
+    band_.best[prev][1] = kGapOpen;
+    band_.best_dir[prev][1] = FROM_I;
+    band_.row0_trace[1] = PackTrace(FROM_I, FROM_NOWHERE, FROM_NOWHERE, FROM_NOWHERE, false);
+    for (int q_idx=2; q_idx<(int)q_limit_plus_[0]; q_idx++) {
+      band_.best[prev][q_idx] = band_.best[prev][q_idx-1] + kGapExtend;
+      band_.best_dir[prev][q_idx] = FROM_I;
+      band_.row0_trace[q_idx] = PackTrace(FROM_I, FROM_NOWHERE, FROM_I, FROM_NOWHERE, false);
+    }
+  }
+
+  // --- First column of the matrix; moving vertically for deletions
+  band_.col0_trace.assign(t_size+1, na_trace);
+  band_.col0_best.resize(t_size+1);
+  band_.col0_best[0] = band_.best[prev][0];
+  for (int t_idx=1; t_idx<=t_size; t_idx++)
+    band_.col0_best[t_idx] = band_.col0_blocked[t_idx] ? kNotApplicable : 0;
+  if (!start_anywhere_in_ref_ and t_size > 0) {
+    band_.col0_best[1] = kGapOpen;
+    band_.col0_trace[1] = PackTrace(FROM_D, FROM_NOWHERE, FROM_NOWHERE, FROM_NOWHERE, false);
+    int t_idx = 2;
+    while (t_idx <= t_size and q_limit_minus_[t_idx] == 0) {
+      band_.col0_best[t_idx] = band_.col0_best[t_idx-1] + kGapExtend;
+      band_.col0_trace[t_idx] = PackTrace(FROM_D, FROM_NOWHERE, FROM_NOWHERE, FROM_D, false);
+      t_idx++;
+    }
+  }
+
+  // ------ Main alignment loop ------
+  const __m128i v_na        = _mm_set1_epi32(kNotApplicable);
+  const __m128i v_zero      = _mm_setzero_si128();
+  const __m128i v_match     = _mm_set1_epi32(kMatchScore);
+  const __m128i v_mismatch  = _mm_set1_epi32(kMismatchScore);
+  const __m128i v_gap_open  = _mm_set1_epi32(kGapOpen);
+  const __m128i v_gap_ext   = _mm_set1_epi32(kGapExtend);
+  const __m128i v_from_m    = _mm_set1_epi32(FROM_MATCH);
+  const __m128i v_from_x    = _mm_set1_epi32(FROM_MISM);
+  const __m128i v_from_d    = _mm_set1_epi32(FROM_D);
+  const __m128i v_nowhere   = _mm_set1_epi32(FROM_NOWHERE);
+  const int     nowhere_score = soft_clip_left_ ? 0 : kNotApplicable;
+
+  int highest_score = band_.best[prev][0];
+  best_t_idx = 0;
+  best_q_idx = 0;
+  int prev_lo = 0, prev_hi = q_size+1;
+
+  for (int t_idx=1; t_idx<=t_size; t_idx++) {
+
+    int q_lo = max((int)q_limit_minus_[t_idx], 1);
+    int q_hi = min((int)q_limit_plus_[t_idx], q_size+1);
+    if (q_hi <= q_lo) {
+      prev_lo = prev_hi = 0;
+      swap(prev, curr);
+      continue;
+    }
+
+    // Cells of the previous row outside of its tube are border cells or lie in the first column
+    for (int q_idx=q_lo-1; q_idx<q_hi; q_idx++) {
+      if (q_idx >= prev_lo and q_idx < prev_hi)
+        continue;
+      band_.score_M[prev][q_idx] = kNotApplicable;
+      band_.score_X[prev][q_idx] = kNotApplicable;
+      band_.score_D[prev][q_idx] = kNotApplicable;
+      if (q_idx == 0) {
+        band_.best[prev][q_idx] = band_.col0_best[t_idx-1];
+        band_.best_dir[prev][q_idx] = band_.col0_trace[t_idx-1] & 7;
+      } else {
+        band_.best[prev][q_idx] = kNotApplicable;
+        band_.best_dir[prev][q_idx] = FROM_NOWHERE;
+      }
+    }
+
+    const int  t_mask  = getNucMask(t_seq_[t_idx-1]);
+    const int* p_M     = &band_.score_M[prev][0];
+    const int* p_X     = &band_.score_X[prev][0];
+    const int* p_D     = &band_.score_D[prev][0];
+    const int* p_best  = &band_.best[prev][0];
+    const int* p_dir   = &band_.best_dir[prev][0];
+    const int* q_mask  = &band_.q_mask[0];
+    int*       c_M     = &band_.score_M[curr][0];
+    int*       c_X     = &band_.score_X[curr][0];
+    int*       c_D     = &band_.score_D[curr][0];
+    int*       c_best  = &band_.best[curr][0];
+    int*       c_dir   = &band_.best_dir[curr][0];
+    int*       c_dir_D = &band_.dir_D[0];
+
+    // 1) - Match / Mismatch and Deletion scores, four cells at a time
+    const __m128i v_t_mask = _mm_set1_epi32(t_mask);
+    int q_idx = q_lo;
+    for (; q_idx+4 <= q_hi; q_idx+=4) {
+      __m128i diag     = _mm_loadu_si128((const __m128i*)(p_best + q_idx - 1));
+      __m128i no_match = _mm_cmpeq_epi32(_mm_and_si128(_mm_loadu_si128((const __m128i*)(q_mask + q_idx - 1)), v_t_mask), v_zero);
+      _mm_storeu_si128((__m128i*)(c_M + q_idx), SelectEpi32(no_match, v_na, _mm_add_epi32(diag, v_match)));
+      _mm_storeu_si128((__m128i*)(c_X + q_idx), SelectEpi32(no_match, _mm_add_epi32(diag, v_mismatch), v_na));
+
+      // Path ordering creates left aligned deletions
+      __m128i del = v_na, del_dir = v_nowhere, cand, gt;
+      cand    = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(p_D + q_idx)), v_gap_ext);
+      gt      = _mm_cmpgt_epi32(cand, del);
+      del     = SelectEpi32(gt, cand, del);
+      del_dir = SelectEpi32(gt, v_from_d, del_dir);
+      cand    = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(p_M + q_idx)), v_gap_open);
+      gt      = _mm_cmpgt_epi32(cand, del);
+      del     = SelectEpi32(gt, cand, del);
+      del_dir = SelectEpi32(gt, v_from_m, del_dir);
+      cand    = _mm_add_epi32(_mm_loadu_si128((const __m128i*)(p_X + q_idx)), v_gap_open);
+      gt      = _mm_cmpgt_epi32(cand, del);
+      del     = SelectEpi32(gt, cand, del);
+      del_dir = SelectEpi32(gt, v_from_x, del_dir);
+      _mm_storeu_si128((__m128i*)(c_D + q_idx), del);
+      _mm_storeu_si128((__m128i*)(c_dir_D + q_idx), del_dir);
+    }
+    for (; q_idx < q_hi; q_idx++) {
+      if (q_mask[q_idx-1] & t_mask) {
+        c_M[q_idx] = p_best[q_idx-1] + kMatchScore;
+        c_X[q_idx] = kNotApplicable;
+      } else {
+        c_M[q_idx] = kNotApplicable;
+        c_X[q_idx] = p_best[q_idx-1] + kMismatchScore;
+      }
+      c_D[q_idx] = kNotApplicable;
+      c_dir_D[q_idx] = FROM_NOWHERE;
+      if (p_D[q_idx] + kGapExtend > c_D[q_idx]) { c_D[q_idx] = p_D[q_idx] + kGapExtend; c_dir_D[q_idx] = FROM_D; }
+      if (p_M[q_idx] + kGapOpen > c_D[q_idx])   { c_D[q_idx] = p_M[q_idx] + kGapOpen;   c_dir_D[q_idx] = FROM_MATCH; }
+      if (p_X[q_idx] + kGapOpen > c_D[q_idx])   { c_D[q_idx] = p_X[q_idx] + kGapOpen;   c_dir_D[q_idx] = FROM_MISM; }
+    }
+
+    // 2) - Insertion score and best move; the cell left of the tube never holds a valid score
+    bool valid_t_idx = stop_anywhere_in_ref_ or (t_idx == t_size);
+    unsigned short* trace = &band_.trace[0] + band_.row_offset[t_idx];
+    int left_M = kNotApplicable, left_X = kNotApplicable, left_I = kNotApplicable;
+
+    for (q_idx = q_lo; q_idx < q_hi; q_idx++) {
+      // Path ordering creates left aligned insertions
+      int ins = kNotApplicable, ins_dir = FROM_NOWHERE;
+      if (left_I + kGapExtend > ins) { ins = left_I + kGapExtend; ins_dir = FROM_I; }
+      if (left_M + kGapOpen > ins)   { ins = left_M + kGapOpen;   ins_dir = FROM_MATCH; }
+      if (left_X + kGapOpen > ins)   { ins = left_X + kGapOpen;   ins_dir = FROM_MISM; }
+
+      // Choose best move for this cell
+      int best = kNotApplicable-1, best_dir = FROM_NOWHERE;
+      if (c_M[q_idx] > best)     { best = c_M[q_idx];     best_dir = FROM_MATCH; }
+      if (c_X[q_idx] > best)     { best = c_X[q_idx];     best_dir = FROM_MISM; }
+      if (ins > best)            { best = ins;            best_dir = FROM_I; }
+      if (c_D[q_idx] > best)     { best = c_D[q_idx];     best_dir = FROM_D; }
+      if (nowhere_score > best)  { best = nowhere_score;  best_dir = FROM_NOWHERE; }
+      c_best[q_idx] = best;
+      c_dir[q_idx]  = best_dir;
+      trace[q_idx]  = PackTrace(best_dir, p_dir[q_idx-1], ins_dir, c_dir_D[q_idx], (q_mask[q_idx-1] & t_mask) != 0);
+
+      // Clipping settings determine where we search for the best scoring cell to stop aligning
+      bool valid_q_idx = soft_clip_right_ or (q_idx == q_size);
+      if (valid_t_idx and valid_q_idx and best > highest_score) {
+        highest_score = best;
+        best_t_idx = t_idx;
+        best_q_idx = q_idx;
+      }
+      left_M = c_M[q_idx];
+      left_X = c_X[q_idx];
+      left_I = ins;
+    }
+
+    prev_lo = q_lo;
+    prev_hi = q_hi;
+    swap(prev, curr);
+  }
+  // ------- end alignment matrix loop ------
+
+  // Force full string alignment if desired, no matter what the score is.
+  if (!stop_anywhere_in_ref_ and !soft_clip_right_) {
+    best_t_idx = t_size;
+    best_q_idx = q_size;
+  }
+}
+
+// -------------------------------------------------------------------
+
+unsigned short Realigner::TraceBits(unsigned int t_idx, unsigned int q_idx) const
+{
+  if (matrix_is_current_) {
+    const AlignmentCell& cell = DP_matrix[t_idx][q_idx];
+    int diag_in = cell.is_match ? cell.in_directions[FROM_MATCH] : cell.in_directions[FROM_MISM];
+    return PackTrace(cell.best_path_direction, diag_in, cell.in_directions[FROM_I], cell.in_directions[FROM_D], cell.is_match);
+  }
+  if (t_idx == 0)
+    return band_.row0_trace[q_idx];
+  if (q_idx == 0)
+    return band_.col0_trace[t_idx];
+  if (q_idx >= q_limit_minus_[t_idx] and q_idx < q_limit_plus_[t_idx])
+    return band_.trace[band_.row_offset[t_idx] + q_idx];
+  return PackTrace(FROM_NOWHERE, FROM_NOWHERE, FROM_NOWHERE, FROM_NOWHERE, false);
+}
+
+// -------------------------------------------------------------------
+
+int Realigner::TraceInDirection(unsigned short bits, int align_type)
+{
+  bool is_match = bits & TRACE_IS_MATCH;
+  switch (align_type) {
+    case FROM_MATCH: return is_match ? ((bits >> 3) & 7) : FROM_NOWHERE;
+    case FROM_MISM:  return is_match ? FROM_NOWHERE : ((bits >> 3) & 7);
+    case FROM_I:     return (bits >> 6) & 7;
+    case FROM_D:     return (bits >> 9) & 7;
+  }
+  return FROM_NOWHERE;
+}
+
+// -------------------------------------------------------------------
+
+void Realigner::CrossCheckAlignment(const string& aln_path, const vector<CigarOp>& CigarData,
+                       const vector<MDelement>& MD_data, unsigned int start_pos_update)
+{
+  string banded_qseq = pretty_qseq_;
+  string banded_tseq = pretty_tseq_;
+  string banded_aln  = pretty_aln_;
+  bool   was_verbose = verbose_;
+
+  vector<CigarOp>    ref_cigar;
+  vector<MDelement>  ref_md;
+  unsigned int       ref_start_pos_update = 0;
+  pretty_aln_ = aln_path;
+  verbose_ = false;
+  bool same = computeSWalignmentReference(ref_cigar, ref_md, ref_start_pos_update);
+  verbose_ = was_verbose;
+
+  same = same and (pretty_aln_ == banded_aln) and (pretty_qseq_ == banded_qseq) and (pretty_tseq_ == banded_tseq)
+         and (ref_start_pos_update == start_pos_update) and (ref_cigar.size() == CigarData.size())
+         and (ref_md.size() == MD_data.size());
+  for (unsigned int i=0; same and i<CigarData.size(); i++)
+    same = (ref_cigar[i].Type == CigarData[i].Type) and (ref_cigar[i].Length == CigarData[i].Length);
+  for (unsigned int i=0; same and i<MD_data.size(); i++)
+    same = (ref_md[i].Type == MD_data[i].Type) and (ref_md[i].Length == MD_data[i].Length);
+
+  if (not same) {
+    num_cross_check_diffs_++;
+    cerr << "Realigner: banded alignment differs from reference alignment of " << endl
+         << q_seq_ << endl << aln_path << endl << t_seq_ << endl
+         << "Banded:    " << banded_aln << endl
+         << "Reference: " << pretty_aln_ << endl;
+  }
+  // Hand out the banded result
+  pretty_qseq_ = banded_qseq;
+  pretty_tseq_ = banded_tseq;
+  pretty_aln_  = banded_aln;
+  matrix_is_current_ = false;
+}
+
+// -------------------------------------------------------------------
+
+
+bool Realigner::computeSWalignmentReference(vector<CigarOp>& CigarData, vector<MDelement>& MD_data,
+                       unsigned int& start_pos_update) {
+
   string dummy_string;
-  
+
+  // Resize DP_matrix if necessary
+  if (t_seq_.size()+1 > DP_matrix.size())
+    DP_matrix.resize(t_seq_.size()+1);
+  // initialize first row and column of DP matrix
+  for (unsigned int t_idx=0; t_idx<t_seq_.size()+1; t_idx++) {
+    if (DP_matrix[t_idx].size() < q_seq_.size() +1)
+      DP_matrix[t_idx].resize(q_seq_.size()+1);
+    DP_matrix[t_idx][0].initialize(0);
+  }
+  for (unsigned int q_idx=0; q_idx<q_seq_.size()+1; q_idx++)
+    DP_matrix[0][q_idx].initialize(0);
+
   // Compute boundaries for tubed alignment around previously found alignment
-  if (!ComputeTubedAlignmentBoundaries())
+  if (!ComputeTubedAlignmentBoundaries(true))
     return false;
 
   // Path ordering creates left aligned InDels
@@ -456,6 +846,7 @@ bool Realigner::computeSWalignment(vector<CigarOp>& CigarData, vector<MDelement>
   }
 
   // Backtrack alignment in dynamic programming matrix, generate cigar string / MD tag
+  matrix_is_current_ = true;
   backtrackAlignment(highest_score_cell[0], highest_score_cell[1], CigarData, MD_data, start_pos_update);
   return true;
 }
@@ -483,7 +874,8 @@ void Realigner::backtrackAlignment(unsigned int t_idx, unsigned int q_idx,
   current_MD_element.Type = '=';
   current_MD_element.Length = 0;
 
-  int current_move = DP_matrix[t_idx][q_idx].best_path_direction;
+  unsigned short cell = TraceBits(t_idx, q_idx);
+  int current_move = cell & 7;
   int next_move = FROM_NOWHERE;
   int last_move = -1;
 
@@ -493,12 +885,12 @@ void Realigner::backtrackAlignment(unsigned int t_idx, unsigned int q_idx,
       case FROM_MATCH: // Match
         pretty_tseq_.push_back(t_seq_[t_idx-1]);
         pretty_qseq_.push_back(q_seq_[q_idx-1]);
-        addMDelement(FROM_MATCH, DP_matrix[t_idx][q_idx].is_match, last_move, t_idx, current_MD_element, MD_data);
+        addMDelement(FROM_MATCH, (cell & TRACE_IS_MATCH) != 0, last_move, t_idx, current_MD_element, MD_data);
         addCigarElement(FROM_MATCH, last_move, current_cigar_element, CigarData);
         pretty_aln_.push_back(ALN_MATCH);
         if (t_idx <= start_pos_update)
           start_pos_update = t_idx-1;
-        next_move = DP_matrix[t_idx][q_idx].in_directions[FROM_MATCH];
+        next_move = TraceInDirection(cell, FROM_MATCH);
         t_idx--;
         q_idx--;
         break;
@@ -506,12 +898,12 @@ void Realigner::backtrackAlignment(unsigned int t_idx, unsigned int q_idx,
       case FROM_MISM: // Mismatch
         pretty_tseq_.push_back(t_seq_[t_idx-1]);
         pretty_qseq_.push_back(q_seq_[q_idx-1]);
-        addMDelement(FROM_MATCH, DP_matrix[t_idx][q_idx].is_match, last_move, t_idx, current_MD_element, MD_data);
+        addMDelement(FROM_MATCH, (cell & TRACE_IS_MATCH) != 0, last_move, t_idx, current_MD_element, MD_data);
         addCigarElement(FROM_MATCH, last_move, current_cigar_element, CigarData);
         pretty_aln_.push_back(ALN_MISMATCH);
         if (t_idx <= start_pos_update)
           start_pos_update = t_idx-1;
-        next_move = DP_matrix[t_idx][q_idx].in_directions[FROM_MISM];
+        next_move = TraceInDirection(cell, FROM_MISM);
         t_idx--;
         q_idx--;
         break;
@@ -522,7 +914,7 @@ void Realigner::backtrackAlignment(unsigned int t_idx, unsigned int q_idx,
         pretty_qseq_.push_back(q_seq_[q_idx-1]);
         addMDelement(FROM_I, false, last_move, t_idx, current_MD_element, MD_data);
         addCigarElement(FROM_I, last_move, current_cigar_element, CigarData);
-        next_move = DP_matrix[t_idx][q_idx].in_directions[FROM_I];
+        next_move = TraceInDirection(cell, FROM_I);
         q_idx--;
         break;
 
@@ -532,16 +924,17 @@ void Realigner::backtrackAlignment(unsigned int t_idx, unsigned int q_idx,
         pretty_tseq_.push_back(t_seq_[t_idx-1]);
         addMDelement(FROM_D, false, last_move, t_idx, current_MD_element, MD_data);
         addCigarElement(FROM_D, last_move, current_cigar_element, CigarData);
-        next_move = DP_matrix[t_idx][q_idx].in_directions[FROM_D];
+        next_move = TraceInDirection(cell, FROM_D);
         t_idx--;
         break;
     }
     last_move = current_move;
     current_move = next_move;
+    if (current_move != FROM_NOWHERE)
+      cell = TraceBits(t_idx, q_idx);
     if (verbose_ and debug_) {
       cout << "Added: " << PrintAlignType(last_move) << " Next: " << PrintAlignType(current_move)
-           << " at (" << t_idx << ", " << q_idx
-           << ") Score: " << DP_matrix[t_idx][q_idx].scores[current_move] << endl;
+           << " at (" << t_idx << ", " << q_idx << ")" << endl;
     }
   }
   MD_data.push_back(current_MD_element);
@@ -581,16 +974,19 @@ void Realigner::backtrackAlignment(unsigned int t_idx, unsigned int q_idx,
 // -------------------------------------------------------------------
 
 void Realigner::PrintScores() const {
-  printf("Cell scores:\n");
-  for (unsigned int t_idx=0; t_idx<t_seq_.size()+1; t_idx++) {
-    for (unsigned int q_idx=0; q_idx<q_seq_.size()+1; q_idx++)
-      printf("%d\t", DP_matrix[t_idx][q_idx].best_score);
-    printf("\n");
+  // The banded aligner only keeps the traceback of the full matrix
+  if (matrix_is_current_) {
+    printf("Cell scores:\n");
+    for (unsigned int t_idx=0; t_idx<t_seq_.size()+1; t_idx++) {
+      for (unsigned int q_idx=0; q_idx<q_seq_.size()+1; q_idx++)
+        printf("%d\t", DP_matrix[t_idx][q_idx].best_score);
+      printf("\n");
+    }
   }
   printf("Path directions:\n");
     for (unsigned int t_idx=0; t_idx<t_seq_.size()+1; t_idx++) {
       for (unsigned int q_idx=0; q_idx<q_seq_.size()+1; q_idx++)
-        printf("%d\t", DP_matrix[t_idx][q_idx].best_path_direction);
+        printf("%d\t", TraceBits(t_idx, q_idx) & 7);
       printf("\n");
     }
 }
@@ -40,6 +40,26 @@ struct AlignmentCell {
   vector<int>     in_directions;
 };
 
+//! Flat storage for the banded dynamic programming of Realigner::computeSWalignment.
+//! Scores are only kept for the previous and the current row of the tube, while every cell
+//! inside the tube keeps a packed traceback word (see Realigner::PackTrace).
+struct BandedDPStore {
+  vector<int>             score_M[2];    //!< Match scores of previous / current row
+  vector<int>             score_X[2];    //!< Mismatch scores of previous / current row
+  vector<int>             score_D[2];    //!< Deletion scores of previous / current row
+  vector<int>             best[2];       //!< Best cell scores of previous / current row
+  vector<int>             best_dir[2];   //!< Best incoming move of previous / current row
+  vector<int>             dir_D;         //!< Incoming move of the deletion state in the current row
+  vector<int>             q_mask;        //!< Nucleotide bit masks of the query sequence
+  vector<int>             row_offset;    //!< Offset of row t in trace, indexed by query index
+  vector<unsigned short>  trace;         //!< Packed traceback words of all cells inside the tube
+  vector<unsigned short>  row0_trace;    //!< Packed traceback words of the first row
+  vector<unsigned short>  col0_trace;    //!< Packed traceback words of the first column
+  vector<int>             col0_best;     //!< Best scores of the first column
+  vector<char>            row0_blocked;  //!< First row cells that lie on the tube border
+  vector<char>            col0_blocked;  //!< First column cells that lie on the tube border
+};
+
 struct MDelement {
   string Type;
   int    Length;
@@ -83,6 +103,11 @@ public:
   bool computeSWalignment(vector<CigarOp>& CigarData, vector<MDelement>& MD_data,
          unsigned int& start_pos_update);
 
+  //! @brief  Computes the same alignment as computeSWalignment on a full matrix of alignment cells.
+  //!         Slow reference implementation used to validate the banded aligner.
+  bool computeSWalignmentReference(vector<CigarOp>& CigarData, vector<MDelement>& MD_data,
+         unsigned int& start_pos_update);
+
   //! @brief  Creates the Reference from the bases in the read and the cigar / md tag in the BAM
   //! @param[in]  algn_query_bases       read bases as written in input BAM
   //! @param[in]  algn_cigar_data        cigar string as obtained from input BAM
@@ -177,6 +202,8 @@ public:
   bool             verbose_;                //!< Print detailed information about realignment to screen
   bool             debug_;
   bool             invalid_cigar_in_input;  //!< Gets set to true if invalid cigar / md pairs are encountered in the input
+  bool             cross_check_;            //!< Recompute every alignment with the reference matrix and report differences
+  unsigned int     num_cross_check_diffs_;  //!< Alignments the cross check found to differ
 
 
 
@@ -202,7 +229,25 @@ protected:
   void ReverseClipping();
 
   //! @brief  Computes the boundaries of a tubed alignment around the previously found one
-  bool ComputeTubedAlignmentBoundaries();
+  //! @param[in]  init_matrix_borders  Initialize the border cells of the full cell matrix
+  bool ComputeTubedAlignmentBoundaries(bool init_matrix_borders);
+
+  //! @brief  Fills the flat banded dynamic programming store and returns the cell to start the backtrack
+  void FillBandedMatrix(unsigned int& best_t_idx, unsigned int& best_q_idx);
+
+  //! @brief  Packed traceback word of a cell of the most recently filled dynamic programming matrix
+  unsigned short TraceBits(unsigned int t_idx, unsigned int q_idx) const;
+
+  //! @brief  Packs best move, incoming moves of the three alignment states and match flag of a cell
+  static unsigned short PackTrace(int best_dir, int diag_in, int ins_in, int del_in, bool is_match)
+    { return (unsigned short)(best_dir | (diag_in << 3) | (ins_in << 6) | (del_in << 9) | (is_match ? TRACE_IS_MATCH : 0)); };
+
+  //! @brief  Unpacks the incoming move of the state align_type from a traceback word
+  static int TraceInDirection(unsigned short bits, int align_type);
+
+  //! @brief  Repeats the alignment with the reference matrix and reports differences to the banded result
+  void CrossCheckAlignment(const string& aln_path, const vector<CigarOp>& CigarData,
+          const vector<MDelement>& MD_data, unsigned int start_pos_update);
 
   //! @brief  Updates or adds another element in a partial cigar vector
   void addCigarElement(int align_type, int last_move,
@@ -236,7 +281,9 @@ protected:
   //string           aln_path_;               //!< previously computed alignment of query and target
 
   //ion::FlowOrder   flow_order_;             //!< Sequence of nucleotide flows
-  vector<vector<AlignmentCell> > DP_matrix; //!< Dynamic programming matrix
+  vector<vector<AlignmentCell> > DP_matrix; //!< Dynamic programming matrix of the reference implementation
+  BandedDPStore    band_;                   //!< Flat dynamic programming store of the banded aligner
+  bool             matrix_is_current_;      //!< Last alignment was computed in DP_matrix rather than band_
   unsigned int     alignment_bandwidth_;    //!< Diagonal bandwidth of tubed alignment around previously found one
   vector<unsigned int>   q_limit_minus_;    //!< Lower (inclusive) limit on the query index for each target index
   vector<unsigned int>   q_limit_plus_;     //!< Upper (exclusive) limit on the query index for each target index
@@ -257,6 +304,8 @@ protected:
   const static int      FROM_D       = 3;   //!< The alignment was extended from an deletion.
   const static int      FROM_NOWHERE = 4;   //!< No valid incoming alignment move.
 
+  const static int      TRACE_IS_MATCH = 1 << 12; //!< Match flag in a packed traceback word.
+
   const static char     ALN_DEL      = '-'; //!< A base deletion in the alignment string.
   const static char     ALN_INS      = '+'; //!< A base insertion in the alignment string.
   const static char     ALN_MATCH    = '|'; //!< A matching base in the alignment string.
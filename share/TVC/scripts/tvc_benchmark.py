@@ -0,0 +1,135 @@
+#!/usr/bin/python
+# Copyright (C) 2014 Ion Torrent Systems, Inc. All Rights Reserved
+
+# Runs tvc on synthetic data sets from "tvcbench generate" over a matrix of depths and thread counts,
+# and reports wall time, peak RSS and throughput of each run.
+
+from __future__ import print_function
+
+import sys
+import os
+import re
+import time
+import subprocess
+from optparse import OptionParser
+
+
+def printtime(message):
+    print('[ ' + time.strftime('%X') + ' ] ' + message)
+    sys.stdout.flush()
+
+
+def RunTimed(command, log_filename):
+    # Returns exit status, wall seconds and peak RSS in MB of the command and its children
+    log_file = open(log_filename, 'w')
+    start_time = time.time()
+    process = subprocess.Popen(command, stdout=log_file, stderr=subprocess.STDOUT)
+    (pid, status, rusage) = os.wait4(process.pid, 0)
+    wall_time = time.time() - start_time
+    log_file.close()
+    return (os.WEXITSTATUS(status) if os.WIFEXITED(status) else -1, wall_time, rusage.ru_maxrss / 1024.0)
+
+
+def IntList(text):
+    return [int(value) for value in text.split(',') if value]
+
+
+def main():
+
+    parser = OptionParser()
+    parser.add_option('-w', '--work-dir',       help='Directory for data sets and tvc outputs [required]', dest='workdir')
+    parser.add_option('-n', '--num-threads',    help='Comma separated tvc thread counts [1,2,4,8]', dest='threads', default='1,2,4,8')
+    parser.add_option('-d', '--depths',         help='Comma separated reads per amplicon [100,500,2000]', dest='depths', default='100,500,2000')
+    parser.add_option('-a', '--num-amplicons',  help='Amplicons per data set [200]', dest='amplicons', default='200')
+    parser.add_option('-l', '--read-length',    help='Maximum read length [200]', dest='readlength', default='200')
+    parser.add_option('-e', '--error-rate',     help='Per base homopolymer indel error rate [0.005]', dest='errorrate', default='0.005')
+    parser.add_option('-s', '--seed',           help='Random seed of the data sets [1]', dest='seed', default='1')
+    parser.add_option('-r', '--repeat',         help='Runs per matrix cell; the fastest is reported [1]', dest='repeat', default='1')
+    parser.add_option('-p', '--parameters-file', help='tvc parameters file [optional]', dest='paramfile')
+    parser.add_option('-t', '--tvc',            help='tvc executable [tvc]', dest='tvc', default='tvc')
+    parser.add_option('-g', '--tvcbench',       help='tvcbench executable [tvcbench]', dest='tvcbench', default='tvcbench')
+    parser.add_option('-o', '--output-tsv',     help='Results table [WORK_DIR/benchmark.tsv]', dest='output')
+    (options, args) = parser.parse_args()
+
+    if options.workdir is None:
+        parser.print_help()
+        return 1
+    if options.paramfile and not os.path.isfile(options.paramfile):
+        printtime('ERROR: No parameter file found at: ' + options.paramfile)
+        return 1
+    if not os.path.isdir(options.workdir):
+        os.makedirs(options.workdir)
+    if options.output is None:
+        options.output = os.path.join(options.workdir, 'benchmark.tsv')
+
+    results = []
+    for depth in IntList(options.depths):
+
+        # Data sets are reused when they were generated with the same settings
+        dataset = os.path.join(options.workdir, 'depth_%d' % depth)
+        generate_command = [options.tvcbench, 'generate',
+            '--output-dir',     dataset,
+            '--depth',          str(depth),
+            '--num-amplicons',  options.amplicons,
+            '--read-length',    options.readlength,
+            '--error-rate',     options.errorrate,
+            '--seed',           options.seed]
+        stamp_filename = os.path.join(dataset, 'generate_command.txt')
+        stamp = ' '.join(generate_command[1:])
+        if not os.path.isfile(stamp_filename) or open(stamp_filename).read().strip() != stamp:
+            printtime('Generating ' + dataset)
+            if not os.path.isdir(dataset):
+                os.makedirs(dataset)
+            (status, wall_time, peak_rss) = RunTimed(generate_command, os.path.join(dataset, 'generate.log'))
+            if status != 0:
+                printtime('ERROR: tvcbench generate failed with status %d, see %s/generate.log' % (status, dataset))
+                return 1
+            open(stamp_filename, 'w').write(stamp + '\n')
+
+        num_reads = 0
+        for line in open(os.path.join(dataset, 'generate.log')):
+            match = re.match(r'Wrote (\d+) reads', line)
+            if match:
+                num_reads = int(match.group(1))
+
+        for threads in IntList(options.threads):
+            outdir = os.path.join(dataset, 'threads_%d' % threads)
+            if not os.path.isdir(outdir):
+                os.makedirs(outdir)
+            tvc_command = [options.tvc,
+                '--reference',              os.path.join(dataset, 'reference.fasta'),
+                '--input-bam',              os.path.join(dataset, 'reads.bam'),
+                '--target-file',            os.path.join(dataset, 'targets.bed'),
+                '--trim-ampliseq-primers',  'on',
+                '--num-threads',            str(threads),
+                '--output-dir',             outdir,
+                '--output-vcf',             'small_variants.vcf']
+            if options.paramfile:
+                tvc_command += ['--parameters-file', options.paramfile]
+
+            best = None
+            for run in range(int(options.repeat)):
+                printtime('Running tvc: depth %d, %d threads, run %d' % (depth, threads, run + 1))
+                (status, wall_time, peak_rss) = RunTimed(tvc_command, os.path.join(outdir, 'tvc.log'))
+                if status != 0:
+                    printtime('ERROR: tvc failed with status %d, see %s/tvc.log' % (status, outdir))
+                    return 1
+                if best is None or wall_time < best[0]:
+                    best = (wall_time, peak_rss)
+            results.append((depth, threads, num_reads, best[0], best[1], num_reads / max(best[0], 1e-6)))
+
+    header = ('depth', 'threads', 'reads', 'wall_s', 'peak_rss_mb', 'reads_per_s')
+    output = open(options.output, 'w')
+    output.write('\t'.join(header) + '\n')
+    print('')
+    print('%8s %8s %10s %10s %12s %12s' % header)
+    for (depth, threads, num_reads, wall_time, peak_rss, throughput) in results:
+        output.write('%d\t%d\t%d\t%.2f\t%.1f\t%.0f\n' % (depth, threads, num_reads, wall_time, peak_rss, throughput))
+        print('%8d %8d %10d %10.2f %12.1f %12.0f' % (depth, threads, num_reads, wall_time, peak_rss, throughput))
+    output.close()
+    printtime('Results written to ' + options.output)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())